@@ -0,0 +1,185 @@
+//! Shared fixtures for the benchmark suite, and the machine-readable summary.
+//!
+//! Criterion keeps its own per-benchmark estimates under `target/criterion`.
+//! After a run, `write_summary` flattens every estimate found there into
+//! `target/criterion/summary.json`, one record per benchmark id:
+//!
+//! ```json
+//! {"benchmarks": [{"id": "ppm_get_probs/arena/3", "mean_ns": 812.4, "median_ns": 803.1, "std_dev_ns": 21.7}]}
+//! ```
+//!
+//! The file can be compared across releases without parsing criterion's layout.
+
+#![allow(dead_code)]
+
+use std::fs;
+use std::path::{Path, PathBuf};
+
+use dasher_core::alphabet::load_symbol_table;
+use dasher_core::model::{ArenaPPMLanguageModel, LanguageModel, PPMOrder};
+use dasher_core::view::{Color, DasherScreen, Label};
+use dasher_core::{Alphabet, DasherModel};
+use serde_json::{json, Value};
+
+/// Size of the training text used by the model benchmarks, in bytes
+pub const CORPUS_BYTES: usize = 16 << 10;
+
+/// Path of a file in the repository
+pub fn data_path(relative: &str) -> PathBuf {
+    Path::new(env!("CARGO_MANIFEST_DIR")).join(relative)
+}
+
+/// The start of the English training text, restricted to ASCII
+///
+/// `PPMLanguageModel` slices its contexts by byte, so the corpus is kept to
+/// single-byte characters for every model to see the same input.
+pub fn corpus() -> String {
+    let text = fs::read_to_string(data_path("data/training/training_english_GB.txt"))
+        .expect("training text is missing");
+    text.chars().filter(char::is_ascii).take(CORPUS_BYTES).collect()
+}
+
+/// The CJK alphabet with the largest symbol table in the tree
+pub fn cangjie_alphabet() -> Alphabet {
+    load_symbol_table(data_path("data/alphabets/autoConverted/alphabet.cantonese.trad.by.cangjie.xml"))
+        .expect("cangjie alphabet is missing")
+        .into_alphabet()
+}
+
+/// An initialised model with `alphabet` and an order 3 model trained on the corpus
+pub fn trained_model(alphabet: Alphabet) -> DasherModel {
+    let mut language_model = ArenaPPMLanguageModel::new(PPMOrder::Three);
+    for c in corpus().chars() {
+        language_model.enter_symbol(c);
+    }
+    let mut model = DasherModel::new();
+    model.set_alphabet(alphabet);
+    model.set_language_model(Box::new(language_model));
+    model.initialize().expect("model failed to initialise");
+    model
+}
+
+/// Label that only keeps its text
+pub struct NullLabel {
+    text: String,
+    wrap_size: u32,
+}
+
+impl Label for NullLabel {
+    fn get_text(&self) -> &str {
+        &self.text
+    }
+
+    fn get_wrap_size(&self) -> u32 {
+        self.wrap_size
+    }
+}
+
+/// Screen that measures text with a fixed advance and discards all drawing
+pub struct NullScreen {
+    pub width: i32,
+    pub height: i32,
+}
+
+impl DasherScreen for NullScreen {
+    fn get_width(&self) -> i32 {
+        self.width
+    }
+
+    fn get_height(&self) -> i32 {
+        self.height
+    }
+
+    fn make_label(&self, text: &str, wrap_size: u32) -> Box<dyn Label> {
+        Box::new(NullLabel { text: text.to_string(), wrap_size })
+    }
+
+    fn text_size(&self, label: &dyn Label, font_size: u32) -> (i32, i32) {
+        let chars = label.get_text().chars().count() as i32;
+        (chars * font_size as i32 / 2, font_size as i32)
+    }
+
+    fn draw_string(&mut self, _label: &dyn Label, _x: i32, _y: i32, _font_size: u32, _color: Color) {}
+
+    fn draw_rectangle(&mut self, _x1: i32, _y1: i32, _x2: i32, _y2: i32,
+                      _fill_color: Color, _outline_color: Color, _line_width: i32) {}
+
+    fn draw_circle(&mut self, _cx: i32, _cy: i32, _r: i32,
+                   _fill_color: Color, _line_color: Color, _line_width: i32) {}
+
+    fn draw_line(&mut self, _x1: i32, _y1: i32, _x2: i32, _y2: i32, _color: Color, _line_width: i32) {}
+
+    fn display(&mut self) {}
+
+    fn is_point_visible(&self, _x: i32, _y: i32) -> bool {
+        true
+    }
+}
+
+/// Directory criterion writes its results to
+fn criterion_dir() -> PathBuf {
+    if let Some(home) = std::env::var_os("CRITERION_HOME") {
+        return PathBuf::from(home);
+    }
+    let target = std::env::var_os("CARGO_TARGET_DIR")
+        .map(PathBuf::from)
+        .unwrap_or_else(|| data_path("target"));
+    target.join("criterion")
+}
+
+/// Collect `<id>/new/{benchmark,estimates}.json` records below `dir`
+fn collect_estimates(dir: &Path, records: &mut Vec<Value>) {
+    let entries = match fs::read_dir(dir) {
+        Ok(entries) => entries,
+        Err(_) => return,
+    };
+    for entry in entries.flatten() {
+        let path = entry.path();
+        if !path.is_dir() {
+            continue;
+        }
+        if path.file_name().map_or(false, |name| name == "new") {
+            let read = |name: &str| -> Option<Value> {
+                serde_json::from_str(&fs::read_to_string(path.join(name)).ok()?).ok()
+            };
+            if let (Some(benchmark), Some(estimates)) = (read("benchmark.json"), read("estimates.json")) {
+                records.push(json!({
+                    "id": benchmark["full_id"],
+                    "mean_ns": estimates["mean"]["point_estimate"],
+                    "median_ns": estimates["median"]["point_estimate"],
+                    "std_dev_ns": estimates["std_dev"]["point_estimate"],
+                }));
+            }
+        } else if path.file_name().map_or(true, |name| name != "base" && name != "report") {
+            collect_estimates(&path, records);
+        }
+    }
+}
+
+/// Write `summary.json` next to criterion's results
+pub fn write_summary() {
+    let dir = criterion_dir();
+    let mut records = Vec::new();
+    collect_estimates(&dir, &mut records);
+    records.sort_by(|a, b| a["id"].as_str().cmp(&b["id"].as_str()));
+
+    let summary = json!({ "benchmarks": records });
+    let path = dir.join("summary.json");
+    let text = serde_json::to_string_pretty(&summary).expect("summary is valid JSON");
+    match fs::create_dir_all(&dir).and_then(|_| fs::write(&path, text)) {
+        Ok(()) => println!("Wrote {}", path.display()),
+        Err(e) => eprintln!("Failed to write {}: {}", path.display(), e),
+    }
+}
+
+/// Define `main` for a benchmark binary: run the groups, then refresh the summary
+#[macro_export]
+macro_rules! bench_main {
+    ($($group:path),+ $(,)*) => {
+        fn main() {
+            $($group();)+
+            criterion::Criterion::default().configure_from_args().final_summary();
+            common::write_summary();
+        }
+    };
+}
@@ -0,0 +1,62 @@
+//! Frame round trips through the C interface, as a host application drives it.
+
+mod common;
+
+use criterion::{criterion_group, Criterion};
+use dasher_core::api::profiler::FrameStats;
+use dasher_core::ffi::*;
+
+fn bench_new_frame(c: &mut Criterion) {
+    let mut group = c.benchmark_group("ffi");
+
+    unsafe {
+        let interface = dasher_interface_create(std::ptr::null());
+        assert!(!interface.is_null(), "interface creation failed");
+        let screen = dasher_create_screen(800, 600);
+        let input = dasher_create_mouse_input();
+        dasher_interface_set_screen(interface, screen);
+        dasher_interface_set_input(interface, input);
+        dasher_interface_start(interface);
+
+        let mut time_ms = 0u64;
+        let mut frame = 0i32;
+        group.bench_function("new_frame", |b| {
+            b.iter(|| {
+                // Sweep the pointer right of the crosshair so the model keeps zooming
+                frame = (frame + 1) % 200;
+                dasher_set_mouse_coordinates(input, 500 + frame, 200 + frame);
+                time_ms += 16;
+                dasher_interface_new_frame(interface, time_ms)
+            })
+        });
+
+        // Report what a steady-state frame allocates when the library counts it
+        if dasher_set_allocation_tracking(true) {
+            dasher_interface_new_frame(interface, time_ms + 16);
+            dasher_interface_new_frame(interface, time_ms + 32);
+            time_ms += 32;
+            let mut stats = FrameStats::default();
+            dasher_interface_get_frame_stats(interface, &mut stats);
+            println!("ffi/new_frame allocations: {} ({} bytes)",
+                     stats.last_counts.allocations, stats.last_counts.allocated_bytes);
+            dasher_set_allocation_tracking(false);
+        }
+
+        let buffer = dasher_draw_buffer_create();
+        group.bench_function("render_into", |b| {
+            b.iter(|| {
+                time_ms += 16;
+                dasher_interface_render_into(interface, time_ms, buffer)
+            })
+        });
+
+        dasher_draw_buffer_destroy(buffer);
+        dasher_interface_destroy(interface);
+        dasher_destroy_screen(screen);
+        dasher_destroy_input(input);
+    }
+    group.finish();
+}
+
+criterion_group!(benches, bench_new_frame);
+bench_main!(benches);
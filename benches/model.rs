@@ -0,0 +1,135 @@
+//! Language model and DasherModel hot paths: PPM training and prediction,
+//! node expansion and zoom scheduling.
+
+mod common;
+
+use std::hint::black_box;
+
+use criterion::{criterion_group, BatchSize, BenchmarkId, Criterion, Throughput};
+use dasher_core::model::node::NodeFlags;
+use dasher_core::model::{ArenaPPMLanguageModel, LanguageModel, PPMLanguageModel, PPMOrder};
+use dasher_core::{Alphabet, DasherModel};
+
+/// Orders covered by the PPM benchmarks; `PPMOrder` stops at five
+const ORDERS: [PPMOrder; 4] = [PPMOrder::Two, PPMOrder::Three, PPMOrder::Four, PPMOrder::Five];
+
+/// Contexts queried by the prediction benchmarks
+const CONTEXTS: [&str; 4] = ["the quick ", "and then", "of th", "wh"];
+
+fn bench_enter_symbol(c: &mut Criterion) {
+    let corpus = common::corpus();
+    let chars = corpus.chars().count() as u64;
+    let mut group = c.benchmark_group("ppm_enter_symbol");
+    group.throughput(Throughput::Elements(chars));
+
+    for order in ORDERS {
+        group.bench_with_input(BenchmarkId::new("trie", order.value()), &corpus, |b, corpus| {
+            b.iter(|| {
+                let mut model = PPMLanguageModel::new(order);
+                let mut context = String::new();
+                for c in corpus.chars() {
+                    model.enter_symbol(&context, c);
+                    context.push(c);
+                    if context.len() > 8 {
+                        context.remove(0);
+                    }
+                }
+                model
+            })
+        });
+        group.bench_with_input(BenchmarkId::new("arena", order.value()), &corpus, |b, corpus| {
+            b.iter(|| {
+                let mut model = ArenaPPMLanguageModel::new(order);
+                for c in corpus.chars() {
+                    model.enter_symbol(c);
+                }
+                model
+            })
+        });
+    }
+    group.finish();
+}
+
+fn bench_get_probs(c: &mut Criterion) {
+    let corpus = common::corpus();
+    let mut group = c.benchmark_group("ppm_get_probs");
+    group.throughput(Throughput::Elements(CONTEXTS.len() as u64));
+
+    for order in ORDERS {
+        let mut trie = PPMLanguageModel::new(order);
+        let mut arena = ArenaPPMLanguageModel::new(order);
+        let mut context = String::new();
+        for c in corpus.chars() {
+            trie.enter_symbol(&context, c);
+            arena.enter_symbol(c);
+            context.push(c);
+            if context.len() > 8 {
+                context.remove(0);
+            }
+        }
+
+        group.bench_function(BenchmarkId::new("trie", order.value()), |b| {
+            b.iter(|| CONTEXTS.iter().map(|context| trie.get_probs(black_box(context)).len()).sum::<usize>())
+        });
+        group.bench_function(BenchmarkId::new("arena", order.value()), |b| {
+            b.iter(|| CONTEXTS.iter().map(|context| arena.get_probs(black_box(context)).len()).sum::<usize>())
+        });
+    }
+    group.finish();
+}
+
+fn bench_expand_node(c: &mut Criterion) {
+    let mut group = c.benchmark_group("expand_node");
+    group.sample_size(20);
+
+    let alphabets: [(&str, fn() -> Alphabet); 2] = [
+        ("english", Alphabet::english),
+        ("cangjie", common::cangjie_alphabet),
+    ];
+    for (name, alphabet) in alphabets {
+        let mut model = common::trained_model(alphabet());
+        let root = model.get_root_node().expect("model has no root");
+        group.bench_function(name, |b| {
+            b.iter(|| {
+                root.borrow_mut().set_flag(NodeFlags::ALL_CHILDREN, false);
+                model.expand_node(&root);
+            })
+        });
+    }
+    group.finish();
+}
+
+fn bench_zoom(c: &mut Criterion) {
+    let mut group = c.benchmark_group("next_scheduled_step");
+    let centre = DasherModel::MAX_Y / 2;
+
+    for steps in [8, 32, 128] {
+        group.bench_with_input(BenchmarkId::new("zoom_in", steps), &steps, |b, &steps| {
+            b.iter_batched_ref(
+                || {
+                    let mut model = common::trained_model(Alphabet::english());
+                    model.schedule_zoom(centre - DasherModel::MAX_Y / 8, centre + DasherModel::MAX_Y / 8, steps);
+                    model
+                },
+                |model| while model.next_scheduled_step() {},
+                BatchSize::LargeInput,
+            )
+        });
+        // Four steps per frame, as after dropped frames
+        group.bench_with_input(BenchmarkId::new("zoom_in_batched", steps), &steps, |b, &steps| {
+            b.iter_batched_ref(
+                || {
+                    let mut model = common::trained_model(Alphabet::english());
+                    model.schedule_zoom(centre - DasherModel::MAX_Y / 8, centre + DasherModel::MAX_Y / 8, steps);
+                    model
+                },
+                |model| while model.next_scheduled_steps(4) {},
+                BatchSize::LargeInput,
+            )
+        });
+    }
+    group.finish();
+}
+
+criterion_group!(benches, bench_enter_symbol, bench_get_probs, bench_expand_node, bench_zoom);
+bench_main!(benches);
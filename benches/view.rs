@@ -0,0 +1,36 @@
+//! Square view rendering into a screen that discards its drawing, and into a
+//! reusable draw command buffer.
+
+mod common;
+
+use criterion::{criterion_group, Criterion};
+use dasher_core::view::{DasherView, DasherViewSquare, DrawCommandBuffer};
+use dasher_core::Alphabet;
+
+fn bench_render(c: &mut Criterion) {
+    let mut group = c.benchmark_group("square_render");
+
+    let alphabets: [(&str, fn() -> Alphabet); 2] = [
+        ("english", Alphabet::english),
+        ("cangjie", common::cangjie_alphabet),
+    ];
+    for (name, alphabet) in alphabets {
+        let mut model = common::trained_model(alphabet());
+        let mut view = DasherViewSquare::new(Box::new(common::NullScreen { width: 800, height: 600 }));
+        group.bench_function(format!("null_screen/{}", name), |b| {
+            b.iter(|| view.render(&mut model).expect("render failed"))
+        });
+
+        let mut buffer = DrawCommandBuffer::new();
+        group.bench_function(format!("draw_buffer/{}", name), |b| {
+            b.iter(|| {
+                view.render_into(&mut model, &mut buffer).expect("render failed");
+                buffer.commands().len()
+            })
+        });
+    }
+    group.finish();
+}
+
+criterion_group!(benches, bench_render);
+bench_main!(benches);
@@ -0,0 +1,119 @@
+// WebGL renderer for frames tessellated by DasherInterfaceWasm.render_vertices.
+//
+// The triangle list is read as a zero-copy view of WASM memory and uploaded
+// in one bufferData call, then drawn in one drawArrays call. Labels go on a 2D
+// canvas stacked over the WebGL one; there are only a few per frame.
+//
+//   const renderer = new VertexRenderer(glCanvas, labelCanvas);
+//   dasher.set_viewport(glCanvas.width, glCanvas.height);
+//   function frame(t) { dasher.render_vertices(BigInt(Math.floor(t))); renderer.draw(dasher); ... }
+
+const VERTEX_SHADER = `
+attribute vec2 a_position;
+attribute vec4 a_color;
+uniform vec2 u_viewport;
+varying vec4 v_color;
+void main() {
+  vec2 clip = a_position / u_viewport * 2.0 - 1.0;
+  gl_Position = vec4(clip.x, -clip.y, 0.0, 1.0);
+  v_color = a_color;
+}`;
+
+const FRAGMENT_SHADER = `
+precision mediump float;
+varying vec4 v_color;
+void main() {
+  gl_FragColor = v_color;
+}`;
+
+// Bytes per vertex: x, y as f32 and RGBA as 4 bytes
+const VERTEX_STRIDE = 12;
+
+// Words per label: x, y, font size (f32), color, id, text offset, text length (u32)
+const LABEL_WORDS = 7;
+
+function compile(gl, type, source) {
+  const shader = gl.createShader(type);
+  gl.shaderSource(shader, source);
+  gl.compileShader(shader);
+  if (!gl.getShaderParameter(shader, gl.COMPILE_STATUS)) {
+    throw new Error(gl.getShaderInfoLog(shader));
+  }
+  return shader;
+}
+
+export class VertexRenderer {
+  constructor(glCanvas, labelCanvas) {
+    const gl = glCanvas.getContext('webgl', { antialias: true });
+    if (!gl) throw new Error('WebGL is not available');
+    this.gl = gl;
+    this.labels = labelCanvas.getContext('2d');
+    this.labelText = new Map(); // label id -> text
+
+    const program = gl.createProgram();
+    gl.attachShader(program, compile(gl, gl.VERTEX_SHADER, VERTEX_SHADER));
+    gl.attachShader(program, compile(gl, gl.FRAGMENT_SHADER, FRAGMENT_SHADER));
+    gl.linkProgram(program);
+    if (!gl.getProgramParameter(program, gl.LINK_STATUS)) {
+      throw new Error(gl.getProgramInfoLog(program));
+    }
+    gl.useProgram(program);
+
+    this.viewport = gl.getUniformLocation(program, 'u_viewport');
+    this.buffer = gl.createBuffer();
+    gl.bindBuffer(gl.ARRAY_BUFFER, this.buffer);
+    const position = gl.getAttribLocation(program, 'a_position');
+    const color = gl.getAttribLocation(program, 'a_color');
+    gl.enableVertexAttribArray(position);
+    gl.vertexAttribPointer(position, 2, gl.FLOAT, false, VERTEX_STRIDE, 0);
+    gl.enableVertexAttribArray(color);
+    gl.vertexAttribPointer(color, 4, gl.UNSIGNED_BYTE, true, VERTEX_STRIDE, 8);
+
+    gl.enable(gl.BLEND);
+    gl.blendFunc(gl.SRC_ALPHA, gl.ONE_MINUS_SRC_ALPHA);
+  }
+
+  // Draw the frame last rendered by dasher.render_vertices
+  draw(dasher) {
+    const gl = this.gl;
+    const { width, height } = gl.canvas;
+    gl.viewport(0, 0, width, height);
+    gl.uniform2f(this.viewport, width, height);
+    gl.clearColor(1, 1, 1, 1);
+    gl.clear(gl.COLOR_BUFFER_BIT);
+
+    // The views are only valid until the next call into WASM, so use them at once
+    const vertices = dasher.vertices();
+    gl.bindBuffer(gl.ARRAY_BUFFER, this.buffer);
+    gl.bufferData(gl.ARRAY_BUFFER, vertices, gl.STREAM_DRAW);
+    gl.drawArrays(gl.TRIANGLES, 0, dasher.vertex_count());
+
+    this.drawLabels(dasher);
+  }
+
+  drawLabels(dasher) {
+    const ctx = this.labels;
+    ctx.clearRect(0, 0, ctx.canvas.width, ctx.canvas.height);
+    ctx.textBaseline = 'middle';
+
+    // Copy the label table before label_text calls can move WASM memory
+    const floats = dasher.labels().slice();
+    const words = new Uint32Array(floats.buffer);
+    for (let i = 0; i < dasher.label_count(); i++) {
+      const base = i * LABEL_WORDS;
+      const id = words[base + 4];
+      let text = id !== 0 ? this.labelText.get(id) : undefined;
+      if (text === undefined) {
+        text = dasher.label_text(i) ?? '';
+        if (id !== 0) this.labelText.set(id, text);
+      }
+
+      const packed = words[base + 3];
+      const r = packed & 0xff, g = (packed >> 8) & 0xff, b = (packed >> 16) & 0xff;
+      const a = (packed >>> 24) / 255;
+      ctx.fillStyle = `rgba(${r}, ${g}, ${b}, ${a})`;
+      ctx.font = `${floats[base + 2]}px sans-serif`;
+      ctx.fillText(text, floats[base], floats[base + 1]);
+    }
+  }
+}
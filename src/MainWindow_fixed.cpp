@@ -2,10 +2,179 @@
 
 #include <filesystem>
 #include <iostream>
+#include <set>
+#include <string>
+
+extern "C" size_t dasher_default_alphabet_glyphs(char* buffer, size_t buffer_size);
+
+namespace
+{
+    // Glyphs in the font atlas, kept so that alphabet switches only rebuild it for new glyphs
+    struct FontAtlasState
+    {
+        ImFont* Font = nullptr;
+        float PixelSize = 0.0f;
+        std::set<char32_t> Glyphs;
+        // ImGui reads the ranges again when the atlas is rebuilt, so they live here
+        ImVector<ImWchar> LatinRanges;
+        ImVector<ImWchar> ExtendedRanges;
+
+        bool Contains(const std::u32string& Text) const
+        {
+            for (char32_t c : Text)
+            {
+                if (Glyphs.count(c) == 0)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        void Add(const std::u32string& Text)
+        {
+            Glyphs.insert(Text.begin(), Text.end());
+        }
+    };
+
+    FontAtlasState& AtlasState()
+    {
+        static FontAtlasState State;
+        return State;
+    }
+
+    // Find the Resources directory once, rather than probing every font path separately
+    const std::string& ResourceDir()
+    {
+        static const std::string Dir = []
+        {
+            const char* Candidates[] = {
+                "Resources",
+                "../Resources",
+                "../../Resources",
+                "../../../Resources",
+                "/Users/willwade/GitHub/DasherCoreRust/DasherUI-main/Resources"
+            };
+            for (const char* Candidate : Candidates)
+            {
+                std::error_code Error;
+                if (std::filesystem::exists(std::filesystem::path(Candidate) / "NotoSans-Medium.ttf", Error))
+                {
+                    std::cout << "Using fonts from: " << Candidate << std::endl;
+                    return std::string(Candidate);
+                }
+            }
+            std::cout << "No Resources directory with fonts found" << std::endl;
+            return std::string();
+        }();
+        return Dir;
+    }
+
+    // Characters of the alphabet the Rust interface starts with
+    std::string DefaultAlphabetGlyphs()
+    {
+        std::string Glyphs(dasher_default_alphabet_glyphs(nullptr, 0), '\0');
+        dasher_default_alphabet_glyphs(Glyphs.data(), Glyphs.size() + 1);
+        return Glyphs;
+    }
+
+    // Decode UTF-8, keeping the code points ImGui can hold in an ImWchar
+    std::u32string DecodeUtf8(const std::string& Text)
+    {
+        std::u32string Result;
+        for (size_t i = 0; i < Text.size();)
+        {
+            const unsigned char Lead = static_cast<unsigned char>(Text[i]);
+            const size_t Length = Lead < 0x80 ? 1 : Lead < 0xE0 ? 2 : Lead < 0xF0 ? 3 : 4;
+            char32_t c = Length == 1 ? Lead : Lead & (0x7F >> Length);
+            for (size_t j = 1; j < Length && i + j < Text.size(); j++)
+            {
+                c = (c << 6) | (static_cast<unsigned char>(Text[i + j]) & 0x3F);
+            }
+            i += Length;
+            if (c <= IM_UNICODE_CODEPOINT_MAX)
+            {
+                Result.push_back(c);
+            }
+        }
+        return Result;
+    }
+
+    // Build the atlas for the UTF-8 characters in alphabet_glyphs, reusing it when they are already in it.
+    // A rebuild frees every ImFont the atlas held, so this only runs outside ImGui::NewFrame()/Render().
+    ImFont* BuildFontAtlas(float pixel_size, const std::string& alphabet_glyphs)
+    {
+        ImGuiIO& io = ImGui::GetIO();
+        std::u32string glyphs = DecodeUtf8(alphabet_glyphs);
+        glyphs.push_back(0x25A1); // box
+
+        FontAtlasState& atlas = AtlasState();
+        if (atlas.Font != nullptr && atlas.PixelSize == pixel_size && atlas.Contains(glyphs)) {
+            // Switching to an alphabet whose glyphs are already in the atlas costs nothing
+            return atlas.Font;
+        }
+        if (atlas.PixelSize != pixel_size) {
+            atlas.Glyphs.clear();
+        }
+        atlas.Add(glyphs);
+        atlas.PixelSize = pixel_size;
+
+        // Rebuild from the union of every alphabet used so far. The renderer backend
+        // re-uploads the font texture when the atlas changes.
+        io.Fonts->Clear();
+        atlas.Font = nullptr;
+        atlas.LatinRanges.clear();
+        atlas.ExtendedRanges.clear();
+
+        ImFontGlyphRangesBuilder latin;
+        ImFontGlyphRangesBuilder extended;
+        latin.AddRanges(io.Fonts->GetGlyphRangesDefault());
+        for (char32_t c : atlas.Glyphs) {
+            // The Latin font covers Latin, Greek and Cyrillic; anything beyond comes from the Japanese font
+            (c < 0x0530 ? latin : extended).AddChar(static_cast<ImWchar>(c));
+        }
+        latin.BuildRanges(&atlas.LatinRanges);
+        extended.BuildRanges(&atlas.ExtendedRanges);
+
+        const std::string& resources = ResourceDir();
+        if (!resources.empty()) {
+            const std::string path = resources + "/NotoSans-Medium.ttf";
+            atlas.Font = io.Fonts->AddFontFromFileTTF(path.c_str(), pixel_size, nullptr, atlas.LatinRanges.Data);
+            if (atlas.Font != nullptr) {
+                std::cout << "Successfully loaded font from: " << path << std::endl;
+            } else {
+                std::cout << "Failed to load font from: " << path << std::endl;
+            }
+        }
+
+        if (atlas.Font == nullptr) {
+            std::cout << "Failed to load any font. Using default font." << std::endl;
+            atlas.Font = io.Fonts->AddFontDefault();
+            return atlas.Font;
+        }
+
+        // Skip the Japanese font entirely when the alphabet needs nothing from it
+        if (atlas.ExtendedRanges.Size > 1) {
+            ImFontConfig config;
+            config.MergeMode = true;
+
+            const std::string path = resources + "/NotoSansJP-Medium.otf";
+            if (io.Fonts->AddFontFromFileTTF(path.c_str(), pixel_size, &config, atlas.ExtendedRanges.Data) != nullptr) {
+                std::cout << "Successfully loaded Japanese font from: " << path << std::endl;
+            } else {
+                std::cout << "Failed to load Japanese font." << std::endl;
+            }
+        }
+
+        io.Fonts->Build();
+        std::cout << "Built font atlas with " << atlas.Glyphs.size() << " alphabet glyphs" << std::endl;
+        return atlas.Font;
+    }
+}
 
 MainWindow::MainWindow()
 {
-	ImGui::SetCurrentFont(LoadFonts(22.0f));
+	ImGui::GetIO().FontDefault = LoadFonts(22.0f);
 
 	Controller = std::make_unique<NewDasherController>();
 	Controller->Initialize();
@@ -109,81 +278,6 @@ void MainWindow::ClearBuffer() const
 
 ImFont* MainWindow::LoadFonts(float pixel_size)
 {
-    ImVector<ImWchar> ranges;
-    ImFontGlyphRangesBuilder builder;
-    builder.AddRanges(ImGui::GetIO().Fonts->GetGlyphRangesJapanese());
-    builder.AddText("\xE2\x96\xA1"); // box
-    builder.BuildRanges(&ranges);
-
-    ImGuiIO& io = ImGui::GetIO();
-    
-    // Try different paths for the main font
-    const char* fontPaths[] = {
-        "Resources/NotoSans-Medium.ttf",
-        "../Resources/NotoSans-Medium.ttf",
-        "../../Resources/NotoSans-Medium.ttf",
-        "../../../Resources/NotoSans-Medium.ttf",
-        "./Resources/NotoSans-Medium.ttf",
-        "/Users/willwade/GitHub/DasherCoreRust/DasherUI-main/Resources/NotoSans-Medium.ttf"
-    };
-    
-    ImFont* font = nullptr;
-    for (const char* path : fontPaths) {
-        std::cout << "Trying to load font from: " << path << std::endl;
-        if (std::filesystem::exists(path)) {
-            std::cout << "Font file exists at: " << path << std::endl;
-            font = io.Fonts->AddFontFromFileTTF(path, pixel_size, nullptr, io.Fonts->GetGlyphRangesDefault());
-            if (font != nullptr) {
-                std::cout << "Successfully loaded font from: " << path << std::endl;
-                break;
-            } else {
-                std::cout << "Failed to load font from: " << path << std::endl;
-            }
-        } else {
-            std::cout << "Font file does not exist at: " << path << std::endl;
-        }
-    }
-    
-    if (font == nullptr) {
-        std::cout << "Failed to load any font. Using default font." << std::endl;
-        font = io.Fonts->AddFontDefault();
-        return font;
-    }
-    
-    // Try different paths for the Japanese font
-    const char* jpFontPaths[] = {
-        "Resources/NotoSansJP-Medium.otf",
-        "../Resources/NotoSansJP-Medium.otf",
-        "../../Resources/NotoSansJP-Medium.otf",
-        "../../../Resources/NotoSansJP-Medium.otf",
-        "./Resources/NotoSansJP-Medium.otf",
-        "/Users/willwade/GitHub/DasherCoreRust/DasherUI-main/Resources/NotoSansJP-Medium.otf"
-    };
-    
-    ImFontConfig config;
-    config.MergeMode = true;
-    
-    bool jpFontLoaded = false;
-    for (const char* path : jpFontPaths) {
-        std::cout << "Trying to load Japanese font from: " << path << std::endl;
-        if (std::filesystem::exists(path)) {
-            std::cout << "Japanese font file exists at: " << path << std::endl;
-            if (io.Fonts->AddFontFromFileTTF(path, pixel_size, &config, ranges.Data) != nullptr) {
-                std::cout << "Successfully loaded Japanese font from: " << path << std::endl;
-                jpFontLoaded = true;
-                break;
-            } else {
-                std::cout << "Failed to load Japanese font from: " << path << std::endl;
-            }
-        } else {
-            std::cout << "Japanese font file does not exist at: " << path << std::endl;
-        }
-    }
-    
-    if (!jpFontLoaded) {
-        std::cout << "Failed to load Japanese font." << std::endl;
-    }
-    
-    io.Fonts->Build();
-    return font;
+    // Only the glyphs the alphabet can show or write are rasterised
+    return BuildFontAtlas(pixel_size, DefaultAlphabetGlyphs());
 }
@@ -0,0 +1,268 @@
+// Headless replay of recorded input traces through the Dasher FFI.
+//
+// A trace is recorded from a live session with dasher_trace_start_recording()
+// and dasher_trace_stop_recording(). This driver feeds it back through the same
+// entry points MainWindow uses, against a screen without draw callbacks, and
+// reports how long each frame took and the text that was written.
+//
+//   replay_harness session.trace [--width 1280] [--height 720] [--warmup 30] [--csv frames.csv]
+//
+// Build against the static library:
+//   c++ -std=c++17 -O2 src/ReplayHarness.cpp target/release/libdasher_core.a -lpthread -ldl -o replay_harness
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+extern "C" {
+    struct DasherInterfaceFFI;
+    struct DasherScreenFFI;
+    struct DasherInputFFI;
+
+    struct DasherTextSpan
+    {
+        const char* data;
+        size_t len;
+        uint64_t generation;
+    };
+
+    DasherInterfaceFFI* dasher_interface_create(void* settings);
+    void dasher_interface_destroy(DasherInterfaceFFI* interface);
+    bool dasher_interface_new_frame(DasherInterfaceFFI* interface, uint64_t time_ms);
+    bool dasher_interface_set_screen(DasherInterfaceFFI* interface, DasherScreenFFI* screen);
+    bool dasher_interface_set_input(DasherInterfaceFFI* interface, DasherInputFFI* input);
+    void dasher_interface_start(DasherInterfaceFFI* interface);
+    void dasher_interface_key_down(DasherInterfaceFFI* interface, uint64_t time_ms, int32_t key);
+    void dasher_interface_key_up(DasherInterfaceFFI* interface, uint64_t time_ms, int32_t key);
+    DasherTextSpan dasher_interface_get_output_span(const DasherInterfaceFFI* interface);
+
+    DasherScreenFFI* dasher_create_screen(int32_t width, int32_t height);
+    void dasher_destroy_screen(DasherScreenFFI* screen);
+
+    DasherInputFFI* dasher_create_mouse_input();
+    void dasher_destroy_input(DasherInputFFI* input);
+    bool dasher_set_mouse_coordinates(DasherInputFFI* input, int32_t x, int32_t y);
+}
+
+namespace
+{
+    enum class EventKind
+    {
+        Mouse,
+        KeyDown,
+        KeyUp,
+        Frame
+    };
+
+    struct TraceEvent
+    {
+        uint64_t TimeMs = 0;
+        EventKind Kind = EventKind::Frame;
+        int32_t A = 0;
+        int32_t B = 0;
+    };
+
+    struct Options
+    {
+        std::string TracePath;
+        std::string CsvPath;
+        int32_t Width = 1280;
+        int32_t Height = 720;
+        size_t Warmup = 30;
+    };
+
+    // Parse the line format written by src/ffi/trace.rs; returns false for comments and unknown lines
+    bool ParseEvent(const std::string& Line, TraceEvent& Event)
+    {
+        if (Line.empty() || Line[0] == '#')
+        {
+            return false;
+        }
+
+        std::istringstream Fields(Line);
+        std::string Kind;
+        if (!(Fields >> Event.TimeMs >> Kind))
+        {
+            return false;
+        }
+
+        if (Kind == "mouse")
+        {
+            Event.Kind = EventKind::Mouse;
+            return static_cast<bool>(Fields >> Event.A >> Event.B);
+        }
+        if (Kind == "down" || Kind == "up")
+        {
+            Event.Kind = Kind == "down" ? EventKind::KeyDown : EventKind::KeyUp;
+            return static_cast<bool>(Fields >> Event.A);
+        }
+        if (Kind == "frame")
+        {
+            Event.Kind = EventKind::Frame;
+            return true;
+        }
+        return false;
+    }
+
+    bool LoadTrace(const std::string& Path, std::vector<TraceEvent>& Events)
+    {
+        std::ifstream File(Path);
+        if (!File)
+        {
+            return false;
+        }
+
+        std::string Line;
+        TraceEvent Event;
+        while (std::getline(File, Line))
+        {
+            if (ParseEvent(Line, Event))
+            {
+                Events.push_back(Event);
+            }
+        }
+        return true;
+    }
+
+    bool ParseOptions(int argc, char** argv, Options& Result)
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            const std::string Arg = argv[i];
+            const bool HasValue = i + 1 < argc;
+            if (Arg == "--width" && HasValue)
+            {
+                Result.Width = std::atoi(argv[++i]);
+            }
+            else if (Arg == "--height" && HasValue)
+            {
+                Result.Height = std::atoi(argv[++i]);
+            }
+            else if (Arg == "--warmup" && HasValue)
+            {
+                Result.Warmup = static_cast<size_t>(std::atol(argv[++i]));
+            }
+            else if (Arg == "--csv" && HasValue)
+            {
+                Result.CsvPath = argv[++i];
+            }
+            else if (Result.TracePath.empty() && Arg[0] != '-')
+            {
+                Result.TracePath = Arg;
+            }
+            else
+            {
+                return false;
+            }
+        }
+        return !Result.TracePath.empty();
+    }
+
+    // Nearest-rank percentile of sorted samples
+    double Percentile(const std::vector<double>& Sorted, double P)
+    {
+        if (Sorted.empty())
+        {
+            return 0.0;
+        }
+        const size_t Rank = static_cast<size_t>(P / 100.0 * static_cast<double>(Sorted.size() - 1) + 0.5);
+        return Sorted[std::min(Rank, Sorted.size() - 1)];
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options Opts;
+    if (!ParseOptions(argc, argv, Opts))
+    {
+        std::cerr << "usage: replay_harness TRACE [--width N] [--height N] [--warmup FRAMES] [--csv FILE]" << std::endl;
+        return 2;
+    }
+
+    std::vector<TraceEvent> Events;
+    if (!LoadTrace(Opts.TracePath, Events))
+    {
+        std::cerr << "Failed to read " << Opts.TracePath << std::endl;
+        return 1;
+    }
+
+    DasherInterfaceFFI* Interface = dasher_interface_create(nullptr);
+    if (!Interface)
+    {
+        std::cerr << "Failed to create the Dasher interface" << std::endl;
+        return 1;
+    }
+
+    // A screen without callbacks discards all drawing
+    DasherScreenFFI* Screen = dasher_create_screen(Opts.Width, Opts.Height);
+    DasherInputFFI* Input = dasher_create_mouse_input();
+    dasher_interface_set_screen(Interface, Screen);
+    dasher_interface_set_input(Interface, Input);
+    dasher_interface_start(Interface);
+
+    using Clock = std::chrono::steady_clock;
+    std::vector<double> FrameMicros;
+    FrameMicros.reserve(Events.size());
+
+    for (const TraceEvent& Event : Events)
+    {
+        switch (Event.Kind)
+        {
+        case EventKind::Mouse:
+            dasher_set_mouse_coordinates(Input, Event.A, Event.B);
+            // The interface keeps its own copy of the device, so hand it the new position
+            dasher_interface_set_input(Interface, Input);
+            break;
+        case EventKind::KeyDown:
+            dasher_interface_key_down(Interface, Event.TimeMs, Event.A);
+            break;
+        case EventKind::KeyUp:
+            dasher_interface_key_up(Interface, Event.TimeMs, Event.A);
+            break;
+        case EventKind::Frame:
+        {
+            const Clock::time_point Start = Clock::now();
+            dasher_interface_new_frame(Interface, Event.TimeMs);
+            FrameMicros.push_back(std::chrono::duration<double, std::micro>(Clock::now() - Start).count());
+            break;
+        }
+        }
+    }
+
+    if (!Opts.CsvPath.empty())
+    {
+        std::ofstream Csv(Opts.CsvPath);
+        Csv << "frame,micros\n";
+        for (size_t i = 0; i < FrameMicros.size(); i++)
+        {
+            Csv << i << ',' << FrameMicros[i] << '\n';
+        }
+    }
+
+    // Warm-up frames fill caches and node pools; leave them out of the percentiles
+    const size_t Skip = std::min(Opts.Warmup, FrameMicros.size());
+    std::vector<double> Sorted(FrameMicros.begin() + static_cast<std::ptrdiff_t>(Skip), FrameMicros.end());
+    std::sort(Sorted.begin(), Sorted.end());
+
+    std::cout << "events " << Events.size() << ", frames " << FrameMicros.size() << " (" << Skip << " warm-up)" << std::endl;
+    std::cout << "frame us: p50 " << Percentile(Sorted, 50.0)
+              << "  p90 " << Percentile(Sorted, 90.0)
+              << "  p99 " << Percentile(Sorted, 99.0)
+              << "  p99.9 " << Percentile(Sorted, 99.9)
+              << "  max " << (Sorted.empty() ? 0.0 : Sorted.back()) << std::endl;
+
+    const DasherTextSpan Output = dasher_interface_get_output_span(Interface);
+    std::cout << "output: " << std::string(Output.data ? Output.data : "", Output.len) << std::endl;
+
+    dasher_interface_destroy(Interface);
+    dasher_destroy_screen(Screen);
+    dasher_destroy_input(Input);
+    return 0;
+}
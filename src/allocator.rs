@@ -0,0 +1,237 @@
+//! # Allocator
+//!
+//! Global allocator for the C library, built with the `ffi-allocator` feature.
+//! It serves every Rust allocation from the system allocator or, once a host
+//! installs them, from host callbacks such as a C++ application's own arena.
+//! While tracking is on it also counts allocations and bytes. The frame
+//! profiler subtracts these counts at the start and end of each frame, so a
+//! host can check that frames in a steady state make no allocations.
+//!
+//! The callbacks must be installed before the library makes its first
+//! allocation. Without this, blocks from one allocator would be freed by the
+//! other. Counts cover every thread, including the simulation and training
+//! threads.
+//!
+//! Without the feature Rust's default allocator is used. Installing callbacks
+//! and enabling tracking then fail, and the counts stay at zero. The C entry
+//! points that wrap this module live in `ffi`.
+
+use std::alloc::{GlobalAlloc, Layout, System};
+use std::ffi::c_void;
+use std::sync::atomic::{AtomicBool, AtomicPtr, AtomicU64, AtomicU8, AtomicUsize, Ordering};
+
+/// Host callback that allocates `size` bytes aligned to `align`, or returns null
+pub type HostAllocFn = unsafe extern "C" fn(size: usize, align: usize, user_data: *mut c_void) -> *mut u8;
+
+/// Host callback that frees a block returned by the matching `HostAllocFn`
+pub type HostFreeFn = unsafe extern "C" fn(ptr: *mut u8, size: usize, align: usize, user_data: *mut c_void);
+
+/// Allocation counts since the library was loaded
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct AllocationStats {
+    /// Number of allocations, counting each reallocation as one
+    pub allocations: u64,
+    /// Number of blocks freed
+    pub deallocations: u64,
+    /// Bytes requested, counting each reallocation in full
+    pub allocated_bytes: u64,
+    /// Bytes currently allocated
+    pub live_bytes: u64,
+}
+
+/// No allocation has been made yet
+const STATE_UNUSED: u8 = 0;
+/// Host callbacks are being stored
+const STATE_INSTALLING: u8 = 1;
+/// Allocations go to the system allocator
+const STATE_SYSTEM: u8 = 2;
+/// Allocations go to the host callbacks
+const STATE_HOST: u8 = 3;
+
+static STATE: AtomicU8 = AtomicU8::new(STATE_UNUSED);
+static HOST_ALLOC: AtomicUsize = AtomicUsize::new(0);
+static HOST_FREE: AtomicUsize = AtomicUsize::new(0);
+static HOST_USER_DATA: AtomicPtr<c_void> = AtomicPtr::new(std::ptr::null_mut());
+
+static TRACKING: AtomicBool = AtomicBool::new(false);
+static ALLOCATIONS: AtomicU64 = AtomicU64::new(0);
+static DEALLOCATIONS: AtomicU64 = AtomicU64::new(0);
+static ALLOCATED_BYTES: AtomicU64 = AtomicU64::new(0);
+static LIVE_BYTES: AtomicU64 = AtomicU64::new(0);
+
+/// Check whether the library was built with its own global allocator
+pub const fn is_available() -> bool {
+    cfg!(feature = "ffi-allocator")
+}
+
+/// Route all later allocations to host callbacks
+///
+/// Returns false if the library has already allocated or was built without
+/// the `ffi-allocator` feature.
+///
+/// # Safety
+///
+/// The callbacks must behave like `malloc` and `free` for the given alignment,
+/// be callable from any thread, and stay valid while the library is loaded.
+pub unsafe fn install_host_allocator(alloc: HostAllocFn, free: HostFreeFn, user_data: *mut c_void) -> bool {
+    if !is_available()
+        || STATE.compare_exchange(STATE_UNUSED, STATE_INSTALLING, Ordering::Acquire, Ordering::Relaxed).is_err() {
+        return false;
+    }
+    HOST_ALLOC.store(alloc as usize, Ordering::Relaxed);
+    HOST_FREE.store(free as usize, Ordering::Relaxed);
+    HOST_USER_DATA.store(user_data, Ordering::Relaxed);
+    STATE.store(STATE_HOST, Ordering::Release);
+    true
+}
+
+/// Turn allocation counting on or off; returns false if it is unavailable
+pub fn set_tracking(enabled: bool) -> bool {
+    if !is_available() {
+        return false;
+    }
+    TRACKING.store(enabled, Ordering::Relaxed);
+    true
+}
+
+/// Check whether allocations are being counted
+pub fn is_tracking() -> bool {
+    TRACKING.load(Ordering::Relaxed)
+}
+
+/// Get the allocation counts
+pub fn stats() -> AllocationStats {
+    AllocationStats {
+        allocations: ALLOCATIONS.load(Ordering::Relaxed),
+        deallocations: DEALLOCATIONS.load(Ordering::Relaxed),
+        allocated_bytes: ALLOCATED_BYTES.load(Ordering::Relaxed),
+        live_bytes: LIVE_BYTES.load(Ordering::Relaxed),
+    }
+}
+
+/// Global allocator serving the system allocator or host callbacks
+pub struct DasherAllocator;
+
+impl DasherAllocator {
+    /// Get the allocator state, fixing it to the system allocator on first use
+    #[inline]
+    fn state() -> u8 {
+        let state = STATE.load(Ordering::Acquire);
+        if state == STATE_SYSTEM || state == STATE_HOST {
+            return state;
+        }
+        let _ = STATE.compare_exchange(STATE_UNUSED, STATE_SYSTEM, Ordering::AcqRel, Ordering::Acquire);
+        loop {
+            match STATE.load(Ordering::Acquire) {
+                STATE_INSTALLING => std::hint::spin_loop(),
+                state => return state,
+            }
+        }
+    }
+
+    #[inline]
+    fn host_alloc() -> HostAllocFn {
+        // Only read once the state is STATE_HOST, after the callbacks were stored
+        unsafe { std::mem::transmute::<usize, HostAllocFn>(HOST_ALLOC.load(Ordering::Relaxed)) }
+    }
+
+    #[inline]
+    fn host_free() -> HostFreeFn {
+        unsafe { std::mem::transmute::<usize, HostFreeFn>(HOST_FREE.load(Ordering::Relaxed)) }
+    }
+
+    #[inline]
+    fn count_alloc(size: usize) {
+        if TRACKING.load(Ordering::Relaxed) {
+            ALLOCATIONS.fetch_add(1, Ordering::Relaxed);
+            ALLOCATED_BYTES.fetch_add(size as u64, Ordering::Relaxed);
+            LIVE_BYTES.fetch_add(size as u64, Ordering::Relaxed);
+        }
+    }
+
+    #[inline]
+    fn count_dealloc(size: usize) {
+        if TRACKING.load(Ordering::Relaxed) {
+            DEALLOCATIONS.fetch_add(1, Ordering::Relaxed);
+            // Blocks allocated before tracking started were never added
+            let _ = LIVE_BYTES.fetch_update(Ordering::Relaxed, Ordering::Relaxed,
+                                            |live| Some(live.saturating_sub(size as u64)));
+        }
+    }
+}
+
+unsafe impl GlobalAlloc for DasherAllocator {
+    unsafe fn alloc(&self, layout: Layout) -> *mut u8 {
+        let ptr = if Self::state() == STATE_HOST {
+            Self::host_alloc()(layout.size(), layout.align(), HOST_USER_DATA.load(Ordering::Relaxed))
+        } else {
+            System.alloc(layout)
+        };
+        if !ptr.is_null() {
+            Self::count_alloc(layout.size());
+        }
+        ptr
+    }
+
+    unsafe fn dealloc(&self, ptr: *mut u8, layout: Layout) {
+        Self::count_dealloc(layout.size());
+        if Self::state() == STATE_HOST {
+            Self::host_free()(ptr, layout.size(), layout.align(), HOST_USER_DATA.load(Ordering::Relaxed));
+        } else {
+            System.dealloc(ptr, layout);
+        }
+    }
+
+    unsafe fn realloc(&self, ptr: *mut u8, layout: Layout, new_size: usize) -> *mut u8 {
+        if Self::state() == STATE_HOST {
+            // The host interface has no realloc, so move the block
+            let new_layout = Layout::from_size_align_unchecked(new_size, layout.align());
+            let new_ptr = self.alloc(new_layout);
+            if !new_ptr.is_null() {
+                std::ptr::copy_nonoverlapping(ptr, new_ptr, layout.size().min(new_size));
+                self.dealloc(ptr, layout);
+            }
+            return new_ptr;
+        }
+
+        let new_ptr = System.realloc(ptr, layout, new_size);
+        if !new_ptr.is_null() {
+            Self::count_dealloc(layout.size());
+            Self::count_alloc(new_size);
+        }
+        new_ptr
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    unsafe extern "C" fn refuse_alloc(_size: usize, _align: usize, _user_data: *mut c_void) -> *mut u8 {
+        std::ptr::null_mut()
+    }
+
+    unsafe extern "C" fn ignore_free(_ptr: *mut u8, _size: usize, _align: usize, _user_data: *mut c_void) {}
+
+    #[test]
+    fn test_counts_allocations_when_built_in() {
+        if !is_available() {
+            assert!(!set_tracking(true));
+            assert_eq!(stats(), AllocationStats::default());
+            return;
+        }
+
+        assert!(set_tracking(true));
+        let before = stats();
+        drop(std::hint::black_box(Vec::<u8>::with_capacity(100)));
+        let after = stats();
+        set_tracking(false);
+        assert!(after.allocations > before.allocations);
+        assert!(after.deallocations > before.deallocations);
+        assert!(after.allocated_bytes >= before.allocated_bytes + 100);
+
+        // The test harness allocated long before this, so callbacks are refused
+        assert!(!unsafe { install_host_allocator(refuse_alloc, ignore_free, std::ptr::null_mut()) });
+    }
+}
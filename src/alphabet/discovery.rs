@@ -8,6 +8,7 @@ use super::{
     color_schemes::{ColorScheme, load_color_schemes},
     AlphabetXmlError,
     load_alphabet,
+    DiscoveryIndex,
 };
 
 /// Error type for alphabet discovery operations
@@ -146,6 +147,26 @@ impl AlphabetDiscovery {
         Ok(result)
     }
 
+    /// Update `index` with the files on the search paths
+    ///
+    /// Unlike `discover`, only files that changed since they were last indexed
+    /// are read, and alphabets are not parsed until `DiscoveryIndex::load_alphabet`.
+    pub fn discover_indexed(&self, index: &mut DiscoveryIndex) -> Result<(), DiscoveryError> {
+        index.refresh(&self.search_paths)
+    }
+
+    /// Load the index from its default location, update it, and save it back
+    pub fn discover_cached(&self) -> Result<DiscoveryIndex, DiscoveryError> {
+        let path = DiscoveryIndex::default_path();
+        let mut index = path.as_ref().map(DiscoveryIndex::load).unwrap_or_default();
+        self.discover_indexed(&mut index)?;
+        if let Some(path) = path {
+            // A read-only cache directory only costs the next startup a rescan
+            let _ = index.save(path);
+        }
+        Ok(index)
+    }
+
     /// Find an alphabet by ID
     pub fn find_alphabet(&self, id: &str) -> Result<Option<AlphabetInfo>, DiscoveryError> {
         for path in &self.search_paths {
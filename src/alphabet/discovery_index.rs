@@ -0,0 +1,365 @@
+//! Persistent alphabet discovery index
+//!
+//! Listing the available alphabets only needs their names, but parsing every
+//! alphabet file at startup reads megabytes of XML. The index records, for each
+//! XML file on the search paths, its modification time, length and content hash
+//! next to the metadata from the file's root element. A refresh only reads files
+//! whose stamp changed, and full alphabets are parsed when one is selected.
+
+use std::collections::{HashMap, HashSet};
+use std::fs;
+use std::io::{BufReader, Read};
+use std::path::{Path, PathBuf};
+use std::sync::Arc;
+use std::time::UNIX_EPOCH;
+
+use quick_xml::events::Event;
+use quick_xml::Reader;
+use serde::{Deserialize, Serialize};
+
+use super::{load_alphabet, load_color_schemes, AlphabetInfo, DiscoveryError};
+
+/// Version of the on-disk index format; older indexes are rebuilt
+const INDEX_VERSION: u32 = 1;
+
+/// Metadata from an alphabet file's root element
+#[derive(Debug, Clone, PartialEq, Eq, Serialize, Deserialize)]
+pub struct AlphabetMetadata {
+    /// Alphabet id (the `name` attribute)
+    pub id: String,
+    /// File the alphabet was found in
+    pub path: PathBuf,
+    /// Orientation code, e.g. `LR`
+    pub orientation: String,
+    /// Training file name
+    pub training_file: String,
+    /// Preferred color scheme name
+    pub colors_name: String,
+}
+
+/// What an indexed file contains
+#[derive(Debug, Clone, PartialEq, Eq, Serialize, Deserialize)]
+pub enum IndexedContent {
+    /// An alphabet
+    Alphabet(AlphabetMetadata),
+    /// Color schemes, by name
+    ColorSchemes(Vec<String>),
+    /// Neither; skipped until the file changes
+    Other,
+}
+
+/// Identity of a file's contents at the time it was indexed
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Serialize, Deserialize)]
+pub struct FileStamp {
+    /// Modification time in nanoseconds since the Unix epoch
+    pub modified_ns: u64,
+    /// File length in bytes
+    pub len: u64,
+    /// FNV-1a hash of the contents
+    pub hash: u64,
+}
+
+/// An indexed file
+#[derive(Debug, Clone, Serialize, Deserialize)]
+struct IndexEntry {
+    stamp: FileStamp,
+    content: IndexedContent,
+}
+
+/// Persisted form of the index
+#[derive(Serialize, Deserialize)]
+struct IndexFile {
+    version: u32,
+    entries: HashMap<PathBuf, IndexEntry>,
+}
+
+/// Index of the alphabet and color scheme files on the search paths
+#[derive(Debug, Default)]
+pub struct DiscoveryIndex {
+    /// Indexed files, by path
+    entries: HashMap<PathBuf, IndexEntry>,
+
+    /// Alphabets parsed so far, with the stamp they were parsed at
+    parsed: HashMap<PathBuf, (FileStamp, Arc<AlphabetInfo>)>,
+
+    /// Whether entries changed since the index was loaded or saved
+    dirty: bool,
+
+    /// Number of files read during the last refresh
+    files_read: usize,
+}
+
+impl DiscoveryIndex {
+    /// Create an empty index
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Get the default location of the index file
+    pub fn default_path() -> Option<PathBuf> {
+        dirs::cache_dir().map(|dir| dir.join("dasher").join("alphabet-index.json"))
+    }
+
+    /// Load an index file; a missing or outdated file gives an empty index
+    pub fn load<P: AsRef<Path>>(path: P) -> Self {
+        let entries = fs::read(path)
+            .ok()
+            .and_then(|bytes| serde_json::from_slice::<IndexFile>(&bytes).ok())
+            .filter(|file| file.version == INDEX_VERSION)
+            .map(|file| file.entries)
+            .unwrap_or_default();
+        Self { entries, ..Self::default() }
+    }
+
+    /// Save the index if it changed
+    pub fn save<P: AsRef<Path>>(&mut self, path: P) -> Result<(), DiscoveryError> {
+        if !self.dirty {
+            return Ok(());
+        }
+        if let Some(dir) = path.as_ref().parent() {
+            fs::create_dir_all(dir)?;
+        }
+
+        let file = IndexFile { version: INDEX_VERSION, entries: self.entries.clone() };
+        let json = serde_json::to_vec(&file).map_err(|e| DiscoveryError::InvalidData(e.to_string()))?;
+        fs::write(path, json)?;
+        self.dirty = false;
+        Ok(())
+    }
+
+    /// Bring the index up to date with the XML files in `search_paths`
+    ///
+    /// Files whose modification time and length are unchanged are not opened.
+    /// Entries for files that no longer exist are dropped.
+    pub fn refresh(&mut self, search_paths: &[PathBuf]) -> Result<(), DiscoveryError> {
+        self.files_read = 0;
+        let mut seen = HashSet::new();
+
+        for dir in search_paths {
+            if !dir.is_dir() {
+                continue;
+            }
+            for entry in fs::read_dir(dir)? {
+                let path = entry?.path();
+                if !path.is_file() || path.extension().map_or(true, |ext| ext != "xml") {
+                    continue;
+                }
+                self.refresh_file(&path)?;
+                seen.insert(path);
+            }
+        }
+
+        let before = self.entries.len();
+        self.entries.retain(|path, _| seen.contains(path));
+        self.dirty |= self.entries.len() != before;
+        Ok(())
+    }
+
+    /// Re-index one file if its stamp changed
+    fn refresh_file(&mut self, path: &Path) -> Result<(), DiscoveryError> {
+        let metadata = fs::metadata(path)?;
+        let modified_ns = metadata.modified().ok()
+            .and_then(|time| time.duration_since(UNIX_EPOCH).ok())
+            .map(|d| d.as_nanos() as u64)
+            .unwrap_or(0);
+        let len = metadata.len();
+
+        if let Some(entry) = self.entries.get_mut(path) {
+            if entry.stamp.modified_ns == modified_ns && entry.stamp.len == len {
+                return Ok(());
+            }
+            // Touched but possibly unchanged: the hash decides
+            if entry.stamp.len == len {
+                self.files_read += 1;
+                if hash_file(path)? == entry.stamp.hash {
+                    entry.stamp.modified_ns = modified_ns;
+                    self.dirty = true;
+                    return Ok(());
+                }
+            }
+        }
+
+        self.files_read += 1;
+        let stamp = FileStamp { modified_ns, len, hash: hash_file(path)? };
+        let content = match read_alphabet_header(path) {
+            Ok(Some(metadata)) => IndexedContent::Alphabet(metadata),
+            _ => match load_color_schemes(path) {
+                Ok(schemes) if !schemes.is_empty() => {
+                    IndexedContent::ColorSchemes(schemes.into_iter().map(|s| s.name).collect())
+                }
+                _ => IndexedContent::Other,
+            },
+        };
+        self.entries.insert(path.to_path_buf(), IndexEntry { stamp, content });
+        self.dirty = true;
+        Ok(())
+    }
+
+    /// Get the metadata of every indexed alphabet, sorted by id
+    pub fn alphabets(&self) -> Vec<&AlphabetMetadata> {
+        let mut alphabets: Vec<_> = self.entries.values()
+            .filter_map(|entry| match &entry.content {
+                IndexedContent::Alphabet(metadata) => Some(metadata),
+                _ => None,
+            })
+            .collect();
+        alphabets.sort_by(|a, b| a.id.cmp(&b.id).then_with(|| a.path.cmp(&b.path)));
+        alphabets
+    }
+
+    /// Get the names of every indexed color scheme
+    pub fn color_scheme_names(&self) -> Vec<&str> {
+        let mut names: Vec<&str> = self.entries.values()
+            .filter_map(|entry| match &entry.content {
+                IndexedContent::ColorSchemes(names) => Some(names),
+                _ => None,
+            })
+            .flatten()
+            .map(String::as_str)
+            .collect();
+        names.sort_unstable();
+        names
+    }
+
+    /// Find an indexed alphabet by id
+    pub fn find(&self, id: &str) -> Option<&AlphabetMetadata> {
+        self.alphabets().into_iter().find(|metadata| metadata.id == id)
+    }
+
+    /// Parse the full alphabet with the given id
+    ///
+    /// Parsed alphabets are kept until their file changes, so selecting the same
+    /// alphabet again does not re-read it.
+    pub fn load_alphabet(&mut self, id: &str) -> Result<Option<Arc<AlphabetInfo>>, DiscoveryError> {
+        let path = match self.find(id) {
+            Some(metadata) => metadata.path.clone(),
+            None => return Ok(None),
+        };
+        let stamp = self.entries[&path].stamp;
+
+        if let Some((parsed_stamp, alphabet)) = self.parsed.get(&path) {
+            if *parsed_stamp == stamp {
+                return Ok(Some(alphabet.clone()));
+            }
+        }
+
+        let alphabet = Arc::new(load_alphabet(&path)?);
+        self.parsed.insert(path, (stamp, alphabet.clone()));
+        Ok(Some(alphabet))
+    }
+
+    /// Get the number of files opened by the last refresh
+    pub fn files_read(&self) -> usize {
+        self.files_read
+    }
+
+    /// Get the number of indexed files
+    pub fn len(&self) -> usize {
+        self.entries.len()
+    }
+
+    /// Check whether the index holds no files
+    pub fn is_empty(&self) -> bool {
+        self.entries.is_empty()
+    }
+}
+
+/// Hash a file's contents with 64-bit FNV-1a
+fn hash_file(path: &Path) -> Result<u64, DiscoveryError> {
+    let mut reader = BufReader::new(fs::File::open(path)?);
+    let mut buffer = [0u8; 8192];
+    let mut hash = 0xcbf2_9ce4_8422_2325u64;
+    loop {
+        let n = reader.read(&mut buffer)?;
+        if n == 0 {
+            return Ok(hash);
+        }
+        for &byte in &buffer[..n] {
+            hash = (hash ^ byte as u64).wrapping_mul(0x0000_0100_0000_01b3);
+        }
+    }
+}
+
+/// Read the attributes of an alphabet file's root element, stopping there
+///
+/// Returns `None` if the first element is not `<alphabet>`.
+fn read_alphabet_header(path: &Path) -> Result<Option<AlphabetMetadata>, DiscoveryError> {
+    let mut reader = Reader::from_reader(BufReader::new(fs::File::open(path)?));
+    let mut buf = Vec::new();
+
+    loop {
+        match reader.read_event_into(&mut buf).map_err(|e| DiscoveryError::InvalidData(e.to_string()))? {
+            Event::Start(e) | Event::Empty(e) => {
+                if e.name().as_ref() != b"alphabet" {
+                    return Ok(None);
+                }
+
+                let mut metadata = AlphabetMetadata {
+                    id: String::new(),
+                    path: path.to_path_buf(),
+                    orientation: String::new(),
+                    training_file: String::new(),
+                    colors_name: String::new(),
+                };
+                for attr in e.attributes().flatten() {
+                    let value = attr.unescape_value()
+                        .map(|v| v.into_owned())
+                        .unwrap_or_default();
+                    match attr.key.as_ref() {
+                        b"name" => metadata.id = value,
+                        b"orientation" => metadata.orientation = value,
+                        b"trainingFilename" => metadata.training_file = value,
+                        b"colorsName" => metadata.colors_name = value,
+                        _ => {}
+                    }
+                }
+                return Ok((!metadata.id.is_empty()).then_some(metadata));
+            }
+            Event::Eof => return Ok(None),
+            _ => {}
+        }
+        buf.clear();
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_refresh_reads_only_changed_files() {
+        let dir = tempfile::tempdir().unwrap();
+        let alphabet = dir.path().join("alphabet.test.xml");
+        fs::write(&alphabet, r#"<?xml version="1.0"?>
+<alphabet name="Test" orientation="LR" trainingFilename="training_test.txt">
+    <group name="letters"><node label="a"/></group>
+</alphabet>"#).unwrap();
+        fs::write(dir.path().join("notes.xml"), "<notes/>").unwrap();
+
+        let search_paths = vec![dir.path().to_path_buf()];
+        let mut index = DiscoveryIndex::new();
+        index.refresh(&search_paths).unwrap();
+        assert_eq!(index.files_read(), 2);
+        assert_eq!(index.alphabets().len(), 1);
+        assert_eq!(index.find("Test").unwrap().training_file, "training_test.txt");
+
+        // A saved index is reused without opening unchanged files
+        let index_path = dir.path().join("cache").join("index.json");
+        index.save(&index_path).unwrap();
+        let mut index = DiscoveryIndex::load(&index_path);
+        index.refresh(&search_paths).unwrap();
+        assert_eq!(index.files_read(), 0);
+        assert_eq!(index.len(), 2);
+
+        // Parsed alphabets are cached until the file changes
+        let first = index.load_alphabet("Test").unwrap().unwrap();
+        let second = index.load_alphabet("Test").unwrap().unwrap();
+        assert!(Arc::ptr_eq(&first, &second));
+        assert!(index.load_alphabet("Missing").unwrap().is_none());
+
+        // Removed files drop out of the index
+        fs::remove_file(&alphabet).unwrap();
+        index.refresh(&search_paths).unwrap();
+        assert!(index.alphabets().is_empty());
+    }
+}
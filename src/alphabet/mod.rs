@@ -14,16 +14,18 @@ mod xml;
 mod colors;
 mod conversion;
 mod discovery;
+mod discovery_index;
 mod training;
 mod color_schemes;
 
 pub use info::{AlphabetInfo, ScreenOrientation, AlphabetConversion, Character};
 pub use group::GroupInfo;
 pub use map::AlphabetMap;
-pub use xml::{AlphabetXmlError, save_alphabet, load_alphabet, load_color_schemes};
+pub use xml::{AlphabetXmlError, SymbolTable, save_alphabet, load_alphabet, load_color_schemes, load_symbol_table, read_symbol_table};
 pub use colors::{Color, ColorManager, ColorScheme};
 pub use conversion::{ConversionManager, ConversionTable, ConversionRule};
 pub use discovery::{AlphabetDiscovery, DiscoveryError, DiscoveryResult};
+pub use discovery_index::{AlphabetMetadata, DiscoveryIndex, FileStamp, IndexedContent};
 pub use training::{TrainingManager, TrainingStats, TrainingError};
 
 use std::collections::HashMap;
@@ -156,6 +158,11 @@ impl Alphabet {
     pub fn get_index(&self, c: char) -> Option<usize> {
         self.char_to_index.get(&c).copied()
     }
+
+    /// Get the map from each symbol's character to its index
+    pub fn symbol_index(&self) -> &HashMap<char, usize> {
+        &self.char_to_index
+    }
     
     /// Get the number of symbols in the alphabet
     pub fn size(&self) -> usize {
@@ -171,4 +178,19 @@ impl Alphabet {
     pub fn symbols(&self) -> &[Symbol] {
         &self.symbols
     }
+
+    /// Get every character a host needs a glyph for, sorted and without repeats
+    ///
+    /// This covers both the node labels (`display_text`) and the characters
+    /// written to the output, so hosts can rasterise just these instead of a
+    /// whole script's range.
+    pub fn glyphs(&self) -> String {
+        let mut glyphs: Vec<char> = self.symbols.iter()
+            .flat_map(|symbol| symbol.display_text.chars().chain(std::iter::once(symbol.character)))
+            .filter(|c| !c.is_control())
+            .collect();
+        glyphs.sort_unstable();
+        glyphs.dedup();
+        glyphs.into_iter().collect()
+    }
 }
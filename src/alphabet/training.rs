@@ -95,6 +95,21 @@ impl TrainingStats {
         self.last_update = SystemTime::now();
     }
 
+    /// Add the counts of another set of statistics to these
+    pub fn merge(&mut self, other: &TrainingStats) {
+        self.total_chars += other.total_chars;
+        for (&c, &count) in &other.char_frequency {
+            *self.char_frequency.entry(c).or_insert(0) += count;
+        }
+        for (word, &count) in &other.word_frequency {
+            *self.word_frequency.entry(word.clone()).or_insert(0) += count;
+        }
+        for (&pair, &count) in &other.bigram_frequency {
+            *self.bigram_frequency.entry(pair).or_insert(0) += count;
+        }
+        self.last_update = self.last_update.max(other.last_update);
+    }
+
     /// Get character probability
     pub fn char_probability(&self, c: char) -> f64 {
         if self.total_chars == 0 {
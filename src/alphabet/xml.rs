@@ -1,5 +1,6 @@
 use quick_xml::{Reader, Writer, events::{Event, BytesStart, BytesEnd, BytesDecl, BytesText}};
-use std::io::{self, BufReader, BufWriter, Write};
+use std::io::{self, BufRead, BufReader, BufWriter, Write};
+use std::ops::Range;
 use std::fs::File;
 use std::path::Path;
 
@@ -9,6 +10,8 @@ use super::{
     Character,
     GroupInfo,
     Color,
+    Alphabet,
+    Symbol,
 };
 
 /// Error type for alphabet XML operations
@@ -350,6 +353,139 @@ pub fn load_alphabet<P: AsRef<Path>>(path: P) -> Result<AlphabetInfo, AlphabetXm
     reader.read()
 }
 
+/// Flat symbol table read from an alphabet file in one pass
+///
+/// The label and output text of every `<node>` are interned into a single
+/// string arena, so reading a large alphabet costs one allocation per grown
+/// buffer rather than several per symbol. Group structure is not kept.
+#[derive(Debug, Clone, Default)]
+pub struct SymbolTable {
+    /// Alphabet name
+    name: String,
+    /// Interned label and text of every symbol
+    arena: String,
+    /// Label and text spans into `arena`, in document order
+    spans: Vec<(Range<u32>, Range<u32>)>,
+}
+
+impl SymbolTable {
+    /// Get the alphabet name
+    pub fn name(&self) -> &str {
+        &self.name
+    }
+
+    /// Get the number of symbols
+    pub fn len(&self) -> usize {
+        self.spans.len()
+    }
+
+    /// Check whether the table has no symbols
+    pub fn is_empty(&self) -> bool {
+        self.spans.is_empty()
+    }
+
+    /// Get the label shown for a symbol
+    pub fn label(&self, index: usize) -> Option<&str> {
+        self.spans.get(index).map(|(label, _)| self.span(label))
+    }
+
+    /// Get the text a symbol outputs
+    pub fn text(&self, index: usize) -> Option<&str> {
+        self.spans.get(index).map(|(_, text)| self.span(text))
+    }
+
+    /// Iterate over (label, text) pairs in document order
+    pub fn iter(&self) -> impl Iterator<Item = (&str, &str)> + '_ {
+        self.spans.iter().map(|(label, text)| (self.span(label), self.span(text)))
+    }
+
+    /// Build the alphabet whose `symbols()` are the nodes of this table
+    pub fn into_alphabet(self) -> Alphabet {
+        let mut alphabet = Alphabet::new(&self.name);
+        for (label, text) in self.iter() {
+            alphabet.add_symbol(Symbol::with_default_colors(text.chars().next().unwrap_or(' '), label));
+        }
+        alphabet
+    }
+
+    fn span(&self, span: &Range<u32>) -> &str {
+        &self.arena[span.start as usize..span.end as usize]
+    }
+
+    /// Append an attribute value to the arena, unescaping only when needed
+    fn intern(&mut self, value: &[u8], escaped: bool) -> Result<Range<u32>, AlphabetXmlError> {
+        let start = self.arena.len() as u32;
+        let raw = std::str::from_utf8(value)
+            .map_err(|e| AlphabetXmlError::InvalidData(format!("Invalid UTF-8: {}", e)))?;
+        if escaped {
+            let unescaped = quick_xml::escape::unescape(raw)
+                .map_err(|e| AlphabetXmlError::InvalidData(format!("XML error: {}", e)))?;
+            self.arena.push_str(&unescaped);
+        } else {
+            self.arena.push_str(raw);
+        }
+        Ok(start..self.arena.len() as u32)
+    }
+
+    /// Record a `<node>` element; `text` defaults to `label`
+    fn push_node(&mut self, node: &BytesStart) -> Result<(), AlphabetXmlError> {
+        let mut label = None;
+        let mut text = None;
+        for attr in node.attributes() {
+            let attr = attr?;
+            let escaped = attr.value.contains(&b'&');
+            match attr.key.as_ref() {
+                b"label" => label = Some(self.intern(&attr.value, escaped)?),
+                b"text" => text = Some(self.intern(&attr.value, escaped)?),
+                _ => {}
+            }
+        }
+        let label = label.ok_or_else(|| AlphabetXmlError::InvalidData("Missing node label".into()))?;
+        let text = text.unwrap_or_else(|| label.clone());
+        self.spans.push((label, text));
+        Ok(())
+    }
+}
+
+/// Read the symbol table of an alphabet in a single streaming pass
+///
+/// One event buffer is reused for the whole document and attribute values are
+/// borrowed from it until they are copied into the table's arena.
+pub fn read_symbol_table<R: BufRead>(input: R) -> Result<SymbolTable, AlphabetXmlError> {
+    let mut reader = Reader::from_reader(input);
+    let mut buf = Vec::new();
+    let mut table = SymbolTable::default();
+    let mut found_alphabet = false;
+
+    loop {
+        match reader.read_event_into(&mut buf)? {
+            Event::Start(ref e) | Event::Empty(ref e) => match e.name().as_ref() {
+                b"node" => table.push_node(e)?,
+                b"alphabet" => {
+                    found_alphabet = true;
+                    if let Some(name) = e.try_get_attribute("name")? {
+                        table.name = name.unescape_value()?.into_owned();
+                    }
+                }
+                _ => {}
+            },
+            Event::Eof => break,
+            _ => {}
+        }
+        buf.clear();
+    }
+
+    if !found_alphabet {
+        return Err(AlphabetXmlError::InvalidData("No alphabet found".into()));
+    }
+    Ok(table)
+}
+
+/// Load the symbol table of an alphabet file
+pub fn load_symbol_table<P: AsRef<Path>>(path: P) -> Result<SymbolTable, AlphabetXmlError> {
+    read_symbol_table(BufReader::new(File::open(path)?))
+}
+
 #[cfg(test)]
 mod tests {
     use super::*;
@@ -400,4 +536,34 @@ mod tests {
 
         assert!(found_alphabet);
     }
+
+    #[test]
+    fn test_read_symbol_table() {
+        let xml = r#"<?xml version="1.0"?>
+<alphabets>
+  <alphabet name="Test">
+    <orientation type="LR"/>
+    <group name="Letters" label="abc">
+      <node label="a"/>
+      <group label="inner">
+        <node label="b" text="B"></node>
+      </group>
+    </group>
+    <node label="&amp;" text="&amp;"/>
+    <node label="&lt;"/>
+  </alphabet>
+</alphabets>"#;
+
+        let table = read_symbol_table(Cursor::new(xml)).unwrap();
+        assert_eq!(table.name(), "Test");
+        let symbols: Vec<_> = table.iter().collect();
+        assert_eq!(symbols, vec![("a", "a"), ("b", "B"), ("&", "&"), ("<", "<")]);
+
+        let alphabet = table.into_alphabet();
+        assert_eq!(alphabet.size(), 4);
+        assert_eq!(alphabet.get_index('B'), Some(1));
+        assert_eq!(alphabet.symbols()[3].display_text, "<");
+
+        assert!(read_symbol_table(Cursor::new("<colours/>")).is_err());
+    }
 }
@@ -2,14 +2,25 @@
 //!
 //! This module contains the main API for the Dasher core.
 
+pub mod profiler;
+pub mod simulation;
+
 use std::cell::RefCell;
 use std::rc::Rc;
 
-use crate::model::{DasherModel, node::DasherNode};
-use crate::view::{DasherScreen, DasherView, DasherViewSquare, Orientation, NodeShape};
+use crate::model::{DasherModel, node::DasherNode, output::OutputDelta};
+use crate::model::memory_governor::{MemoryLimits, MemoryStats};
+use crate::view::{DasherScreen, DasherView, DasherViewSquare, DrawCommandBuffer, FrameChange, Orientation, NodeShape};
 use crate::input::{DasherInput, InputFilter, InputManager, VirtualKey};
 use crate::settings::{Settings, Parameter};
 use crate::Result;
+use profiler::{FrameCounts, FrameProfiler, FrameStage, FrameStats};
+
+/// Frame interval that scheduled zoom steps are paced for, in milliseconds
+const STEP_INTERVAL_MS: u64 = 16;
+
+/// Most scheduled zoom steps taken in one frame
+const MAX_STEPS_PER_FRAME: u64 = 8;
 
 /// The main interface for the Dasher core.
 ///
@@ -36,6 +47,12 @@ pub struct DasherInterface {
 
     /// The current frame time
     current_time: u64,
+
+    /// Time of the previous frame, used to catch up on scheduled steps
+    last_frame_time: u64,
+
+    /// Timings and counts of processed frames
+    profiler: FrameProfiler,
 }
 
 impl DasherInterface {
@@ -56,6 +73,8 @@ impl DasherInterface {
             running: false,
             paused: false,
             current_time: 0,
+            last_frame_time: 0,
+            profiler: FrameProfiler::new(),
         }
     }
 
@@ -100,36 +119,115 @@ impl DasherInterface {
 
     /// Process a new frame
     pub fn new_frame(&mut self, time_ms: u64) -> bool {
-        // Update the current time
+        self.process_frame(time_ms, None)
+    }
+
+    /// Process a new frame, recording the drawing into `buffer` instead of the screen
+    ///
+    /// Requires a Square View. The buffer is cleared and refilled, so hosts can reuse
+    /// one buffer for every frame.
+    pub fn render_into(&mut self, time_ms: u64, buffer: &mut DrawCommandBuffer) -> bool {
+        self.process_frame(time_ms, Some(buffer))
+    }
+
+    /// Advance the model for a frame and render it
+    fn process_frame(&mut self, time_ms: u64, buffer: Option<&mut DrawCommandBuffer>) -> bool {
+        // Update the current time; key events also set it, so steps are timed from the last frame
         self.current_time = time_ms;
+        let previous_time = std::mem::replace(&mut self.last_frame_time, time_ms);
 
         // If not running, do nothing
         if !self.running {
             return false;
         }
 
-        // If paused, just render
-        if self.paused {
-            if let Some(view) = &mut self.view {
-                return view.render(&mut self.model).is_ok();
-            }
-            return false;
-        }
+        // Publish a background-trained language model between frames
+        self.model.poll_background_training();
 
-        // Process input
         if let Some(view) = &mut self.view {
-            self.input_manager.process_frame(time_ms, &mut self.model, view.as_mut());
+            self.profiler.begin_frame();
+            let expansions = self.model.expansion_count();
+            let created = self.model.nodes_created();
+
+            self.input_manager.poll_samples();
+
+            // If paused, just render
+            if !self.paused {
+                // Process input
+                self.profiler.time(FrameStage::Input, || {
+                    self.input_manager.process_frame(time_ms, &mut self.model, view.as_mut())
+                });
+
+                // Process the scheduled steps due, catching up after dropped frames
+                let steps = if previous_time == 0 {
+                    1
+                } else {
+                    (time_ms.saturating_sub(previous_time) / STEP_INTERVAL_MS).clamp(1, MAX_STEPS_PER_FRAME)
+                };
+                self.profiler.time(FrameStage::Step, || self.model.next_scheduled_steps(steps as usize));
+            }
 
-            // Process the next scheduled step in the model
-            self.model.next_scheduled_step();
+            // Create the children that are about to come into view
+            let (_min_x, min_y, _max_x, max_y) = view.get_visible_region();
+            self.profiler.time(FrameStage::Expand, || {
+                self.model.expand_visible(min_y, max_y);
+                self.model.enforce_memory_limits();
+            });
 
             // Render the view
-            return view.render(&mut self.model).is_ok();
+            let rendered = self.profiler.time(FrameStage::Render, || match buffer {
+                Some(buffer) => match view.as_any_mut().downcast_mut::<DasherViewSquare>() {
+                    Some(square_view) => square_view.render_into(&mut self.model, buffer).is_ok(),
+                    None => false,
+                },
+                None => view.render(&mut self.model).is_ok(),
+            });
+
+            let mut counts = FrameCounts {
+                nodes_expanded: (self.model.expansion_count() - expansions) as u32,
+                nodes_created: (self.model.nodes_created() - created) as u32,
+                ..Default::default()
+            };
+            if let Some(square_view) = view.as_any_mut().downcast_mut::<DasherViewSquare>() {
+                let render_stats = square_view.last_render_stats();
+                counts.nodes_drawn = render_stats.nodes_drawn;
+                counts.labels_created = render_stats.labels_created;
+                self.profiler.add_stage_time(FrameStage::TextLayout, render_stats.text_layout);
+            }
+            self.profiler.add_counts(counts);
+            self.profiler.end_frame();
+
+            return rendered;
         }
 
         false
     }
 
+    /// Get timing and work statistics for the frames processed so far
+    pub fn frame_stats(&self) -> FrameStats {
+        self.profiler.stats()
+    }
+
+    /// Forget the frame statistics collected so far
+    pub fn reset_frame_stats(&mut self) {
+        self.profiler.reset();
+    }
+
+    /// Get the limits on the size of the node tree
+    pub fn memory_limits(&self) -> MemoryLimits {
+        self.model.memory_limits()
+    }
+
+    /// Set the limits on the size of the node tree
+    pub fn set_memory_limits(&mut self, limits: MemoryLimits) {
+        self.model.set_memory_limits(limits);
+    }
+
+    /// Get the node tree's size and eviction counters
+    pub fn memory_stats(&self) -> MemoryStats {
+        self.model.memory_stats()
+    }
+
     /// Handle a key down event
     pub fn key_down(&mut self, time_ms: u64, key: VirtualKey) {
         // Update the current time
@@ -272,6 +370,26 @@ impl DasherInterface {
         self.model.output_text()
     }
 
+    /// Get the characters the current alphabet needs glyphs for
+    pub fn alphabet_glyphs(&self) -> String {
+        self.model.alphabet().map(|alphabet| alphabet.glyphs()).unwrap_or_default()
+    }
+
+    /// Get the generation of the alphabet, incremented every time it is replaced
+    pub fn get_alphabet_generation(&self) -> u64 {
+        self.model.alphabet_generation()
+    }
+
+    /// Get the generation of the output text, incremented on every change
+    pub fn get_output_generation(&self) -> u64 {
+        self.model.output_generation()
+    }
+
+    /// Get the changes to the output text made after `generation`
+    pub fn get_output_delta(&self, generation: u64) -> OutputDelta<'_> {
+        self.model.output_delta_since(generation)
+    }
+
     /// Handle a parameter change
     pub fn handle_parameter_change(&mut self, parameter: Parameter) {
         if parameter == Parameter::Orientation {
@@ -454,6 +572,48 @@ impl DasherInterface {
         }
     }
 
+    /// Set the limits that bound how much of the tree is drawn each frame
+    pub fn set_render_limits(&mut self, min_node_size: i32, max_render_depth: usize, max_nodes_per_frame: u32) -> Result<()> {
+        if let Some(view) = &mut self.view {
+            // Try to downcast to DasherViewSquare
+            let square_view = view.as_any_mut().downcast_mut::<DasherViewSquare>();
+            if let Some(square_view) = square_view {
+                square_view.set_render_limits(min_node_size, max_render_depth, max_nodes_per_frame);
+                Ok(())
+            } else {
+                Err(crate::DasherError::RenderingError("View is not a Square View".to_string()))
+            }
+        } else {
+            Err(crate::DasherError::RenderingError("No view available".to_string()))
+        }
+    }
+
+    /// Enable or disable retained rendering while the tree is stationary
+    pub fn set_retained_mode(&mut self, enable: bool) -> Result<()> {
+        if let Some(view) = &mut self.view {
+            // Try to downcast to DasherViewSquare
+            let square_view = view.as_any_mut().downcast_mut::<DasherViewSquare>();
+            if let Some(square_view) = square_view {
+                square_view.set_retained_mode(enable);
+                Ok(())
+            } else {
+                Err(crate::DasherError::RenderingError("View is not a Square View".to_string()))
+            }
+        } else {
+            Err(crate::DasherError::RenderingError("No view available".to_string()))
+        }
+    }
+
+    /// Get how much of the last frame was redrawn
+    ///
+    /// Always `FrameChange::Full` unless retained mode is on.
+    pub fn last_frame_change(&self) -> FrameChange {
+        self.view.as_ref()
+            .and_then(|view| view.as_any().downcast_ref::<DasherViewSquare>())
+            .map(|square_view| square_view.last_render_stats().frame_change)
+            .unwrap_or_default()
+    }
+
     /// Reset the Dasher interface
     pub fn reset(&mut self) -> Result<()> {
         // Reset the model
@@ -0,0 +1,242 @@
+//! # Frame Profiler
+//!
+//! Records how long each stage of a frame takes, together with per-frame counts
+//! of the work done, and keeps a fixed-size histogram of total frame times so
+//! hosts can show an overlay or report percentiles without storing frames.
+
+use std::time::{Duration, Instant};
+
+use crate::allocator::{self, AllocationStats};
+
+/// Number of stages timed in a frame
+pub const FRAME_STAGE_COUNT: usize = 5;
+
+/// Number of buckets in the frame-time histogram; the last one collects everything slower
+pub const FRAME_HISTOGRAM_BUCKETS: usize = 32;
+
+/// Width of a histogram bucket in microseconds
+pub const FRAME_HISTOGRAM_BUCKET_US: u32 = 1000;
+
+/// A stage of a frame
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum FrameStage {
+    /// Input processing
+    Input = 0,
+    /// Model stepping (`next_scheduled_step`)
+    Step = 1,
+    /// Node expansion
+    Expand = 2,
+    /// Rendering, including text layout
+    Render = 3,
+    /// Text layout, as part of rendering
+    TextLayout = 4,
+}
+
+/// Work counted during a frame
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct FrameCounts {
+    /// Nodes whose children were created
+    pub nodes_expanded: u32,
+    /// Child nodes created
+    pub nodes_created: u32,
+    /// Node shapes drawn
+    pub nodes_drawn: u32,
+    /// Labels created for text
+    pub labels_created: u32,
+    /// Heap allocations, counted while allocation tracking is on
+    pub allocations: u32,
+    /// Bytes allocated, counted while allocation tracking is on
+    pub allocated_bytes: u32,
+}
+
+/// Profile of the frames processed so far
+///
+/// Stage arrays are indexed by `FrameStage`. Percentiles are estimated from the
+/// histogram and report the upper edge of the bucket they fall in.
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq)]
+pub struct FrameStats {
+    /// Number of frames recorded
+    pub frame_count: u64,
+    /// Total time of the last frame, in microseconds
+    pub last_frame_us: u32,
+    /// Slowest frame, in microseconds
+    pub max_frame_us: u32,
+    /// Median frame time, in microseconds
+    pub p50_frame_us: u32,
+    /// 95th percentile frame time, in microseconds
+    pub p95_frame_us: u32,
+    /// 99th percentile frame time, in microseconds
+    pub p99_frame_us: u32,
+    /// Time of each stage in the last frame, in microseconds
+    pub last_stage_us: [u32; FRAME_STAGE_COUNT],
+    /// Mean time of each stage over all frames, in microseconds
+    pub mean_stage_us: [u32; FRAME_STAGE_COUNT],
+    /// Work counted in the last frame
+    pub last_counts: FrameCounts,
+    /// Number of frames per `FRAME_HISTOGRAM_BUCKET_US`-wide bucket
+    pub histogram: [u32; FRAME_HISTOGRAM_BUCKETS],
+}
+
+/// Collects frame timings and counts
+#[derive(Debug, Default)]
+pub struct FrameProfiler {
+    /// Aggregated statistics
+    stats: FrameStats,
+
+    /// Sum of each stage's time over all frames, in microseconds
+    stage_totals_us: [u64; FRAME_STAGE_COUNT],
+
+    /// Start of the frame in progress
+    frame_start: Option<Instant>,
+
+    /// Stage times of the frame in progress
+    stage_us: [u32; FRAME_STAGE_COUNT],
+
+    /// Counts of the frame in progress
+    counts: FrameCounts,
+
+    /// Allocation counts at the start of the frame in progress
+    allocations_at_start: AllocationStats,
+}
+
+impl FrameProfiler {
+    /// Create a new profiler with no recorded frames
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Start timing a frame
+    pub fn begin_frame(&mut self) {
+        self.frame_start = Some(Instant::now());
+        self.stage_us = [0; FRAME_STAGE_COUNT];
+        self.counts = FrameCounts::default();
+        self.allocations_at_start = allocator::stats();
+    }
+
+    /// Run `f`, adding its duration to `stage`
+    pub fn time<T>(&mut self, stage: FrameStage, f: impl FnOnce() -> T) -> T {
+        let start = Instant::now();
+        let result = f();
+        self.add_stage_time(stage, start.elapsed());
+        result
+    }
+
+    /// Add a duration measured elsewhere to `stage`
+    pub fn add_stage_time(&mut self, stage: FrameStage, duration: Duration) {
+        let us = &mut self.stage_us[stage as usize];
+        *us = us.saturating_add(duration_us(duration));
+    }
+
+    /// Add to the counts of the frame in progress
+    ///
+    /// Allocations are measured by the profiler itself.
+    pub fn add_counts(&mut self, counts: FrameCounts) {
+        self.counts.nodes_expanded += counts.nodes_expanded;
+        self.counts.nodes_created += counts.nodes_created;
+        self.counts.nodes_drawn += counts.nodes_drawn;
+        self.counts.labels_created += counts.labels_created;
+    }
+
+    /// Finish the frame in progress and fold it into the statistics
+    pub fn end_frame(&mut self) {
+        let frame_us = match self.frame_start.take() {
+            Some(start) => duration_us(start.elapsed()),
+            None => return,
+        };
+
+        let allocations = allocator::stats();
+        self.counts.allocations = clamp_u32(allocations.allocations - self.allocations_at_start.allocations);
+        self.counts.allocated_bytes = clamp_u32(allocations.allocated_bytes - self.allocations_at_start.allocated_bytes);
+
+        let stats = &mut self.stats;
+        stats.frame_count += 1;
+        stats.last_frame_us = frame_us;
+        stats.max_frame_us = stats.max_frame_us.max(frame_us);
+        stats.last_stage_us = self.stage_us;
+        stats.last_counts = self.counts;
+
+        for (total, &us) in self.stage_totals_us.iter_mut().zip(&self.stage_us) {
+            *total += us as u64;
+        }
+
+        let bucket = ((frame_us / FRAME_HISTOGRAM_BUCKET_US) as usize).min(FRAME_HISTOGRAM_BUCKETS - 1);
+        stats.histogram[bucket] = stats.histogram[bucket].saturating_add(1);
+    }
+
+    /// Get the statistics of the frames recorded so far
+    pub fn stats(&self) -> FrameStats {
+        let mut stats = self.stats;
+        if stats.frame_count == 0 {
+            return stats;
+        }
+
+        for (mean, &total) in stats.mean_stage_us.iter_mut().zip(&self.stage_totals_us) {
+            *mean = (total / stats.frame_count) as u32;
+        }
+        stats.p50_frame_us = self.percentile(0.50);
+        stats.p95_frame_us = self.percentile(0.95);
+        stats.p99_frame_us = self.percentile(0.99);
+        stats
+    }
+
+    /// Forget all recorded frames
+    pub fn reset(&mut self) {
+        *self = Self::default();
+    }
+
+    /// Estimate a frame-time percentile from the histogram
+    fn percentile(&self, fraction: f64) -> u32 {
+        let total: u64 = self.stats.histogram.iter().map(|&n| n as u64).sum();
+        let target = ((total as f64 * fraction).ceil() as u64).max(1);
+
+        let mut seen = 0u64;
+        for (bucket, &n) in self.stats.histogram.iter().enumerate() {
+            seen += n as u64;
+            if seen >= target {
+                if bucket == FRAME_HISTOGRAM_BUCKETS - 1 {
+                    return self.stats.max_frame_us;
+                }
+                return (bucket as u32 + 1) * FRAME_HISTOGRAM_BUCKET_US;
+            }
+        }
+        self.stats.max_frame_us
+    }
+}
+
+fn duration_us(duration: Duration) -> u32 {
+    duration.as_micros().min(u32::MAX as u128) as u32
+}
+
+fn clamp_u32(value: u64) -> u32 {
+    value.min(u32::MAX as u64) as u32
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_stage_times_and_histogram() {
+        let mut profiler = FrameProfiler::new();
+        for _ in 0..10 {
+            profiler.begin_frame();
+            profiler.add_stage_time(FrameStage::Step, Duration::from_micros(300));
+            profiler.add_stage_time(FrameStage::Render, Duration::from_micros(500));
+            profiler.add_counts(FrameCounts { nodes_drawn: 7, ..Default::default() });
+            profiler.end_frame();
+        }
+
+        let stats = profiler.stats();
+        assert_eq!(stats.frame_count, 10);
+        assert_eq!(stats.last_stage_us[FrameStage::Step as usize], 300);
+        assert_eq!(stats.mean_stage_us[FrameStage::Render as usize], 500);
+        assert_eq!(stats.last_counts.nodes_drawn, 7);
+        assert_eq!(stats.histogram.iter().sum::<u32>(), 10);
+        assert!(stats.p50_frame_us <= stats.p99_frame_us);
+
+        profiler.reset();
+        assert_eq!(profiler.stats().frame_count, 0);
+    }
+}
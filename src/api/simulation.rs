@@ -0,0 +1,293 @@
+//! # Simulation Thread
+//!
+//! Runs a `DasherInterface` on its own thread at a fixed step rate, so zooming
+//! keeps its speed when the host's render loop stalls. The host feeds input
+//! without blocking the thread and draws whatever frame was published last.
+//!
+//! The interface is built on the simulation thread, since its node tree is not
+//! `Send`. Each step renders into a draw command buffer that is published as an
+//! immutable `FrameSnapshot`. Two snapshots are alternated: the thread fills
+//! one while the host reads the other, and a new one is only allocated when the
+//! host still holds the snapshot the thread wants to refill.
+
+use std::sync::atomic::{AtomicBool, AtomicU64, Ordering};
+use std::sync::mpsc::{self, Receiver, Sender};
+use std::sync::{Arc, Mutex};
+use std::thread::{self, JoinHandle};
+use std::time::{Duration, Instant};
+
+use super::DasherInterface;
+use crate::input::VirtualKey;
+use crate::view::DrawCommandBuffer;
+
+/// Steps run back to back to catch up after a stall before the schedule is reset
+const MAX_CATCH_UP_STEPS: u32 = 4;
+
+/// Mouse position value meaning no position has been set
+const NO_POSITION: u64 = u64::MAX;
+
+/// One simulation step's worth of state for the render thread
+#[derive(Debug, Default)]
+pub struct FrameSnapshot {
+    /// Number of the step this frame comes from, starting at 1
+    pub sequence: u64,
+    /// Simulated time of the step, in milliseconds
+    pub time_ms: u64,
+    /// Root node coordinates in the model
+    pub root_range: (i64, i64),
+    /// Output text generation at the end of the step
+    pub output_generation: u64,
+    /// Output text at the end of the step
+    pub output_text: String,
+    /// Drawing of the visible nodes
+    pub commands: DrawCommandBuffer,
+}
+
+/// A command for the simulation thread
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub enum SimulationCommand {
+    KeyDown(VirtualKey),
+    KeyUp(VirtualKey),
+    Pause,
+    Resume,
+}
+
+/// Handle to an interface stepping on its own thread
+pub struct SimulationThread {
+    /// Latest mouse position, packed as `x << 32 | y`
+    mouse: Arc<AtomicU64>,
+    commands: Sender<SimulationCommand>,
+    published: Arc<Mutex<Arc<FrameSnapshot>>>,
+    stop: Arc<AtomicBool>,
+    handle: Option<JoinHandle<()>>,
+}
+
+impl SimulationThread {
+    /// Start stepping the interface returned by `build` at `rate_hz` steps per second
+    ///
+    /// `build` runs on the new thread and should return a started interface with
+    /// a screen set. If it returns `None` the thread exits and no frames are published.
+    pub fn spawn<F>(rate_hz: u32, build: F) -> Self
+    where
+        F: FnOnce() -> Option<DasherInterface> + Send + 'static,
+    {
+        let mouse = Arc::new(AtomicU64::new(NO_POSITION));
+        let (commands, receiver) = mpsc::channel();
+        let published = Arc::new(Mutex::new(Arc::new(FrameSnapshot::default())));
+        let stop = Arc::new(AtomicBool::new(false));
+
+        let worker = Worker {
+            rate_hz: rate_hz.max(1),
+            mouse: Arc::clone(&mouse),
+            commands: receiver,
+            published: Arc::clone(&published),
+            stop: Arc::clone(&stop),
+        };
+        let handle = thread::Builder::new()
+            .name("dasher-simulation".to_string())
+            .spawn(move || {
+                if let Some(interface) = build() {
+                    worker.run(interface);
+                }
+            })
+            .ok();
+
+        Self { mouse, commands, published, stop, handle }
+    }
+
+    /// Set the mouse position in screen coordinates, read at the start of the next step
+    pub fn set_mouse_position(&self, x: i32, y: i32) {
+        let packed = ((x as u32 as u64) << 32) | y as u32 as u64;
+        self.mouse.store(packed, Ordering::Relaxed);
+    }
+
+    /// Queue a command for the next step
+    pub fn send(&self, command: SimulationCommand) {
+        // A send only fails once the thread has exited, when there is nothing left to drive
+        let _ = self.commands.send(command);
+    }
+
+    /// Get the most recently published frame
+    ///
+    /// The lock is only held to clone the pointer, never while a step runs.
+    pub fn latest(&self) -> Arc<FrameSnapshot> {
+        Arc::clone(&self.published.lock().unwrap_or_else(|e| e.into_inner()))
+    }
+
+    /// Check whether the simulation thread is still running
+    pub fn is_running(&self) -> bool {
+        self.handle.as_ref().is_some_and(|handle| !handle.is_finished())
+    }
+
+    /// Stop the thread and wait for it to exit
+    pub fn stop(&mut self) {
+        self.stop.store(true, Ordering::Release);
+        if let Some(handle) = self.handle.take() {
+            let _ = handle.join();
+        }
+    }
+}
+
+impl Drop for SimulationThread {
+    fn drop(&mut self) {
+        self.stop();
+    }
+}
+
+/// State owned by the simulation thread
+struct Worker {
+    rate_hz: u32,
+    mouse: Arc<AtomicU64>,
+    commands: Receiver<SimulationCommand>,
+    published: Arc<Mutex<Arc<FrameSnapshot>>>,
+    stop: Arc<AtomicBool>,
+}
+
+impl Worker {
+    fn run(self, mut interface: DasherInterface) {
+        let period = Duration::from_secs_f64(1.0 / self.rate_hz as f64);
+        let mut deadline = Instant::now();
+        let mut step: u64 = 0;
+        let mut last_mouse = NO_POSITION;
+        let mut spare = Arc::new(FrameSnapshot::default());
+
+        while !self.stop.load(Ordering::Acquire) {
+            // Time advances by whole steps, however late the step actually runs
+            step += 1;
+            let time_ms = step * 1000 / self.rate_hz as u64;
+
+            for command in self.commands.try_iter() {
+                match command {
+                    SimulationCommand::KeyDown(key) => interface.key_down(time_ms, key),
+                    SimulationCommand::KeyUp(key) => interface.key_up(time_ms, key),
+                    SimulationCommand::Pause => interface.pause(),
+                    SimulationCommand::Resume => interface.resume(),
+                }
+            }
+
+            let mouse = self.mouse.load(Ordering::Relaxed);
+            if mouse != last_mouse && mouse != NO_POSITION {
+                let _ = interface.set_mouse_position((mouse >> 32) as u32 as i32, mouse as u32 as i32);
+                last_mouse = mouse;
+            }
+
+            // Refill the snapshot published two steps ago, unless the host still holds it
+            let snapshot = match Arc::get_mut(&mut spare) {
+                Some(snapshot) => snapshot,
+                None => {
+                    spare = Arc::new(FrameSnapshot::default());
+                    Arc::get_mut(&mut spare).expect("a new snapshot is not shared")
+                }
+            };
+            interface.render_into(time_ms, &mut snapshot.commands);
+            snapshot.sequence = step;
+            snapshot.time_ms = time_ms;
+            snapshot.root_range = interface.model().root_range();
+            if snapshot.output_generation != interface.get_output_generation() || snapshot.sequence == 1 {
+                snapshot.output_generation = interface.get_output_generation();
+                snapshot.output_text.clear();
+                snapshot.output_text.push_str(interface.get_output_text());
+            }
+
+            {
+                let mut published = self.published.lock().unwrap_or_else(|e| e.into_inner());
+                std::mem::swap(&mut *published, &mut spare);
+            }
+
+            deadline += period;
+            let now = Instant::now();
+            if deadline > now {
+                thread::sleep(deadline - now);
+            } else if now - deadline > period * MAX_CATCH_UP_STEPS {
+                // Too far behind to catch up; drop the missed steps rather than racing through them
+                deadline = now;
+            }
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::input::MouseInput;
+    use crate::settings::Settings;
+    use crate::view::{DasherScreen, Label};
+
+    struct NullLabel(String);
+
+    impl Label for NullLabel {
+        fn get_text(&self) -> &str {
+            &self.0
+        }
+
+        fn get_wrap_size(&self) -> u32 {
+            0
+        }
+    }
+
+    struct NullScreen;
+
+    impl DasherScreen for NullScreen {
+        fn get_width(&self) -> i32 {
+            640
+        }
+
+        fn get_height(&self) -> i32 {
+            480
+        }
+
+        fn make_label(&self, text: &str, _wrap_size: u32) -> Box<dyn Label> {
+            Box::new(NullLabel(text.to_string()))
+        }
+
+        fn text_size(&self, label: &dyn Label, font_size: u32) -> (i32, i32) {
+            (label.get_text().len() as i32 * font_size as i32 / 2, font_size as i32)
+        }
+
+        fn draw_string(&mut self, _: &dyn Label, _: i32, _: i32, _: u32, _: crate::view::Color) {}
+        fn draw_rectangle(&mut self, _: i32, _: i32, _: i32, _: i32, _: crate::view::Color, _: crate::view::Color, _: i32) {}
+        fn draw_circle(&mut self, _: i32, _: i32, _: i32, _: crate::view::Color, _: crate::view::Color, _: i32) {}
+        fn draw_line(&mut self, _: i32, _: i32, _: i32, _: i32, _: crate::view::Color, _: i32) {}
+        fn draw_polygon(&mut self, _: &[(i32, i32)], _: crate::view::Color, _: crate::view::Color, _: i32) {}
+        fn display(&mut self) {}
+        fn is_point_visible(&self, _: i32, _: i32) -> bool {
+            true
+        }
+    }
+
+    #[test]
+    fn test_publishes_fixed_rate_frames() {
+        let mut simulation = SimulationThread::spawn(500, || {
+            let mut interface = DasherInterface::new(Settings::new());
+            interface.model_mut().initialize().ok()?;
+            interface.change_screen(Box::new(NullScreen)).ok()?;
+            interface.set_input(Box::new(MouseInput::new()));
+            interface.start();
+            Some(interface)
+        });
+
+        let start = Instant::now();
+        while simulation.latest().sequence < 5 && start.elapsed() < Duration::from_secs(10) {
+            simulation.set_mouse_position(500, 100);
+            thread::sleep(Duration::from_millis(2));
+        }
+
+        // Held frames stay intact while the thread keeps stepping
+        let held = simulation.latest();
+        assert!(held.sequence >= 5);
+        assert_eq!(held.time_ms, held.sequence * 2);
+        assert!(!held.commands.is_empty());
+        let commands = held.commands.commands().to_vec();
+
+        simulation.send(SimulationCommand::Pause);
+        while simulation.latest().sequence < held.sequence + 3 && start.elapsed() < Duration::from_secs(10) {
+            thread::sleep(Duration::from_millis(2));
+        }
+        assert!(simulation.latest().sequence > held.sequence);
+        assert_eq!(held.commands.commands(), &commands[..]);
+
+        assert!(simulation.is_running());
+        simulation.stop();
+        assert!(!simulation.is_running());
+    }
+}
@@ -0,0 +1,93 @@
+//! Dictionary indexer: converts word lists into an indexed dictionary file.
+//!
+//! ```text
+//! dasher-dict -o words.ddix words.txt...
+//! ```
+//!
+//! Input lines are `word\tfrequency`, as `Dictionary::load` reads, or bare
+//! words, whose frequency is their share of all bare words read.
+
+use std::collections::HashMap;
+use std::path::PathBuf;
+use std::process::ExitCode;
+use std::time::Instant;
+
+use dasher_core::model::save_dictionary_index;
+
+const USAGE: &str = "usage: dasher-dict -o OUTPUT.ddix INPUT...";
+
+/// Parsed command line
+struct Options {
+    output: PathBuf,
+    inputs: Vec<PathBuf>,
+}
+
+fn parse_args() -> Result<Options, String> {
+    let mut output = None;
+    let mut inputs = Vec::new();
+
+    let mut args = std::env::args().skip(1);
+    while let Some(arg) = args.next() {
+        match arg.as_str() {
+            "-o" | "--output" => output = Some(PathBuf::from(args.next().ok_or("-o needs a value")?)),
+            "-h" | "--help" => return Err(USAGE.to_string()),
+            _ => inputs.push(PathBuf::from(arg)),
+        }
+    }
+
+    let output = output.ok_or_else(|| USAGE.to_string())?;
+    if inputs.is_empty() {
+        return Err(USAGE.to_string());
+    }
+    Ok(Options { output, inputs })
+}
+
+fn main() -> ExitCode {
+    let options = match parse_args() {
+        Ok(options) => options,
+        Err(message) => {
+            eprintln!("{}", message);
+            return ExitCode::from(2);
+        }
+    };
+
+    let start = Instant::now();
+    let mut frequencies: HashMap<String, f64> = HashMap::new();
+    let mut counts: HashMap<String, u64> = HashMap::new();
+    for input in &options.inputs {
+        let text = match std::fs::read_to_string(input) {
+            Ok(text) => text,
+            Err(e) => {
+                eprintln!("Failed to read {}: {}", input.display(), e);
+                return ExitCode::FAILURE;
+            }
+        };
+        for line in text.lines() {
+            if line.is_empty() || line.starts_with('#') {
+                continue;
+            }
+            match line.split_once('\t') {
+                Some((word, frequency)) => {
+                    if let Ok(frequency) = frequency.trim().parse::<f64>() {
+                        let entry = frequencies.entry(word.trim().to_string()).or_insert(frequency);
+                        *entry = entry.max(frequency);
+                    }
+                }
+                None => *counts.entry(line.trim().to_string()).or_default() += 1,
+            }
+        }
+    }
+
+    let total = counts.values().sum::<u64>().max(1) as f64;
+    for (word, count) in counts {
+        frequencies.entry(word).or_insert(count as f64 / total);
+    }
+
+    if let Err(e) = save_dictionary_index(frequencies.iter().map(|(word, &frequency)| (word, frequency)), &options.output) {
+        eprintln!("Failed to write {}: {}", options.output.display(), e);
+        return ExitCode::FAILURE;
+    }
+    println!("Indexed {} words in {:.2?}", frequencies.len(), start.elapsed());
+    println!("Wrote {}", options.output.display());
+    ExitCode::SUCCESS
+}
@@ -0,0 +1,91 @@
+//! Offline trainer: builds a binary PPM snapshot from text corpora on all cores.
+//!
+//! ```text
+//! dasher-train [--order N] [--threads N] [--shard-mb N] -o model.dppm corpus.txt...
+//! ```
+
+use std::path::PathBuf;
+use std::process::ExitCode;
+use std::time::Instant;
+
+use dasher_core::model::sharded_training::{ShardedTrainer, DEFAULT_SHARD_BYTES};
+use dasher_core::model::PPMOrder;
+
+const USAGE: &str = "usage: dasher-train [--order N] [--threads N] [--shard-mb N] -o OUTPUT.dppm INPUT...";
+
+/// Parsed command line
+struct Options {
+    order: PPMOrder,
+    threads: Option<usize>,
+    shard_bytes: usize,
+    output: PathBuf,
+    inputs: Vec<PathBuf>,
+}
+
+fn parse_args() -> Result<Options, String> {
+    let mut order = PPMOrder::Five;
+    let mut threads = None;
+    let mut shard_bytes = DEFAULT_SHARD_BYTES;
+    let mut output = None;
+    let mut inputs = Vec::new();
+
+    let mut args = std::env::args().skip(1);
+    while let Some(arg) = args.next() {
+        let mut value = |name: &str| args.next().ok_or_else(|| format!("{} needs a value", name));
+        match arg.as_str() {
+            "--order" => {
+                let value: i32 = value("--order")?.parse().map_err(|_| "invalid --order".to_string())?;
+                order = PPMOrder::from_value(value).ok_or("--order must be between -1 and 5")?;
+            }
+            "--threads" => {
+                threads = Some(value("--threads")?.parse().map_err(|_| "invalid --threads".to_string())?);
+            }
+            "--shard-mb" => {
+                let mb: usize = value("--shard-mb")?.parse().map_err(|_| "invalid --shard-mb".to_string())?;
+                shard_bytes = mb.max(1) << 20;
+            }
+            "-o" | "--output" => output = Some(PathBuf::from(value("-o")?)),
+            "-h" | "--help" => return Err(USAGE.to_string()),
+            _ => inputs.push(PathBuf::from(arg)),
+        }
+    }
+
+    let output = output.ok_or_else(|| USAGE.to_string())?;
+    if inputs.is_empty() {
+        return Err(USAGE.to_string());
+    }
+    Ok(Options { order, threads, shard_bytes, output, inputs })
+}
+
+fn main() -> ExitCode {
+    let options = match parse_args() {
+        Ok(options) => options,
+        Err(message) => {
+            eprintln!("{}", message);
+            return ExitCode::from(2);
+        }
+    };
+
+    let mut trainer = ShardedTrainer::new(options.order).with_shard_bytes(options.shard_bytes);
+    if let Some(threads) = options.threads {
+        trainer = trainer.with_threads(threads);
+    }
+
+    let start = Instant::now();
+    let corpus = match trainer.train_files(&options.inputs) {
+        Ok(corpus) => corpus,
+        Err(e) => {
+            eprintln!("Failed to read training data: {:?}", e);
+            return ExitCode::FAILURE;
+        }
+    };
+    println!("Trained {} characters into {} nodes in {:.2?}",
+             corpus.stats.total_chars, corpus.model.node_count(), start.elapsed());
+
+    if let Err(e) = corpus.save_snapshot(&options.output) {
+        eprintln!("Failed to write {}: {}", options.output.display(), e);
+        return ExitCode::FAILURE;
+    }
+    println!("Wrote {}", options.output.display());
+    ExitCode::SUCCESS
+}
@@ -126,6 +126,7 @@ impl From<SquareViewConfigFFI> for SquareViewConfig {
             flowing_interface: config.flowing_interface,
             flowing_speed: config.flowing_speed,
             use_ppm: config.use_ppm,
+            ..SquareViewConfig::default()
         }
     }
 }
@@ -201,5 +202,6 @@ pub unsafe fn ffi_to_rust_config(config: &SquareViewConfigFFI) -> SquareViewConf
         flowing_interface: config.flowing_interface,
         flowing_speed: config.flowing_speed,
         use_ppm: config.use_ppm,
+        ..SquareViewConfig::default()
     }
 }
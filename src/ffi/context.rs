@@ -1,16 +1,47 @@
 //! # Context Module for FFI
 //!
 //! This module provides context information for the FFI layer.
-
-use std::sync::atomic::{AtomicBool, AtomicI32, Ordering};
-use std::sync::Mutex;
+//!
+//! Every interface handle owns an `FFIContext` for its debug messages and
+//! screen state. FFI calls on a handle enter its context for their duration,
+//! so logging from deep inside rendering reaches the right session without
+//! passing the context around. Messages logged outside any interface call go
+//! to a process-wide default context.
+
+use std::sync::atomic::{AtomicBool, AtomicI32, AtomicUsize, Ordering};
+use std::sync::{Mutex, OnceLock};
 use std::collections::HashMap;
 use std::sync::Arc;
 use std::cell::RefCell;
 use std::rc::Rc;
-use crate::model::node::DasherNode;
+use super::debug_ring::DebugRing;
+
+/// Number of contexts with debug mode on, readable without touching any context
+static DEBUG_CONTEXTS: AtomicUsize = AtomicUsize::new(0);
+
+/// Check whether debug mode is on in any context
+///
+/// This is a single relaxed load, cheap enough to guard per-node logging. The
+/// active context still checks its own flag before keeping a message.
+#[inline]
+pub fn debug_enabled() -> bool {
+    DEBUG_CONTEXTS.load(Ordering::Relaxed) != 0
+}
+
+/// Log a formatted debug message
+///
+/// The arguments are only evaluated, and the message only formatted, when
+/// debug mode is on.
+macro_rules! ffi_debug {
+    ($($arg:tt)*) => {
+        if $crate::ffi::context::debug_enabled() {
+            $crate::ffi::context::current_context().add_debug(&format!($($arg)*));
+        }
+    };
+}
+pub(crate) use ffi_debug;
 
-/// Global context for FFI operations
+/// Debug and screen state of an FFI session
 pub struct FFIContext {
     /// Debug mode flag
     pub debug_mode: AtomicBool,
@@ -24,8 +55,8 @@ pub struct FFIContext {
     /// Error messages
     pub error_messages: Mutex<Vec<String>>,
 
-    /// Debug messages
-    pub debug_messages: Mutex<Vec<String>>,
+    /// Debug messages, drained by the host
+    pub debug_messages: DebugRing,
 
     /// Node information for debugging
     pub node_info: Mutex<HashMap<String, String>>,
@@ -39,14 +70,20 @@ impl FFIContext {
             screen_width: AtomicI32::new(0),
             screen_height: AtomicI32::new(0),
             error_messages: Mutex::new(Vec::new()),
-            debug_messages: Mutex::new(Vec::new()),
+            debug_messages: DebugRing::new(),
             node_info: Mutex::new(HashMap::new()),
         }
     }
 
     /// Set debug mode
     pub fn set_debug_mode(&self, debug: bool) {
-        self.debug_mode.store(debug, Ordering::SeqCst);
+        if self.debug_mode.swap(debug, Ordering::SeqCst) != debug {
+            if debug {
+                DEBUG_CONTEXTS.fetch_add(1, Ordering::Relaxed);
+            } else {
+                DEBUG_CONTEXTS.fetch_sub(1, Ordering::Relaxed);
+            }
+        }
     }
 
     /// Get debug mode
@@ -76,11 +113,11 @@ impl FFIContext {
     }
 
     /// Add a debug message
+    ///
+    /// Messages are dropped if the host has not drained the ring in time.
     pub fn add_debug(&self, message: &str) {
         if self.get_debug_mode() {
-            if let Ok(mut messages) = self.debug_messages.lock() {
-                messages.push(message.to_string());
-            }
+            self.debug_messages.push(message);
         }
     }
 
@@ -97,13 +134,7 @@ impl FFIContext {
 
     /// Get all debug messages and clear the list
     pub fn get_debug_messages(&self) -> Vec<String> {
-        if let Ok(mut messages) = self.debug_messages.lock() {
-            let result = messages.clone();
-            messages.clear();
-            result
-        } else {
-            Vec::new()
-        }
+        std::iter::from_fn(|| self.debug_messages.pop()).collect()
     }
 
     /// Add node information
@@ -132,33 +163,68 @@ impl FFIContext {
     }
 }
 
-/// Global FFI context
-static mut GLOBAL_CONTEXT: Option<Arc<FFIContext>> = None;
+impl Default for FFIContext {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+impl Drop for FFIContext {
+    fn drop(&mut self) {
+        self.set_debug_mode(false);
+    }
+}
+
+/// Context for calls made outside any interface
+static GLOBAL_CONTEXT: OnceLock<Arc<FFIContext>> = OnceLock::new();
+
+thread_local! {
+    /// Context of the interface call running on this thread, if any
+    static ACTIVE_CONTEXT: RefCell<Option<Arc<FFIContext>>> = const { RefCell::new(None) };
+}
 
 /// Initialize the global FFI context
+///
+/// The context is created once; later calls return the same one.
 pub fn init_global_context() -> Arc<FFIContext> {
-    let context = Arc::new(FFIContext::new());
-    unsafe {
-        GLOBAL_CONTEXT = Some(context.clone());
-    }
-    context
+    get_global_context()
 }
 
 /// Get the global FFI context
 pub fn get_global_context() -> Arc<FFIContext> {
-    unsafe {
-        if let Some(context) = &GLOBAL_CONTEXT {
-            context.clone()
-        } else {
-            init_global_context()
-        }
+    GLOBAL_CONTEXT.get_or_init(|| Arc::new(FFIContext::new())).clone()
+}
+
+/// Get the context of the interface call running on this thread, or the global one
+pub fn current_context() -> Arc<FFIContext> {
+    ACTIVE_CONTEXT
+        .with(|active| active.borrow().clone())
+        .unwrap_or_else(get_global_context)
+}
+
+/// Make `context` the current context on this thread until the guard is dropped
+pub fn enter(context: &Arc<FFIContext>) -> ContextGuard {
+    let previous = ACTIVE_CONTEXT.with(|active| active.replace(Some(Arc::clone(context))));
+    ContextGuard { previous }
+}
+
+/// Restores the previously current context when dropped
+#[must_use = "the context is left as soon as the guard is dropped"]
+pub struct ContextGuard {
+    previous: Option<Arc<FFIContext>>,
+}
+
+impl Drop for ContextGuard {
+    fn drop(&mut self) {
+        let previous = self.previous.take();
+        ACTIVE_CONTEXT.with(|active| *active.borrow_mut() = previous);
     }
 }
 
-/// Enhanced callback context for drawing operations
+/// Description of a node being drawn, for debug logging
 #[derive(Clone, Debug)]
 pub struct DrawingContext {
-    /// Node ID for the current node being drawn
+    /// Node ID of the node being drawn
     pub node_id: String,
 
     /// Node depth in the tree
@@ -206,7 +272,7 @@ impl DrawingContext {
             depth: node_ref.get_depth(),
             probability: node_ref.get_probability(),
             symbol: node_ref.symbol(),
-            text: node_ref.label().cloned().unwrap_or_default(),
+            text: node_ref.get_text(),
             is_leaf: node_ref.children().is_empty(),
             is_visible: true,
             is_selected: false,
@@ -229,38 +295,44 @@ impl DrawingContext {
     }
 }
 
-/// Thread-local current drawing context
-thread_local! {
-    static CURRENT_DRAWING_CONTEXT: RefCell<DrawingContext> = RefCell::new(DrawingContext::new());
-}
-
-/// Set the current drawing context
-pub fn set_current_drawing_context(context: DrawingContext) {
-    CURRENT_DRAWING_CONTEXT.with(|c| {
-        *c.borrow_mut() = context;
-    });
-}
-
-/// Get the current drawing context
-pub fn get_current_drawing_context() -> DrawingContext {
-    CURRENT_DRAWING_CONTEXT.with(|c| {
-        c.borrow().clone()
-    })
-}
-
-/// Clear the current drawing context
-pub fn clear_current_drawing_context() {
-    CURRENT_DRAWING_CONTEXT.with(|c| {
-        *c.borrow_mut() = DrawingContext::new();
-    });
-}
-
-/// Add the current drawing context to the global context
-pub fn log_current_drawing_context() {
-    let context = get_current_drawing_context();
-    let global = get_global_context();
-
-    if global.get_debug_mode() {
-        global.add_node_info(&context.node_id, &context.to_string());
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_debug_messages_go_to_the_entered_context() {
+        let first = Arc::new(FFIContext::new());
+        let second = Arc::new(FFIContext::new());
+        first.set_debug_mode(true);
+        second.set_debug_mode(true);
+        assert!(debug_enabled());
+
+        {
+            let _first = enter(&first);
+            ffi_debug!("first {}", 1);
+            {
+                let _second = enter(&second);
+                ffi_debug!("second");
+            }
+            ffi_debug!("first {}", 2);
+        }
+        assert!(!Arc::ptr_eq(&current_context(), &first));
+
+        assert_eq!(first.get_debug_messages(), vec!["first 1", "first 2"]);
+        assert_eq!(second.get_debug_messages(), vec!["second"]);
+
+        // Contexts on other threads are independent
+        let handle = {
+            let second = Arc::clone(&second);
+            std::thread::spawn(move || {
+                let _second = enter(&second);
+                ffi_debug!("worker");
+                Arc::ptr_eq(&current_context(), &second)
+            })
+        };
+        let _first = enter(&first);
+        assert!(handle.join().unwrap());
+        assert!(Arc::ptr_eq(&current_context(), &first));
+        assert_eq!(second.get_debug_messages(), vec!["worker"]);
     }
 }
@@ -223,3 +223,69 @@ pub fn transform_rectangle(
     
     (screen_x1, screen_y1, screen_x2, screen_y2)
 }
+
+/// Transform many rectangles from Dasher coordinates to screen coordinates
+///
+/// `rects` holds `(x1, y1, x2, y2)` quadruples and `out` receives the matching
+/// `transform_rectangle` results. The scale factors are computed once for the
+/// batch, and only as many rectangles as both slices hold are transformed.
+pub fn transform_rectangles(
+    rects: &[[i64; 4]],
+    screen_width: i32,
+    screen_height: i32,
+    orientation: i32,
+    out: &mut [[i32; 4]],
+) {
+    let (width, height) = (screen_width, screen_height);
+    let (x_max, y_max) = (DASHER_X_MAX as f64, DASHER_Y_MAX as f64);
+
+    match orientation {
+        1 => {
+            let (xs, ys) = (width as f64 / x_max, height as f64 / y_max);
+            map_rectangles(rects, out, |x, y| ((x as f64 * xs) as i32, height / 2 + ((y - DASHER_ORIGIN_Y) as f64 * ys) as i32))
+        }
+        2 => {
+            let (xs, ys) = (width as f64 / y_max, height as f64 / x_max);
+            map_rectangles(rects, out, |x, y| (width / 2 + ((y - DASHER_ORIGIN_Y) as f64 * xs) as i32, height - (x as f64 * ys) as i32))
+        }
+        3 => {
+            let (xs, ys) = (width as f64 / y_max, height as f64 / x_max);
+            map_rectangles(rects, out, |x, y| (width / 2 + ((y - DASHER_ORIGIN_Y) as f64 * xs) as i32, (x as f64 * ys) as i32))
+        }
+        _ => {
+            let (xs, ys) = (width as f64 / x_max, height as f64 / y_max);
+            map_rectangles(rects, out, |x, y| (width - (x as f64 * xs) as i32, height / 2 + ((y - DASHER_ORIGIN_Y) as f64 * ys) as i32))
+        }
+    }
+}
+
+/// Apply a point map to both corners of each rectangle and normalise the result
+#[inline]
+fn map_rectangles(rects: &[[i64; 4]], out: &mut [[i32; 4]], map: impl Fn(i64, i64) -> (i32, i32)) {
+    for (rect, result) in rects.iter().zip(out.iter_mut()) {
+        let (sx1, sy1) = map(rect[0], rect[1]);
+        let (sx2, sy2) = map(rect[2], rect[3]);
+        *result = [sx1.min(sx2), sy1.min(sy2), sx1.max(sx2), sy1.max(sy2)];
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_transform_rectangles_matches_single() {
+        let rects = [
+            [0, 0, DASHER_X_MAX / 2, DASHER_Y_MAX / 3],
+            [DASHER_X_MAX, DASHER_Y_MAX, 100, -200],
+        ];
+        for orientation in 0..4 {
+            let mut out = [[0; 4]; 2];
+            transform_rectangles(&rects, 800, 600, orientation, &mut out);
+            for (rect, result) in rects.iter().zip(&out) {
+                let (x1, y1, x2, y2) = transform_rectangle(rect[0], rect[1], rect[2], rect[3], 800, 600, orientation);
+                assert_eq!(*result, [x1, y1, x2, y2]);
+            }
+        }
+    }
+}
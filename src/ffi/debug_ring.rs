@@ -0,0 +1,227 @@
+//! # Debug Ring Module
+//!
+//! A bounded, lock-free queue of debug messages for the FFI layer.
+//!
+//! Any thread may push; the host drains messages oldest first. Messages are
+//! copied into fixed-size slots, so neither side allocates or takes a lock, and
+//! a full ring drops new messages instead of blocking the render loop. The
+//! algorithm is Dmitry Vyukov's bounded MPMC queue: each slot carries a
+//! sequence number that tells producers and consumers whose turn it is.
+
+use std::cell::UnsafeCell;
+use std::sync::atomic::{AtomicUsize, Ordering};
+
+/// Number of messages the ring holds (a power of two)
+pub const DEBUG_RING_CAPACITY: usize = 256;
+
+/// Maximum length of a message in bytes; longer messages are truncated
+pub const DEBUG_MESSAGE_LEN: usize = 256;
+
+/// A message slot
+struct Slot {
+    /// Position this slot is ready for: `pos` to write, `pos + 1` to read
+    sequence: AtomicUsize,
+
+    /// Number of bytes used in `data`
+    len: UnsafeCell<usize>,
+
+    /// Message bytes
+    data: UnsafeCell<[u8; DEBUG_MESSAGE_LEN]>,
+}
+
+/// Lock-free ring of debug messages
+pub struct DebugRing {
+    slots: Box<[Slot]>,
+    enqueue_pos: AtomicUsize,
+    dequeue_pos: AtomicUsize,
+    dropped: AtomicUsize,
+}
+
+// Slot contents are only touched by the thread that won the slot's sequence number
+unsafe impl Send for DebugRing {}
+unsafe impl Sync for DebugRing {}
+
+impl DebugRing {
+    /// Create an empty ring
+    pub fn new() -> Self {
+        let slots = (0..DEBUG_RING_CAPACITY)
+            .map(|i| Slot {
+                sequence: AtomicUsize::new(i),
+                len: UnsafeCell::new(0),
+                data: UnsafeCell::new([0; DEBUG_MESSAGE_LEN]),
+            })
+            .collect();
+
+        Self {
+            slots,
+            enqueue_pos: AtomicUsize::new(0),
+            dequeue_pos: AtomicUsize::new(0),
+            dropped: AtomicUsize::new(0),
+        }
+    }
+
+    /// Append a message, truncated to `DEBUG_MESSAGE_LEN` bytes
+    ///
+    /// Returns false, and counts the message as dropped, if the ring is full.
+    pub fn push(&self, message: &str) -> bool {
+        let mut len = message.len().min(DEBUG_MESSAGE_LEN);
+        while !message.is_char_boundary(len) {
+            len -= 1;
+        }
+
+        let mut pos = self.enqueue_pos.load(Ordering::Relaxed);
+        loop {
+            let slot = &self.slots[pos & (DEBUG_RING_CAPACITY - 1)];
+            let sequence = slot.sequence.load(Ordering::Acquire);
+            let diff = sequence as isize - pos as isize;
+
+            if diff == 0 {
+                match self.enqueue_pos.compare_exchange_weak(pos, pos + 1, Ordering::Relaxed, Ordering::Relaxed) {
+                    Ok(_) => {
+                        unsafe {
+                            let data = &mut *slot.data.get();
+                            data[..len].copy_from_slice(&message.as_bytes()[..len]);
+                            *slot.len.get() = len;
+                        }
+                        slot.sequence.store(pos + 1, Ordering::Release);
+                        return true;
+                    }
+                    Err(current) => pos = current,
+                }
+            } else if diff < 0 {
+                self.dropped.fetch_add(1, Ordering::Relaxed);
+                return false;
+            } else {
+                pos = self.enqueue_pos.load(Ordering::Relaxed);
+            }
+        }
+    }
+
+    /// Remove the oldest message, copying it into `buffer`
+    ///
+    /// A message longer than `buffer` is truncated on a character boundary.
+    /// Returns the number of bytes copied.
+    pub fn pop_into(&self, buffer: &mut [u8]) -> Option<usize> {
+        let mut pos = self.dequeue_pos.load(Ordering::Relaxed);
+        loop {
+            let slot = &self.slots[pos & (DEBUG_RING_CAPACITY - 1)];
+            let sequence = slot.sequence.load(Ordering::Acquire);
+            let diff = sequence as isize - (pos + 1) as isize;
+
+            if diff == 0 {
+                match self.dequeue_pos.compare_exchange_weak(pos, pos + 1, Ordering::Relaxed, Ordering::Relaxed) {
+                    Ok(_) => {
+                        let len = unsafe {
+                            let len = *slot.len.get();
+                            let data = &*slot.data.get();
+                            let mut copy_len = len.min(buffer.len());
+                            // Back off over UTF-8 continuation bytes
+                            while copy_len < len && data[copy_len] & 0xC0 == 0x80 {
+                                copy_len -= 1;
+                            }
+                            buffer[..copy_len].copy_from_slice(&data[..copy_len]);
+                            copy_len
+                        };
+                        slot.sequence.store(pos + DEBUG_RING_CAPACITY, Ordering::Release);
+                        return Some(len);
+                    }
+                    Err(current) => pos = current,
+                }
+            } else if diff < 0 {
+                return None;
+            } else {
+                pos = self.dequeue_pos.load(Ordering::Relaxed);
+            }
+        }
+    }
+
+    /// Remove the oldest message
+    pub fn pop(&self) -> Option<String> {
+        let mut buffer = [0u8; DEBUG_MESSAGE_LEN];
+        let len = self.pop_into(&mut buffer)?;
+        Some(String::from_utf8_lossy(&buffer[..len]).into_owned())
+    }
+
+    /// Get the number of messages waiting to be drained
+    pub fn len(&self) -> usize {
+        let enqueued = self.enqueue_pos.load(Ordering::Acquire);
+        let dequeued = self.dequeue_pos.load(Ordering::Acquire);
+        enqueued.saturating_sub(dequeued)
+    }
+
+    /// Check whether no messages are waiting
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+
+    /// Get the number of messages dropped because the ring was full
+    pub fn dropped(&self) -> usize {
+        self.dropped.load(Ordering::Relaxed)
+    }
+}
+
+impl Default for DebugRing {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::sync::Arc;
+
+    #[test]
+    fn test_push_pop_order_and_overflow() {
+        let ring = DebugRing::new();
+        assert!(ring.push("first"));
+        assert!(ring.push("second"));
+        assert_eq!(ring.len(), 2);
+        assert_eq!(ring.pop().as_deref(), Some("first"));
+        assert_eq!(ring.pop().as_deref(), Some("second"));
+        assert_eq!(ring.pop(), None);
+
+        for i in 0..DEBUG_RING_CAPACITY {
+            assert!(ring.push(&i.to_string()));
+        }
+        assert!(!ring.push("overflow"));
+        assert_eq!(ring.dropped(), 1);
+        assert_eq!(ring.pop().as_deref(), Some("0"));
+
+        // Long messages are truncated on a character boundary
+        let long = "é".repeat(DEBUG_MESSAGE_LEN);
+        let ring = DebugRing::new();
+        ring.push(&long);
+        assert_eq!(ring.pop().unwrap().len(), DEBUG_MESSAGE_LEN);
+
+        // So are messages copied into a short buffer
+        ring.push("aé");
+        let mut buffer = [0u8; 2];
+        assert_eq!(ring.pop_into(&mut buffer), Some(1));
+        assert_eq!(&buffer[..1], b"a");
+    }
+
+    #[test]
+    fn test_concurrent_producers() {
+        let ring = Arc::new(DebugRing::new());
+        let handles: Vec<_> = (0..4)
+            .map(|t| {
+                let ring = ring.clone();
+                std::thread::spawn(move || {
+                    for i in 0..32 {
+                        ring.push(&format!("{}-{}", t, i));
+                    }
+                })
+            })
+            .collect();
+        for handle in handles {
+            handle.join().unwrap();
+        }
+
+        let mut count = 0;
+        while ring.pop().is_some() {
+            count += 1;
+        }
+        assert_eq!(count, 4 * 32);
+    }
+}
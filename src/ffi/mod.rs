@@ -6,17 +6,27 @@
 mod coordinates;
 mod config;
 pub mod context;
+pub mod debug_ring;
+pub mod trace;
 
 pub use coordinates::*;
 pub use config::*;
 pub use context::*;
 
+use crate::allocator;
 use crate::api::DasherInterface;
-use crate::input::{DasherInput, MouseInput, VirtualKey};
+use crate::api::profiler::FrameStats;
+use crate::api::simulation::{FrameSnapshot, SimulationCommand, SimulationThread};
+use crate::input::{DasherInput, EyeTrackerInput, InputSample, MouseInput, SampleRing, VirtualKey};
+use crate::model::memory_governor::{MemoryLimits, MemoryStats};
+use crate::model::training_job::TrainingSource;
+use crate::model::{IndexBytes, IndexedDictionary, LanguageModel, PPMSnapshot, SnapshotLanguageModel};
+use self::trace::TraceEvent;
 use crate::settings::Settings;
-use crate::view::{DasherScreen, Color, Label};
+use crate::view::{DasherScreen, Color, Label, DrawCommand, DrawCommandBuffer, DrawPoint, FrameChange};
 use crate::view::square::{DasherViewSquare, SquareViewConfig, NodeShape};
 use std::ffi::{c_char, CStr};
+use std::sync::Arc;
 
 // Simple implementation of Label for FFI
 struct SimpleLabel {
@@ -130,16 +140,11 @@ impl DasherScreen for SimpleDasherScreen {
     }
 
     fn make_label(&self, text: &str, wrap_size: u32) -> Box<dyn Label> {
-        // Get the global context
-        let context = context::get_global_context();
-
         // Update screen dimensions in the context
-        context.set_screen_dimensions(self.width, self.height);
+        context::current_context().set_screen_dimensions(self.width, self.height);
 
         // Log debug information
-        if context.get_debug_mode() {
-            context.add_debug(&format!("make_label: text={}, wrap_size={}", text, wrap_size));
-        }
+        ffi_debug!("make_label: text={}, wrap_size={}", text, wrap_size);
 
         if let Some(f) = self.make_label_fn {
             // Convert the text to a C string
@@ -148,32 +153,23 @@ impl DasherScreen for SimpleDasherScreen {
 
             if !label_ptr.is_null() {
                 // Create a new SimpleLabel that wraps the C label
-                if context.get_debug_mode() {
-                    context.add_debug(&format!("make_label: Created label for '{}'", text));
-                }
+                ffi_debug!("make_label: Created label for '{}'", text);
                 return Box::new(SimpleLabel::new(text, wrap_size));
-            } else if context.get_debug_mode() {
-                context.add_debug("make_label: C function returned null pointer");
+            } else {
+                ffi_debug!("make_label: C function returned null pointer");
             }
-        } else if context.get_debug_mode() {
-            context.add_debug("make_label: No C function registered");
+        } else {
+            ffi_debug!("make_label: No C function registered");
         }
 
         // Fallback to a simple implementation
-        if context.get_debug_mode() {
-            context.add_debug(&format!("make_label: Using fallback for '{}'", text));
-        }
+        ffi_debug!("make_label: Using fallback for '{}'", text);
         Box::new(SimpleLabel::new(text, wrap_size))
     }
 
     fn text_size(&self, label: &dyn Label, font_size: u32) -> (i32, i32) {
-        // Get the global context
-        let context = context::get_global_context();
-
         // Log debug information
-        if context.get_debug_mode() {
-            context.add_debug(&format!("text_size: text={}, font_size={}", label.get_text(), font_size));
-        }
+        ffi_debug!("text_size: text={}, font_size={}", label.get_text(), font_size);
 
         if let Some(f) = self.get_text_size_fn {
             // Create a new SimpleLabel that wraps the C label
@@ -194,16 +190,14 @@ impl DasherScreen for SimpleDasherScreen {
                     destroy_label(label_ptr);
                 }
 
-                if context.get_debug_mode() {
-                    context.add_debug(&format!("text_size: width={}, height={}", width, height));
-                }
+                ffi_debug!("text_size: width={}, height={}", width, height);
 
                 return (width, height);
-            } else if context.get_debug_mode() {
-                context.add_debug("text_size: make_label_fn returned null pointer");
+            } else {
+                ffi_debug!("text_size: make_label_fn returned null pointer");
             }
-        } else if context.get_debug_mode() {
-            context.add_debug("text_size: No get_text_size_fn registered");
+        } else {
+            ffi_debug!("text_size: No get_text_size_fn registered");
         }
 
         // Fallback to a simple implementation
@@ -212,28 +206,17 @@ impl DasherScreen for SimpleDasherScreen {
         let width = text.len() as i32 * char_width;
         let height = font_size as i32;
 
-        if context.get_debug_mode() {
-            context.add_debug(&format!("text_size (fallback): width={}, height={}", width, height));
-        }
+        ffi_debug!("text_size (fallback): width={}, height={}", width, height);
 
         (width, height)
     }
 
     fn draw_string(&mut self, label: &dyn Label, x: i32, y: i32, font_size: u32, color: Color) {
-        // Get the global context
-        let context = context::get_global_context();
-
-        // Get the current drawing context
-        let drawing_context = context::get_current_drawing_context();
-
         // Log debug information
-        if context.get_debug_mode() {
-            context.add_debug(&format!(
-                "draw_string: text={}, x={}, y={}, font_size={}, color=({},{},{},{}), node={}",
-                label.get_text(), x, y, font_size, color.r, color.g, color.b, color.a,
-                drawing_context.node_id
-            ));
-        }
+        ffi_debug!(
+            "draw_string: text={}, x={}, y={}, font_size={}, color=({},{},{},{})",
+            label.get_text(), x, y, font_size, color.r, color.g, color.b, color.a
+        );
 
         if let Some(f) = self.draw_string_fn {
             // Convert the text to a C string
@@ -243,9 +226,7 @@ impl DasherScreen for SimpleDasherScreen {
             f(c_text.as_ptr(), x, y, font_size as i32, color.r, color.g, color.b, color.a);
         } else {
             // Fallback to a simple implementation
-            if context.get_debug_mode() {
-                context.add_debug("draw_string: Using fallback implementation");
-            }
+            ffi_debug!("draw_string: Using fallback implementation");
 
             let (width, height) = self.text_size(label, font_size);
 
@@ -262,117 +243,109 @@ impl DasherScreen for SimpleDasherScreen {
 
     fn draw_rectangle(&mut self, x1: i32, y1: i32, x2: i32, y2: i32,
                      fill_color: Color, outline_color: Color, line_width: i32) {
-        // Get the global context
-        let context = context::get_global_context();
-
-        // Get the current drawing context
-        let drawing_context = context::get_current_drawing_context();
-
         // Log debug information
-        if context.get_debug_mode() {
-            context.add_debug(&format!(
-                "draw_rectangle: x1={}, y1={}, x2={}, y2={}, fill=({},{},{},{}), outline=({},{},{},{}), width={}, node={}",
-                x1, y1, x2, y2,
-                fill_color.r, fill_color.g, fill_color.b, fill_color.a,
-                outline_color.r, outline_color.g, outline_color.b, outline_color.a,
-                line_width,
-                drawing_context.node_id
-            ));
-        }
+        ffi_debug!(
+            "draw_rectangle: x1={}, y1={}, x2={}, y2={}, fill=({},{},{},{}), outline=({},{},{},{}), width={}",
+            x1, y1, x2, y2,
+            fill_color.r, fill_color.g, fill_color.b, fill_color.a,
+            outline_color.r, outline_color.g, outline_color.b, outline_color.a,
+            line_width
+        );
 
         if let Some(f) = self.draw_rectangle_fn {
             f(x1, y1, x2, y2,
               fill_color.r, fill_color.g, fill_color.b, fill_color.a,
               outline_color.r, outline_color.g, outline_color.b, outline_color.a,
               line_width);
-        } else if context.get_debug_mode() {
-            context.add_debug("draw_rectangle: No C function registered");
+        } else {
+            ffi_debug!("draw_rectangle: No C function registered");
         }
     }
 
     fn draw_circle(&mut self, cx: i32, cy: i32, r: i32,
                   fill_color: Color, line_color: Color, line_width: i32) {
-        // Get the global context
-        let context = context::get_global_context();
-
-        // Get the current drawing context
-        let drawing_context = context::get_current_drawing_context();
-
         // Log debug information
-        if context.get_debug_mode() {
-            context.add_debug(&format!(
-                "draw_circle: cx={}, cy={}, r={}, fill=({},{},{},{}), line=({},{},{},{}), width={}, node={}",
-                cx, cy, r,
-                fill_color.r, fill_color.g, fill_color.b, fill_color.a,
-                line_color.r, line_color.g, line_color.b, line_color.a,
-                line_width,
-                drawing_context.node_id
-            ));
-        }
+        ffi_debug!(
+            "draw_circle: cx={}, cy={}, r={}, fill=({},{},{},{}), line=({},{},{},{}), width={}",
+            cx, cy, r,
+            fill_color.r, fill_color.g, fill_color.b, fill_color.a,
+            line_color.r, line_color.g, line_color.b, line_color.a,
+            line_width
+        );
 
         if let Some(f) = self.draw_circle_fn {
             f(cx, cy, r,
               fill_color.r, fill_color.g, fill_color.b, fill_color.a,
               line_color.r, line_color.g, line_color.b, line_color.a,
               line_width);
-        } else if context.get_debug_mode() {
-            context.add_debug("draw_circle: No C function registered");
+        } else {
+            ffi_debug!("draw_circle: No C function registered");
         }
     }
 
     fn draw_line(&mut self, x1: i32, y1: i32, x2: i32, y2: i32, color: Color, line_width: i32) {
-        // Get the global context
-        let context = context::get_global_context();
-
-        // Get the current drawing context
-        let drawing_context = context::get_current_drawing_context();
-
         // Log debug information
-        if context.get_debug_mode() {
-            context.add_debug(&format!(
-                "draw_line: x1={}, y1={}, x2={}, y2={}, color=({},{},{},{}), width={}, node={}",
-                x1, y1, x2, y2,
-                color.r, color.g, color.b, color.a,
-                line_width,
-                drawing_context.node_id
-            ));
-        }
+        ffi_debug!(
+            "draw_line: x1={}, y1={}, x2={}, y2={}, color=({},{},{},{}), width={}",
+            x1, y1, x2, y2,
+            color.r, color.g, color.b, color.a,
+            line_width
+        );
 
         if let Some(f) = self.draw_line_fn {
             f(x1, y1, x2, y2, color.r, color.g, color.b, color.a, line_width);
-        } else if context.get_debug_mode() {
-            context.add_debug("draw_line: No C function registered");
+        } else {
+            ffi_debug!("draw_line: No C function registered");
         }
     }
 
     fn display(&mut self) {
-        // Get the global context
-        let context = context::get_global_context();
-
         // Log debug information
-        if context.get_debug_mode() {
-            context.add_debug("display: Frame complete");
-        }
+        ffi_debug!("display: Frame complete");
     }
 
     fn is_point_visible(&self, x: i32, y: i32) -> bool {
-        // Get the global context
-        let context = context::get_global_context();
-
         // Log debug information
-        if context.get_debug_mode() {
-            context.add_debug(&format!("is_point_visible: x={}, y={}", x, y));
-        }
+        ffi_debug!("is_point_visible: x={}, y={}", x, y);
 
         true
     }
 }
 
+/// Opaque handle to a DasherInterface and its FFI context
 #[repr(C)]
 pub struct DasherInterfaceFFI {
     interface: DasherInterface,
+    context: Arc<FFIContext>,
+}
+
+impl DasherInterfaceFFI {
+    fn new(interface: DasherInterface) -> Self {
+        Self { interface, context: Arc::new(FFIContext::new()) }
+    }
+}
+
+/// Make an interface's context current until the returned guard is dropped
+///
+/// Every export that takes a `DasherInterfaceFFI` calls this once its null
+/// checks pass, so debug messages and screen state go to that interface.
+///
+/// # Safety
+///
+/// `interface` must be a valid pointer created by `dasher_interface_create`.
+unsafe fn enter_interface(interface: *const DasherInterfaceFFI) -> context::ContextGuard {
+    context::enter(&(*interface).context)
 }
 
+// SAFETY: the `Rc` node tree and other non-`Send` state of an interface are
+// created by and reachable only from that interface; nothing outside the handle
+// keeps a clone, and the only data shared between handles is immutable and
+// behind `Arc`. Moving the handle moves the whole graph, so a host may create an
+// interface on one thread and drive it from another, as long as it makes one
+// call on a handle at a time. The host's screen callbacks run on whichever
+// thread is making the call.
+unsafe impl Send for DasherInterfaceFFI {}
+
 #[repr(C)]
 pub struct DasherSettingsFFI {
     // TODO: Define FFI-compatible settings structure
@@ -420,12 +393,82 @@ pub struct DasherInputFFI {
     input: Box<dyn DasherInput>,
 }
 
+// SAFETY: input devices own their state outright, with no shared references
+unsafe impl Send for DasherInputFFI {}
+
+/// Opaque handle to a ring of batched input samples
+pub struct DasherSampleRingFFI {
+    ring: Arc<SampleRing>,
+}
+
+/// Opaque handle to a trained language model shared read-only between interfaces
+pub struct DasherSharedModelFFI {
+    snapshot: PPMSnapshot<Arc<[u8]>>,
+}
+
 /// Opaque handle to a DasherScreen
 #[repr(C)]
 pub struct DasherScreenFFI {
     screen: SimpleDasherScreen,
 }
 
+/// Opaque handle to a reusable draw command buffer
+///
+/// Transparent so that a buffer inside a simulation frame can be read with the
+/// same accessors.
+#[repr(transparent)]
+pub struct DasherDrawBufferFFI {
+    buffer: DrawCommandBuffer,
+}
+
+/// Load the alphabet `dasher_interface_create` starts with
+fn load_default_alphabet() -> crate::alphabet::Alphabet {
+    // Try different paths for the English alphabet
+    println!("FFI: Loading alphabet");
+    let alphabet_paths = [
+        "data/alphabets/alphabet.english.with.limited.punctuation.xml",
+        "DasherUI/Data/alphabet.english.with.limited.punctuation.xml",
+        "DasherUI-main/build/DasherUI/Data/alphabet.english.with.limited.punctuation.xml",
+        "./DasherUI/Data/alphabet.english.with.limited.punctuation.xml"
+    ];
+
+    for &path in &alphabet_paths {
+        let alphabet_path = std::path::Path::new(path);
+        println!("FFI: Trying alphabet path: {}", path);
+        if alphabet_path.exists() {
+            println!("FFI: Alphabet path exists: {}", path);
+            match crate::alphabet::load_symbol_table(alphabet_path) {
+                Ok(table) => {
+                    println!("FFI: Loaded {} symbols from {}", table.len(), path);
+                    return table.into_alphabet();
+                }
+                Err(e) => {
+                    println!("FFI: Failed to load alphabet from {}: {:?}", path, e);
+                }
+            }
+        } else {
+            println!("FFI: Alphabet path does not exist: {}", path);
+        }
+    }
+
+    // If no alphabet was loaded, create a default English alphabet
+    println!("FFI: Using default English alphabet");
+    crate::alphabet::Alphabet::english()
+}
+
+/// Copy `text` into a host buffer, null-terminated and truncated to fit
+///
+/// Returns the full length of `text` in bytes, so hosts can size the buffer
+/// with a first call that passes a null buffer.
+unsafe fn copy_to_host_buffer(text: &str, buffer: *mut c_char, buffer_size: usize) -> usize {
+    if !buffer.is_null() && buffer_size > 0 {
+        let copy_len = std::cmp::min(text.len(), buffer_size - 1);
+        std::ptr::copy_nonoverlapping(text.as_ptr(), buffer as *mut u8, copy_len);
+        *buffer.add(copy_len) = 0;
+    }
+    text.len()
+}
+
 #[no_mangle]
 pub extern "C" fn dasher_interface_create(
     settings: *const DasherSettingsFFI
@@ -442,6 +485,17 @@ pub extern "C" fn dasher_interface_create(
         Settings::new()
     };
 
+    match build_interface(settings, None) {
+        Some(interface) => Box::into_raw(Box::new(DasherInterfaceFFI::new(interface))),
+        None => std::ptr::null_mut(),
+    }
+}
+
+/// Create an interface with the default alphabet
+///
+/// The language model is `language_model` if given, otherwise the first
+/// snapshot or training text found in the data directories.
+fn build_interface(settings: Settings, language_model: Option<Box<dyn LanguageModel>>) -> Option<DasherInterface> {
     println!("FFI: Creating DasherInterface with settings");
     let mut interface = DasherInterface::new(settings);
 
@@ -449,47 +503,17 @@ pub extern "C" fn dasher_interface_create(
     println!("FFI: Initializing model");
     if let Err(e) = interface.model_mut().initialize() {
         println!("FFI: Failed to initialize model: {:?}", e);
-        return std::ptr::null_mut();
+        return None;
     }
     println!("FFI: Model initialized successfully");
 
-    // Try different paths for the English alphabet
-    println!("FFI: Loading alphabet");
-    let alphabet_paths = [
-        "data/alphabets/alphabet.english.xml",
-        "DasherUI/Data/alphabet.english.with.limited.punctuation.xml",
-        "DasherUI-main/build/DasherUI/Data/alphabet.english.with.limited.punctuation.xml",
-        "./DasherUI/Data/alphabet.english.with.limited.punctuation.xml"
-    ];
-
-    let mut alphabet_loaded = false;
-    for &path in &alphabet_paths {
-        let alphabet_path = std::path::Path::new(path);
-        println!("FFI: Trying alphabet path: {}", path);
-        if alphabet_path.exists() {
-            println!("FFI: Alphabet path exists: {}", path);
-            match crate::alphabet::load_alphabet(alphabet_path) {
-                Ok(alphabet_info) => {
-                    println!("FFI: Loaded alphabet from {}", path);
-                    let alphabet = crate::alphabet::Alphabet::from_info(alphabet_info);
-                    interface.model_mut().set_alphabet(alphabet);
-                    alphabet_loaded = true;
-                    break;
-                }
-                Err(e) => {
-                    println!("FFI: Failed to load alphabet from {}: {:?}", path, e);
-                }
-            }
-        } else {
-            println!("FFI: Alphabet path does not exist: {}", path);
-        }
-    }
+    interface.model_mut().set_alphabet(load_default_alphabet());
 
-    // If no alphabet was loaded, create a default English alphabet
-    if !alphabet_loaded {
-        println!("FFI: Using default English alphabet");
-        let alphabet = crate::alphabet::Alphabet::english();
-        interface.model_mut().set_alphabet(alphabet);
+    let mut training_loaded = false;
+    if let Some(language_model) = language_model {
+        println!("FFI: Using the shared language model");
+        interface.model_mut().set_language_model(language_model);
+        training_loaded = true;
     }
 
     // Try different paths for the training data
@@ -501,9 +525,25 @@ pub extern "C" fn dasher_interface_create(
         "./DasherUI/Data/training_english_GB.txt"
     ];
 
-    let mut training_loaded = false;
-    for &path in &training_paths {
+    for &path in training_paths.iter().filter(|_| !training_loaded) {
         let training_path = std::path::Path::new(path);
+
+        // A snapshot next to the training text skips retraining
+        let snapshot_path = training_path.with_extension("dppm");
+        if snapshot_path.exists() {
+            match crate::model::SnapshotLanguageModel::open(&snapshot_path) {
+                Ok(language_model) => {
+                    println!("FFI: Loaded model snapshot from {}", snapshot_path.display());
+                    interface.model_mut().set_language_model(Box::new(language_model));
+                    training_loaded = true;
+                    break;
+                }
+                Err(e) => {
+                    println!("FFI: Failed to load model snapshot from {}: {}", snapshot_path.display(), e);
+                }
+            }
+        }
+
         println!("FFI: Trying training path: {}", path);
         if training_path.exists() {
             println!("FFI: Training path exists: {}", path);
@@ -538,7 +578,76 @@ pub extern "C" fn dasher_interface_create(
     }
 
     println!("FFI: DasherInterface created successfully");
-    Box::into_raw(Box::new(DasherInterfaceFFI { interface }))
+    Some(interface)
+}
+
+/// Load a model snapshot to share between interfaces
+///
+/// The snapshot is read once; every interface created from it with
+/// `dasher_interface_create_with_shared_model` reads the same bytes and only
+/// keeps its own overlay of what its user has written. The handle may be used
+/// from any thread. Returns null if the file cannot be read or is not a snapshot.
+///
+/// # Safety
+///
+/// The `path` pointer must be a valid null-terminated C string.
+#[no_mangle]
+pub unsafe extern "C" fn dasher_shared_model_open(path: *const c_char) -> *mut DasherSharedModelFFI {
+    if path.is_null() {
+        return std::ptr::null_mut();
+    }
+
+    let path = match CStr::from_ptr(path).to_str() {
+        Ok(path) => path,
+        Err(_) => return std::ptr::null_mut(),
+    };
+    match PPMSnapshot::open_shared(path) {
+        Ok(snapshot) => Box::into_raw(Box::new(DasherSharedModelFFI { snapshot })),
+        Err(e) => {
+            println!("FFI: Failed to load model snapshot from {}: {}", path, e);
+            std::ptr::null_mut()
+        }
+    }
+}
+
+/// Destroy a shared model handle
+///
+/// Interfaces created from the model keep its bytes alive, so the handle can be
+/// destroyed while they are still in use.
+///
+/// # Safety
+///
+/// The `model` pointer must be a valid pointer created by `dasher_shared_model_open`.
+/// After this function is called, the pointer is no longer valid and should not be used.
+#[no_mangle]
+pub unsafe extern "C" fn dasher_shared_model_destroy(model: *mut DasherSharedModelFFI) {
+    if !model.is_null() {
+        let _ = Box::from_raw(model);
+    }
+}
+
+/// Create an interface that predicts from a shared model
+///
+/// Like `dasher_interface_create`, but skips loading training data: the new
+/// interface reads `model` and learns its user's input in a private overlay.
+///
+/// # Safety
+///
+/// The `model` pointer must be a valid pointer created by `dasher_shared_model_open`.
+#[no_mangle]
+pub unsafe extern "C" fn dasher_interface_create_with_shared_model(
+    _settings: *const DasherSettingsFFI,
+    model: *const DasherSharedModelFFI,
+) -> *mut DasherInterfaceFFI {
+    if model.is_null() {
+        return std::ptr::null_mut();
+    }
+
+    let language_model = SnapshotLanguageModel::new((*model).snapshot.clone());
+    match build_interface(Settings::new(), Some(Box::new(language_model))) {
+        Some(interface) => Box::into_raw(Box::new(DasherInterfaceFFI::new(interface))),
+        None => std::ptr::null_mut(),
+    }
 }
 
 /// # Safety
@@ -549,6 +658,7 @@ pub extern "C" fn dasher_interface_create(
 #[no_mangle]
 pub unsafe extern "C" fn dasher_interface_destroy(interface: *mut DasherInterfaceFFI) {
     if !interface.is_null() {
+        let _context = enter_interface(interface);
         let _ = Box::from_raw(interface);
     }
 }
@@ -568,6 +678,8 @@ pub unsafe extern "C" fn dasher_interface_new_frame(
         return false;
     }
 
+    let _context = enter_interface(interface);
+    trace::record(Some(time_ms), TraceEvent::Frame);
     (*interface).interface.new_frame(time_ms)
 }
 
@@ -578,6 +690,100 @@ pub extern "C" fn dasher_create_mouse_input() -> *mut DasherInputFFI {
     Box::into_raw(Box::new(DasherInputFFI { input }))
 }
 
+/// Create a ring for batched input samples
+///
+/// `capacity` is rounded up to a power of two; 0 picks a default of about a
+/// second of samples at 600 Hz.
+#[no_mangle]
+pub extern "C" fn dasher_sample_ring_create(capacity: usize) -> *mut DasherSampleRingFFI {
+    let ring = match capacity {
+        0 => SampleRing::default(),
+        capacity => SampleRing::new(capacity),
+    };
+    Box::into_raw(Box::new(DasherSampleRingFFI { ring: Arc::new(ring) }))
+}
+
+/// Destroy a sample ring handle
+///
+/// Input devices created from the ring keep it alive.
+///
+/// # Safety
+///
+/// The `ring` pointer must be a valid pointer created by `dasher_sample_ring_create`.
+/// After this function is called, the pointer is no longer valid and should not be used.
+#[no_mangle]
+pub unsafe extern "C" fn dasher_sample_ring_destroy(ring: *mut DasherSampleRingFFI) {
+    if !ring.is_null() {
+        let _ = Box::from_raw(ring);
+    }
+}
+
+/// Queue timestamped samples for the next frame
+///
+/// Meant to be called from the tracker's callback thread as samples arrive,
+/// without locking. Samples are in screen coordinates, oldest first, with times on
+/// the clock passed to `dasher_interface_new_frame`. Returns how many were queued;
+/// the rest were dropped because the ring was full or another thread was pushing.
+///
+/// # Safety
+///
+/// The `ring` pointer must be a valid pointer created by `dasher_sample_ring_create`,
+/// and `samples` must point to `count` samples.
+#[no_mangle]
+pub unsafe extern "C" fn dasher_sample_ring_push(
+    ring: *const DasherSampleRingFFI,
+    samples: *const InputSample,
+    count: usize,
+) -> usize {
+    if ring.is_null() || samples.is_null() {
+        return 0;
+    }
+
+    let samples = std::slice::from_raw_parts(samples, count);
+    let ring = &*ring;
+    ring.ring.push_slice(samples)
+}
+
+/// Get the number of samples a ring has dropped
+///
+/// # Safety
+///
+/// The `ring` pointer must be a valid pointer created by `dasher_sample_ring_create`.
+#[no_mangle]
+pub unsafe extern "C" fn dasher_sample_ring_get_dropped(ring: *const DasherSampleRingFFI) -> u64 {
+    if ring.is_null() {
+        return 0;
+    }
+
+    let ring = &*ring;
+    ring.ring.dropped()
+}
+
+/// Create an eye tracker input that steers from the samples pushed into `ring`
+///
+/// Each frame the interface drains the ring and smooths every sample in time
+/// order, so hosts only push samples and never call `dasher_interface_set_input`
+/// again. `smoothing` is the share of the previous position kept per 60 Hz frame
+/// interval, from 0 (none) to 1.
+///
+/// # Safety
+///
+/// The `ring` pointer must be a valid pointer created by `dasher_sample_ring_create`.
+#[no_mangle]
+pub unsafe extern "C" fn dasher_create_eye_tracker_input(
+    ring: *const DasherSampleRingFFI,
+    smoothing: f64,
+) -> *mut DasherInputFFI {
+    if ring.is_null() {
+        return std::ptr::null_mut();
+    }
+
+    let mut input = EyeTrackerInput::with_sample_ring(Arc::clone(&(*ring).ring));
+    input.set_smoothing_factor(smoothing);
+    input.activate();
+    Box::into_raw(Box::new(DasherInputFFI { input: Box::new(input) }))
+}
+
 /// Destroy an input device
 ///
 /// # Safety
@@ -602,6 +808,7 @@ pub unsafe extern "C" fn dasher_interface_set_input(
         return false;
     }
 
+    let _context = enter_interface(interface);
     let input_box = Box::from_raw(input);
     (*interface).interface.set_input(input_box.input.box_clone());
     // Don't drop the input, just forget the box
@@ -620,6 +827,8 @@ pub unsafe extern "C" fn dasher_set_mouse_coordinates(
         return false;
     }
 
+    trace::record(None, TraceEvent::Mouse { x, y });
+
     // For now, we'll assume it's a MouseInput since that's all we're using
     // In a more complete implementation, we'd need a way to check the type
     let input_ref = &mut (*input).input;
@@ -638,18 +847,9 @@ pub unsafe extern "C" fn dasher_set_mouse_coordinates(
     }
 }
 
-/// Handle a key down event
-#[no_mangle]
-pub unsafe extern "C" fn dasher_interface_key_down(
-    interface: *mut DasherInterfaceFFI,
-    time_ms: u64,
-    key: i32
-) {
-    if interface.is_null() {
-        return;
-    }
-
-    let virtual_key = match key {
+/// Map an FFI key code to a virtual key
+fn virtual_key(key: i32) -> VirtualKey {
+    match key {
         0 => VirtualKey::PrimaryInput,
         1 => VirtualKey::SecondaryInput,
         2 => VirtualKey::TertiaryInput,
@@ -670,7 +870,23 @@ pub unsafe extern "C" fn dasher_interface_key_down(
         17 => VirtualKey::Escape,
         18 => VirtualKey::Space,
         _ => VirtualKey::Other(' '),
-    };
+    }
+}
+
+/// Handle a key down event
+#[no_mangle]
+pub unsafe extern "C" fn dasher_interface_key_down(
+    interface: *mut DasherInterfaceFFI,
+    time_ms: u64,
+    key: i32
+) {
+    if interface.is_null() {
+        return;
+    }
+
+    let virtual_key = virtual_key(key);
+    let _context = enter_interface(interface);
+    trace::record(Some(time_ms), TraceEvent::KeyDown(key));
     (*interface).interface.key_down(time_ms, virtual_key);
 }
 
@@ -685,28 +901,9 @@ pub unsafe extern "C" fn dasher_interface_key_up(
         return;
     }
 
-    let virtual_key = match key {
-        0 => VirtualKey::PrimaryInput,
-        1 => VirtualKey::SecondaryInput,
-        2 => VirtualKey::TertiaryInput,
-        3 => VirtualKey::StartStopKey,
-        4 => VirtualKey::Button1,
-        5 => VirtualKey::Button2,
-        6 => VirtualKey::Button3,
-        7 => VirtualKey::Button4,
-        8 => VirtualKey::Button5,
-        9 => VirtualKey::Left,
-        10 => VirtualKey::Right,
-        11 => VirtualKey::Up,
-        12 => VirtualKey::Down,
-        13 => VirtualKey::Delete,
-        14 => VirtualKey::Backspace,
-        15 => VirtualKey::Tab,
-        16 => VirtualKey::Return,
-        17 => VirtualKey::Escape,
-        18 => VirtualKey::Space,
-        _ => VirtualKey::Other(' '),
-    };
+    let virtual_key = virtual_key(key);
+    let _context = enter_interface(interface);
+    trace::record(Some(time_ms), TraceEvent::KeyUp(key));
     (*interface).interface.key_up(time_ms, virtual_key);
 }
 
@@ -717,6 +914,7 @@ pub unsafe extern "C" fn dasher_interface_start(interface: *mut DasherInterfaceF
         return;
     }
 
+    let _context = enter_interface(interface);
     (*interface).interface.start();
 }
 
@@ -727,6 +925,7 @@ pub unsafe extern "C" fn dasher_interface_stop(interface: *mut DasherInterfaceFF
         return;
     }
 
+    let _context = enter_interface(interface);
     (*interface).interface.stop();
 }
 
@@ -737,6 +936,7 @@ pub unsafe extern "C" fn dasher_interface_pause(interface: *mut DasherInterfaceF
         return;
     }
 
+    let _context = enter_interface(interface);
     (*interface).interface.pause();
 }
 
@@ -747,6 +947,7 @@ pub unsafe extern "C" fn dasher_interface_resume(interface: *mut DasherInterface
         return;
     }
 
+    let _context = enter_interface(interface);
     (*interface).interface.resume();
 }
 
@@ -757,6 +958,7 @@ pub unsafe extern "C" fn dasher_interface_is_running(interface: *mut DasherInter
         return false;
     }
 
+    let _context = enter_interface(interface);
     (*interface).interface.is_running()
 }
 
@@ -767,6 +969,7 @@ pub unsafe extern "C" fn dasher_interface_is_paused(interface: *mut DasherInterf
         return false;
     }
 
+    let _context = enter_interface(interface);
     (*interface).interface.is_paused()
 }
 
@@ -777,6 +980,7 @@ pub unsafe extern "C" fn dasher_interface_get_offset(interface: *mut DasherInter
         return 0;
     }
 
+    let _context = enter_interface(interface);
     (*interface).interface.get_offset()
 }
 
@@ -790,6 +994,7 @@ pub unsafe extern "C" fn dasher_interface_edit_output(
         return;
     }
 
+    let _context = enter_interface(interface);
     let c_str = CStr::from_ptr(text);
     if let Ok(text) = c_str.to_str() {
         (*interface).interface.edit_output(text);
@@ -934,6 +1139,7 @@ pub unsafe extern "C" fn dasher_interface_set_screen(
 
     let interface = &mut *interface;
     let screen_ref = &mut *screen;
+    let _context = enter_interface(interface);
 
     println!("FFI: Screen dimensions: {}x{}", screen_ref.screen.get_width(), screen_ref.screen.get_height());
 
@@ -986,10 +1192,323 @@ pub unsafe extern "C" fn dasher_interface_set_screen(
     }
 }
 
-/// Node shape types for FFI
-#[repr(C)]
-pub enum NodeShapeFFI {
-    /// Rectangle shape
+/// Create a reusable draw command buffer
+#[no_mangle]
+pub extern "C" fn dasher_draw_buffer_create() -> *mut DasherDrawBufferFFI {
+    Box::into_raw(Box::new(DasherDrawBufferFFI { buffer: DrawCommandBuffer::new() }))
+}
+
+/// Destroy a draw command buffer
+///
+/// # Safety
+///
+/// The `buffer` pointer must be a valid pointer to a `DasherDrawBufferFFI` object
+/// that was created by `dasher_draw_buffer_create`. After this function is called,
+/// the pointer is no longer valid and should not be used.
+#[no_mangle]
+pub unsafe extern "C" fn dasher_draw_buffer_destroy(buffer: *mut DasherDrawBufferFFI) {
+    if !buffer.is_null() {
+        let _ = Box::from_raw(buffer);
+    }
+}
+
+/// Process a new frame and record its drawing into a draw command buffer
+///
+/// This replaces the per-primitive screen callbacks: the screen set with
+/// `dasher_interface_set_screen` is only used to measure text, and the host replays
+/// the commands from `dasher_draw_buffer_get_commands` afterwards.
+///
+/// # Safety
+///
+/// The `interface` and `buffer` pointers must be valid pointers created by
+/// `dasher_interface_create` and `dasher_draw_buffer_create`.
+#[no_mangle]
+pub unsafe extern "C" fn dasher_interface_render_into(
+    interface: *mut DasherInterfaceFFI,
+    time_ms: u64,
+    buffer: *mut DasherDrawBufferFFI,
+) -> bool {
+    if interface.is_null() || buffer.is_null() {
+        return false;
+    }
+
+    let _context = enter_interface(interface);
+    trace::record(Some(time_ms), TraceEvent::Frame);
+    (*interface).interface.render_into(time_ms, &mut (*buffer).buffer)
+}
+
+/// Opaque handle to an interface stepping on its own thread
+pub struct DasherSimulationFFI {
+    simulation: SimulationThread,
+}
+
+/// Opaque handle to a frame published by a simulation thread
+pub struct DasherFrameFFI {
+    frame: Arc<FrameSnapshot>,
+}
+
+/// Fixed-size details of a simulation frame
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default)]
+pub struct DasherFrameInfo {
+    /// Step the frame comes from, starting at 1; 0 before the first step
+    pub sequence: u64,
+    /// Simulated time of the step in milliseconds
+    pub time_ms: u64,
+    pub root_min: i64,
+    pub root_max: i64,
+    /// Output text generation, as from `dasher_interface_get_output_generation`
+    pub output_generation: u64,
+}
+
+/// Start an interface stepping at `rate_hz` on its own thread
+///
+/// The interface loads the same alphabet and training data as
+/// `dasher_interface_create`, draws on a `width` x `height` screen, takes mouse
+/// input and is started. Text is measured without host callbacks, since they
+/// would run on the simulation thread. The host samples input with the
+/// `dasher_simulation_*` calls and draws the frames from
+/// `dasher_simulation_acquire_frame`, at whatever rate it renders.
+#[no_mangle]
+pub extern "C" fn dasher_simulation_create(rate_hz: u32, width: i32, height: i32) -> *mut DasherSimulationFFI {
+    let simulation = SimulationThread::spawn(rate_hz, move || {
+        let mut interface = build_interface(Settings::new(), None)?;
+        interface.change_screen(Box::new(SimpleDasherScreen::new(width, height))).ok()?;
+        interface.set_input(Box::new(MouseInput::new()));
+        interface.start();
+        Some(interface)
+    });
+    Box::into_raw(Box::new(DasherSimulationFFI { simulation }))
+}
+
+/// Stop a simulation thread and destroy it
+///
+/// # Safety
+///
+/// The `simulation` pointer must have been created by `dasher_simulation_create`
+/// and must not be used afterwards. Frames acquired from it stay valid until released.
+#[no_mangle]
+pub unsafe extern "C" fn dasher_simulation_destroy(simulation: *mut DasherSimulationFFI) {
+    if !simulation.is_null() {
+        let _ = Box::from_raw(simulation);
+    }
+}
+
+/// Set the mouse position for the next simulation step
+///
+/// This never blocks on the simulation thread.
+///
+/// # Safety
+///
+/// The `simulation` pointer must be a valid pointer created by `dasher_simulation_create`.
+#[no_mangle]
+pub unsafe extern "C" fn dasher_simulation_set_mouse_coordinates(
+    simulation: *const DasherSimulationFFI,
+    x: i32,
+    y: i32,
+) -> bool {
+    if simulation.is_null() {
+        return false;
+    }
+
+    trace::record(None, TraceEvent::Mouse { x, y });
+    (*simulation).simulation.set_mouse_position(x, y);
+    true
+}
+
+/// Queue a key down event for the next simulation step
+///
+/// # Safety
+///
+/// The `simulation` pointer must be a valid pointer created by `dasher_simulation_create`.
+#[no_mangle]
+pub unsafe extern "C" fn dasher_simulation_key_down(simulation: *const DasherSimulationFFI, key: i32) {
+    if simulation.is_null() {
+        return;
+    }
+    (*simulation).simulation.send(SimulationCommand::KeyDown(virtual_key(key)));
+}
+
+/// Queue a key up event for the next simulation step
+///
+/// # Safety
+///
+/// The `simulation` pointer must be a valid pointer created by `dasher_simulation_create`.
+#[no_mangle]
+pub unsafe extern "C" fn dasher_simulation_key_up(simulation: *const DasherSimulationFFI, key: i32) {
+    if simulation.is_null() {
+        return;
+    }
+    (*simulation).simulation.send(SimulationCommand::KeyUp(virtual_key(key)));
+}
+
+/// Pause or resume a simulation; a paused simulation keeps publishing frames
+///
+/// # Safety
+///
+/// The `simulation` pointer must be a valid pointer created by `dasher_simulation_create`.
+#[no_mangle]
+pub unsafe extern "C" fn dasher_simulation_set_paused(simulation: *const DasherSimulationFFI, paused: bool) {
+    if simulation.is_null() {
+        return;
+    }
+    let command = if paused { SimulationCommand::Pause } else { SimulationCommand::Resume };
+    (*simulation).simulation.send(command);
+}
+
+/// Take the most recently published frame
+///
+/// The frame is immutable and stays valid until `dasher_frame_release`, however
+/// many steps run meanwhile. Hosts should release it once drawn so that the
+/// simulation thread can reuse its buffers.
+///
+/// # Safety
+///
+/// The `simulation` pointer must be a valid pointer created by `dasher_simulation_create`.
+#[no_mangle]
+pub unsafe extern "C" fn dasher_simulation_acquire_frame(simulation: *const DasherSimulationFFI) -> *mut DasherFrameFFI {
+    if simulation.is_null() {
+        return std::ptr::null_mut();
+    }
+    Box::into_raw(Box::new(DasherFrameFFI { frame: (*simulation).simulation.latest() }))
+}
+
+/// Release a frame taken with `dasher_simulation_acquire_frame`
+///
+/// # Safety
+///
+/// The `frame` pointer must have been returned by `dasher_simulation_acquire_frame`
+/// and must not be used afterwards.
+#[no_mangle]
+pub unsafe extern "C" fn dasher_frame_release(frame: *mut DasherFrameFFI) {
+    if !frame.is_null() {
+        let _ = Box::from_raw(frame);
+    }
+}
+
+/// Get the fixed-size details of a frame
+///
+/// # Safety
+///
+/// The `frame` pointer must be a valid pointer returned by `dasher_simulation_acquire_frame`,
+/// and `info` must be a valid pointer to a `DasherFrameInfo`.
+#[no_mangle]
+pub unsafe extern "C" fn dasher_frame_get_info(frame: *const DasherFrameFFI, info: *mut DasherFrameInfo) -> bool {
+    if frame.is_null() || info.is_null() {
+        return false;
+    }
+
+    let frame = &(*frame).frame;
+    *info = DasherFrameInfo {
+        sequence: frame.sequence,
+        time_ms: frame.time_ms,
+        root_min: frame.root_range.0,
+        root_max: frame.root_range.1,
+        output_generation: frame.output_generation,
+    };
+    true
+}
+
+/// Get the draw commands of a frame
+///
+/// The result is read with the `dasher_draw_buffer_get_*` accessors, and is owned
+/// by the frame: it must not be rendered into or destroyed.
+///
+/// # Safety
+///
+/// The `frame` pointer must be a valid pointer returned by `dasher_simulation_acquire_frame`.
+#[no_mangle]
+pub unsafe extern "C" fn dasher_frame_get_buffer(frame: *const DasherFrameFFI) -> *const DasherDrawBufferFFI {
+    if frame.is_null() {
+        return std::ptr::null();
+    }
+    let frame = &*frame;
+    &frame.frame.commands as *const DrawCommandBuffer as *const DasherDrawBufferFFI
+}
+
+/// Copy the output text of a frame, returning its length in bytes
+///
+/// # Safety
+///
+/// The `frame` pointer must be a valid pointer returned by `dasher_simulation_acquire_frame`,
+/// and `buffer` must be null or point to at least `buffer_size` bytes.
+#[no_mangle]
+pub unsafe extern "C" fn dasher_frame_get_output(frame: *const DasherFrameFFI, buffer: *mut c_char, buffer_size: usize) -> usize {
+    if frame.is_null() {
+        return 0;
+    }
+    let frame = &*frame;
+    copy_to_host_buffer(&frame.frame.output_text, buffer, buffer_size)
+}
+
+/// Get the recorded draw commands
+///
+/// The returned pointer stays valid until the buffer is next rendered into or destroyed.
+///
+/// # Safety
+///
+/// The `buffer` pointer must be a valid pointer created by `dasher_draw_buffer_create`,
+/// and `count` must be a valid pointer to a `usize`.
+#[no_mangle]
+pub unsafe extern "C" fn dasher_draw_buffer_get_commands(
+    buffer: *const DasherDrawBufferFFI,
+    count: *mut usize,
+) -> *const DrawCommand {
+    if buffer.is_null() || count.is_null() {
+        return std::ptr::null();
+    }
+
+    let commands = (*buffer).buffer.commands();
+    *count = commands.len();
+    commands.as_ptr()
+}
+
+/// Get the polygon vertices referenced by polygon commands
+///
+/// # Safety
+///
+/// The `buffer` pointer must be a valid pointer created by `dasher_draw_buffer_create`,
+/// and `count` must be a valid pointer to a `usize`.
+#[no_mangle]
+pub unsafe extern "C" fn dasher_draw_buffer_get_points(
+    buffer: *const DasherDrawBufferFFI,
+    count: *mut usize,
+) -> *const DrawPoint {
+    if buffer.is_null() || count.is_null() {
+        return std::ptr::null();
+    }
+
+    let points = (*buffer).buffer.points();
+    *count = points.len();
+    points.as_ptr()
+}
+
+/// Get the UTF-8 text referenced by string commands
+///
+/// Every string is followed by a null terminator that is not counted in its `data_len`.
+///
+/// # Safety
+///
+/// The `buffer` pointer must be a valid pointer created by `dasher_draw_buffer_create`,
+/// and `len` must be a valid pointer to a `usize`.
+#[no_mangle]
+pub unsafe extern "C" fn dasher_draw_buffer_get_text(
+    buffer: *const DasherDrawBufferFFI,
+    len: *mut usize,
+) -> *const c_char {
+    if buffer.is_null() || len.is_null() {
+        return std::ptr::null();
+    }
+
+    let text = (*buffer).buffer.text();
+    *len = text.len();
+    text.as_ptr() as *const c_char
+}
+
+/// Node shape types for FFI
+#[repr(C)]
+pub enum NodeShapeFFI {
+    /// Rectangle shape
     Rectangle = 0,
     /// Triangle shape
     Triangle = 1,
@@ -1023,6 +1542,7 @@ pub unsafe extern "C" fn dasher_interface_set_node_shape(
         return false;
     }
 
+    let _context = enter_interface(interface);
     let interface = &mut *interface;
     let result = interface.interface.set_node_shape(shape.into());
     result.is_ok()
@@ -1038,6 +1558,7 @@ pub unsafe extern "C" fn dasher_interface_set_x_nonlinear(
         return false;
     }
 
+    let _context = enter_interface(interface);
     let interface = &mut *interface;
     let result = interface.interface.set_x_nonlinear(enable);
     result.is_ok()
@@ -1053,6 +1574,7 @@ pub unsafe extern "C" fn dasher_interface_set_y_nonlinear(
         return false;
     }
 
+    let _context = enter_interface(interface);
     let interface = &mut *interface;
     let result = interface.interface.set_y_nonlinear(enable);
     result.is_ok()
@@ -1068,6 +1590,7 @@ pub unsafe extern "C" fn dasher_interface_set_text_3d(
         return false;
     }
 
+    let _context = enter_interface(interface);
     let interface = &mut *interface;
     let result = interface.interface.set_text_3d(enable);
     result.is_ok()
@@ -1083,6 +1606,7 @@ pub unsafe extern "C" fn dasher_interface_set_flowing_interface(
         return false;
     }
 
+    let _context = enter_interface(interface);
     let interface = &mut *interface;
     let result = interface.interface.set_flowing_interface(enable);
     result.is_ok()
@@ -1098,6 +1622,7 @@ pub unsafe extern "C" fn dasher_interface_set_flowing_speed(
         return false;
     }
 
+    let _context = enter_interface(interface);
     let interface = &mut *interface;
     let result = interface.interface.set_flowing_speed(speed);
     result.is_ok()
@@ -1113,6 +1638,7 @@ pub unsafe extern "C" fn dasher_interface_set_ppm(
         return false;
     }
 
+    let _context = enter_interface(interface);
     let interface = &mut *interface;
     let result = interface.interface.set_ppm(enable);
     result.is_ok()
@@ -1128,6 +1654,7 @@ pub unsafe extern "C" fn dasher_interface_set_draw_crosshair(
         return false;
     }
 
+    let _context = enter_interface(interface);
     let interface = &mut *interface;
     let result = interface.interface.set_draw_crosshair(enable);
     result.is_ok()
@@ -1143,6 +1670,7 @@ pub unsafe extern "C" fn dasher_interface_set_draw_cursor(
         return false;
     }
 
+    let _context = enter_interface(interface);
     let interface = &mut *interface;
     let result = interface.interface.set_draw_cursor(enable);
     result.is_ok()
@@ -1158,11 +1686,125 @@ pub unsafe extern "C" fn dasher_interface_set_draw_outlines(
         return false;
     }
 
+    let _context = enter_interface(interface);
     let interface = &mut *interface;
     let result = interface.interface.set_draw_outlines(enable);
     result.is_ok()
 }
 
+/// Limit how much of the tree is drawn each frame
+///
+/// Nodes shorter than `min_node_size` pixels are merged into spans, levels
+/// deeper than `max_depth` below the root are not drawn, and drawing stops
+/// after `max_nodes` shapes.
+#[no_mangle]
+pub unsafe extern "C" fn dasher_interface_set_render_limits(
+    interface: *mut DasherInterfaceFFI,
+    min_node_size: i32,
+    max_depth: u32,
+    max_nodes: u32,
+) -> bool {
+    if interface.is_null() {
+        return false;
+    }
+
+    let _context = enter_interface(interface);
+    let interface = &mut *interface;
+    let result = interface.interface.set_render_limits(min_node_size, max_depth as usize, max_nodes);
+    result.is_ok()
+}
+
+/// Enable or disable retained rendering
+///
+/// While the tree is stationary, frames then only redraw the crosshair and
+/// cursor, or nothing; `dasher_interface_get_frame_change` tells the host which.
+/// Hosts using `dasher_interface_render_into` must pass the same buffer every frame.
+#[no_mangle]
+pub unsafe extern "C" fn dasher_interface_set_retained_mode(
+    interface: *mut DasherInterfaceFFI,
+    enable: bool,
+) -> bool {
+    if interface.is_null() {
+        return false;
+    }
+
+    let _context = enter_interface(interface);
+    let interface = &mut *interface;
+    let result = interface.interface.set_retained_mode(enable);
+    result.is_ok()
+}
+
+/// Get how much of the last frame was redrawn
+///
+/// With `FrameChange::Unchanged` the host can keep showing what it drew for the
+/// previous frame; with `FrameChange::Overlay` only the crosshair and cursor moved.
+///
+/// # Safety
+///
+/// The `interface` pointer must be a valid pointer created by `dasher_interface_create`.
+#[no_mangle]
+pub unsafe extern "C" fn dasher_interface_get_frame_change(interface: *const DasherInterfaceFFI) -> FrameChange {
+    if interface.is_null() {
+        return FrameChange::Full;
+    }
+
+    let _context = enter_interface(interface);
+    (*interface).interface.last_frame_change()
+}
+
+/// Get the UTF-8 characters the current alphabet needs glyphs for
+///
+/// Returns the length in bytes; pass a null buffer to query it. Hosts build
+/// their font atlas from these characters rather than whole script ranges.
+///
+/// # Safety
+///
+/// The `interface` pointer must be a valid pointer created by `dasher_interface_create`,
+/// and `buffer` must be null or point to at least `buffer_size` bytes.
+#[no_mangle]
+pub unsafe extern "C" fn dasher_interface_get_alphabet_glyphs(
+    interface: *const DasherInterfaceFFI,
+    buffer: *mut c_char,
+    buffer_size: usize
+) -> usize {
+    if interface.is_null() {
+        return 0;
+    }
+
+    let _context = enter_interface(interface);
+    copy_to_host_buffer(&(*interface).interface.alphabet_glyphs(), buffer, buffer_size)
+}
+
+/// Get the generation of the current alphabet, incremented every time it is replaced
+///
+/// Hosts compare it between frames and only fetch the glyphs again when it changes.
+///
+/// # Safety
+///
+/// The `interface` pointer must be a valid pointer created by `dasher_interface_create`.
+#[no_mangle]
+pub unsafe extern "C" fn dasher_interface_get_alphabet_generation(interface: *const DasherInterfaceFFI) -> u64 {
+    if interface.is_null() {
+        return 0;
+    }
+
+    let _context = enter_interface(interface);
+    (*interface).interface.get_alphabet_generation()
+}
+
+/// Get the UTF-8 characters needing glyphs in the alphabet `dasher_interface_create` loads
+///
+/// This lets hosts build their fonts before any interface exists. Returns the
+/// length in bytes; pass a null buffer to query it.
+///
+/// # Safety
+///
+/// `buffer` must be null or point to at least `buffer_size` bytes.
+#[no_mangle]
+pub unsafe extern "C" fn dasher_default_alphabet_glyphs(buffer: *mut c_char, buffer_size: usize) -> usize {
+    copy_to_host_buffer(&load_default_alphabet().glyphs(), buffer, buffer_size)
+}
+
 /// Get the output text
 #[no_mangle]
 pub unsafe extern "C" fn dasher_interface_get_output(
@@ -1174,6 +1816,7 @@ pub unsafe extern "C" fn dasher_interface_get_output(
         return 0;
     }
 
+    let _context = enter_interface(interface);
     let output = (*interface).interface.get_output_text();
     let output_len = output.len();
 
@@ -1197,6 +1840,447 @@ pub unsafe extern "C" fn dasher_interface_get_output(
     copy_len
 }
 
+/// Borrowed view of the output text
+#[repr(C)]
+pub struct DasherTextSpan {
+    /// UTF-8 bytes, not null-terminated
+    pub data: *const c_char,
+    /// Number of bytes
+    pub len: usize,
+    /// Generation of the text
+    pub generation: u64,
+}
+
+/// Changes to the output text since a generation
+#[repr(C)]
+pub struct DasherTextDelta {
+    /// Number of leading bytes of the caller's copy to keep
+    pub keep: usize,
+    /// UTF-8 bytes to append after truncating to `keep`, not null-terminated
+    pub data: *const c_char,
+    /// Number of bytes to append
+    pub len: usize,
+    /// Generation the caller's copy is at after applying the delta
+    pub generation: u64,
+    /// The requested generation was too old; `data` holds the whole text and `keep` is 0
+    pub resync: bool,
+}
+
+/// Get the output text without copying it
+///
+/// The span borrows the interface's text and is valid until the next call that
+/// changes the output (`dasher_interface_new_frame`, `dasher_interface_edit_output`, ...).
+///
+/// # Safety
+///
+/// The `interface` pointer must be a valid pointer created by `dasher_interface_create`.
+#[no_mangle]
+pub unsafe extern "C" fn dasher_interface_get_output_span(
+    interface: *const DasherInterfaceFFI
+) -> DasherTextSpan {
+    if interface.is_null() {
+        return DasherTextSpan { data: std::ptr::null(), len: 0, generation: 0 };
+    }
+
+    let _context = enter_interface(interface);
+    let interface = &(*interface).interface;
+    let output = interface.get_output_text();
+    DasherTextSpan {
+        data: output.as_ptr() as *const c_char,
+        len: output.len(),
+        generation: interface.get_output_generation(),
+    }
+}
+
+/// Get the changes to the output text made after `generation`
+///
+/// The data pointer has the same lifetime as the one from `dasher_interface_get_output_span`.
+///
+/// # Safety
+///
+/// The `interface` pointer must be a valid pointer created by `dasher_interface_create`,
+/// and `delta` must be a valid pointer to a `DasherTextDelta`.
+#[no_mangle]
+pub unsafe extern "C" fn dasher_interface_get_output_delta(
+    interface: *const DasherInterfaceFFI,
+    generation: u64,
+    delta: *mut DasherTextDelta
+) -> bool {
+    if interface.is_null() || delta.is_null() {
+        return false;
+    }
+
+    let _context = enter_interface(interface);
+    let changes = (*interface).interface.get_output_delta(generation);
+    *delta = DasherTextDelta {
+        keep: changes.keep,
+        data: changes.appended.as_ptr() as *const c_char,
+        len: changes.appended.len(),
+        generation: changes.generation,
+        resync: changes.resync,
+    };
+    true
+}
+
+/// Get timing and work statistics for the frames processed so far
+///
+/// # Safety
+///
+/// The `interface` pointer must be a valid pointer created by `dasher_interface_create`,
+/// and `stats` must be a valid pointer to a `FrameStats`.
+#[no_mangle]
+pub unsafe extern "C" fn dasher_interface_get_frame_stats(
+    interface: *const DasherInterfaceFFI,
+    stats: *mut FrameStats
+) -> bool {
+    if interface.is_null() || stats.is_null() {
+        return false;
+    }
+
+    let _context = enter_interface(interface);
+    *stats = (*interface).interface.frame_stats();
+    true
+}
+
+/// Forget the frame statistics collected so far
+///
+/// # Safety
+///
+/// The `interface` pointer must be a valid pointer created by `dasher_interface_create`.
+#[no_mangle]
+pub unsafe extern "C" fn dasher_interface_reset_frame_stats(interface: *mut DasherInterfaceFFI) {
+    if interface.is_null() {
+        return;
+    }
+
+    let _context = enter_interface(interface);
+    (*interface).interface.reset_frame_stats();
+}
+
+/// Get the limits on the size of the node tree
+///
+/// # Safety
+///
+/// The `interface` pointer must be a valid pointer created by `dasher_interface_create`,
+/// and `limits` must be a valid pointer to a `MemoryLimits`.
+#[no_mangle]
+pub unsafe extern "C" fn dasher_interface_get_memory_limits(
+    interface: *const DasherInterfaceFFI,
+    limits: *mut MemoryLimits
+) -> bool {
+    if interface.is_null() || limits.is_null() {
+        return false;
+    }
+
+    let _context = enter_interface(interface);
+    *limits = (*interface).interface.memory_limits();
+    true
+}
+
+/// Set the limits on the size of the node tree
+///
+/// A limit of 0 on nodes or bytes means no limit. When the tree grows past a
+/// limit, the expanded subtrees seen least recently are collapsed.
+///
+/// # Safety
+///
+/// The `interface` pointer must be a valid pointer created by `dasher_interface_create`,
+/// and `limits` must be a valid pointer to a `MemoryLimits`.
+#[no_mangle]
+pub unsafe extern "C" fn dasher_interface_set_memory_limits(
+    interface: *mut DasherInterfaceFFI,
+    limits: *const MemoryLimits
+) -> bool {
+    if interface.is_null() || limits.is_null() {
+        return false;
+    }
+
+    let _context = enter_interface(interface);
+    let interface = &mut *interface;
+    interface.interface.set_memory_limits(*limits);
+    true
+}
+
+/// Get the node tree's size and eviction counters
+///
+/// # Safety
+///
+/// The `interface` pointer must be a valid pointer created by `dasher_interface_create`,
+/// and `stats` must be a valid pointer to a `MemoryStats`.
+#[no_mangle]
+pub unsafe extern "C" fn dasher_interface_get_memory_stats(
+    interface: *const DasherInterfaceFFI,
+    stats: *mut MemoryStats
+) -> bool {
+    if interface.is_null() || stats.is_null() {
+        return false;
+    }
+
+    let _context = enter_interface(interface);
+    *stats = (*interface).interface.memory_stats();
+    true
+}
+
+/// Route the library's allocations to host callbacks
+///
+/// Must be called before any other function of the library, which would
+/// otherwise already have allocated from the system allocator. Returns false
+/// then, or if the library was built without the `ffi-allocator` feature.
+///
+/// # Safety
+///
+/// `alloc` and `free` must behave like `malloc` and `free` for the alignment
+/// they are given, be callable from any thread, and stay valid while the
+/// library is loaded. `user_data` is passed to both.
+#[no_mangle]
+pub unsafe extern "C" fn dasher_set_allocator(
+    alloc: Option<allocator::HostAllocFn>,
+    free: Option<allocator::HostFreeFn>,
+    user_data: *mut std::ffi::c_void
+) -> bool {
+    match (alloc, free) {
+        (Some(alloc), Some(free)) => allocator::install_host_allocator(alloc, free, user_data),
+        _ => false,
+    }
+}
+
+/// Turn allocation counting on or off
+///
+/// While it is on, `FrameCounts` reports the allocations made during each frame.
+/// Returns false if the library was built without the `ffi-allocator` feature.
+#[no_mangle]
+pub extern "C" fn dasher_set_allocation_tracking(enabled: bool) -> bool {
+    allocator::set_tracking(enabled)
+}
+
+/// Get the allocations counted since the library was loaded
+///
+/// # Safety
+///
+/// `stats` must be a valid pointer to an `AllocationStats`.
+#[no_mangle]
+pub unsafe extern "C" fn dasher_get_allocation_stats(stats: *mut allocator::AllocationStats) -> bool {
+    if stats.is_null() {
+        return false;
+    }
+
+    *stats = allocator::stats();
+    true
+}
+
+/// Train a language model on a text file and write it as a binary snapshot
+///
+/// A snapshot saved next to a training file with the `.dppm` extension is loaded
+/// by `dasher_interface_create` instead of retraining from the text.
+///
+/// # Safety
+///
+/// `training_path` and `snapshot_path` must be valid null-terminated C strings.
+#[no_mangle]
+pub unsafe extern "C" fn dasher_build_model_snapshot(
+    training_path: *const c_char,
+    snapshot_path: *const c_char,
+    order: i32
+) -> bool {
+    if training_path.is_null() || snapshot_path.is_null() {
+        return false;
+    }
+
+    let (training_path, snapshot_path) = match (CStr::from_ptr(training_path).to_str(), CStr::from_ptr(snapshot_path).to_str()) {
+        (Ok(training), Ok(snapshot)) => (training, snapshot),
+        _ => return false,
+    };
+    let order = match crate::model::PPMOrder::from_value(order) {
+        Some(order) => order,
+        None => return false,
+    };
+    let text = match std::fs::read_to_string(training_path) {
+        Ok(text) => text,
+        Err(_) => return false,
+    };
+
+    let mut model = crate::model::ArenaPPMLanguageModel::new(order);
+    for c in text.chars() {
+        crate::model::LanguageModel::enter_symbol(&mut model, c);
+    }
+    let mut stats = crate::alphabet::TrainingStats::new();
+    stats.update(&text);
+
+    model.save_snapshot(Some(&stats), snapshot_path).is_ok()
+}
+
+/// Replace the language model with one loaded from a binary snapshot
+///
+/// The node tree is rebuilt from the output text, as for any model swap, so no
+/// node keeps a cursor into the previous model.
+///
+/// # Safety
+///
+/// The `interface` pointer must be a valid pointer created by `dasher_interface_create`,
+/// and `path` must be a valid null-terminated C string.
+#[no_mangle]
+pub unsafe extern "C" fn dasher_interface_load_model_snapshot(
+    interface: *mut DasherInterfaceFFI,
+    path: *const c_char
+) -> bool {
+    if interface.is_null() || path.is_null() {
+        return false;
+    }
+
+    let _context = enter_interface(interface);
+    let path = match CStr::from_ptr(path).to_str() {
+        Ok(path) => path,
+        Err(_) => return false,
+    };
+    match crate::model::SnapshotLanguageModel::open(path) {
+        Ok(language_model) => {
+            (*interface).interface.model_mut().set_language_model(Box::new(language_model));
+            true
+        }
+        Err(_) => false,
+    }
+}
+
+/// Load a dictionary into the interface's language model
+///
+/// The file is either a `word\tfrequency` list or an indexed dictionary built
+/// with `dasher-dict`; the index is read once and queried in place.
+///
+/// # Safety
+///
+/// The `interface` pointer must be a valid pointer created by `dasher_interface_create`,
+/// and `path` must be a valid null-terminated C string.
+#[no_mangle]
+pub unsafe extern "C" fn dasher_interface_load_dictionary(
+    interface: *mut DasherInterfaceFFI,
+    path: *const c_char
+) -> bool {
+    if interface.is_null() || path.is_null() {
+        return false;
+    }
+
+    let _context = enter_interface(interface);
+    let path = match CStr::from_ptr(path).to_str() {
+        Ok(path) => path,
+        Err(_) => return false,
+    };
+    (*interface).interface.model_mut().load_dictionary(path).is_ok()
+}
+
+/// Use an indexed dictionary the host has memory-mapped
+///
+/// The index is read straight from the mapping, so processes mapping the same
+/// file share its pages. Returns false if the bytes are not a valid index or
+/// the language model has no dictionary.
+///
+/// # Safety
+///
+/// The `interface` pointer must be a valid pointer created by `dasher_interface_create`.
+/// `data` must point to `len` readable bytes that stay mapped and unchanged
+/// until every interface given them has been destroyed.
+#[no_mangle]
+pub unsafe extern "C" fn dasher_interface_map_dictionary(
+    interface: *mut DasherInterfaceFFI,
+    data: *const u8,
+    len: usize
+) -> bool {
+    if interface.is_null() || data.is_null() {
+        return false;
+    }
+
+    let _context = enter_interface(interface);
+    let bytes: &'static [u8] = std::slice::from_raw_parts(data, len);
+    match IndexedDictionary::from_bytes(IndexBytes::Mapped(bytes)) {
+        Ok(index) => (*interface).interface.model_mut().set_dictionary_index(index),
+        Err(e) => {
+            println!("FFI: Failed to map dictionary: {}", e);
+            false
+        }
+    }
+}
+
+/// Start recording FFI input to a trace file for offline replay
+///
+/// Mouse moves, key events and frames from every interface are appended in call
+/// order until `dasher_trace_stop_recording`. Starting again replaces the
+/// current recording.
+///
+/// # Safety
+///
+/// `path` must be a valid null-terminated C string.
+#[no_mangle]
+pub unsafe extern "C" fn dasher_trace_start_recording(path: *const c_char) -> bool {
+    if path.is_null() {
+        return false;
+    }
+
+    match CStr::from_ptr(path).to_str() {
+        Ok(path) => trace::start_recording(path).is_ok(),
+        Err(_) => false,
+    }
+}
+
+/// Stop recording and flush the trace file
+///
+/// Returns false if nothing was recording or the trace could not be written.
+#[no_mangle]
+pub extern "C" fn dasher_trace_stop_recording() -> bool {
+    trace::stop_recording().unwrap_or(false)
+}
+
+/// Start training a language model from a text file on a worker thread
+///
+/// The current model keeps working until the new one is swapped in at the start
+/// of a later frame. A `.dppm` path is loaded as a model snapshot instead.
+///
+/// # Safety
+///
+/// The `interface` pointer must be a valid pointer created by `dasher_interface_create`,
+/// and `path` must be a valid null-terminated C string.
+#[no_mangle]
+pub unsafe extern "C" fn dasher_interface_start_background_training(
+    interface: *mut DasherInterfaceFFI,
+    path: *const c_char,
+    order: i32
+) -> bool {
+    if interface.is_null() || path.is_null() {
+        return false;
+    }
+
+    let _context = enter_interface(interface);
+    let path = match CStr::from_ptr(path).to_str() {
+        Ok(path) => std::path::PathBuf::from(path),
+        Err(_) => return false,
+    };
+    let order = match crate::model::PPMOrder::from_value(order) {
+        Some(order) => order,
+        None => return false,
+    };
+
+    let source = if path.extension().map_or(false, |ext| ext == "dppm") {
+        TrainingSource::Snapshot(path)
+    } else {
+        TrainingSource::File(path)
+    };
+    (*interface).interface.model_mut().start_background_training(order, vec![source]);
+    true
+}
+
+/// Get the progress of background training, from 0 to 1, or -1 if none is running
+///
+/// # Safety
+///
+/// The `interface` pointer must be a valid pointer created by `dasher_interface_create`.
+#[no_mangle]
+pub unsafe extern "C" fn dasher_interface_get_training_progress(interface: *const DasherInterfaceFFI) -> f32 {
+    if interface.is_null() {
+        return -1.0;
+    }
+
+    let _context = enter_interface(interface);
+    (*interface).interface.model().background_training_progress().unwrap_or(-1.0)
+}
+
 /// Transform Dasher coordinates to screen coordinates
 ///
 /// # Safety
@@ -1304,6 +2388,34 @@ pub unsafe extern "C" fn dasher_transform_rectangle(
     true
 }
 
+/// Transform an array of rectangles from Dasher coordinates to screen coordinates
+///
+/// `rects` holds `count` rectangles as `x1, y1, x2, y2` and `out` receives
+/// `count` normalised screen rectangles in the same layout.
+///
+/// # Safety
+///
+/// `rects` must point to `4 * count` readable `i64` values and `out` to
+/// `4 * count` writable `i32` values.
+#[no_mangle]
+pub unsafe extern "C" fn dasher_transform_rectangles(
+    rects: *const i64,
+    count: usize,
+    screen_width: i32,
+    screen_height: i32,
+    orientation: i32,
+    out: *mut i32
+) -> bool {
+    if rects.is_null() || out.is_null() {
+        return false;
+    }
+
+    let rects = std::slice::from_raw_parts(rects as *const [i64; 4], count);
+    let out = std::slice::from_raw_parts_mut(out as *mut [i32; 4], count);
+    coordinates::transform_rectangles(rects, screen_width, screen_height, orientation, out);
+    true
+}
+
 /// Create a default square view configuration
 #[no_mangle]
 pub extern "C" fn dasher_create_square_view_config() -> *mut SquareViewConfigFFI {
@@ -1339,6 +2451,7 @@ pub unsafe extern "C" fn dasher_interface_set_square_view_config(
         return false;
     }
 
+    let _context = enter_interface(interface);
     let interface = &mut *interface;
     let config = &*config;
 
@@ -1370,6 +2483,7 @@ pub unsafe extern "C" fn dasher_interface_get_square_view_config(
         return false;
     }
 
+    let _context = enter_interface(interface);
     let interface = &mut *interface;
 
     // Get the square view from the interface
@@ -1451,11 +2565,15 @@ pub unsafe extern "C" fn dasher_get_error_message(
 #[no_mangle]
 pub extern "C" fn dasher_get_debug_message_count() -> i32 {
     let context = context::get_global_context();
-    let messages = context.get_debug_messages();
-    messages.len() as i32
+    context.debug_messages.len() as i32
 }
 
-/// Get a debug message
+/// Take the oldest debug message
+///
+/// Messages are drained oldest first, whatever `index` is; it is kept for
+/// compatibility and ignored. A loop over `0..dasher_get_debug_message_count()`
+/// receives each message once. Messages longer than the buffer are truncated
+/// on a UTF-8 character boundary. Returns false once no messages are left.
 ///
 /// # Safety
 ///
@@ -1463,34 +2581,85 @@ pub extern "C" fn dasher_get_debug_message_count() -> i32 {
 /// The `buffer` pointer must be valid and point to a buffer of at least `buffer_size` bytes.
 #[no_mangle]
 pub unsafe extern "C" fn dasher_get_debug_message(
-    index: i32,
+    _index: i32,
     buffer: *mut c_char,
     buffer_size: usize
 ) -> bool {
-    if buffer.is_null() {
+    if buffer.is_null() || buffer_size == 0 {
         return false;
     }
 
     let context = context::get_global_context();
-    let messages = context.get_debug_messages();
+    pop_debug_message(&context, buffer, buffer_size)
+}
 
-    if index < 0 || index >= messages.len() as i32 {
-        return false;
+/// Move the oldest debug message of `context` into a host buffer, null-terminated
+unsafe fn pop_debug_message(context: &FFIContext, buffer: *mut c_char, buffer_size: usize) -> bool {
+    let buffer = std::slice::from_raw_parts_mut(buffer as *mut u8, buffer_size);
+    match context.debug_messages.pop_into(&mut buffer[..buffer_size - 1]) {
+        Some(len) => {
+            // Null-terminate the string
+            buffer[len] = 0;
+            true
+        }
+        None => false,
     }
+}
 
-    let message = &messages[index as usize];
-    let copy_len = std::cmp::min(message.len(), buffer_size - 1);
+/// Enable or disable debug mode for one interface
+///
+/// Messages logged while the interface is handling a call go to its own queue,
+/// read with `dasher_interface_get_debug_message`, instead of the global one.
+///
+/// # Safety
+///
+/// The `interface` pointer must be a valid pointer created by `dasher_interface_create`.
+#[no_mangle]
+pub unsafe extern "C" fn dasher_interface_set_debug_mode(interface: *mut DasherInterfaceFFI, enable: bool) {
+    if interface.is_null() {
+        return;
+    }
 
-    std::ptr::copy_nonoverlapping(
-        message.as_ptr(),
-        buffer as *mut u8,
-        copy_len
-    );
+    let _context = enter_interface(interface);
+    (*interface).context.set_debug_mode(enable);
+}
 
-    // Null-terminate the string
-    *buffer.add(copy_len) = 0;
+/// Get the number of debug messages queued for one interface
+///
+/// # Safety
+///
+/// The `interface` pointer must be a valid pointer created by `dasher_interface_create`.
+#[no_mangle]
+pub unsafe extern "C" fn dasher_interface_get_debug_message_count(interface: *const DasherInterfaceFFI) -> i32 {
+    if interface.is_null() {
+        return 0;
+    }
 
-    true
+    let _context = enter_interface(interface);
+    let interface = &*interface;
+    interface.context.debug_messages.len() as i32
+}
+
+/// Take the oldest debug message queued for one interface
+///
+/// Messages longer than the buffer are truncated on a UTF-8 character boundary.
+///
+/// # Safety
+///
+/// The `interface` pointer must be a valid pointer created by `dasher_interface_create`.
+/// The `buffer` pointer must be valid and point to a buffer of at least `buffer_size` bytes.
+#[no_mangle]
+pub unsafe extern "C" fn dasher_interface_get_debug_message(
+    interface: *const DasherInterfaceFFI,
+    buffer: *mut c_char,
+    buffer_size: usize
+) -> bool {
+    if interface.is_null() || buffer.is_null() || buffer_size == 0 {
+        return false;
+    }
+
+    let _context = enter_interface(interface);
+    pop_debug_message(&(*interface).context, buffer, buffer_size)
 }
 
 /// Add a debug message
@@ -1518,3 +2687,110 @@ pub unsafe extern "C" fn dasher_add_debug_message(
 }
 
 // Functions moved to avoid duplication
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::model::ArenaPPMLanguageModel;
+    use crate::model::PPMOrder;
+    use std::ffi::CString;
+
+    #[test]
+    fn test_sessions_run_on_separate_threads() {
+        let dir = tempfile::tempdir().unwrap();
+        let path = dir.path().join("shared.dppm");
+        let mut trained = ArenaPPMLanguageModel::new(PPMOrder::Two);
+        for c in "the quick brown fox jumps over the lazy dog".chars() {
+            trained.enter_symbol(c);
+        }
+        trained.save_snapshot(None, &path).unwrap();
+
+        let c_path = CString::new(path.to_str().unwrap()).unwrap();
+        let model = unsafe { dasher_shared_model_open(c_path.as_ptr()) };
+        assert!(!model.is_null());
+
+        let sessions: Vec<_> = (0..2).map(|i| {
+            let interface = unsafe {
+                Box::from_raw(dasher_interface_create_with_shared_model(std::ptr::null(), model))
+            };
+            std::thread::spawn(move || unsafe {
+                let interface = Box::into_raw(interface);
+                dasher_interface_set_debug_mode(interface, true);
+                let screen = dasher_create_screen(640 + i, 480);
+                assert!(dasher_interface_set_screen(interface, screen));
+                dasher_interface_start(interface);
+
+                let buffer = dasher_draw_buffer_create();
+                for frame in 0..5 {
+                    assert!(dasher_interface_render_into(interface, frame * 16, buffer));
+                }
+                assert!(dasher_interface_get_debug_message_count(interface) > 0);
+
+                dasher_draw_buffer_destroy(buffer);
+                dasher_destroy_screen(screen);
+                Box::from_raw(interface)
+            })
+        }).collect();
+        unsafe { dasher_shared_model_destroy(model) };
+
+        for session in sessions {
+            let interface = session.join().unwrap();
+            assert!(interface.interface.model().language_model().is_some());
+            assert!(interface.context.debug_messages.len() > 0);
+            // Screen state is tracked per session
+            assert!(interface.context.get_screen_dimensions().0 >= 640);
+        }
+    }
+
+    #[test]
+    fn test_loading_a_smaller_snapshot_into_a_running_interface() {
+        let dir = tempfile::tempdir().unwrap();
+        let save = |name: &str, text: &str| {
+            let mut trained = ArenaPPMLanguageModel::new(PPMOrder::Three);
+            for c in text.chars() {
+                trained.enter_symbol(c);
+            }
+            let path = dir.path().join(name);
+            trained.save_snapshot(None, &path).unwrap();
+            CString::new(path.to_str().unwrap()).unwrap()
+        };
+        let large = save("large.dppm", &"the quick brown fox jumps over the lazy dog. ".repeat(50));
+        let small = save("small.dppm", "ab");
+
+        unsafe {
+            let model = dasher_shared_model_open(large.as_ptr());
+            let interface = dasher_interface_create_with_shared_model(std::ptr::null(), model);
+            dasher_shared_model_destroy(model);
+            let screen = dasher_create_screen(640, 480);
+            assert!(dasher_interface_set_screen(interface, screen));
+            dasher_interface_start(interface);
+            let buffer = dasher_draw_buffer_create();
+
+            // Expand the tree two levels deep with cursors into the large snapshot
+            let expand = |interface: *mut DasherInterfaceFFI, levels: usize| {
+                let model = (*interface).interface.model_mut();
+                let mut nodes = vec![model.get_root_node().unwrap()];
+                for _ in 0..levels {
+                    let children: Vec<_> = nodes.iter().flat_map(|node| node.borrow().children().to_vec()).collect();
+                    for child in &children {
+                        model.expand_node(child);
+                    }
+                    nodes = children;
+                }
+            };
+
+            // Leave unexpanded nodes holding cursors into the large snapshot
+            assert!(dasher_interface_render_into(interface, 16, buffer));
+            expand(interface, 1);
+
+            // Nodes expanded after the swap read only the small snapshot
+            assert!(dasher_interface_load_model_snapshot(interface, small.as_ptr()));
+            expand(interface, 2);
+            assert!(dasher_interface_render_into(interface, 32, buffer));
+
+            dasher_draw_buffer_destroy(buffer);
+            dasher_destroy_screen(screen);
+            dasher_interface_destroy(interface);
+        }
+    }
+}
@@ -0,0 +1,242 @@
+//! # Input Trace Module
+//!
+//! Records the input a host feeds through the FFI so that a session can be
+//! replayed offline, frame for frame, by `src/ReplayHarness.cpp`.
+//!
+//! A trace is plain text with one event per line, in call order:
+//!
+//! ```text
+//! # dasher-trace 1
+//! 1200 mouse 512 300
+//! 1216 frame
+//! 1240 down 18
+//! 1260 up 18
+//! ```
+//!
+//! Mouse moves carry no timestamp through the FFI, so they are stamped with the
+//! time of the last frame or key event; replay only depends on their order.
+//! FFI recording is process wide because `dasher_set_mouse_coordinates` only sees
+//! the input device, not the interface it drives.
+
+use std::fmt;
+use std::fs::File;
+use std::io::{self, BufWriter, Write};
+use std::path::Path;
+use std::sync::atomic::{AtomicBool, AtomicU64, Ordering};
+use std::sync::Mutex;
+
+/// First line of every trace file
+pub const TRACE_HEADER: &str = "# dasher-trace 1";
+
+/// An input event passed through the FFI
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum TraceEvent {
+    /// `dasher_set_mouse_coordinates`
+    Mouse { x: i32, y: i32 },
+    /// `dasher_interface_key_down`, with the FFI key code
+    KeyDown(i32),
+    /// `dasher_interface_key_up`, with the FFI key code
+    KeyUp(i32),
+    /// `dasher_interface_new_frame` or `dasher_interface_render_into`
+    Frame,
+}
+
+/// A trace event and the time it happened, in milliseconds
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct TimedEvent {
+    pub time_ms: u64,
+    pub event: TraceEvent,
+}
+
+impl fmt::Display for TimedEvent {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        match self.event {
+            TraceEvent::Mouse { x, y } => write!(f, "{} mouse {} {}", self.time_ms, x, y),
+            TraceEvent::KeyDown(key) => write!(f, "{} down {}", self.time_ms, key),
+            TraceEvent::KeyUp(key) => write!(f, "{} up {}", self.time_ms, key),
+            TraceEvent::Frame => write!(f, "{} frame", self.time_ms),
+        }
+    }
+}
+
+impl TimedEvent {
+    /// Parse one trace line; comments and blank lines give `None`
+    pub fn parse(line: &str) -> Option<Self> {
+        let line = line.trim();
+        if line.is_empty() || line.starts_with('#') {
+            return None;
+        }
+        let mut fields = line.split_ascii_whitespace();
+        let time_ms = fields.next()?.parse().ok()?;
+        let kind = fields.next()?;
+        let mut int = || fields.next()?.parse::<i32>().ok();
+        let event = match kind {
+            "mouse" => TraceEvent::Mouse { x: int()?, y: int()? },
+            "down" => TraceEvent::KeyDown(int()?),
+            "up" => TraceEvent::KeyUp(int()?),
+            "frame" => TraceEvent::Frame,
+            _ => return None,
+        };
+        Some(Self { time_ms, event })
+    }
+}
+
+/// A trace file being written, or nothing
+///
+/// The FFI records into the process-wide instance behind `start_recording`,
+/// `stop_recording` and `record`; separate instances are independent.
+pub struct TraceRecorder {
+    /// Set while a recording is open, so calls that are not recorded skip the lock
+    recording: AtomicBool,
+
+    /// Time of the last timestamped event, used for mouse moves
+    last_time_ms: AtomicU64,
+
+    /// Open recording, if any
+    writer: Mutex<Option<BufWriter<File>>>,
+}
+
+impl TraceRecorder {
+    /// Create a recorder that is not recording
+    pub const fn new() -> Self {
+        Self {
+            recording: AtomicBool::new(false),
+            last_time_ms: AtomicU64::new(0),
+            writer: Mutex::new(None),
+        }
+    }
+
+    /// Start recording to `path`, replacing any recording in progress
+    pub fn start<P: AsRef<Path>>(&self, path: P) -> io::Result<()> {
+        let mut writer = BufWriter::new(File::create(path)?);
+        writeln!(writer, "{}", TRACE_HEADER)?;
+
+        let mut recorder = self.writer.lock().unwrap_or_else(|e| e.into_inner());
+        if let Some(mut previous) = recorder.replace(writer) {
+            previous.flush()?;
+        }
+        self.recording.store(true, Ordering::Release);
+        Ok(())
+    }
+
+    /// Stop recording and flush the trace; returns false if nothing was recording
+    pub fn stop(&self) -> io::Result<bool> {
+        self.recording.store(false, Ordering::Release);
+        let mut recorder = self.writer.lock().unwrap_or_else(|e| e.into_inner());
+        match recorder.take() {
+            Some(mut writer) => writer.flush().map(|_| true),
+            None => Ok(false),
+        }
+    }
+
+    /// Check whether a recording is open
+    #[inline]
+    pub fn is_recording(&self) -> bool {
+        self.recording.load(Ordering::Relaxed)
+    }
+
+    /// Append an event to the open recording
+    ///
+    /// `time_ms` is `None` for events the FFI does not timestamp. A write error
+    /// closes the recording rather than failing the call being recorded.
+    #[inline]
+    pub fn record(&self, time_ms: Option<u64>, event: TraceEvent) {
+        if !self.is_recording() {
+            return;
+        }
+        let time_ms = match time_ms {
+            Some(time_ms) => {
+                self.last_time_ms.store(time_ms, Ordering::Relaxed);
+                time_ms
+            }
+            None => self.last_time_ms.load(Ordering::Relaxed),
+        };
+
+        let mut recorder = self.writer.lock().unwrap_or_else(|e| e.into_inner());
+        if let Some(writer) = recorder.as_mut() {
+            if writeln!(writer, "{}", TimedEvent { time_ms, event }).is_err() {
+                *recorder = None;
+                self.recording.store(false, Ordering::Release);
+            }
+        }
+    }
+}
+
+impl Default for TraceRecorder {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+/// Recorder the FFI entry points write to
+static RECORDER: TraceRecorder = TraceRecorder::new();
+
+/// Start recording to `path`, replacing any recording in progress
+pub fn start_recording<P: AsRef<Path>>(path: P) -> io::Result<()> {
+    RECORDER.start(path)
+}
+
+/// Stop recording and flush the trace; returns false if nothing was recording
+pub fn stop_recording() -> io::Result<bool> {
+    RECORDER.stop()
+}
+
+/// Check whether a recording is open
+#[inline]
+pub fn is_recording() -> bool {
+    RECORDER.is_recording()
+}
+
+/// Append an event to the open recording
+#[inline]
+pub fn record(time_ms: Option<u64>, event: TraceEvent) {
+    RECORDER.record(time_ms, event);
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_trace_lines_round_trip() {
+        let events = [
+            TimedEvent { time_ms: 0, event: TraceEvent::Mouse { x: -4, y: 300 } },
+            TimedEvent { time_ms: 16, event: TraceEvent::Frame },
+            TimedEvent { time_ms: 40, event: TraceEvent::KeyDown(18) },
+            TimedEvent { time_ms: 60, event: TraceEvent::KeyUp(18) },
+        ];
+        for event in events {
+            assert_eq!(TimedEvent::parse(&event.to_string()), Some(event));
+        }
+        assert_eq!(TimedEvent::parse(TRACE_HEADER), None);
+        assert_eq!(TimedEvent::parse("16 jump"), None);
+        assert_eq!(TimedEvent::parse("16 mouse 4"), None);
+    }
+
+    #[test]
+    fn test_records_events_in_order() {
+        let dir = tempfile::tempdir().unwrap();
+        let path = dir.path().join("session.trace");
+
+        // A recorder of its own, so FFI tests running alongside do not add events
+        let recorder = TraceRecorder::new();
+
+        recorder.record(Some(5), TraceEvent::Frame);
+        recorder.start(&path).unwrap();
+        recorder.record(Some(16), TraceEvent::Frame);
+        recorder.record(None, TraceEvent::Mouse { x: 10, y: 20 });
+        recorder.record(Some(32), TraceEvent::KeyDown(0));
+        assert!(recorder.stop().unwrap());
+        assert!(!recorder.stop().unwrap());
+        recorder.record(Some(48), TraceEvent::Frame);
+
+        let text = std::fs::read_to_string(&path).unwrap();
+        let events: Vec<_> = text.lines().filter_map(TimedEvent::parse).collect();
+        assert_eq!(text.lines().next(), Some(TRACE_HEADER));
+        assert_eq!(events, vec![
+            TimedEvent { time_ms: 16, event: TraceEvent::Frame },
+            TimedEvent { time_ms: 16, event: TraceEvent::Mouse { x: 10, y: 20 } },
+            TimedEvent { time_ms: 32, event: TraceEvent::KeyDown(0) },
+        ]);
+    }
+}
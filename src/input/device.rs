@@ -2,9 +2,18 @@
 //!
 //! This module contains the implementation of input devices for Dasher.
 
+use std::sync::Arc;
+
 use super::VirtualKey;
+use super::sample_ring::{InputSample, SampleRing};
 use crate::view::DasherView;
 
+/// Sample interval the eye tracker smoothing factor is defined at, one 60 Hz frame
+const SMOOTHING_INTERVAL_MS: f64 = 1000.0 / 60.0;
+
+/// Interval assumed between batched samples with the same timestamp
+const MIN_SAMPLE_INTERVAL_MS: f64 = 0.5;
+
 /// Interface for input devices
 pub trait DasherInput {
     /// Get the coordinates from the input device in Dasher coordinates
@@ -36,6 +45,17 @@ pub trait DasherInput {
 
     /// Clone the input device into a Box
     fn box_clone(&self) -> Box<dyn DasherInput>;
+
+    /// Take the samples that arrived since the last frame
+    ///
+    /// Called once at the start of every frame on the device the interface
+    /// owns, before any filter reads its coordinates.
+    fn poll_samples(&mut self) {}
+
+    /// Get the samples taken by the last `poll_samples`, oldest first
+    fn frame_samples(&self) -> &[InputSample] {
+        &[]
+    }
 }
 
 /// Mouse input implementation
@@ -240,6 +260,12 @@ impl DasherInput for OneDimensionalInput {
 }
 
 /// Eye tracker input implementation
+///
+/// Positions come either one at a time through `set_screen_position`, or in
+/// batches from a `SampleRing` fed by the tracker's own thread. Batched samples
+/// are smoothed one by one in time order, weighted by the time between them, so
+/// the smoothing factor means the same at any tracker rate and a frame steers
+/// towards the newest sample instead of lagging a frame behind.
 #[derive(Clone)]
 pub struct EyeTrackerInput {
     /// Name of the input device
@@ -265,11 +291,19 @@ pub struct EyeTrackerInput {
     /// Previous Y coordinate
     #[allow(dead_code)]
     prev_y: i32,
+
+    /// Ring the tracker thread pushes samples into
+    samples: Option<Arc<SampleRing>>,
+
+    /// Samples taken at the start of this frame
+    frame_samples: Vec<InputSample>,
+
+    /// Smoothed position and time of the last batched sample
+    smoothed: Option<(f64, f64, u64)>,
 }
 
 impl EyeTrackerInput {
     /// Create a new eye tracker input
-    #[allow(dead_code)]
     pub fn new() -> Self {
         Self {
             name: "Eye Tracker".to_string(),
@@ -279,9 +313,37 @@ impl EyeTrackerInput {
             smoothing_factor: 0.8,
             prev_x: 0,
             prev_y: 0,
+            samples: None,
+            frame_samples: Vec::new(),
+            smoothed: None,
         }
     }
 
+    /// Create an eye tracker input that reads batched samples from `samples`
+    pub fn with_sample_ring(samples: Arc<SampleRing>) -> Self {
+        Self { samples: Some(samples), ..Self::new() }
+    }
+
+    /// Smooth one batched sample into the current position
+    fn add_sample(&mut self, sample: InputSample) {
+        let (mut x, mut y) = (sample.x as f64, sample.y as f64);
+        let mut time = sample.time_ms;
+        if let Some((prev_x, prev_y, prev_time)) = self.smoothed {
+            // The previous position keeps `smoothing_factor` of its weight per reference interval.
+            // Timestamps are whole milliseconds, so samples that share one still count.
+            let dt = (time.saturating_sub(prev_time) as f64).max(MIN_SAMPLE_INTERVAL_MS);
+            let keep = self.smoothing_factor.powf(dt / SMOOTHING_INTERVAL_MS);
+            x = prev_x * keep + x * (1.0 - keep);
+            y = prev_y * keep + y * (1.0 - keep);
+            time = time.max(prev_time);
+        }
+        self.smoothed = Some((x, y, time));
+        self.x = x.round() as i32;
+        self.y = y.round() as i32;
+        self.prev_x = self.x;
+        self.prev_y = self.y;
+    }
+
     /// Set the coordinates
     #[allow(dead_code)]
     pub fn set_coordinates(&mut self, x: i32, y: i32) {
@@ -294,7 +356,9 @@ impl EyeTrackerInput {
     }
 
     /// Set the smoothing factor
-    #[allow(dead_code)]
+    ///
+    /// This is the share of the previous position kept per 60 Hz frame
+    /// interval; 0 follows the newest sample exactly.
     pub fn set_smoothing_factor(&mut self, factor: f64) {
         self.smoothing_factor = factor.max(0.0).min(1.0);
     }
@@ -321,6 +385,7 @@ impl DasherInput for EyeTrackerInput {
     fn set_screen_position(&mut self, x: i32, y: i32) {
         // Apply smoothing in the set_coordinates method
         self.set_coordinates(x, y);
+        self.smoothed = Some((self.x as f64, self.y as f64, self.smoothed.map_or(0, |s| s.2)));
     }
 
     fn get_name(&self) -> &str {
@@ -350,4 +415,52 @@ impl DasherInput for EyeTrackerInput {
     fn box_clone(&self) -> Box<dyn DasherInput> {
         Box::new(self.clone())
     }
+
+    fn poll_samples(&mut self) {
+        self.frame_samples.clear();
+        if let Some(ring) = &self.samples {
+            ring.drain_into(&mut self.frame_samples);
+        }
+        for i in 0..self.frame_samples.len() {
+            self.add_sample(self.frame_samples[i]);
+        }
+    }
+
+    fn frame_samples(&self) -> &[InputSample] {
+        &self.frame_samples
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_eye_tracker_smooths_batched_samples() {
+        let ring = Arc::new(SampleRing::default());
+        let mut tracker = EyeTrackerInput::with_sample_ring(ring.clone());
+        ring.push(InputSample { time_ms: 0, x: 0, y: 0 });
+        tracker.poll_samples();
+        assert_eq!(tracker.frame_samples().len(), 1);
+
+        // 50 ms of 200 Hz samples at a new position move as far as three 60 Hz samples would
+        let samples: Vec<_> = (1..=10)
+            .map(|i| InputSample { time_ms: i * 5, x: 1000, y: -1000 })
+            .collect();
+        ring.push_slice(&samples);
+        tracker.poll_samples();
+        assert_eq!(tracker.frame_samples(), &samples[..]);
+        let (x, y) = (tracker.x, tracker.y);
+        assert!((x - 488).abs() <= 1 && (y + 488).abs() <= 1, "smoothed to ({}, {})", x, y);
+
+        // Frames without new samples keep the position
+        tracker.poll_samples();
+        assert!(tracker.frame_samples().is_empty());
+        assert_eq!((tracker.x, tracker.y), (x, y));
+
+        tracker.set_smoothing_factor(0.0);
+        ring.push(InputSample { time_ms: 50, x: 7, y: 9 });
+        tracker.poll_samples();
+        assert_eq!((tracker.x, tracker.y), (7, 9));
+    }
 }
@@ -9,13 +9,15 @@ mod circle_start;
 mod frame_rate;
 mod dynamic_filter;
 mod demo_filter;
+pub mod sample_ring;
 
 
 use crate::model::DasherModel;
 use crate::view::DasherView;
 
 pub use filter::{InputFilter, DefaultFilter};
-pub use device::{DasherInput, MouseInput};
+pub use device::{DasherInput, MouseInput, EyeTrackerInput};
+pub use sample_ring::{InputSample, SampleRing};
 pub use button::{ButtonHandler, ButtonConfig, ButtonMode};
 pub use circle_start::{CircleStartHandler, CircleStartConfig};
 pub use frame_rate::FrameRate;
@@ -231,6 +233,16 @@ impl InputManager {
         self.input_filter = Some(filter);
     }
 
+    /// Take the samples the input device received since the last frame
+    ///
+    /// Runs every frame, paused or not, so a batched device never steers from
+    /// samples that queued up during a pause.
+    pub fn poll_samples(&mut self) {
+        if let Some(device) = &mut self.input_device {
+            device.poll_samples();
+        }
+    }
+
     /// Process input for a frame
     pub fn process_frame(&mut self, _time: u64, model: &mut DasherModel, view: &mut dyn DasherView) {
         if self.paused {
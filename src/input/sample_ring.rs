@@ -0,0 +1,204 @@
+//! # Sample Ring Module
+//!
+//! A bounded, lock-free queue of timestamped pointer samples from a
+//! high-rate device such as an eye tracker.
+//!
+//! The tracker's own thread pushes samples as they arrive, at 120 to 600 Hz,
+//! and the interface drains everything since the last frame when the frame
+//! starts. Neither side allocates or blocks. There is one producer and one
+//! consumer at a time: each side claims its end with an atomic flag, so a
+//! second producer pushing at the same moment is turned away instead of
+//! corrupting the ring. When the ring is full, new samples are dropped and
+//! counted, which only happens if frames stop draining it.
+
+use std::cell::UnsafeCell;
+use std::sync::atomic::{AtomicBool, AtomicU64, AtomicUsize, Ordering};
+
+/// Default number of samples a ring holds, about a second at 600 Hz
+pub const DEFAULT_SAMPLE_RING_CAPACITY: usize = 1024;
+
+/// A pointer position in screen coordinates and the time it was taken
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct InputSample {
+    /// Time of the sample in milliseconds, on the same clock as frame times
+    pub time_ms: u64,
+    pub x: i32,
+    pub y: i32,
+}
+
+/// An index owned by one side of the ring, on its own cache line
+#[repr(align(64))]
+struct Position(AtomicUsize);
+
+/// Lock-free single-producer, single-consumer ring of input samples
+pub struct SampleRing {
+    slots: Box<[UnsafeCell<InputSample>]>,
+    /// Next slot the producer writes
+    head: Position,
+    /// Next slot the consumer reads
+    tail: Position,
+    pushing: AtomicBool,
+    draining: AtomicBool,
+    dropped: AtomicU64,
+}
+
+// Slots between `tail` and `head` belong to the consumer, the rest to the
+// producer, and each side is held by at most one thread at a time
+unsafe impl Send for SampleRing {}
+unsafe impl Sync for SampleRing {}
+
+impl SampleRing {
+    /// Create an empty ring holding `capacity` samples, rounded up to a power of two
+    pub fn new(capacity: usize) -> Self {
+        let capacity = capacity.max(2).next_power_of_two();
+        Self {
+            slots: (0..capacity).map(|_| UnsafeCell::new(InputSample::default())).collect(),
+            head: Position(AtomicUsize::new(0)),
+            tail: Position(AtomicUsize::new(0)),
+            pushing: AtomicBool::new(false),
+            draining: AtomicBool::new(false),
+            dropped: AtomicU64::new(0),
+        }
+    }
+
+    /// Get the number of samples the ring holds
+    pub fn capacity(&self) -> usize {
+        self.slots.len()
+    }
+
+    /// Append samples, oldest first
+    ///
+    /// Returns how many were stored. Samples that do not fit, or all of them if
+    /// another thread is pushing at the same moment, are counted as dropped.
+    pub fn push_slice(&self, samples: &[InputSample]) -> usize {
+        if self.pushing.swap(true, Ordering::Acquire) {
+            self.dropped.fetch_add(samples.len() as u64, Ordering::Relaxed);
+            return 0;
+        }
+
+        let mask = self.capacity() - 1;
+        let head = self.head.0.load(Ordering::Relaxed);
+        let tail = self.tail.0.load(Ordering::Acquire);
+        let free = self.capacity() - head.wrapping_sub(tail);
+        let count = samples.len().min(free);
+        for (i, sample) in samples[..count].iter().enumerate() {
+            unsafe {
+                *self.slots[head.wrapping_add(i) & mask].get() = *sample;
+            }
+        }
+        self.head.0.store(head.wrapping_add(count), Ordering::Release);
+        self.pushing.store(false, Ordering::Release);
+
+        if count < samples.len() {
+            self.dropped.fetch_add((samples.len() - count) as u64, Ordering::Relaxed);
+        }
+        count
+    }
+
+    /// Append one sample; returns false if it was dropped
+    pub fn push(&self, sample: InputSample) -> bool {
+        self.push_slice(std::slice::from_ref(&sample)) == 1
+    }
+
+    /// Move every waiting sample to the end of `out`, oldest first
+    ///
+    /// Returns how many were moved, or 0 if another thread is draining.
+    pub fn drain_into(&self, out: &mut Vec<InputSample>) -> usize {
+        if self.draining.swap(true, Ordering::Acquire) {
+            return 0;
+        }
+
+        let mask = self.capacity() - 1;
+        let tail = self.tail.0.load(Ordering::Relaxed);
+        let head = self.head.0.load(Ordering::Acquire);
+        let count = head.wrapping_sub(tail);
+        out.reserve(count);
+        for i in 0..count {
+            out.push(unsafe { *self.slots[tail.wrapping_add(i) & mask].get() });
+        }
+        self.tail.0.store(head, Ordering::Release);
+        self.draining.store(false, Ordering::Release);
+        count
+    }
+
+    /// Get the number of samples waiting to be drained
+    pub fn len(&self) -> usize {
+        let head = self.head.0.load(Ordering::Acquire);
+        let tail = self.tail.0.load(Ordering::Acquire);
+        head.wrapping_sub(tail)
+    }
+
+    /// Check whether no samples are waiting
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+
+    /// Get the number of samples dropped so far
+    pub fn dropped(&self) -> u64 {
+        self.dropped.load(Ordering::Relaxed)
+    }
+}
+
+impl Default for SampleRing {
+    fn default() -> Self {
+        Self::new(DEFAULT_SAMPLE_RING_CAPACITY)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::sync::Arc;
+
+    fn sample(i: usize) -> InputSample {
+        InputSample { time_ms: i as u64, x: i as i32, y: -(i as i32) }
+    }
+
+    #[test]
+    fn test_push_drain_order_and_overflow() {
+        let ring = SampleRing::new(6);
+        assert_eq!(ring.capacity(), 8);
+
+        let samples: Vec<_> = (0..5).map(sample).collect();
+        assert_eq!(ring.push_slice(&samples), 5);
+        let mut out = Vec::new();
+        assert_eq!(ring.drain_into(&mut out), 5);
+        assert_eq!(out, samples);
+        assert!(ring.is_empty());
+
+        // Wraps around the end of the slots, and drops what does not fit
+        let samples: Vec<_> = (5..15).map(sample).collect();
+        assert_eq!(ring.push_slice(&samples), 8);
+        assert!(!ring.push(sample(99)));
+        assert_eq!(ring.dropped(), 3);
+        out.clear();
+        ring.drain_into(&mut out);
+        assert_eq!(out, samples[..8]);
+    }
+
+    #[test]
+    fn test_concurrent_producer_and_consumer() {
+        const COUNT: usize = 20_000;
+        let ring = Arc::new(SampleRing::new(64));
+        let producer = {
+            let ring = ring.clone();
+            std::thread::spawn(move || {
+                let mut next = 0;
+                while next < COUNT {
+                    let batch: Vec<_> = (next..(next + 7).min(COUNT)).map(sample).collect();
+                    next += ring.push_slice(&batch);
+                }
+            })
+        };
+
+        let mut received = Vec::new();
+        while received.len() < COUNT {
+            ring.drain_into(&mut received);
+        }
+        producer.join().unwrap();
+
+        assert!(received.iter().enumerate().all(|(i, s)| *s == sample(i)));
+    }
+
+}
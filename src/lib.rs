@@ -28,6 +28,7 @@ pub mod settings;
 pub mod alphabet;
 pub mod wordgen;
 pub mod action;
+pub mod allocator;
 mod logging;
 
 // FFI and WebAssembly support
@@ -37,8 +38,11 @@ pub mod wasm_api_simple;
 // No longer needed with the wasm_bindings module
 #[cfg(feature = "wasm")]
 use serde::Serialize;
+#[cfg(feature = "wasm")]
 use std::cell::RefCell;
 
+// Model behind the WASM bindings; native hosts keep their state in interfaces
+#[cfg(feature = "wasm")]
 thread_local! {
     static MODEL: RefCell<DasherModel> = RefCell::new({
         let mut model = DasherModel::new();
@@ -137,6 +141,10 @@ pub mod wasm_bindings {
 
 pub mod ffi;
 
+#[cfg(feature = "ffi-allocator")]
+#[global_allocator]
+static GLOBAL_ALLOCATOR: allocator::DasherAllocator = allocator::DasherAllocator;
+
 // Error handling
 use thiserror::Error;
 
@@ -0,0 +1,512 @@
+//! Arena-backed PPM language model
+//!
+//! Stores the PPM trie in one contiguous `Vec` with 32-bit node indices instead of
+//! reference-counted nodes with hash maps. Each node's children are a range of
+//! one shared edge array, sorted by symbol and searched with a binary search.
+//!
+//! A node's range has room for a power-of-two number of children. When a child
+//! is added to a full range, the range moves to the end of the edge array with
+//! twice the room, leaving a gap behind. `canonicalize` closes the gaps and
+//! lays the edges out breadth-first, as a snapshot stores them.
+
+use std::collections::HashMap;
+
+use super::{normalize_probs, ContextCursor, LanguageContext, LanguageModel, PPMOrder, PROB_NORMALIZATION};
+
+/// Index of a node in the arena
+pub(super) type NodeIndex = u32;
+
+/// Marker for a context that has never been seen
+pub(super) const NO_NODE: NodeIndex = NodeIndex::MAX;
+
+/// Index of the root node
+pub(super) const ROOT: NodeIndex = 0;
+
+/// A node of the arena trie
+#[derive(Debug, Clone)]
+pub(super) struct ArenaNode {
+    /// Symbol leading to this node
+    pub(super) symbol: char,
+
+    /// Number of times this node's symbol followed its parent's context
+    pub(super) count: u32,
+
+    /// Start of the node's children in the edge array
+    pub(super) first_edge: u32,
+
+    /// Number of children
+    pub(super) len: u32,
+
+    /// Room for children reserved at `first_edge`
+    pub(super) capacity: u32,
+}
+
+impl ArenaNode {
+    fn new(symbol: char) -> Self {
+        Self { symbol, count: 0, first_edge: 0, len: 0, capacity: 0 }
+    }
+}
+
+/// Position of a context in the arena trie
+///
+/// `nodes[k]` is the node for the last `k` symbols, or `NO_NODE`.
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct ArenaContext {
+    pub(super) nodes: Vec<NodeIndex>,
+}
+
+/// PPM language model with an arena-backed trie
+#[derive(Debug, Clone)]
+pub struct ArenaPPMLanguageModel {
+    /// All trie nodes; index 0 is the root
+    pub(super) nodes: Vec<ArenaNode>,
+
+    /// Child indices of every node, each node's sorted by symbol
+    edges: Vec<NodeIndex>,
+
+    /// Maximum order of the model
+    max_order: PPMOrder,
+
+    /// Context used when training
+    training_context: ArenaContext,
+}
+
+impl ArenaPPMLanguageModel {
+    /// Create a new arena PPM language model
+    pub fn new(max_order: PPMOrder) -> Self {
+        Self {
+            nodes: vec![ArenaNode::new('\0')],
+            edges: Vec::new(),
+            max_order,
+            training_context: ArenaContext { nodes: vec![ROOT] },
+        }
+    }
+
+    /// Get the maximum order of the model
+    pub fn max_order(&self) -> PPMOrder {
+        self.max_order
+    }
+
+    /// Get the number of nodes in the trie
+    pub fn node_count(&self) -> usize {
+        self.nodes.len()
+    }
+
+    /// Approximate heap memory used by the trie, in bytes
+    pub fn memory_usage(&self) -> usize {
+        self.nodes.capacity() * std::mem::size_of::<ArenaNode>()
+            + self.edges.capacity() * std::mem::size_of::<NodeIndex>()
+    }
+
+    fn order(&self) -> usize {
+        self.max_order.value().max(0) as usize
+    }
+
+    /// Get the children of `node`, sorted by symbol
+    #[inline]
+    pub(super) fn children(&self, node: NodeIndex) -> &[NodeIndex] {
+        let node = &self.nodes[node as usize];
+        &self.edges[node.first_edge as usize..][..node.len as usize]
+    }
+
+    /// Find the child of `parent` for `symbol`
+    pub(super) fn find_child(&self, parent: NodeIndex, symbol: char) -> Result<NodeIndex, usize> {
+        let children = self.children(parent);
+        children
+            .binary_search_by(|&child| self.nodes[child as usize].symbol.cmp(&symbol))
+            .map(|pos| children[pos])
+    }
+
+    /// Find or create the child of `parent` for `symbol`
+    fn child_or_insert(&mut self, parent: NodeIndex, symbol: char) -> NodeIndex {
+        match self.find_child(parent, symbol) {
+            Ok(child) => child,
+            Err(pos) => {
+                let child = self.nodes.len() as NodeIndex;
+                self.nodes.push(ArenaNode::new(symbol));
+                self.insert_edge(parent, pos, child);
+                child
+            }
+        }
+    }
+
+    /// Insert `child` at position `pos` of `parent`'s children
+    fn insert_edge(&mut self, parent: NodeIndex, pos: usize, child: NodeIndex) {
+        let node = &mut self.nodes[parent as usize];
+        let (first, len) = (node.first_edge as usize, node.len as usize);
+        if node.len == node.capacity {
+            let capacity = (node.capacity as usize * 2).max(1);
+            if first + len != self.edges.len() || len == 0 {
+                // Move the range to the end, where it can grow
+                node.first_edge = self.edges.len() as u32;
+                self.edges.extend_from_within(first..first + len);
+            }
+            node.capacity = capacity as u32;
+            self.edges.resize(node.first_edge as usize + capacity, NO_NODE);
+        }
+
+        let first = node.first_edge as usize;
+        node.len += 1;
+        self.edges.copy_within(first + pos..first + len, first + pos + 1);
+        self.edges[first + pos] = child;
+    }
+
+    /// Create a context positioned at the root of the trie
+    pub fn empty_context(&self) -> ArenaContext {
+        ArenaContext { nodes: vec![ROOT] }
+    }
+
+    /// Create a context from the last `max_order` symbols of `text`
+    pub fn context_from_text(&self, text: &str) -> ArenaContext {
+        let mut tail: Vec<char> = text.chars().rev().take(self.order()).collect();
+        tail.reverse();
+
+        let mut context = self.empty_context();
+        for c in tail {
+            context = self.advance_context(&context, c);
+        }
+        context
+    }
+
+    /// Advance a context by one symbol in O(max_order) binary searches
+    pub fn advance_context(&self, context: &ArenaContext, symbol: char) -> ArenaContext {
+        let mut nodes = Vec::with_capacity(self.order() + 1);
+        nodes.push(ROOT);
+
+        for &node in context.nodes.iter().take(self.order()) {
+            let next = if node == NO_NODE {
+                NO_NODE
+            } else {
+                self.find_child(node, symbol).unwrap_or(NO_NODE)
+            };
+            nodes.push(next);
+        }
+
+        ArenaContext { nodes }
+    }
+
+    /// Count `symbol` in every order of `context` and return the advanced context
+    pub fn learn_symbol(&mut self, context: &ArenaContext, symbol: char) -> ArenaContext {
+        let mut nodes = Vec::with_capacity(self.order() + 1);
+        nodes.push(ROOT);
+
+        for &node in context.nodes.iter().take(self.order() + 1) {
+            if node == NO_NODE {
+                nodes.push(NO_NODE);
+                continue;
+            }
+            let child = self.child_or_insert(node, symbol);
+            let count = &mut self.nodes[child as usize].count;
+            *count = count.saturating_add(1);
+            nodes.push(child);
+        }
+        nodes.truncate(self.order() + 1);
+
+        ArenaContext { nodes }
+    }
+
+    /// Get probability distribution for the next symbol after a context
+    ///
+    /// Blends orders from highest to lowest with PPM method C escapes and exclusion.
+    pub fn get_context_probs(&self, context: &ArenaContext) -> HashMap<char, f64> {
+        let mut probs = HashMap::new();
+        let mut mass = 1.0;
+
+        for &node in context.nodes.iter().rev() {
+            if node == NO_NODE {
+                continue;
+            }
+
+            let children = self.children(node);
+            let mut total = 0u64;
+            let mut distinct = 0u64;
+            for &child in children {
+                let child = &self.nodes[child as usize];
+                if !probs.contains_key(&child.symbol) {
+                    total += child.count as u64;
+                    distinct += 1;
+                }
+            }
+            if distinct == 0 {
+                continue;
+            }
+
+            let denominator = (total + distinct) as f64;
+            for &child in children {
+                let child = &self.nodes[child as usize];
+                if !probs.contains_key(&child.symbol) {
+                    probs.insert(child.symbol, mass * child.count as f64 / denominator);
+                }
+            }
+            mass *= distinct as f64 / denominator;
+        }
+
+        // Give the remaining escape mass back in proportion
+        let sum: f64 = probs.values().sum();
+        if sum > 0.0 {
+            for prob in probs.values_mut() {
+                *prob /= sum;
+            }
+        }
+
+        probs
+    }
+
+    /// Fill `probs[i]` with the integer probability of symbol ordinal `i` after a context
+    ///
+    /// Same blending as `get_context_probs`, without any allocation. Each order
+    /// walks its node's children once, mapping their symbols to ordinals through
+    /// `index`, so the cost follows the number of symbols seen rather than the
+    /// alphabet size. A zero entry marks a symbol not yet assigned by a higher order.
+    pub fn get_context_probs_into(&self, context: &ArenaContext, index: &HashMap<char, usize>, probs: &mut [u32]) {
+        probs.fill(0);
+
+        // Work in a finer fixed-point scale than the result so low orders keep their share
+        const SCALE: f64 = (1u64 << 30) as f64;
+        let mut mass = SCALE;
+
+        // Ordinal of a child's symbol, if it is one asked for and not yet assigned
+        let ordinal = |probs: &[u32], child: NodeIndex| {
+            index.get(&self.nodes[child as usize].symbol)
+                .copied()
+                .filter(|&i| probs.get(i) == Some(&0))
+        };
+
+        for &node in context.nodes.iter().rev() {
+            if node == NO_NODE {
+                continue;
+            }
+
+            let children = self.children(node);
+            let mut total = 0u64;
+            let mut distinct = 0u64;
+            for &child in children {
+                if ordinal(probs, child).is_some() {
+                    total += self.nodes[child as usize].count as u64;
+                    distinct += 1;
+                }
+            }
+            if distinct == 0 {
+                continue;
+            }
+
+            let denominator = (total + distinct) as f64;
+            for &child in children {
+                if let Some(i) = ordinal(probs, child) {
+                    let count = self.nodes[child as usize].count as f64;
+                    probs[i] = ((mass * count / denominator) as u32).max(1);
+                }
+            }
+            mass *= distinct as f64 / denominator;
+        }
+
+        normalize_probs(probs, PROB_NORMALIZATION);
+    }
+
+    /// Add the counts of another trie to this one
+    ///
+    /// Contexts present in only one trie are kept as they are; shared contexts
+    /// have their counts summed. The training context is reset.
+    pub fn merge(&mut self, other: &ArenaPPMLanguageModel) {
+        let mut pending = vec![(ROOT, ROOT)];
+        while let Some((node, other_node)) = pending.pop() {
+            for &other_child in other.children(other_node) {
+                let other_child_ref = &other.nodes[other_child as usize];
+                let child = self.child_or_insert(node, other_child_ref.symbol);
+                let count = &mut self.nodes[child as usize].count;
+                *count = count.saturating_add(other_child_ref.count);
+                pending.push((child, other_child));
+            }
+        }
+        self.reset_training_context();
+    }
+
+    /// Renumber the nodes in breadth-first order
+    ///
+    /// Tries with the same contents end up with identical layouts regardless of
+    /// the order they were trained or merged in, and siblings sit next to each
+    /// other in memory.
+    pub fn canonicalize(&mut self) {
+        let mut order = Vec::with_capacity(self.nodes.len());
+        let mut new_index = vec![NO_NODE; self.nodes.len()];
+        order.push(ROOT);
+        new_index[ROOT as usize] = ROOT;
+
+        let mut next = 0;
+        while next < order.len() {
+            let node = order[next];
+            next += 1;
+            for &child in self.children(node) {
+                new_index[child as usize] = order.len() as NodeIndex;
+                order.push(child);
+            }
+        }
+
+        // Children of each node in turn, so the ranges are packed with no gaps
+        let mut nodes = Vec::with_capacity(order.len());
+        let mut edges = Vec::with_capacity(order.len().saturating_sub(1));
+        for &old in &order {
+            let children = self.children(old);
+            let node = &self.nodes[old as usize];
+            nodes.push(ArenaNode {
+                symbol: node.symbol,
+                count: node.count,
+                first_edge: edges.len() as u32,
+                len: node.len,
+                capacity: node.len,
+            });
+            edges.extend(children.iter().map(|&child| new_index[child as usize]));
+        }
+        self.nodes = nodes;
+        self.edges = edges;
+        self.reset_training_context();
+    }
+
+    fn reset_training_context(&mut self) {
+        self.training_context = self.empty_context();
+    }
+}
+
+impl LanguageModel for ArenaPPMLanguageModel {
+    fn as_any(&mut self) -> &mut dyn std::any::Any {
+        self
+    }
+
+    fn get_probs(&self, context: &str) -> HashMap<char, f64> {
+        self.get_context_probs(&self.context_from_text(context))
+    }
+
+    fn context_from_text(&self, text: &str) -> LanguageContext {
+        let mut context = LanguageContext::from_text(text);
+        context.cursor = ContextCursor::Arena(ArenaPPMLanguageModel::context_from_text(self, text));
+        context
+    }
+
+    fn context_after(&self, context: &LanguageContext, symbol: char) -> LanguageContext {
+        let mut next = context.with_symbol(symbol);
+        next.cursor = ContextCursor::Arena(match &context.cursor {
+            ContextCursor::Arena(arena) => self.advance_context(arena, symbol),
+            _ => ArenaPPMLanguageModel::context_from_text(self, next.text()),
+        });
+        next
+    }
+
+    fn get_context_probs(&self, context: &LanguageContext) -> HashMap<char, f64> {
+        match &context.cursor {
+            ContextCursor::Arena(arena) => ArenaPPMLanguageModel::get_context_probs(self, arena),
+            _ => self.get_probs(context.text()),
+        }
+    }
+
+    fn get_probs_into(&self, context: &LanguageContext, _symbols: &[char], index: &HashMap<char, usize>, probs: &mut [u32]) {
+        match &context.cursor {
+            ContextCursor::Arena(arena) => self.get_context_probs_into(arena, index, probs),
+            _ => self.get_context_probs_into(&ArenaPPMLanguageModel::context_from_text(self, context.text()), index, probs),
+        }
+    }
+
+    fn enter_symbol(&mut self, symbol: char) {
+        let context = std::mem::replace(&mut self.training_context, ArenaContext { nodes: Vec::new() });
+        self.training_context = self.learn_symbol(&context, symbol);
+    }
+
+    fn reset(&mut self) {
+        self.training_context = self.empty_context();
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::model::language::symbol_index;
+
+    #[test]
+    fn test_arena_ppm_predictions() {
+        let mut model = ArenaPPMLanguageModel::new(PPMOrder::Two);
+        for c in "hello help hello".chars() {
+            model.enter_symbol(c);
+        }
+
+        let probs = LanguageModel::get_probs(&model, "hel");
+        assert!(probs[&'l'] > probs[&'p']);
+        assert!(probs[&'p'] > 0.0);
+
+        let sum: f64 = probs.values().sum();
+        assert!((sum - 1.0).abs() < 1e-9);
+
+        // Advancing a handle matches building it from text
+        let context = LanguageModel::context_from_text(&model, "he");
+        let advanced = LanguageModel::context_after(&model, &context, 'l');
+        let advanced_probs = LanguageModel::get_context_probs(&model, &advanced);
+        assert_eq!(advanced_probs.len(), probs.len());
+        for (c, p) in &probs {
+            assert!((advanced_probs[c] - p).abs() < 1e-12);
+        }
+    }
+
+    #[test]
+    fn test_arena_ppm_probs_into() {
+        let mut model = ArenaPPMLanguageModel::new(PPMOrder::Two);
+        for c in "hello help hello".chars() {
+            model.enter_symbol(c);
+        }
+
+        let symbols = ['h', 'e', 'l', 'o', 'p', ' ', 'z'];
+        let mut probs = [0u32; 7];
+        let context = LanguageModel::context_from_text(&model, "hel");
+        LanguageModel::get_probs_into(&model, &context, &symbols, &symbol_index(&symbols), &mut probs);
+
+        assert_eq!(probs.iter().sum::<u32>(), PROB_NORMALIZATION);
+        assert!(probs[2] > probs[4]);
+        assert!(probs[4] > probs[6]);
+        assert_eq!(probs[6], 1);
+    }
+
+    #[test]
+    fn test_arena_ppm_merge() {
+        let mut whole = ArenaPPMLanguageModel::new(PPMOrder::Two);
+        let mut first = ArenaPPMLanguageModel::new(PPMOrder::Two);
+        let mut second = ArenaPPMLanguageModel::new(PPMOrder::Two);
+        for c in "hello".chars() {
+            whole.enter_symbol(c);
+            first.enter_symbol(c);
+        }
+        whole.reset();
+        for c in "help".chars() {
+            whole.enter_symbol(c);
+            second.enter_symbol(c);
+        }
+
+        // Merging either way round gives the same trie as training on both texts
+        let mut merged = second.clone();
+        merged.merge(&first);
+        merged.canonicalize();
+        first.merge(&second);
+        first.canonicalize();
+        whole.canonicalize();
+        for model in [&merged, &first] {
+            assert_eq!(model.node_count(), whole.node_count());
+            for (i, (a, b)) in model.nodes.iter().zip(&whole.nodes).enumerate() {
+                let i = i as NodeIndex;
+                assert_eq!((a.symbol, a.count, model.children(i)), (b.symbol, b.count, whole.children(i)));
+            }
+            // Canonical edges are packed
+            assert_eq!(model.edges.len(), model.node_count() - 1);
+        }
+    }
+
+    #[test]
+    fn test_arena_ppm_children_sorted() {
+        let mut model = ArenaPPMLanguageModel::new(PPMOrder::One);
+        for c in "zyxabc".chars() {
+            model.enter_symbol(c);
+        }
+
+        let symbols: Vec<char> = model.children(ROOT).iter()
+            .map(|&c| model.nodes[c as usize].symbol)
+            .collect();
+        assert_eq!(symbols, vec!['a', 'b', 'c', 'x', 'y', 'z']);
+        // Root plus one order-0 and one order-1 node per symbol (the last has no successor)
+        assert_eq!(model.node_count(), 1 + 6 + 5);
+    }
+}
@@ -1,8 +1,9 @@
 use std::collections::{HashMap, HashSet};
-use std::fs::File;
-use std::io::{self, BufRead, BufReader};
+use std::io;
 use std::path::Path;
 
+use super::dictionary_index::{IndexBytes, IndexedDictionary, DICTIONARY_INDEX_MAGIC};
+
 /// Dictionary entry with frequency information
 #[derive(Debug, Clone)]
 pub struct DictionaryEntry {
@@ -23,6 +24,8 @@ pub struct Dictionary {
     prefix_cache: HashMap<String, HashSet<String>>,
     /// Maximum prefix length to cache
     max_prefix_length: usize,
+    /// Read-only indexed word list, shared with other dictionaries
+    index: Option<IndexedDictionary<IndexBytes>>,
 }
 
 impl Default for Dictionary {
@@ -38,16 +41,23 @@ impl Dictionary {
             entries: HashMap::new(),
             prefix_cache: HashMap::new(),
             max_prefix_length: 4,
+            index: None,
         }
     }
 
     /// Load dictionary from file
+    ///
+    /// An indexed dictionary file becomes the dictionary's index; any other
+    /// file is read as `word\tfrequency` lines.
     pub fn load<P: AsRef<Path>>(&mut self, path: P) -> io::Result<()> {
-        let file = File::open(path)?;
-        let reader = BufReader::new(file);
+        let bytes = std::fs::read(path)?;
+        if bytes.starts_with(DICTIONARY_INDEX_MAGIC) {
+            self.set_index(IndexedDictionary::from_bytes(IndexBytes::Shared(bytes.into()))?);
+            return Ok(());
+        }
 
-        for line in reader.lines() {
-            let line = line?;
+        let text = String::from_utf8(bytes).map_err(|e| io::Error::new(io::ErrorKind::InvalidData, e))?;
+        for line in text.lines() {
             if line.is_empty() || line.starts_with('#') {
                 continue;
             }
@@ -102,12 +112,52 @@ impl Dictionary {
         }
     }
 
+    /// Set the indexed word list read behind the added words
+    ///
+    /// Cloning an index only shares its bytes, so one loaded file can back
+    /// the dictionaries of any number of sessions.
+    pub fn set_index(&mut self, index: IndexedDictionary<IndexBytes>) {
+        self.index = Some(index);
+    }
+
+    /// Get the indexed word list, if any
+    pub fn index(&self) -> Option<&IndexedDictionary<IndexBytes>> {
+        self.index.as_ref()
+    }
+
     /// Get word entry
+    ///
+    /// Only added words have entries; see `frequency` for indexed words.
     pub fn get_word(&self, word: &str) -> Option<&DictionaryEntry> {
         self.entries.get(word)
     }
 
-    /// Find words with given prefix
+    /// Get the frequency of an added or indexed word
+    pub fn frequency(&self, word: &str) -> Option<f64> {
+        match self.entries.get(word) {
+            Some(entry) => Some(entry.frequency),
+            None => self.index.as_ref()?.get_frequency(word),
+        }
+    }
+
+    /// Call `f` with every added or indexed word starting with `prefix` and its frequency
+    ///
+    /// Indexed words are read in place; an added word replaces an indexed one
+    /// with the same text.
+    pub fn for_each_with_prefix(&self, prefix: &str, mut f: impl FnMut(&str, f64)) {
+        for entry in self.find_words_with_prefix(prefix) {
+            f(&entry.text, entry.frequency);
+        }
+        if let Some(index) = &self.index {
+            for (word, frequency) in index.with_prefix(prefix) {
+                if !self.entries.contains_key(word) {
+                    f(word, frequency);
+                }
+            }
+        }
+    }
+
+    /// Find added words with given prefix
     pub fn find_words_with_prefix(&self, prefix: &str) -> Vec<&DictionaryEntry> {
         let mut results = Vec::new();
 
@@ -131,15 +181,16 @@ impl Dictionary {
         results
     }
 
-    /// Get total word count
+    /// Get total word count, counting a word both added and indexed twice
     pub fn word_count(&self) -> usize {
-        self.entries.len()
+        self.entries.len() + self.index.as_ref().map_or(0, IndexedDictionary::len)
     }
 
     /// Clear dictionary
     pub fn clear(&mut self) {
         self.entries.clear();
         self.prefix_cache.clear();
+        self.index = None;
     }
 }
 
@@ -0,0 +1,333 @@
+//! Indexed dictionary files
+//!
+//! A large word list is converted once into a sorted, indexed file whose
+//! tables are read in place, so loading it costs one read, or nothing when the
+//! host memory-maps the file and hands over the region through any
+//! `AsRef<[u8]>` type. No per-word `String`s are built: lookups binary-search
+//! the offset table and borrow the words straight from the bytes, and every
+//! session in the process, or every process mapping the same file, shares one
+//! copy of them.
+//!
+//! Layout (all fields `u32` unless noted):
+//!
+//! ```text
+//! header   magic "DDIX", version, word count, text length
+//! offsets  (word count + 1) x byte offset of each word in the text,
+//!          words sorted by their UTF-8 bytes
+//! freqs    word count x frequency (f32 bits)
+//! text     concatenated UTF-8 words
+//! ```
+
+use std::fs::File;
+use std::io::{self, BufWriter, Write};
+use std::ops::Range;
+use std::path::Path;
+use std::sync::Arc;
+
+/// Magic bytes at the start of every indexed dictionary
+pub const DICTIONARY_INDEX_MAGIC: &[u8; 4] = b"DDIX";
+
+/// Current indexed dictionary format version
+pub const DICTIONARY_INDEX_VERSION: u32 = 1;
+
+/// Size of the header in bytes
+const HEADER_LEN: usize = 16;
+
+/// Read a little-endian `u32` at a byte offset
+#[inline]
+fn read_u32(bytes: &[u8], offset: usize) -> u32 {
+    u32::from_le_bytes([bytes[offset], bytes[offset + 1], bytes[offset + 2], bytes[offset + 3]])
+}
+
+fn invalid<T>(msg: &str) -> io::Result<T> {
+    Err(io::Error::new(io::ErrorKind::InvalidData, format!("Invalid dictionary index: {}", msg)))
+}
+
+/// Write `(word, frequency)` pairs as an indexed dictionary
+///
+/// Words are sorted; a word given more than once keeps its highest frequency.
+pub fn write_dictionary_index<W, I, S>(entries: I, writer: W) -> io::Result<()>
+where
+    W: Write,
+    I: IntoIterator<Item = (S, f64)>,
+    S: AsRef<str>,
+{
+    let mut entries: Vec<(S, f64)> = entries.into_iter().filter(|(word, _)| !word.as_ref().is_empty()).collect();
+    entries.sort_by(|a, b| a.0.as_ref().cmp(b.0.as_ref()).then(b.1.total_cmp(&a.1)));
+    entries.dedup_by(|later, kept| later.0.as_ref() == kept.0.as_ref());
+
+    let text_len: usize = entries.iter().map(|(word, _)| word.as_ref().len()).sum();
+    if entries.len() >= u32::MAX as usize || text_len > u32::MAX as usize {
+        return invalid("word list too large");
+    }
+
+    let mut out = BufWriter::new(writer);
+    for value in [
+        u32::from_le_bytes(*DICTIONARY_INDEX_MAGIC),
+        DICTIONARY_INDEX_VERSION,
+        entries.len() as u32,
+        text_len as u32,
+    ] {
+        out.write_all(&value.to_le_bytes())?;
+    }
+
+    let mut offset = 0u32;
+    out.write_all(&offset.to_le_bytes())?;
+    for (word, _) in &entries {
+        offset += word.as_ref().len() as u32;
+        out.write_all(&offset.to_le_bytes())?;
+    }
+    for (_, frequency) in &entries {
+        out.write_all(&(*frequency as f32).to_bits().to_le_bytes())?;
+    }
+    for (word, _) in &entries {
+        out.write_all(word.as_ref().as_bytes())?;
+    }
+    out.flush()
+}
+
+/// Write `(word, frequency)` pairs to an indexed dictionary file
+pub fn save_dictionary_index<P, I, S>(entries: I, path: P) -> io::Result<()>
+where
+    P: AsRef<Path>,
+    I: IntoIterator<Item = (S, f64)>,
+    S: AsRef<str>,
+{
+    write_dictionary_index(entries, File::create(path)?)
+}
+
+/// Bytes of an index that dictionaries share
+///
+/// Either a file read once by the core, or a region the host has mapped and
+/// keeps mapped for as long as any dictionary uses it.
+#[derive(Debug, Clone)]
+pub enum IndexBytes {
+    Shared(Arc<[u8]>),
+    Mapped(&'static [u8]),
+}
+
+impl AsRef<[u8]> for IndexBytes {
+    fn as_ref(&self) -> &[u8] {
+        match self {
+            IndexBytes::Shared(bytes) => bytes,
+            IndexBytes::Mapped(bytes) => bytes,
+        }
+    }
+}
+
+/// Read-only view of an indexed dictionary's bytes
+///
+/// `from_bytes` checks the whole file once, so lookups afterwards read the
+/// tables without further checks.
+#[derive(Debug, Clone)]
+pub struct IndexedDictionary<B: AsRef<[u8]> = Vec<u8>> {
+    /// Index bytes
+    bytes: B,
+
+    /// Number of words
+    len: usize,
+
+    /// Byte offset of the frequency table
+    freqs_offset: usize,
+
+    /// Byte offset of the word text
+    text_offset: usize,
+}
+
+impl IndexedDictionary<Vec<u8>> {
+    /// Read an indexed dictionary file
+    pub fn open<P: AsRef<Path>>(path: P) -> io::Result<Self> {
+        Self::from_bytes(std::fs::read(path)?)
+    }
+}
+
+impl IndexedDictionary<IndexBytes> {
+    /// Read an indexed dictionary file into bytes that clones share
+    pub fn open_shared<P: AsRef<Path>>(path: P) -> io::Result<Self> {
+        Self::from_bytes(IndexBytes::Shared(Arc::from(std::fs::read(path)?)))
+    }
+}
+
+impl<B: AsRef<[u8]>> IndexedDictionary<B> {
+    /// Wrap index bytes, checking the header, offsets, order and text encoding
+    pub fn from_bytes(bytes: B) -> io::Result<Self> {
+        let data = bytes.as_ref();
+        if data.len() < HEADER_LEN || &data[..4] != DICTIONARY_INDEX_MAGIC {
+            return invalid("missing header");
+        }
+        if read_u32(data, 4) != DICTIONARY_INDEX_VERSION {
+            return invalid("unsupported version");
+        }
+
+        let len = read_u32(data, 8) as usize;
+        let text_len = read_u32(data, 12) as usize;
+        let freqs_offset = HEADER_LEN + (len + 1) * 4;
+        let text_offset = freqs_offset + len * 4;
+        if data.len() != text_offset + text_len {
+            return invalid("truncated tables");
+        }
+
+        let text = match std::str::from_utf8(&data[text_offset..]) {
+            Ok(text) => text,
+            Err(_) => return invalid("words are not UTF-8"),
+        };
+        let offset = |i: usize| read_u32(data, HEADER_LEN + i * 4) as usize;
+        if offset(0) != 0 || offset(len) != text_len {
+            return invalid("offsets do not cover the text");
+        }
+        let mut previous: Option<&str> = None;
+        for i in 0..len {
+            let (start, end) = (offset(i), offset(i + 1));
+            if start >= end || end > text_len || !text.is_char_boundary(end) {
+                return invalid("bad word offsets");
+            }
+            // Binary search relies on strictly increasing words
+            let word = &text[start..end];
+            if previous.is_some_and(|previous| previous >= word) {
+                return invalid("words are not sorted");
+            }
+            previous = Some(word);
+        }
+
+        Ok(Self { bytes, len, freqs_offset, text_offset })
+    }
+
+    /// Get the number of words
+    pub fn len(&self) -> usize {
+        self.len
+    }
+
+    /// Check whether the index has no words
+    pub fn is_empty(&self) -> bool {
+        self.len == 0
+    }
+
+    /// Get the word at position `i` in sorted order
+    #[inline]
+    pub fn word(&self, i: usize) -> &str {
+        let data = self.bytes.as_ref();
+        let start = read_u32(data, HEADER_LEN + i * 4) as usize;
+        let end = read_u32(data, HEADER_LEN + (i + 1) * 4) as usize;
+        let word = &data[self.text_offset + start..self.text_offset + end];
+        // SAFETY: `from_bytes` checked that the text is UTF-8 and that every
+        // offset falls on a character boundary
+        unsafe { std::str::from_utf8_unchecked(word) }
+    }
+
+    /// Get the frequency of the word at position `i`
+    #[inline]
+    pub fn frequency(&self, i: usize) -> f64 {
+        f32::from_bits(read_u32(self.bytes.as_ref(), self.freqs_offset + i * 4)) as f64
+    }
+
+    /// Find the position of `word`
+    pub fn find(&self, word: &str) -> Option<usize> {
+        let i = self.partition_point(|candidate| candidate < word);
+        (i < self.len && self.word(i) == word).then_some(i)
+    }
+
+    /// Get the frequency of `word`, if it is in the index
+    pub fn get_frequency(&self, word: &str) -> Option<f64> {
+        self.find(word).map(|i| self.frequency(i))
+    }
+
+    /// Get the positions of all words starting with `prefix`
+    pub fn prefix_range(&self, prefix: &str) -> Range<usize> {
+        let start = self.partition_point(|word| word < prefix);
+        let end = start + self.partition_point_from(start, |word| word.starts_with(prefix));
+        start..end
+    }
+
+    /// Iterate over the words starting with `prefix` and their frequencies, in sorted order
+    pub fn with_prefix<'a>(&'a self, prefix: &str) -> impl Iterator<Item = (&'a str, f64)> + 'a {
+        self.prefix_range(prefix).map(move |i| (self.word(i), self.frequency(i)))
+    }
+
+    /// Get the positions of up to `max` words starting with `prefix`, most frequent first
+    pub fn top_with_prefix(&self, prefix: &str, max: usize) -> Vec<usize> {
+        let mut top: Vec<usize> = Vec::with_capacity(max.min(self.len));
+        if max == 0 {
+            return top;
+        }
+        for i in self.prefix_range(prefix) {
+            let frequency = self.frequency(i);
+            if top.len() == max && frequency <= self.frequency(top[max - 1]) {
+                continue;
+            }
+            let at = top.partition_point(|&j| self.frequency(j) >= frequency);
+            if top.len() == max {
+                top.pop();
+            }
+            top.insert(at, i);
+        }
+        top
+    }
+
+    /// First position whose word does not satisfy `pred`, which must hold for a prefix of the words
+    fn partition_point(&self, pred: impl Fn(&str) -> bool) -> usize {
+        self.partition_point_from(0, pred)
+    }
+
+    /// Like `partition_point`, counted from position `start`
+    fn partition_point_from(&self, start: usize, pred: impl Fn(&str) -> bool) -> usize {
+        let (mut lo, mut hi) = (start, self.len);
+        while lo < hi {
+            let mid = lo + (hi - lo) / 2;
+            if pred(self.word(mid)) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        lo - start
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn index(entries: &[(&str, f64)]) -> IndexedDictionary {
+        let mut bytes = Vec::new();
+        write_dictionary_index(entries.iter().copied(), &mut bytes).unwrap();
+        IndexedDictionary::from_bytes(bytes).unwrap()
+    }
+
+    #[test]
+    fn test_index_lookups_read_in_place() {
+        let index = index(&[("help", 0.3), ("hello", 0.5), ("world", 0.4), ("hé", 0.1), ("help", 0.2), ("helm", 0.6)]);
+        assert_eq!(index.len(), 5);
+        assert_eq!((0..index.len()).map(|i| index.word(i)).collect::<Vec<_>>(), ["hello", "helm", "help", "hé", "world"]);
+
+        // Duplicates keep their highest frequency
+        assert_eq!(index.get_frequency("help"), Some(0.3f32 as f64));
+        assert_eq!(index.find("hel"), None);
+
+        let words: Vec<_> = index.with_prefix("hel").map(|(word, _)| word).collect();
+        assert_eq!(words, ["hello", "helm", "help"]);
+        assert_eq!(index.prefix_range("h"), 0..4);
+        assert_eq!(index.prefix_range(""), 0..5);
+        assert!(index.prefix_range("x").is_empty());
+        assert!(index.prefix_range("zz").is_empty());
+
+        let top: Vec<_> = index.top_with_prefix("h", 2).into_iter().map(|i| index.word(i)).collect();
+        assert_eq!(top, ["helm", "hello"]);
+        assert_eq!(index.top_with_prefix("", 10).len(), 5);
+    }
+
+    #[test]
+    fn test_rejects_malformed_indexes() {
+        let mut bytes = Vec::new();
+        write_dictionary_index([("a", 1.0), ("b", 1.0)], &mut bytes).unwrap();
+        assert!(IndexedDictionary::from_bytes(&bytes[..]).is_ok());
+
+        assert!(IndexedDictionary::from_bytes(&bytes[..bytes.len() - 1]).is_err());
+        let mut unsorted = bytes.clone();
+        let text = unsorted.len() - 2;
+        unsorted.swap(text, text + 1);
+        assert!(IndexedDictionary::from_bytes(&unsorted[..]).is_err());
+        let mut bad_magic = bytes;
+        bad_magic[0] = b'X';
+        assert!(IndexedDictionary::from_bytes(bad_magic).is_err());
+    }
+}
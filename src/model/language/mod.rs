@@ -1,10 +1,161 @@
 mod ppm;
+mod arena_ppm;
 mod dictionary;
+mod dictionary_index;
+mod snapshot;
 
-pub use ppm::{PPMLanguageModel, PPMOrder, PPMNode};
+pub use ppm::{PPMLanguageModel, PPMOrder, PPMNode, PPMContext};
+pub use arena_ppm::{ArenaPPMLanguageModel, ArenaContext};
 pub use dictionary::Dictionary;
+pub use dictionary_index::{save_dictionary_index, write_dictionary_index, IndexBytes, IndexedDictionary};
+pub use snapshot::{PPMSnapshot, SnapshotError, SnapshotLanguageModel, OverlayContext};
 use std::collections::{HashMap, HashSet};
 
+/// Maximum number of trailing symbols kept in a `LanguageContext`
+const MAX_CONTEXT_SYMBOLS: usize = 32;
+
+/// Most UTF-8 bytes `MAX_CONTEXT_SYMBOLS` symbols can take
+const MAX_CONTEXT_BYTES: usize = MAX_CONTEXT_SYMBOLS * 4;
+
+/// Total that integer probabilities are normalized to (matches the node bounds)
+pub const PROB_NORMALIZATION: u32 = super::DasherModel::NORMALIZATION;
+
+/// Map each of `symbols` to its position, for `LanguageModel::get_probs_into`
+pub fn symbol_index(symbols: &[char]) -> HashMap<char, usize> {
+    symbols.iter().enumerate().map(|(i, &c)| (c, i)).collect()
+}
+
+/// Scale integer weights in place so each entry is at least 1 and they sum to exactly `normalization`
+///
+/// All-zero weights become a uniform distribution.
+pub fn normalize_probs(probs: &mut [u32], normalization: u32) {
+    let n = probs.len() as u64;
+    if n == 0 {
+        return;
+    }
+
+    let total: u64 = probs.iter().map(|&p| p as u64).sum();
+    if total == 0 {
+        // Uniform fallback: a plain fill, with the remainder spread over the first entries
+        let base = (normalization as u64 / n) as u32;
+        let remainder = (normalization as u64 % n) as usize;
+        probs.fill(base);
+        for p in &mut probs[..remainder] {
+            *p += 1;
+        }
+        return;
+    }
+
+    // Reserve one unit per symbol so none has zero width
+    let available = (normalization as u64).saturating_sub(n);
+    let mut assigned = 0u64;
+    let mut largest = 0;
+    for i in 0..probs.len() {
+        probs[i] = 1 + (probs[i] as u64 * available / total) as u32;
+        assigned += probs[i] as u64;
+        if probs[i] > probs[largest] {
+            largest = i;
+        }
+    }
+
+    // Rounding leftovers go to the most probable symbol
+    probs[largest] += (normalization as u64).saturating_sub(assigned) as u32;
+}
+
+/// Context handle for incremental prediction
+///
+/// A context is stored on each tree node, and a child's context is its parent's
+/// advanced by one symbol, so expanding a node does not depend on the length of
+/// the output text.
+#[derive(Debug, Clone, Default)]
+pub struct LanguageContext {
+    /// Trailing symbols of the context, at most `MAX_CONTEXT_SYMBOLS`
+    text: ContextText,
+
+    /// Model-specific position of the context
+    cursor: ContextCursor,
+}
+
+/// Model-specific position of a `LanguageContext`
+#[derive(Debug, Clone, Default)]
+pub(crate) enum ContextCursor {
+    /// Only the trailing text is known
+    #[default]
+    None,
+    /// Position in a `PPMLanguageModel` trie
+    Trie(PPMContext),
+    /// Position in an `ArenaPPMLanguageModel` trie
+    Arena(ArenaContext),
+    /// Position in a `SnapshotLanguageModel` snapshot and overlay
+    Snapshot(OverlayContext),
+}
+
+/// Trailing symbols of a context, kept inline so advancing a context does not allocate
+#[derive(Clone, Copy)]
+struct ContextText {
+    /// UTF-8 text in `bytes[..len]`
+    bytes: [u8; MAX_CONTEXT_BYTES],
+    len: u8,
+    /// Number of symbols in the text
+    chars: u8,
+}
+
+impl Default for ContextText {
+    fn default() -> Self {
+        Self { bytes: [0; MAX_CONTEXT_BYTES], len: 0, chars: 0 }
+    }
+}
+
+impl std::fmt::Debug for ContextText {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        self.as_str().fmt(f)
+    }
+}
+
+impl ContextText {
+    fn as_str(&self) -> &str {
+        // Only whole UTF-8 encoded symbols are ever written or removed
+        unsafe { std::str::from_utf8_unchecked(&self.bytes[..self.len as usize]) }
+    }
+
+    /// Append `symbol`, dropping the oldest symbol when full
+    fn push(&mut self, symbol: char) {
+        if self.chars as usize >= MAX_CONTEXT_SYMBOLS {
+            let first = self.as_str().chars().next().map_or(0, char::len_utf8);
+            self.bytes.copy_within(first..self.len as usize, 0);
+            self.len -= first as u8;
+            self.chars -= 1;
+        }
+        let len = self.len as usize;
+        self.len += symbol.encode_utf8(&mut self.bytes[len..]).len() as u8;
+        self.chars += 1;
+    }
+}
+
+impl LanguageContext {
+    /// Create a context from the trailing symbols of `text`
+    pub fn from_text(text: &str) -> Self {
+        let skip = text.chars().count().saturating_sub(MAX_CONTEXT_SYMBOLS);
+        let mut context = Self::default();
+        for symbol in text.chars().skip(skip) {
+            context.text.push(symbol);
+        }
+        context
+    }
+
+    /// Get the trailing symbols of the context
+    pub fn text(&self) -> &str {
+        self.text.as_str()
+    }
+
+    /// Get a copy of this context with `symbol` appended
+    pub fn with_symbol(&self, symbol: char) -> Self {
+        let mut text = self.text;
+        text.push(symbol);
+        Self { text, cursor: ContextCursor::None }
+    }
+}
+
 /// Language model trait
 pub trait LanguageModel {
     /// Create an empty context (stub)
@@ -12,6 +163,36 @@ pub trait LanguageModel {
     /// Get probability distribution for next symbol
     fn get_probs(&self, context: &str) -> HashMap<char, f64>;
 
+    /// Build a context handle from the trailing symbols of `text`
+    fn context_from_text(&self, text: &str) -> LanguageContext {
+        LanguageContext::from_text(text)
+    }
+
+    /// Advance a context handle by one symbol
+    fn context_after(&self, context: &LanguageContext, symbol: char) -> LanguageContext {
+        context.with_symbol(symbol)
+    }
+
+    /// Get probability distribution for the symbol following a context handle
+    fn get_context_probs(&self, context: &LanguageContext) -> HashMap<char, f64> {
+        self.get_probs(context.text())
+    }
+
+    /// Fill `probs[i]` with the integer probability of `symbols[i]` following a context
+    ///
+    /// `index` maps each symbol to its position in `symbols`, as
+    /// `Alphabet::symbol_index` does, so models can go from the symbols they
+    /// have seen to ordinals without searching for every symbol. The result sums
+    /// to `PROB_NORMALIZATION` and gives every symbol at least 1. `probs` must
+    /// be the same length as `symbols`.
+    fn get_probs_into(&self, context: &LanguageContext, symbols: &[char], _index: &HashMap<char, usize>, probs: &mut [u32]) {
+        let map = self.get_context_probs(context);
+        for (p, c) in probs.iter_mut().zip(symbols) {
+            *p = (map.get(c).copied().unwrap_or(0.0) * PROB_NORMALIZATION as f64) as u32;
+        }
+        normalize_probs(probs, PROB_NORMALIZATION);
+    }
+
     /// Enter symbol into model
     fn enter_symbol(&mut self, symbol: char);
 
@@ -94,29 +275,17 @@ impl CombinedLanguageModel {
     pub fn ppm_mut(&mut self) -> &mut PPMLanguageModel {
         &mut self.ppm
     }
-}
-
-impl LanguageModel for CombinedLanguageModel {
-    fn as_any(&mut self) -> &mut dyn std::any::Any {
-        self
-    }
-
-    fn get_probs(&self, context: &str) -> HashMap<char, f64> {
-        // Get PPM probabilities
-        let mut probs = self.ppm.get_probs(context);
 
+    /// Mix dictionary continuations of `word` into PPM probabilities and normalize
+    fn mix_dictionary(&self, mut probs: HashMap<char, f64>, word: &str) -> HashMap<char, f64> {
         // Get dictionary predictions if we're building a word
-        if !self.current_word.is_empty() {
-            let dict_words = self.dictionary.find_words_with_prefix(&self.current_word);
+        if !word.is_empty() {
             let dict_weight = 1.0 - self.ppm_weight;
-
-            for entry in dict_words {
-                if self.current_word.len() < entry.text.len() {
-                    let next_char = entry.text.chars().nth(self.current_word.len()).unwrap();
-                    let prob = entry.frequency * dict_weight;
-                    *probs.entry(next_char).or_insert(0.0) += prob;
+            self.dictionary.for_each_with_prefix(word, |text, frequency| {
+                if let Some(next_char) = text[word.len()..].chars().next() {
+                    *probs.entry(next_char).or_insert(0.0) += frequency * dict_weight;
                 }
-            }
+            });
         }
 
         // Normalize probabilities
@@ -129,6 +298,59 @@ impl LanguageModel for CombinedLanguageModel {
 
         probs
     }
+}
+
+impl LanguageModel for CombinedLanguageModel {
+    fn as_any(&mut self) -> &mut dyn std::any::Any {
+        self
+    }
+
+    fn get_probs(&self, context: &str) -> HashMap<char, f64> {
+        // Get PPM probabilities
+        let probs = self.ppm.get_probs(context);
+        self.mix_dictionary(probs, &self.current_word)
+    }
+
+    fn context_from_text(&self, text: &str) -> LanguageContext {
+        let mut context = LanguageContext::from_text(text);
+
+        // Training resets the PPM context at word boundaries, so prediction does too
+        let text = context.text();
+        let word_start = text
+            .rfind(|c: char| self.word_separators.contains(&c))
+            .map(|i| i + text[i..].chars().next().map_or(0, char::len_utf8))
+            .unwrap_or(0);
+        let cursor = ContextCursor::Trie(self.ppm.context_from_text(&text[word_start..]));
+        context.cursor = cursor;
+        context
+    }
+
+    fn context_after(&self, context: &LanguageContext, symbol: char) -> LanguageContext {
+        let mut next = context.with_symbol(symbol);
+        next.cursor = ContextCursor::Trie(if self.word_separators.contains(&symbol) {
+            self.ppm.empty_context()
+        } else {
+            match &context.cursor {
+                ContextCursor::Trie(ppm) => self.ppm.advance_context(ppm, symbol),
+                _ => self.ppm.context_from_text(next.text()),
+            }
+        });
+        next
+    }
+
+    fn get_context_probs(&self, context: &LanguageContext) -> HashMap<char, f64> {
+        let probs = match &context.cursor {
+            ContextCursor::Trie(ppm) => self.ppm.get_context_probs(ppm),
+            _ => self.ppm.get_probs(context.text()),
+        };
+
+        // The word being built is the part of the context after the last separator
+        let word = context.text()
+            .rsplit(|c: char| self.word_separators.contains(&c))
+            .next()
+            .unwrap_or("");
+        self.mix_dictionary(probs, word)
+    }
 
     fn enter_symbol(&mut self, symbol: char) {
         // Update PPM model with context buffer
@@ -181,4 +403,75 @@ mod tests {
         model.enter_symbol(' ');
         assert_eq!(model.current_word, "");
     }
+
+    #[test]
+    fn test_context_keeps_trailing_symbols() {
+        let text: String = "ab日本".chars().cycle().take(MAX_CONTEXT_SYMBOLS + 3).collect();
+        let tail: String = text.chars().skip(3).collect();
+        let context = LanguageContext::from_text(&text);
+        assert_eq!(context.text(), tail);
+
+        // Advancing a full context drops its oldest symbol
+        let advanced = context.with_symbol('語');
+        let expected: String = tail.chars().skip(1).chain(['語']).collect();
+        assert_eq!(advanced.text(), expected);
+        assert_eq!(LanguageContext::default().with_symbol('x').text(), "x");
+    }
+
+    #[test]
+    fn test_normalize_probs() {
+        // Uniform fallback
+        let mut probs = vec![0u32; 3];
+        normalize_probs(&mut probs, 10);
+        assert_eq!(probs, vec![4, 3, 3]);
+
+        // Weighted, with a minimum of 1 and an exact total
+        let mut probs = vec![0, 300, 100];
+        normalize_probs(&mut probs, PROB_NORMALIZATION);
+        assert_eq!(probs.iter().sum::<u32>(), PROB_NORMALIZATION);
+        assert_eq!(probs[0], 1);
+        assert!(probs[1] > probs[2] * 2);
+    }
+
+    #[test]
+    fn test_combined_model_context_handles() {
+        let mut model = CombinedLanguageModel::new(PPMOrder::Two);
+        model.dictionary_mut().add_word("help", 0.3, false);
+        for c in "hello world".chars() {
+            model.enter_symbol(c);
+        }
+
+        // A handle advanced from the parent predicts like one built from the whole text
+        let parent = model.context_from_text("say he");
+        let child = model.context_after(&parent, 'l');
+        let rebuilt = model.context_from_text("say hel");
+        assert_eq!(child.text(), "say hel");
+
+        let advanced = model.get_context_probs(&child);
+        assert_eq!(advanced, model.get_context_probs(&rebuilt));
+        assert!(advanced.contains_key(&'l'));
+        assert!(advanced.contains_key(&'p'));
+    }
+
+    #[test]
+    fn test_combined_model_reads_indexed_dictionary() {
+        let mut bytes = Vec::new();
+        write_dictionary_index([("hello", 0.5), ("help", 0.3), ("world", 0.4)], &mut bytes).unwrap();
+        let index = IndexedDictionary::from_bytes(IndexBytes::Shared(bytes.into())).unwrap();
+
+        let mut model = CombinedLanguageModel::new(PPMOrder::Two);
+        model.dictionary_mut().set_index(index.clone());
+        model.dictionary_mut().add_word("helmet", 0.2, true);
+        assert_eq!(model.dictionary().word_count(), 4);
+        assert_eq!(model.dictionary().frequency("help"), Some(0.3f32 as f64));
+
+        let mut words = Vec::new();
+        model.dictionary().for_each_with_prefix("hel", |word, _| words.push(word.to_string()));
+        assert_eq!(words, ["helmet", "hello", "help"]);
+
+        // With an untrained PPM model the dictionary decides the next letter
+        let probs = model.get_context_probs(&model.context_from_text("hel"));
+        assert!(probs[&'l'] > probs[&'p']);
+        assert!(probs[&'p'] > probs[&'m']);
+    }
 }
@@ -97,6 +97,20 @@ impl PPMOrder {
             PPMOrder::Five => 5,
         }
     }
+
+    /// Get the order with a numeric value, if there is one
+    pub fn from_value(value: i32) -> Option<Self> {
+        match value {
+            -1 => Some(PPMOrder::None),
+            0 => Some(PPMOrder::Zero),
+            1 => Some(PPMOrder::One),
+            2 => Some(PPMOrder::Two),
+            3 => Some(PPMOrder::Three),
+            4 => Some(PPMOrder::Four),
+            5 => Some(PPMOrder::Five),
+            _ => None,
+        }
+    }
 }
 
 /// PPM language model
@@ -258,6 +272,74 @@ impl PPMLanguageModel {
     pub fn max_order(&self) -> PPMOrder {
         self.max_order
     }
+
+    /// Create a context positioned at the root of the trie
+    pub fn empty_context(&self) -> PPMContext {
+        PPMContext { nodes: vec![Some(self.root.clone())] }
+    }
+
+    /// Create a context from the last `max_order` symbols of `text`
+    pub fn context_from_text(&self, text: &str) -> PPMContext {
+        let order = self.max_order.value().max(0) as usize;
+        let mut tail: Vec<char> = text.chars().rev().take(order).collect();
+        tail.reverse();
+
+        let mut context = self.empty_context();
+        for c in tail {
+            context = self.advance_context(&context, c);
+        }
+        context
+    }
+
+    /// Advance a context by one symbol
+    ///
+    /// Each order follows one child link from the node of the order below it, so this
+    /// costs O(max_order) regardless of how much text precedes the context.
+    pub fn advance_context(&self, context: &PPMContext, symbol: char) -> PPMContext {
+        let order = self.max_order.value().max(0) as usize;
+        let mut nodes = Vec::with_capacity(order + 1);
+        nodes.push(Some(self.root.clone()));
+
+        for node in context.nodes.iter().take(order) {
+            let next = node.as_ref().and_then(|n| n.borrow().children.get(&symbol).cloned());
+            nodes.push(next);
+        }
+
+        PPMContext { nodes }
+    }
+
+    /// Get probability distribution for the next symbol after a context
+    ///
+    /// Uses the highest order that has seen any continuation, like `get_probs`, but
+    /// escapes to lower orders when a context exists without continuations.
+    pub fn get_context_probs(&self, context: &PPMContext) -> HashMap<char, f64> {
+        let mut probs = HashMap::new();
+
+        for node in context.nodes.iter().rev().flatten() {
+            let node_ref = node.borrow();
+            let total = node_ref.children.len();
+            if total == 0 {
+                continue;
+            }
+
+            for symbol in node_ref.children.keys() {
+                probs.insert(*symbol, 1.0 / total as f64);
+            }
+            break;
+        }
+
+        probs
+    }
+}
+
+/// Position of a context in the PPM trie
+///
+/// `nodes[k]` is the trie node for the last `k` symbols of the context, or `None`
+/// if that context has never been seen. Nodes are shared with the trie, so a context
+/// stays valid while the model keeps training.
+#[derive(Debug, Clone)]
+pub struct PPMContext {
+    nodes: Vec<Option<Rc<RefCell<PPMNode>>>>,
 }
 
 #[cfg(test)]
@@ -351,4 +433,28 @@ mod tests {
         assert!(probs.contains_key(&'b'));
         assert!((probs.get(&'a').unwrap() - probs.get(&'b').unwrap()).abs() < 0.1);
     }
+
+    #[test]
+    fn test_ppm_context_advance() {
+        let mut model = PPMLanguageModel::new(PPMOrder::Two);
+
+        let mut ctx = String::new();
+        for c in "hello".chars() {
+            model.enter_symbol(&ctx, c);
+            if ctx.len() == 2 {
+                ctx.remove(0);
+            }
+            ctx.push(c);
+        }
+
+        // Advancing symbol by symbol reaches the same trie position as building from text
+        let mut context = model.empty_context();
+        for c in "he".chars() {
+            context = model.advance_context(&context, c);
+        }
+        assert_eq!(model.get_context_probs(&context), model.get_context_probs(&model.context_from_text("xhe")));
+
+        let probs = model.get_context_probs(&context);
+        assert!(probs.contains_key(&'l'));
+    }
 }
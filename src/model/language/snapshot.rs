@@ -0,0 +1,820 @@
+//! Binary PPM model snapshots
+//!
+//! A snapshot is a trained `ArenaPPMLanguageModel`, and optionally its
+//! `TrainingStats`, written as flat little-endian tables. Queries read the tables
+//! in place, so a snapshot is usable as soon as its bytes are available: read
+//! from a file, or handed over as a memory-mapped region by the host through any
+//! `AsRef<[u8]>` type. `SnapshotLanguageModel` answers predictions from a
+//! read-only snapshot plus a small writable overlay that learns new input.
+//!
+//! Layout (all fields `u32` unless noted):
+//!
+//! ```text
+//! header   magic "DPPM", version, max order, node count, edge count,
+//!          stats offset, stats length, reserved
+//! nodes    node count x (symbol, count, first edge, edge count)
+//! edges    edge count x child node index, sorted by child symbol
+//! stats    total chars (u64), char count, bigram count, word count,
+//!          chars (symbol, count) sorted by symbol,
+//!          bigrams (first, second, count) sorted by symbol pair,
+//!          words (byte length, count, UTF-8 bytes padded to 4)
+//! ```
+
+use std::cell::RefCell;
+use std::collections::HashMap;
+use std::fs::File;
+use std::io::{self, BufWriter, Write};
+use std::path::Path;
+use std::sync::Arc;
+use std::time::SystemTime;
+
+use crate::alphabet::TrainingStats;
+use super::arena_ppm::{NodeIndex, NO_NODE, ROOT};
+use super::{
+    normalize_probs, ArenaContext, ArenaPPMLanguageModel, ContextCursor, LanguageContext, LanguageModel,
+    PPMOrder, PROB_NORMALIZATION,
+};
+
+/// Magic bytes at the start of every snapshot
+const SNAPSHOT_MAGIC: &[u8; 4] = b"DPPM";
+
+/// Current snapshot format version
+pub const SNAPSHOT_VERSION: u32 = 1;
+
+/// Size of the header in bytes
+const HEADER_LEN: usize = 32;
+
+/// Size of a node record in bytes
+const NODE_LEN: usize = 16;
+
+/// Size of the fixed part of the stats section in bytes
+const STATS_HEADER_LEN: usize = 20;
+
+/// Error type for snapshot operations
+#[derive(Debug)]
+pub enum SnapshotError {
+    /// IO error
+    Io(io::Error),
+    /// Malformed or incompatible snapshot
+    InvalidData(String),
+}
+
+impl From<io::Error> for SnapshotError {
+    fn from(err: io::Error) -> Self {
+        SnapshotError::Io(err)
+    }
+}
+
+impl std::fmt::Display for SnapshotError {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        match self {
+            SnapshotError::Io(err) => write!(f, "IO error: {}", err),
+            SnapshotError::InvalidData(msg) => write!(f, "Invalid snapshot: {}", msg),
+        }
+    }
+}
+
+impl std::error::Error for SnapshotError {}
+
+impl ArenaPPMLanguageModel {
+    /// Write the model, and optionally its training statistics, as a snapshot
+    pub fn write_snapshot<W: Write>(&self, stats: Option<&TrainingStats>, writer: W) -> Result<(), SnapshotError> {
+        let mut out = BufWriter::new(writer);
+
+        let node_count = self.nodes.len();
+        let edge_count: usize = self.nodes.iter().map(|n| n.len as usize).sum();
+        let tables_len = HEADER_LEN + node_count * NODE_LEN + edge_count * 4;
+        let stats_bytes = stats.map(encode_stats).unwrap_or_default();
+        if tables_len + stats_bytes.len() > u32::MAX as usize {
+            return Err(SnapshotError::InvalidData("model too large for a snapshot".to_string()));
+        }
+
+        let stats_offset = if stats.is_some() { tables_len } else { 0 };
+        for value in [
+            u32::from_le_bytes(*SNAPSHOT_MAGIC),
+            SNAPSHOT_VERSION,
+            self.max_order().value().max(0) as u32,
+            node_count as u32,
+            edge_count as u32,
+            stats_offset as u32,
+            stats_bytes.len() as u32,
+            0,
+        ] {
+            out.write_all(&value.to_le_bytes())?;
+        }
+
+        let mut first_edge = 0u32;
+        for node in &self.nodes {
+            for value in [node.symbol as u32, node.count, first_edge, node.len] {
+                out.write_all(&value.to_le_bytes())?;
+            }
+            first_edge += node.len;
+        }
+        for node in 0..node_count as NodeIndex {
+            for &child in self.children(node) {
+                out.write_all(&child.to_le_bytes())?;
+            }
+        }
+
+        out.write_all(&stats_bytes)?;
+        out.flush()?;
+        Ok(())
+    }
+
+    /// Write a snapshot to a file
+    pub fn save_snapshot<P: AsRef<Path>>(&self, stats: Option<&TrainingStats>, path: P) -> Result<(), SnapshotError> {
+        self.write_snapshot(stats, File::create(path)?)
+    }
+}
+
+/// Encode training statistics as a snapshot stats section
+fn encode_stats(stats: &TrainingStats) -> Vec<u8> {
+    let mut chars: Vec<_> = stats.char_frequency.iter().collect();
+    chars.sort_unstable();
+    let mut bigrams: Vec<_> = stats.bigram_frequency.iter().collect();
+    bigrams.sort_unstable();
+    let mut words: Vec<_> = stats.word_frequency.iter().collect();
+    words.sort_unstable();
+
+    let mut out = Vec::new();
+    let put = |out: &mut Vec<u8>, value: usize| out.extend_from_slice(&(value.min(u32::MAX as usize) as u32).to_le_bytes());
+
+    out.extend_from_slice(&(stats.total_chars as u64).to_le_bytes());
+    put(&mut out, chars.len());
+    put(&mut out, bigrams.len());
+    put(&mut out, words.len());
+    for (&c, &count) in chars {
+        put(&mut out, c as usize);
+        put(&mut out, count);
+    }
+    for (&(c1, c2), &count) in bigrams {
+        put(&mut out, c1 as usize);
+        put(&mut out, c2 as usize);
+        put(&mut out, count);
+    }
+    for (word, &count) in words {
+        put(&mut out, word.len());
+        put(&mut out, count);
+        out.extend_from_slice(word.as_bytes());
+        out.resize(out.len() + padding(word.len()), 0);
+    }
+    out
+}
+
+/// Bytes needed to pad `len` to a multiple of 4
+fn padding(len: usize) -> usize {
+    (4 - len % 4) % 4
+}
+
+/// Read a little-endian `u32` at a byte offset
+#[inline]
+fn read_u32(bytes: &[u8], offset: usize) -> u32 {
+    u32::from_le_bytes([bytes[offset], bytes[offset + 1], bytes[offset + 2], bytes[offset + 3]])
+}
+
+/// Read-only view of a snapshot's bytes
+///
+/// `from_bytes` only checks the header and the table bounds; node lookups then
+/// read straight from the bytes.
+#[derive(Debug, Clone)]
+pub struct PPMSnapshot<B: AsRef<[u8]> = Vec<u8>> {
+    /// Snapshot bytes
+    bytes: B,
+
+    /// Maximum order of the snapshotted model
+    max_order: PPMOrder,
+
+    /// Number of nodes in the node table
+    node_count: usize,
+
+    /// Byte offset of the edge table
+    edges_offset: usize,
+
+    /// Byte range of the stats section, if present
+    stats: Option<(usize, usize)>,
+}
+
+/// Position of a context in a snapshot trie
+///
+/// `nodes[k]` is the node for the last `k` symbols, or `NO_NODE`.
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct SnapshotContext {
+    nodes: Vec<NodeIndex>,
+}
+
+impl PPMSnapshot<Vec<u8>> {
+    /// Read a snapshot file
+    pub fn open<P: AsRef<Path>>(path: P) -> Result<Self, SnapshotError> {
+        Self::from_bytes(std::fs::read(path)?)
+    }
+}
+
+impl PPMSnapshot<Arc<[u8]>> {
+    /// Read a snapshot file into bytes that clones share
+    ///
+    /// Cloning the snapshot only bumps a reference count, so one trained model
+    /// can back any number of `SnapshotLanguageModel`s across threads.
+    pub fn open_shared<P: AsRef<Path>>(path: P) -> Result<Self, SnapshotError> {
+        Self::from_bytes(Arc::from(std::fs::read(path)?))
+    }
+}
+
+impl<B: AsRef<[u8]>> PPMSnapshot<B> {
+    /// Wrap snapshot bytes, checking the header and table bounds
+    pub fn from_bytes(bytes: B) -> Result<Self, SnapshotError> {
+        let invalid = |msg: &str| Err(SnapshotError::InvalidData(msg.to_string()));
+        let data = bytes.as_ref();
+
+        if data.len() < HEADER_LEN || &data[..4] != SNAPSHOT_MAGIC {
+            return invalid("missing snapshot header");
+        }
+        if read_u32(data, 4) != SNAPSHOT_VERSION {
+            return invalid("unsupported snapshot version");
+        }
+        let max_order = match PPMOrder::from_value(read_u32(data, 8) as i32) {
+            Some(order) => order,
+            None => return invalid("unsupported model order"),
+        };
+
+        let node_count = read_u32(data, 12) as usize;
+        let edge_count = read_u32(data, 16) as usize;
+        let edges_offset = HEADER_LEN + node_count * NODE_LEN;
+        let tables_end = edges_offset + edge_count * 4;
+        if node_count == 0 || data.len() < tables_end {
+            return invalid("truncated node tables");
+        }
+
+        // Bound every index once so lookups cannot go out of range
+        for node in 0..node_count {
+            let record = HEADER_LEN + node * NODE_LEN;
+            if char::from_u32(read_u32(data, record)).is_none() {
+                return invalid("invalid node symbol");
+            }
+            let first = read_u32(data, record + 8) as usize;
+            let count = read_u32(data, record + 12) as usize;
+            if first + count > edge_count {
+                return invalid("edge range out of bounds");
+            }
+        }
+        if (0..edge_count).any(|edge| read_u32(data, edges_offset + edge * 4) as usize >= node_count) {
+            return invalid("edge target out of bounds");
+        }
+
+        let stats_offset = read_u32(data, 20) as usize;
+        let stats_len = read_u32(data, 24) as usize;
+        let stats = if stats_offset == 0 {
+            None
+        } else if stats_len < STATS_HEADER_LEN || data.len() < stats_offset + stats_len {
+            return invalid("truncated stats section");
+        } else {
+            Some((stats_offset, stats_len))
+        };
+
+        Ok(Self { bytes, max_order, node_count, edges_offset, stats })
+    }
+
+    /// Get the maximum order of the snapshotted model
+    pub fn max_order(&self) -> PPMOrder {
+        self.max_order
+    }
+
+    /// Get the number of nodes in the trie
+    pub fn node_count(&self) -> usize {
+        self.node_count
+    }
+
+    /// Check whether the snapshot carries training statistics
+    pub fn has_stats(&self) -> bool {
+        self.stats.is_some()
+    }
+
+    fn order(&self) -> usize {
+        self.max_order.value().max(0) as usize
+    }
+
+    /// Read field `field` of node `node`
+    #[inline]
+    fn node_field(&self, node: NodeIndex, field: usize) -> u32 {
+        read_u32(self.bytes.as_ref(), HEADER_LEN + node as usize * NODE_LEN + field * 4)
+    }
+
+    /// Get the symbol of a node
+    #[inline]
+    fn symbol(&self, node: NodeIndex) -> char {
+        char::from_u32(self.node_field(node, 0)).unwrap_or('\0')
+    }
+
+    /// Get the count of a node
+    #[inline]
+    fn count(&self, node: NodeIndex) -> u32 {
+        self.node_field(node, 1)
+    }
+
+    /// Get the child indices of a node, in symbol order
+    fn children(&self, node: NodeIndex) -> impl Iterator<Item = NodeIndex> + '_ {
+        let first = self.node_field(node, 2) as usize;
+        let count = self.node_field(node, 3) as usize;
+        (first..first + count).map(move |edge| read_u32(self.bytes.as_ref(), self.edges_offset + edge * 4))
+    }
+
+    /// Find the child of `parent` for `symbol` with a binary search over its edges
+    fn find_child(&self, parent: NodeIndex, symbol: char) -> Option<NodeIndex> {
+        let data = self.bytes.as_ref();
+        let mut lo = self.node_field(parent, 2) as usize;
+        let mut hi = lo + self.node_field(parent, 3) as usize;
+        let target = symbol as u32;
+
+        while lo < hi {
+            let mid = (lo + hi) / 2;
+            let child = read_u32(data, self.edges_offset + mid * 4);
+            match self.node_field(child, 0).cmp(&target) {
+                std::cmp::Ordering::Less => lo = mid + 1,
+                std::cmp::Ordering::Greater => hi = mid,
+                std::cmp::Ordering::Equal => return Some(child),
+            }
+        }
+        None
+    }
+
+    /// Create a context positioned at the root of the trie
+    pub fn empty_context(&self) -> SnapshotContext {
+        SnapshotContext { nodes: vec![ROOT] }
+    }
+
+    /// Create a context from the last `max_order` symbols of `text`
+    pub fn context_from_text(&self, text: &str) -> SnapshotContext {
+        let mut tail: Vec<char> = text.chars().rev().take(self.order()).collect();
+        tail.reverse();
+
+        let mut context = self.empty_context();
+        for c in tail {
+            context = self.advance_context(&context, c);
+        }
+        context
+    }
+
+    /// Advance a context by one symbol
+    pub fn advance_context(&self, context: &SnapshotContext, symbol: char) -> SnapshotContext {
+        let mut nodes = Vec::with_capacity(self.order() + 1);
+        nodes.push(ROOT);
+
+        for &node in context.nodes.iter().take(self.order()) {
+            let next = if node == NO_NODE {
+                NO_NODE
+            } else {
+                self.find_child(node, symbol).unwrap_or(NO_NODE)
+            };
+            nodes.push(next);
+        }
+
+        SnapshotContext { nodes }
+    }
+
+    /// Get the stats section, if present
+    fn stats_bytes(&self) -> Option<&[u8]> {
+        self.stats.map(|(offset, len)| &self.bytes.as_ref()[offset..offset + len])
+    }
+
+    /// Get the number of characters the statistics were gathered over
+    pub fn total_chars(&self) -> usize {
+        self.stats_bytes()
+            .map(|s| u64::from_le_bytes(s[..8].try_into().unwrap()) as usize)
+            .unwrap_or(0)
+    }
+
+    /// Look up a character's frequency in the statistics
+    pub fn char_frequency(&self, c: char) -> usize {
+        let stats = match self.stats_bytes() {
+            Some(stats) => stats,
+            None => return 0,
+        };
+        let entries = read_u32(stats, 8) as usize;
+        if stats.len() < STATS_HEADER_LEN + entries * 8 {
+            return 0;
+        }
+
+        let key = |i: usize| read_u32(stats, STATS_HEADER_LEN + i * 8);
+        let (mut lo, mut hi) = (0, entries);
+        while lo < hi {
+            let mid = (lo + hi) / 2;
+            match key(mid).cmp(&(c as u32)) {
+                std::cmp::Ordering::Less => lo = mid + 1,
+                std::cmp::Ordering::Greater => hi = mid,
+                std::cmp::Ordering::Equal => return read_u32(stats, STATS_HEADER_LEN + mid * 8 + 4) as usize,
+            }
+        }
+        0
+    }
+
+    /// Decode the training statistics into a `TrainingStats`
+    pub fn training_stats(&self) -> Option<TrainingStats> {
+        let stats = self.stats_bytes()?;
+        let field = |offset: usize| -> Option<usize> {
+            (offset + 4 <= stats.len()).then(|| read_u32(stats, offset) as usize)
+        };
+
+        let mut result = TrainingStats {
+            total_chars: self.total_chars(),
+            char_frequency: HashMap::new(),
+            word_frequency: HashMap::new(),
+            bigram_frequency: HashMap::new(),
+            last_update: SystemTime::now(),
+        };
+
+        let (chars, bigrams, words) = (field(8)?, field(12)?, field(16)?);
+        let mut offset = STATS_HEADER_LEN;
+        for _ in 0..chars {
+            let c = char::from_u32(field(offset)? as u32)?;
+            result.char_frequency.insert(c, field(offset + 4)?);
+            offset += 8;
+        }
+        for _ in 0..bigrams {
+            let c1 = char::from_u32(field(offset)? as u32)?;
+            let c2 = char::from_u32(field(offset + 4)? as u32)?;
+            result.bigram_frequency.insert((c1, c2), field(offset + 8)?);
+            offset += 12;
+        }
+        for _ in 0..words {
+            let len = field(offset)?;
+            let count = field(offset + 4)?;
+            let word = stats.get(offset + 8..offset + 8 + len)?;
+            result.word_frequency.insert(std::str::from_utf8(word).ok()?.to_string(), count);
+            offset += 8 + len + padding(len);
+        }
+
+        Some(result)
+    }
+}
+
+/// Context of a `SnapshotLanguageModel`: a position in both the snapshot and the overlay
+#[derive(Debug, Clone)]
+pub struct OverlayContext {
+    base: SnapshotContext,
+    overlay: ArenaContext,
+}
+
+/// Language model backed by a read-only snapshot and a writable overlay
+///
+/// Counts from the snapshot and the overlay are added before blending, so text
+/// entered after loading the snapshot shifts predictions the same way training
+/// would have, without touching the snapshot.
+pub struct SnapshotLanguageModel<B: AsRef<[u8]> + 'static = Vec<u8>> {
+    /// Trained model
+    snapshot: PPMSnapshot<B>,
+
+    /// Symbols entered since the snapshot was loaded
+    overlay: ArenaPPMLanguageModel,
+
+    /// Combined counts by symbol ordinal, kept zeroed between queries
+    scratch: RefCell<Vec<u64>>,
+}
+
+impl SnapshotLanguageModel<Vec<u8>> {
+    /// Load a snapshot file
+    pub fn open<P: AsRef<Path>>(path: P) -> Result<Self, SnapshotError> {
+        Ok(Self::new(PPMSnapshot::open(path)?))
+    }
+}
+
+impl<B: AsRef<[u8]> + 'static> SnapshotLanguageModel<B> {
+    /// Create a model over a snapshot with an empty overlay
+    pub fn new(snapshot: PPMSnapshot<B>) -> Self {
+        let overlay = ArenaPPMLanguageModel::new(snapshot.max_order());
+        Self { snapshot, overlay, scratch: RefCell::new(Vec::new()) }
+    }
+
+    /// Get the snapshot
+    pub fn snapshot(&self) -> &PPMSnapshot<B> {
+        &self.snapshot
+    }
+
+    /// Get the overlay of symbols entered since loading
+    pub fn overlay(&self) -> &ArenaPPMLanguageModel {
+        &self.overlay
+    }
+
+    fn overlay_context(&self, text: &str) -> OverlayContext {
+        OverlayContext {
+            base: self.snapshot.context_from_text(text),
+            overlay: self.overlay.context_from_text(text),
+        }
+    }
+
+    /// Get the combined count of `symbol` after snapshot node `base` and overlay node `overlay`
+    fn symbol_count(&self, base: NodeIndex, overlay: NodeIndex, symbol: char) -> Option<u64> {
+        let base_count = (base != NO_NODE)
+            .then(|| self.snapshot.find_child(base, symbol))
+            .flatten()
+            .map(|child| self.snapshot.count(child) as u64);
+        let overlay_count = (overlay != NO_NODE)
+            .then(|| self.overlay.find_child(overlay, symbol).ok())
+            .flatten()
+            .map(|child| self.overlay.nodes[child as usize].count as u64);
+
+        match (base_count, overlay_count) {
+            (None, None) => None,
+            (a, b) => Some(a.unwrap_or(0) + b.unwrap_or(0)),
+        }
+    }
+
+    /// Fill `weights[i]` with the blended probability of `symbols[i]`
+    ///
+    /// Same PPM method C blending with exclusion as `ArenaPPMLanguageModel`. The
+    /// weights are not normalized.
+    fn blend(&self, context: &OverlayContext, symbols: &[char], weights: &mut [f64]) {
+        weights.fill(0.0);
+        let mut mass = 1.0;
+
+        let orders = context.base.nodes.len().max(context.overlay.nodes.len());
+        for k in (0..orders).rev() {
+            let base = context.base.nodes.get(k).copied().unwrap_or(NO_NODE);
+            let overlay = context.overlay.nodes.get(k).copied().unwrap_or(NO_NODE);
+            if base == NO_NODE && overlay == NO_NODE {
+                continue;
+            }
+
+            let mut total = 0u64;
+            let mut distinct = 0u64;
+            for (i, &symbol) in symbols.iter().enumerate() {
+                if weights[i] != 0.0 {
+                    continue;
+                }
+                if let Some(count) = self.symbol_count(base, overlay, symbol) {
+                    total += count;
+                    distinct += 1;
+                }
+            }
+            if distinct == 0 {
+                continue;
+            }
+
+            let denominator = (total + distinct) as f64;
+            for (i, &symbol) in symbols.iter().enumerate() {
+                if weights[i] != 0.0 {
+                    continue;
+                }
+                if let Some(count) = self.symbol_count(base, overlay, symbol) {
+                    weights[i] = (mass * count as f64 / denominator).max(f64::MIN_POSITIVE);
+                }
+            }
+            mass *= distinct as f64 / denominator;
+        }
+    }
+
+    /// Collect every symbol that follows some order of a context
+    fn candidate_symbols(&self, context: &OverlayContext) -> Vec<char> {
+        let mut symbols = Vec::new();
+        for &node in context.base.nodes.iter().filter(|&&n| n != NO_NODE) {
+            symbols.extend(self.snapshot.children(node).map(|child| self.snapshot.symbol(child)));
+        }
+        for &node in context.overlay.nodes.iter().filter(|&&n| n != NO_NODE) {
+            symbols.extend(self.overlay.children(node).iter()
+                .map(|&child| self.overlay.nodes[child as usize].symbol));
+        }
+        symbols.sort_unstable();
+        symbols.dedup();
+        symbols
+    }
+
+    fn probs_for(&self, context: &OverlayContext) -> HashMap<char, f64> {
+        let symbols = self.candidate_symbols(context);
+        let mut weights = vec![0.0; symbols.len()];
+        self.blend(context, &symbols, &mut weights);
+
+        let sum: f64 = weights.iter().sum();
+        symbols.into_iter()
+            .zip(weights)
+            .filter(|&(_, w)| w > 0.0)
+            .map(|(c, w)| (c, w / sum))
+            .collect()
+    }
+
+    fn probs_into(&self, context: &OverlayContext, index: &HashMap<char, usize>, probs: &mut [u32]) {
+        probs.fill(0);
+
+        // Same fixed-point scale as ArenaPPMLanguageModel::get_context_probs_into
+        const SCALE: f64 = (1u64 << 30) as f64;
+        let mut mass = SCALE;
+
+        let mut counts = self.scratch.borrow_mut();
+        if counts.len() < probs.len() {
+            counts.resize(probs.len(), 0);
+        }
+
+        // Ordinal of a symbol, if it is one asked for and not yet assigned
+        let ordinal = |probs: &[u32], symbol: char| {
+            index.get(&symbol).copied().filter(|&i| probs.get(i) == Some(&0))
+        };
+
+        let orders = context.base.nodes.len().max(context.overlay.nodes.len());
+        for k in (0..orders).rev() {
+            let base = context.base.nodes.get(k).copied().unwrap_or(NO_NODE);
+            let overlay = context.overlay.nodes.get(k).copied().unwrap_or(NO_NODE);
+            // (symbol, count) of every child of this order in either trie
+            let children = || {
+                let base_children = (base != NO_NODE).then(|| self.snapshot.children(base)).into_iter().flatten()
+                    .map(|child| (self.snapshot.symbol(child), self.snapshot.count(child) as u64));
+                let overlay_children = if overlay != NO_NODE { self.overlay.children(overlay) } else { &[] };
+                base_children.chain(overlay_children.iter()
+                    .map(|&child| &self.overlay.nodes[child as usize])
+                    .map(|node| (node.symbol, node.count as u64)))
+            };
+
+            // Sum the counts a symbol has in either trie
+            let mut total = 0u64;
+            let mut distinct = 0u64;
+            for (symbol, count) in children() {
+                if let Some(i) = ordinal(probs, symbol) {
+                    if counts[i] == 0 {
+                        distinct += 1;
+                    }
+                    counts[i] += count;
+                    total += count;
+                }
+            }
+            if distinct == 0 {
+                continue;
+            }
+
+            // Assign each summed symbol once and clear its count for the next order
+            let denominator = (total + distinct) as f64;
+            for (symbol, _) in children() {
+                if let Some(i) = ordinal(probs, symbol) {
+                    probs[i] = ((mass * counts[i] as f64 / denominator) as u32).max(1);
+                    counts[i] = 0;
+                }
+            }
+            mass *= distinct as f64 / denominator;
+        }
+
+        normalize_probs(probs, PROB_NORMALIZATION);
+    }
+}
+
+impl<B: AsRef<[u8]> + 'static> LanguageModel for SnapshotLanguageModel<B> {
+    fn as_any(&mut self) -> &mut dyn std::any::Any {
+        self
+    }
+
+    fn get_probs(&self, context: &str) -> HashMap<char, f64> {
+        self.probs_for(&self.overlay_context(context))
+    }
+
+    fn context_from_text(&self, text: &str) -> LanguageContext {
+        let mut context = LanguageContext::from_text(text);
+        context.cursor = ContextCursor::Snapshot(self.overlay_context(text));
+        context
+    }
+
+    fn context_after(&self, context: &LanguageContext, symbol: char) -> LanguageContext {
+        let mut next = context.with_symbol(symbol);
+        next.cursor = ContextCursor::Snapshot(match &context.cursor {
+            ContextCursor::Snapshot(ctx) => OverlayContext {
+                base: self.snapshot.advance_context(&ctx.base, symbol),
+                overlay: self.overlay.advance_context(&ctx.overlay, symbol),
+            },
+            _ => self.overlay_context(next.text()),
+        });
+        next
+    }
+
+    fn get_context_probs(&self, context: &LanguageContext) -> HashMap<char, f64> {
+        match &context.cursor {
+            ContextCursor::Snapshot(ctx) => self.probs_for(ctx),
+            _ => self.get_probs(context.text()),
+        }
+    }
+
+    fn get_probs_into(&self, context: &LanguageContext, _symbols: &[char], index: &HashMap<char, usize>, probs: &mut [u32]) {
+        match &context.cursor {
+            ContextCursor::Snapshot(ctx) => self.probs_into(ctx, index, probs),
+            _ => self.probs_into(&self.overlay_context(context.text()), index, probs),
+        }
+    }
+
+    fn enter_symbol(&mut self, symbol: char) {
+        self.overlay.enter_symbol(symbol);
+    }
+
+    fn reset(&mut self) {
+        self.overlay.reset();
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::model::language::symbol_index;
+
+    fn trained(text: &str) -> ArenaPPMLanguageModel {
+        let mut model = ArenaPPMLanguageModel::new(PPMOrder::Two);
+        for c in text.chars() {
+            model.enter_symbol(c);
+        }
+        model
+    }
+
+    #[test]
+    fn test_snapshot_matches_model() {
+        let text = "hello help hello";
+        let model = trained(text);
+        let mut stats = TrainingStats::new();
+        stats.update(text);
+
+        let mut bytes = Vec::new();
+        model.write_snapshot(Some(&stats), &mut bytes).unwrap();
+        let snapshot = PPMSnapshot::from_bytes(bytes.as_slice()).unwrap();
+        assert_eq!(snapshot.node_count(), model.node_count());
+        assert_eq!(snapshot.char_frequency('l'), 5);
+        assert_eq!(snapshot.char_frequency('z'), 0);
+
+        let decoded = snapshot.training_stats().unwrap();
+        assert_eq!(decoded.total_chars, stats.total_chars);
+        assert_eq!(decoded.word_frequency, stats.word_frequency);
+        assert_eq!(decoded.bigram_frequency, stats.bigram_frequency);
+
+        // Predictions from the snapshot match the model it was written from
+        let snapshot_model = SnapshotLanguageModel::new(PPMSnapshot::from_bytes(bytes.clone()).unwrap());
+        let expected = model.get_context_probs(&model.context_from_text("hel"));
+        let actual = LanguageModel::get_probs(&snapshot_model, "hel");
+        assert_eq!(actual.len(), expected.len());
+        for (c, p) in &expected {
+            assert!((actual[c] - p).abs() < 1e-9);
+        }
+
+        let symbols = ['h', 'e', 'l', 'o', 'p', ' ', 'z'];
+        let index = symbol_index(&symbols);
+        let (mut a, mut b) = ([0u32; 7], [0u32; 7]);
+        LanguageModel::get_probs_into(&model, &LanguageModel::context_from_text(&model, "hel"), &symbols, &index, &mut a);
+        LanguageModel::get_probs_into(&snapshot_model, &LanguageModel::context_from_text(&snapshot_model, "hel"), &symbols, &index, &mut b);
+        assert_eq!(a, b);
+    }
+
+    #[test]
+    fn test_overlay_learns_new_input() {
+        let mut bytes = Vec::new();
+        trained("abab").write_snapshot(None, &mut bytes).unwrap();
+        let mut model = SnapshotLanguageModel::new(PPMSnapshot::from_bytes(bytes).unwrap());
+        assert!(!model.snapshot().has_stats());
+
+        let before = LanguageModel::get_probs(&model, "a");
+        assert!(!before.contains_key(&'c'));
+        for c in "acacac".chars() {
+            model.enter_symbol(c);
+        }
+        let after = LanguageModel::get_probs(&model, "a");
+        assert!(after[&'c'] > 0.0);
+        assert!(after[&'b'] > 0.0);
+
+        // Snapshot and overlay counts add up as if the text had been trained together
+        let mut merged = trained("abab");
+        merged.merge(&trained("acacac"));
+        let symbols = ['a', 'b', 'c', 'z'];
+        let index = symbol_index(&symbols);
+        let (mut a, mut b) = ([0u32; 4], [0u32; 4]);
+        LanguageModel::get_probs_into(&merged, &LanguageModel::context_from_text(&merged, "a"), &symbols, &index, &mut a);
+        LanguageModel::get_probs_into(&model, &LanguageModel::context_from_text(&model, "a"), &symbols, &index, &mut b);
+        assert_eq!(a, b);
+    }
+
+    #[test]
+    fn test_shared_snapshot_keeps_overlays_private() {
+        let dir = tempfile::tempdir().unwrap();
+        let path = dir.path().join("shared.dppm");
+        trained("abab").save_snapshot(None, &path).unwrap();
+        let shared = PPMSnapshot::open_shared(&path).unwrap();
+
+        let sessions: Vec<_> = ["acac", "adad"].iter().map(|input| {
+            let mut model = SnapshotLanguageModel::new(shared.clone());
+            let input = input.to_string();
+            std::thread::spawn(move || {
+                for c in input.chars() {
+                    model.enter_symbol(c);
+                }
+                LanguageModel::get_probs(&model, "a")
+            })
+        }).collect();
+        let probs: Vec<_> = sessions.into_iter().map(|session| session.join().unwrap()).collect();
+
+        // Each session sees the shared training plus only its own input
+        assert!(probs[0][&'b'] > 0.0 && probs[1][&'b'] > 0.0);
+        assert!(probs[0].contains_key(&'c') && !probs[0].contains_key(&'d'));
+        assert!(probs[1].contains_key(&'d') && !probs[1].contains_key(&'c'));
+        assert_eq!(Arc::strong_count(&shared.bytes), 1);
+    }
+
+    #[test]
+    fn test_rejects_malformed_snapshots() {
+        let mut bytes = Vec::new();
+        trained("abc").write_snapshot(None, &mut bytes).unwrap();
+
+        assert!(PPMSnapshot::from_bytes(&bytes[..HEADER_LEN]).is_err());
+        let mut bad_magic = bytes.clone();
+        bad_magic[0] = b'X';
+        assert!(PPMSnapshot::from_bytes(bad_magic).is_err());
+        let mut bad_edge = bytes.clone();
+        let last = bad_edge.len() - 4;
+        bad_edge[last..].copy_from_slice(&u32::MAX.to_le_bytes());
+        assert!(PPMSnapshot::from_bytes(bad_edge).is_err());
+    }
+}
@@ -0,0 +1,265 @@
+//! # Memory Governor
+//!
+//! Puts a ceiling on the size of the node tree. Zooming only ever prunes the
+//! nephews of a new root, so subtrees that were expanded while on screen and
+//! then scrolled away stay alive under the root and its retained ancestors.
+//! Over a long session they add up.
+//!
+//! `expand_visible` stamps every node it finds on screen with the governor's
+//! clock. Once per frame the governor estimates the tree size from the number
+//! of nodes created since it last counted, and when the estimate passes a limit
+//! it walks the tree. If the tree really is over budget, the expanded subtrees
+//! seen least recently are collapsed back to unexpanded nodes until it is below
+//! `EVICTION_TARGET` of every limit. They are expanded again if they come back
+//! into view. The root, its ancestors, and everything visible in the current
+//! frame are never collapsed, nor is anything below the deepest nodes it
+//! reached, since those may still be on screen.
+
+use std::cell::RefCell;
+use std::rc::Rc;
+
+use super::node::{DasherNode, NodeFlags, NodeHandle};
+use super::node_pool::NodePool;
+
+/// Default most live nodes in the tree
+pub const DEFAULT_MAX_NODES: u64 = 100_000;
+
+/// Default most ancestors of the root kept for `reparent_root`
+pub const DEFAULT_MAX_ANCESTORS: u32 = 10;
+
+/// Share of each limit that eviction brings the tree back down to, so it
+/// does not evict again on the next frame
+const EVICTION_TARGET: f64 = 0.9;
+
+/// Frames between counts of the tree while it is within its limits
+const SURVEY_INTERVAL: u32 = 60;
+
+/// Bytes a node takes before its child list and context text
+const NODE_BYTES: usize = std::mem::size_of::<RefCell<DasherNode>>() + 2 * std::mem::size_of::<usize>();
+
+/// Limits on the size of the node tree
+#[repr(C)]
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct MemoryLimits {
+    /// Most live nodes, or 0 for no limit
+    pub max_nodes: u64,
+    /// Most estimated bytes held by live nodes, or 0 for no limit
+    pub max_bytes: u64,
+    /// Most ancestors of the root kept for `reparent_root` and backspace
+    pub max_ancestors: u32,
+}
+
+impl Default for MemoryLimits {
+    fn default() -> Self {
+        Self { max_nodes: DEFAULT_MAX_NODES, max_bytes: 0, max_ancestors: DEFAULT_MAX_ANCESTORS }
+    }
+}
+
+/// Counters of the node tree's size and of evictions
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct MemoryStats {
+    /// Live nodes at the last count
+    pub live_nodes: u64,
+    /// Estimated bytes held by live nodes at the last count
+    pub live_bytes: u64,
+    /// Most live nodes seen at any count
+    pub peak_nodes: u64,
+    /// Number of times the tree was counted
+    pub surveys: u64,
+    /// Number of subtrees collapsed
+    pub evictions: u64,
+    /// Number of nodes freed by collapsing subtrees
+    pub evicted_nodes: u64,
+    /// Number of ancestors of the root dropped
+    pub ancestors_dropped: u64,
+}
+
+/// An expanded node that could be collapsed
+struct Candidate {
+    last_visible: u32,
+    depth: u32,
+    node: NodeHandle,
+}
+
+/// Tracks the tree's size and collapses subtrees to keep it within limits
+#[derive(Debug, Default)]
+pub struct MemoryGovernor {
+    limits: MemoryLimits,
+    stats: MemoryStats,
+
+    /// Visibility clock, advanced once per `expand_visible`
+    clock: u32,
+
+    /// `nodes_created` at the last count
+    created_at_survey: u64,
+
+    /// Frames since the last count
+    frames_since_survey: u32,
+}
+
+impl MemoryGovernor {
+    /// Create a governor with the default limits
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Get the limits
+    pub fn limits(&self) -> MemoryLimits {
+        self.limits
+    }
+
+    /// Set the limits, taking effect at the next `enforce`
+    pub fn set_limits(&mut self, limits: MemoryLimits) {
+        self.limits = limits;
+        // Count on the next frame rather than trusting the old estimate
+        self.frames_since_survey = SURVEY_INTERVAL;
+    }
+
+    /// Get the counters
+    pub fn stats(&self) -> MemoryStats {
+        self.stats
+    }
+
+    /// Advance the visibility clock for a new frame and return its value
+    pub fn tick(&mut self) -> u32 {
+        self.clock = self.clock.wrapping_add(1).max(1);
+        self.clock
+    }
+
+    /// Get the current value of the visibility clock
+    pub fn clock(&self) -> u32 {
+        self.clock
+    }
+
+    /// Count an ancestor of the root dropped to stay within `max_ancestors`
+    pub fn record_ancestor_dropped(&mut self) {
+        self.stats.ancestors_dropped += 1;
+    }
+
+    /// Check the tree below `top` and collapse subtrees if it is over its limits
+    ///
+    /// `nodes_created` is the model's running count of created nodes, which
+    /// bounds how much the tree can have grown since it was last counted.
+    /// Returns the number of nodes freed.
+    pub fn enforce(&mut self, top: &Rc<RefCell<DasherNode>>, root: &Rc<RefCell<DasherNode>>,
+                   pool: &mut NodePool, nodes_created: u64) -> u64 {
+        self.frames_since_survey = self.frames_since_survey.saturating_add(1);
+        let growth = nodes_created.saturating_sub(self.created_at_survey);
+        let estimate = self.stats.live_nodes + growth;
+        let bytes_estimate = self.stats.live_bytes + growth * NODE_BYTES as u64;
+        if self.frames_since_survey < SURVEY_INTERVAL
+            && !exceeds(estimate, self.limits.max_nodes)
+            && !exceeds(bytes_estimate, self.limits.max_bytes) {
+            return 0;
+        }
+
+        let mut candidates = Vec::new();
+        let (nodes, bytes) = self.survey(top, root, &mut candidates);
+        self.created_at_survey = nodes_created;
+        self.frames_since_survey = 0;
+        self.stats.surveys += 1;
+        self.stats.live_nodes = nodes;
+        self.stats.live_bytes = bytes;
+        self.stats.peak_nodes = self.stats.peak_nodes.max(nodes);
+
+        if !exceeds(nodes, self.limits.max_nodes) && !exceeds(bytes, self.limits.max_bytes) {
+            return 0;
+        }
+
+        let target_nodes = target(self.limits.max_nodes);
+        let target_bytes = target(self.limits.max_bytes);
+        let (mut nodes, mut bytes) = (nodes, bytes);
+
+        // Oldest first; of equally old subtrees, the largest (highest) first
+        candidates.sort_unstable_by_key(|candidate| (candidate.last_visible, candidate.depth));
+        let mut freed = 0;
+        for candidate in candidates {
+            if !exceeds(nodes, target_nodes) && !exceeds(bytes, target_bytes) {
+                break;
+            }
+            // Candidates inside a subtree collapsed earlier were recycled with it
+            let node = match candidate.node.get() {
+                Some(node) => node,
+                None => continue,
+            };
+            let (subtree_nodes, subtree_bytes) = subtree_size(&node);
+            pool.release_children(&node);
+            // The node itself stays
+            nodes -= subtree_nodes - 1;
+            bytes -= subtree_bytes.saturating_sub(node_bytes(&node.borrow()) as u64);
+            freed += subtree_nodes - 1;
+            self.stats.evictions += 1;
+        }
+
+        self.stats.evicted_nodes += freed;
+        self.stats.live_nodes = nodes;
+        self.stats.live_bytes = bytes;
+        freed
+    }
+
+    /// Count the nodes and bytes below `top`, listing the subtrees that may be collapsed
+    fn survey(&self, top: &Rc<RefCell<DasherNode>>, root: &Rc<RefCell<DasherNode>>,
+              candidates: &mut Vec<Candidate>) -> (u64, u64) {
+        // The root and its ancestors hold everything still reachable
+        let mut chain = vec![Rc::as_ptr(root)];
+        let mut parent = root.borrow().parent().and_then(|parent| parent.upgrade());
+        while let Some(node) = parent {
+            chain.push(Rc::as_ptr(&node));
+            parent = node.borrow().parent().and_then(|parent| parent.upgrade());
+        }
+
+        let (mut nodes, mut bytes) = (0u64, 0u64);
+        let mut pending = vec![(top.clone(), 0u32, false)];
+        while let Some((node, depth, protected)) = pending.pop() {
+            let node_ref = node.borrow();
+            nodes += 1;
+            bytes += node_bytes(&node_ref) as u64;
+
+            let visible = node_ref.last_visible() == self.clock;
+            let expanded = node_ref.child_count() > 0 && !node_ref.get_flag(NodeFlags::CONTROL);
+            if expanded && !visible && !protected && !chain.contains(&Rc::as_ptr(&node)) {
+                candidates.push(Candidate { last_visible: node_ref.last_visible(), depth, node: NodeHandle::new(&node) });
+            }
+
+            // `expand_visible` stops descending at small or deep nodes, so
+            // nothing below the last visible nodes it reached is known to be
+            // off screen
+            let frontier = visible && !node_ref.children().iter().any(|child| child.borrow().last_visible() == self.clock);
+            let protect_children = protected || frontier;
+            pending.extend(node_ref.children().iter().map(|child| (child.clone(), depth + 1, protect_children)));
+        }
+        (nodes, bytes)
+    }
+}
+
+/// Check whether `value` is over `limit`, where 0 means no limit
+#[inline]
+fn exceeds(value: u64, limit: u64) -> bool {
+    limit != 0 && value > limit
+}
+
+/// Level eviction brings a limited value down to
+fn target(limit: u64) -> u64 {
+    if limit == 0 { 0 } else { ((limit as f64 * EVICTION_TARGET) as u64).max(1) }
+}
+
+/// Estimate the bytes a node holds, not counting its children
+///
+/// The context's text is stored inline, so `NODE_BYTES` covers it.
+fn node_bytes(node: &DasherNode) -> usize {
+    NODE_BYTES + node.children().capacity() * std::mem::size_of::<Rc<RefCell<DasherNode>>>()
+}
+
+/// Count the nodes and bytes in the subtree below and including `node`
+fn subtree_size(node: &Rc<RefCell<DasherNode>>) -> (u64, u64) {
+    let (mut nodes, mut bytes) = (0u64, 0u64);
+    let mut pending = vec![node.clone()];
+    while let Some(node) = pending.pop() {
+        let node_ref = node.borrow();
+        nodes += 1;
+        bytes += node_bytes(&node_ref) as u64;
+        pending.extend(node_ref.children().iter().cloned());
+    }
+    (nodes, bytes)
+}
@@ -4,18 +4,29 @@
 //! the arithmetic coding algorithm and node tree management.
 
 pub mod node;
+pub mod memory_governor;
+pub mod node_pool;
+pub mod output;
+pub mod sharded_training;
+pub mod training_job;
+pub mod zoom_trajectory;
 mod language;
 pub mod word_generator;
 pub mod word_prediction;
 pub use word_generator::{BaseWordGenerator, PredictiveWordGenerator};
-pub use language::{PPMLanguageModel, PPMOrder, PPMNode, LanguageModel, CombinedLanguageModel};
+pub use language::{PPMLanguageModel, PPMOrder, PPMNode, PPMContext, ArenaPPMLanguageModel, ArenaContext, LanguageModel, LanguageContext, CombinedLanguageModel, normalize_probs, symbol_index, PPMSnapshot, SnapshotLanguageModel, SnapshotError, Dictionary, IndexBytes, IndexedDictionary, write_dictionary_index, save_dictionary_index};
 pub use word_prediction::{WordPredictionManager, create_default_manager};
 use std::cell::RefCell;
 use std::collections::VecDeque;
-use std::rc::{Rc, Weak};
+use std::rc::Rc;
 use std::path::Path;
 
-use node::{DasherNode, NodeFlags};
+use node::{DasherNode, NodeFlags, NodeHandle};
+use memory_governor::{MemoryGovernor, MemoryLimits, MemoryStats};
+use node_pool::NodePool;
+use output::{OutputBuffer, OutputDelta};
+use training_job::{TrainingJob, TrainingSource};
+use zoom_trajectory::ZoomTrajectory;
 use crate::view::{DasherScreen, Color};
 use crate::alphabet::Alphabet;
 use crate::Result;
@@ -59,10 +70,10 @@ pub struct DasherModel {
     display_offset: i64,
 
     /// Last node that was output
-    last_output: Option<Weak<RefCell<DasherNode>>>,
+    last_output: Option<NodeHandle>,
 
-    /// Queue of steps to execute
-    goto_queue: VecDeque<(i64, i64)>,
+    /// Scheduled root movements
+    goto_queue: ZoomTrajectory,
 
     /// Whether characters entered by alphabet manager are expected to require conversion
     require_conversion: bool,
@@ -76,11 +87,35 @@ pub struct DasherModel {
     /// The alphabet used by this model
     alphabet: Option<Alphabet>,
 
+    /// Number of times the alphabet has been replaced
+    alphabet_generation: u64,
+
     /// The language model used by this model
     language_model: Option<Box<dyn LanguageModel>>,
 
     /// The current output text
-    output_text: String,
+    output_text: OutputBuffer,
+
+    /// Characters of the alphabet's symbols, by symbol index
+    symbol_chars: Vec<char>,
+
+    /// Labels of the alphabet's symbols, by symbol index, shared by all nodes
+    symbol_labels: Vec<Rc<str>>,
+
+    /// Reusable buffer for child probabilities during expansion
+    prob_buffer: Vec<u32>,
+
+    /// Recycled nodes for expansion
+    node_pool: NodePool,
+
+    /// Number of nodes expanded so far
+    expansion_count: u64,
+
+    /// Bounds the size of the node tree
+    memory: MemoryGovernor,
+
+    /// Language model being built in the background
+    training_job: Option<TrainingJob>,
 }
 
 impl Default for DasherModel {
@@ -109,9 +144,12 @@ impl DasherModel {
         self.output_text.clear();
 
         // Reset the root
-        if let Some(_root) = &self.root {
+        if let Some(old_root) = self.root.take() {
+            // Return the old tree to the pool
+            self.node_pool.release(old_root);
+
             // Create a new root node
-            let new_root = Rc::new(RefCell::new(DasherNode::new(0, Some("Root".to_string()))));
+            let new_root = self.node_pool.acquire(0, Some(Rc::from("Root")));
 
             // Set the new root
             self.root = Some(new_root.clone());
@@ -155,20 +193,31 @@ impl DasherModel {
     pub const ORIGIN_Y: i64 = 0;
     /// X origin constant for coordinate calculations
     pub const ORIGIN_X: i64 = 0;
-    /// Placeholder for word predictions
+    /// Get word predictions for the output text
+    ///
+    /// Only the symbols entered since the last call are processed.
     pub fn get_word_predictions(&mut self) -> Vec<String> {
         if let Some(manager) = &mut self.word_prediction {
-            manager.get_predictions(&self.output_text)
+            manager.sync(&self.output_text).to_vec()
         } else {
             Vec::new()
         }
     }
+
+    /// Get the word prediction manager
+    pub fn word_prediction_mut(&mut self) -> Option<&mut WordPredictionManager> {
+        self.word_prediction.as_mut()
+    }
     /// Maximum Y coordinate for the model (placeholder value)
     pub const MAX_Y: i64 = 1 << 20;
     /// Maximum X coordinate for the model (placeholder value)
     pub const MAX_X: i64 = 1 << 20;
     /// Normalization constant for probability calculations
     pub const NORMALIZATION: u32 = 1 << 16;
+    /// Smallest on-screen height, in Dasher units, at which `expand_visible` expands a node
+    pub const MIN_EXPAND_HEIGHT: i64 = Self::MAX_Y / 64;
+    /// Number of tree levels below the root that `expand_visible` expands
+    pub const MAX_EXPAND_DEPTH: usize = 3;
     /// Create a new Dasher model with default settings
     pub fn new() -> Self {
         Self::with_language_model(Box::new(CombinedLanguageModel::new(PPMOrder::Three)))
@@ -185,6 +234,9 @@ impl DasherModel {
         action_manager.register_action(Box::new(BackspaceAction));
         action_manager.register_action(Box::new(SpaceAction));
         action_manager.register_action(Box::new(AcceptAction));
+        let alphabet = Alphabet::english();
+        let symbol_chars = alphabet.symbols().iter().map(|s| s.character).collect();
+        let symbol_labels = alphabet.symbols().iter().map(|s| Rc::from(s.display_text.as_str())).collect();
         Self {
             action_manager,
             root: None,
@@ -197,16 +249,26 @@ impl DasherModel {
             root_max_max: i64::MAX / (Self::NORMALIZATION as i64) / 2,
             display_offset: 0,
             last_output: None,
-            goto_queue: VecDeque::new(),
+            goto_queue: ZoomTrajectory::new(),
             require_conversion: false,
             total_nats: 0.0,
             node_creation_handlers: Vec::new(),
-            alphabet: Some(Alphabet::english()),
-            output_text: String::new(),
+            alphabet: Some(alphabet),
+            alphabet_generation: 0,
+            output_text: OutputBuffer::new(),
+            symbol_chars,
+            symbol_labels,
+            prob_buffer: Vec::new(),
+            node_pool: NodePool::default(),
+            expansion_count: 0,
+            memory: MemoryGovernor::new(),
+            training_job: None,
         }
     }
 
     /// Load dictionary for language model
+    ///
+    /// Accepts a `word\tfrequency` list or an indexed dictionary file.
     pub fn load_dictionary<P: AsRef<Path>>(&mut self, path: P) -> std::io::Result<()> {
         if let Some(model) = &mut self.language_model {
             if let Some(combined) = model.as_any().downcast_mut::<CombinedLanguageModel>() {
@@ -216,6 +278,63 @@ impl DasherModel {
         Ok(())
     }
 
+    /// Use an indexed dictionary that may be shared with other models
+    ///
+    /// Returns false if the language model has no dictionary.
+    pub fn set_dictionary_index(&mut self, index: IndexedDictionary<IndexBytes>) -> bool {
+        match self.language_model.as_mut().and_then(|model| model.as_any().downcast_mut::<CombinedLanguageModel>()) {
+            Some(combined) => {
+                combined.dictionary_mut().set_index(index);
+                true
+            }
+            None => false,
+        }
+    }
+
+    /// Start building a language model from `sources` on a worker thread
+    ///
+    /// The current model keeps serving predictions until `poll_background_training`
+    /// swaps the new one in. Starting a new job cancels any job in progress.
+    pub fn start_background_training(&mut self, order: PPMOrder, sources: Vec<TrainingSource>) {
+        self.training_job = Some(TrainingJob::spawn(order, sources));
+    }
+
+    /// Swap in the background-trained language model if it is ready
+    ///
+    /// Call between frames. Text output since the job started is replayed into
+    /// the new model. Returns true if the model was replaced.
+    pub fn poll_background_training(&mut self) -> bool {
+        let result = match self.training_job.as_mut().and_then(|job| job.try_take()) {
+            Some(result) => result,
+            None => return false,
+        };
+        self.training_job = None;
+
+        match result {
+            Ok(mut language_model) => {
+                for c in self.output_text.as_str().chars() {
+                    language_model.enter_symbol(c);
+                }
+                self.set_language_model(language_model);
+                true
+            }
+            Err(e) => {
+                println!("Background training failed: {}", e);
+                false
+            }
+        }
+    }
+
+    /// Get the progress of the background training job, from 0 to 1, if one is running
+    pub fn background_training_progress(&self) -> Option<f32> {
+        self.training_job.as_ref().map(|job| job.progress())
+    }
+
+    /// Cancel the background training job, keeping the current language model
+    pub fn cancel_background_training(&mut self) {
+        self.training_job = None;
+    }
+
     /// Get current probability distribution
     pub fn get_probabilities(&self) -> Option<Vec<(char, f64)>> {
         self.language_model.as_ref().map(|model| {
@@ -233,7 +352,15 @@ impl DasherModel {
 
     /// Set the alphabet for this model
     pub fn set_alphabet(&mut self, alphabet: Alphabet) {
+        self.symbol_chars = alphabet.symbols().iter().map(|s| s.character).collect();
+        self.symbol_labels = alphabet.symbols().iter().map(|s| Rc::from(s.display_text.as_str())).collect();
         self.alphabet = Some(alphabet);
+        self.alphabet_generation += 1;
+    }
+
+    /// Get the generation of the alphabet, incremented every time it is replaced
+    pub fn alphabet_generation(&self) -> u64 {
+        self.alphabet_generation
     }
 
     /// Initialize the model
@@ -259,7 +386,7 @@ impl DasherModel {
         }
 
         // Create a root node
-        let root = Rc::new(RefCell::new(DasherNode::new(0, Some("Root".to_string()))));
+        let root = self.node_pool.acquire(0, Some(Rc::from("Root")));
         println!("Created root node");
 
         // Set the root node
@@ -287,8 +414,31 @@ impl DasherModel {
     }
 
     /// Set the language model for this model
+    ///
+    /// Node contexts are cursors into the model that made them, so the tree is
+    /// rebuilt: ancestors are dropped, the root's children are released and the
+    /// root is expanded again from a context derived from the output text.
     pub fn set_language_model(&mut self, language_model: Box<dyn LanguageModel>) {
+        let context = language_model.context_from_text(self.output_text.as_str());
         self.language_model = Some(language_model);
+
+        let root = match &self.root {
+            Some(root) => root.clone(),
+            None => return,
+        };
+        while let Some(old_root) = self.old_roots.pop_front() {
+            let next = self.old_roots.front().cloned().unwrap_or_else(|| root.clone());
+            self.node_pool.orphan_child(&old_root, &next);
+            self.node_pool.release(old_root);
+        }
+        self.node_pool.release_children(&root);
+        {
+            let mut root_ref = root.borrow_mut();
+            root_ref.set_context(context);
+            root_ref.set_flag(NodeFlags::ALL_CHILDREN, false);
+        }
+        self.last_output = Some(NodeHandle::new(&root));
+        self.expand_node(&root);
     }
 
     /// Get a reference to the language model
@@ -302,7 +452,17 @@ impl DasherModel {
 
     /// Get the current output text
     pub fn output_text(&self) -> &str {
-        &self.output_text
+        self.output_text.as_str()
+    }
+
+    /// Get the generation of the output text, incremented on every change
+    pub fn output_generation(&self) -> u64 {
+        self.output_text.generation()
+    }
+
+    /// Get the changes to the output text made after `generation`
+    pub fn output_delta_since(&self, generation: u64) -> OutputDelta<'_> {
+        self.output_text.delta_since(generation)
     }
 
     /// Append a character to the output text
@@ -313,7 +473,7 @@ impl DasherModel {
 
     /// Set the output text
     pub fn set_output_text(&mut self, text: &str) {
-        self.output_text = text.to_string();
+        self.output_text.set(text);
     }
 
     /// Set the root node
@@ -330,7 +490,7 @@ impl DasherModel {
 
         // Set the root coordinates
         new_root.borrow_mut().set_flag(NodeFlags::SEEN, true);
-        self.last_output = Some(Rc::downgrade(&new_root));
+        self.last_output = Some(NodeHandle::new(&new_root));
 
         // Calculate the root size based on the most probable child
         let most_probable = new_root.borrow().most_probable_child() as f64;
@@ -345,7 +505,7 @@ impl DasherModel {
     /// Get the current offset in the text buffer
     pub fn get_offset(&self) -> i32 {
         if let Some(last_output) = &self.last_output {
-            if let Some(node) = last_output.upgrade() {
+            if let Some(node) = last_output.get() {
                 return node.borrow().offset() + 1;
             }
         }
@@ -359,31 +519,20 @@ impl DasherModel {
 
     /// Get the node that was under the crosshair in the last frame
     pub fn get_node_under_crosshair(&self) -> Option<Rc<RefCell<DasherNode>>> {
-        if let Some(last_output) = &self.last_output {
-            last_output.upgrade()
-        } else {
-            None
-        }
+        self.last_output.as_ref().and_then(NodeHandle::get)
     }
 
     /// Expand a node by creating its children
     pub fn expand_node(&mut self, node: &Rc<RefCell<DasherNode>>) {
-        // Insert action nodes as children (e.g., at the end)
-        // We'll use a special label and NodeFlags for action nodes
-        for action in self.action_manager.all_actions() {
-            let mut action_node = DasherNode::new(0, Some(action.label().to_string()));
-            action_node.set_flag(NodeFlags::CONTROL, true); // Mark as control/action node
-            action_node.set_flag(NodeFlags::ALL_CHILDREN, true); // No further expansion
-            action_node.set_parent(Rc::downgrade(node));
-            node.borrow_mut().add_child(Rc::new(RefCell::new(action_node)));
-        }
+        self.expand_node_in_range(node, 0, Self::NORMALIZATION);
+    }
 
-        // Get word predictions if this is a word boundary
-        let _predictions = if node.borrow().is_word_boundary() {
-            self.get_word_predictions()
-        } else {
-            Vec::new()
-        };
+    /// Expand a node, creating children only for symbols that overlap `[visible_lower, visible_upper)`
+    ///
+    /// The bounds are relative to the node, in `NORMALIZATION` units. Each run of
+    /// symbols outside them becomes a single aggregate child, which
+    /// `expand_visible` splits once it scrolls into view.
+    pub fn expand_node_in_range(&mut self, node: &Rc<RefCell<DasherNode>>, visible_lower: u32, visible_upper: u32) {
         let has_all_children = {
             let node_ref = node.borrow();
             node_ref.get_flag(NodeFlags::ALL_CHILDREN)
@@ -393,113 +542,297 @@ impl DasherModel {
             return;
         }
 
-        // Delete existing children
-        node.borrow_mut().delete_children();
+        // Return existing children to the pool
+        self.node_pool.release_children(node);
+        self.expansion_count += 1;
+
+        if self.alphabet.is_some() {
+            // Reuse the probability buffer across expansions
+            let mut probs = std::mem::take(&mut self.prob_buffer);
+            let context = self.node_context(node);
+            self.fill_symbol_probs(context.as_ref(), &mut probs);
+
+            // Create a child for each visible symbol in the alphabet
+            let mut children = Vec::new();
+            self.create_symbol_children(
+                node, context.as_ref(), &probs, 0, 0,
+                (visible_lower, visible_upper), &mut children,
+            );
+
+            for child in children {
+                node.borrow_mut().add_child(child);
+            }
+            self.prob_buffer = probs;
+        }
+
+        // Insert action nodes as children (e.g., at the end)
+        // We'll use a special label and NodeFlags for action nodes
+        for action in self.action_manager.all_actions() {
+            let action_node = self.node_pool.acquire(0, Some(Rc::from(action.label())));
+            {
+                let mut action_ref = action_node.borrow_mut();
+                action_ref.set_flag(NodeFlags::CONTROL, true); // Mark as control/action node
+                action_ref.set_flag(NodeFlags::ALL_CHILDREN, true); // No further expansion
+                action_ref.set_parent(Rc::downgrade(node));
+            }
+            node.borrow_mut().add_child(action_node);
+        }
 
-        // Get the alphabet
-        if let Some(alphabet) = &self.alphabet {
-            // Get the current offset
-            let offset = node.borrow().offset();
+        // Set the ALL_CHILDREN flag
+        node.borrow_mut().set_flag(NodeFlags::ALL_CHILDREN, true);
 
-            // Get the probabilities for each symbol
-            let probs = if let Some(lm) = &mut self.language_model {
-                // Use the language model to get probabilities
-                // Use the current output text as context for better predictions
-                let context = self.output_text.clone();
-                lm.get_probs(&context)
-            } else {
-                // Use uniform probabilities
-                let num_symbols = alphabet.size();
-                let mut map = std::collections::HashMap::new();
-                for symbol in alphabet.symbols().iter() {
-                    map.insert(symbol.character, 1.0 / num_symbols as f64);
-                }
-                map
-            };
+        // Notify event handlers
+        for handler in &self.node_creation_handlers {
+            handler(node);
+        }
+    }
+
+    /// Get the root node's coordinates
+    pub fn root_range(&self) -> (i64, i64) {
+        (self.root_min, self.root_max)
+    }
+
+    /// Get the number of nodes expanded so far
+    pub fn expansion_count(&self) -> u64 {
+        self.expansion_count
+    }
+
+    /// Get the number of nodes created so far, including reused ones
+    pub fn nodes_created(&self) -> u64 {
+        self.node_pool.stats().0
+    }
 
-            // Create a child for each symbol in the alphabet
-            let mut lower_bound = 0;
-            let mut created_count = 0;
+    /// Expand the root and its descendants that overlap the visible y-range
+    ///
+    /// Nodes are only expanded once they are tall enough on screen, and aggregate
+    /// children that come into view are split into real symbol nodes.
+    pub fn expand_visible(&mut self, min_y: i64, max_y: i64) {
+        let root = match &self.root {
+            Some(root) => root.clone(),
+            None => return,
+        };
+        let (root_min, root_max) = if self.root_max > self.root_min {
+            (self.root_min, self.root_max)
+        } else {
+            (0, Self::MAX_Y)
+        };
 
-            // Ensure we have at least some probability for each symbol
-            let min_prob = 1;
+        let clock = self.memory.tick();
+        let mut pending = vec![(root, root_min, root_max, 0)];
+        while let Some((node, node_min, node_max, depth)) = pending.pop() {
+            if node_max < min_y || node_min > max_y {
+                continue;
+            }
+            node.borrow_mut().set_last_visible(clock);
+            let height = node_max - node_min;
+            if height < Self::MIN_EXPAND_HEIGHT {
+                continue;
+            }
 
-            for symbol in alphabet.symbols().iter() {
-                // Get probability from language model or use minimum
-                let mut prob = probs.get(&symbol.character).copied().unwrap_or(0.0) as u32;
+            let to_relative = |y: i64| {
+                ((y - node_min) as i128 * Self::NORMALIZATION as i128 / height as i128)
+                    .clamp(0, Self::NORMALIZATION as i128) as u32
+            };
+            let visible = (to_relative(min_y), to_relative(max_y).saturating_add(1));
 
-                // Ensure minimum probability
-                if prob < min_prob {
-                    prob = min_prob;
+            if !node.borrow().get_flag(NodeFlags::ALL_CHILDREN) {
+                self.expand_node_in_range(&node, visible.0, visible.1);
+            }
+
+            // Split aggregates that have scrolled into view
+            let aggregates: Vec<_> = node.borrow().children().iter()
+                .filter(|child| {
+                    let child = child.borrow();
+                    child.aggregate().is_some()
+                        && child.upper_bound() > visible.0
+                        && child.lower_bound() < visible.1
+                })
+                .cloned()
+                .collect();
+            for aggregate in aggregates {
+                self.split_aggregate(&node, aggregate, visible);
+            }
+
+            if depth + 1 >= Self::MAX_EXPAND_DEPTH {
+                continue;
+            }
+            for child in node.borrow().children() {
+                let child_ref = child.borrow();
+                if child_ref.aggregate().is_some() || child_ref.get_flag(NodeFlags::CONTROL) {
+                    continue;
                 }
+                let child_min = node_min + (height * child_ref.lower_bound() as i64) / Self::NORMALIZATION as i64;
+                let child_max = node_min + (height * child_ref.upper_bound() as i64) / Self::NORMALIZATION as i64;
+                pending.push((child.clone(), child_min, child_max, depth + 1));
+            }
+        }
+    }
 
-                // Create node if probability is positive
-                if prob > 0 {
-                    let upper_bound = lower_bound + prob;
+    /// Replace an aggregate child of `parent` with children for its symbols
+    fn split_aggregate(&mut self, parent: &Rc<RefCell<DasherNode>>, aggregate: Rc<RefCell<DasherNode>>, visible: (u32, u32)) {
+        let (first, last) = match aggregate.borrow().aggregate() {
+            Some((first, last)) => (first as usize, last as usize),
+            None => return,
+        };
+        if last > self.symbol_chars.len() {
+            return;
+        }
+        let (lower_bound, upper_bound) = {
+            let aggregate = aggregate.borrow();
+            (aggregate.lower_bound(), aggregate.upper_bound())
+        };
 
-                    // Create a new node for this symbol
-                    let child = Rc::new(RefCell::new(DasherNode::new(
-                        offset + 1,
-                        Some(symbol.display_text.clone()),
-                    )));
+        let mut probs = std::mem::take(&mut self.prob_buffer);
+        let context = self.node_context(parent);
+        self.fill_symbol_probs(context.as_ref(), &mut probs);
 
-                    // Set the bounds
-                    child.borrow_mut().set_bounds(lower_bound, upper_bound);
+        // Rescale to the aggregate's own width, in case the model has learnt since
+        let span = &mut probs[first..last];
+        normalize_probs(span, upper_bound - lower_bound);
 
-                    // Set the symbol
-                    child.borrow_mut().set_symbol(symbol.character);
+        let mut children = Vec::new();
+        self.create_symbol_children(
+            parent, context.as_ref(), &probs[first..last], first, lower_bound, visible, &mut children,
+        );
+        self.prob_buffer = probs;
 
-                    // Set the colors
-                    child.borrow_mut().set_colors(
-                        (symbol.foreground_color.r, symbol.foreground_color.g, symbol.foreground_color.b),
-                        (symbol.background_color.r, symbol.background_color.g, symbol.background_color.b)
-                    );
+        let index = parent.borrow().children().iter().position(|child| Rc::ptr_eq(child, &aggregate));
+        if let Some(index) = index {
+            parent.borrow_mut().replace_child(index, children);
+            self.node_pool.release(aggregate);
+        }
+    }
+
+    /// Get the language model context at a node
+    ///
+    /// Only a node created without one (e.g. the root) builds it from the output text.
+    fn node_context(&self, node: &Rc<RefCell<DasherNode>>) -> Option<LanguageContext> {
+        self.language_model.as_ref().map(|lm| {
+            node.borrow().context().cloned()
+                .unwrap_or_else(|| lm.context_from_text(self.output_text.as_str()))
+        })
+    }
 
-                    // Set the parent
-                    child.borrow_mut().set_parent(Rc::downgrade(node));
+    /// Fill `probs` with the probability of each symbol, by symbol index, normalized to the node range
+    fn fill_symbol_probs(&self, context: Option<&LanguageContext>, probs: &mut Vec<u32>) {
+        probs.clear();
+        probs.resize(self.symbol_chars.len(), 0);
+        if let (Some(lm), Some(context), Some(alphabet)) = (&self.language_model, context, &self.alphabet) {
+            lm.get_probs_into(context, &self.symbol_chars, alphabet.symbol_index(), probs);
+        } else {
+            // Use uniform probabilities
+            normalize_probs(probs, Self::NORMALIZATION);
+        }
+    }
 
-                    // Add the child to the parent
-                    node.borrow_mut().add_child(child);
+    /// Create children of `parent` for the symbols starting at index `first`
+    ///
+    /// `probs[i]` is the width of symbol `first + i`; the first child starts at
+    /// `lower_bound`. Runs of symbols outside `visible` become one aggregate.
+    #[allow(clippy::too_many_arguments)]
+    fn create_symbol_children(
+        &mut self,
+        parent: &Rc<RefCell<DasherNode>>,
+        context: Option<&LanguageContext>,
+        probs: &[u32],
+        first: usize,
+        mut lower_bound: u32,
+        visible: (u32, u32),
+        children: &mut Vec<Rc<RefCell<DasherNode>>>,
+    ) {
+        let alphabet = match &self.alphabet {
+            Some(alphabet) => alphabet,
+            None => return,
+        };
+        let offset = parent.borrow().offset();
+
+        // Start of the current run of hidden symbols, as (symbol index, lower bound)
+        let mut hidden: Option<(usize, u32)> = None;
+
+        let symbols = alphabet.symbols().iter().zip(&self.symbol_labels).skip(first);
+        for (i, ((symbol, label), &prob)) in symbols.zip(probs).enumerate() {
+            let index = first + i;
+            let upper_bound = lower_bound + prob;
+
+            if upper_bound <= visible.0 || lower_bound >= visible.1 {
+                hidden.get_or_insert((index, lower_bound));
+                lower_bound = upper_bound;
+                continue;
+            }
 
-                    // Update the lower bound for the next symbol
-                    lower_bound = upper_bound;
-                    created_count += 1;
+            if let Some((start, start_bound)) = hidden.take() {
+                children.push(Self::aggregate_child(&mut self.node_pool, parent, offset + 1, (start, index), (start_bound, lower_bound)));
+            }
+
+            // Create a new node for this symbol
+            let child = self.node_pool.acquire(offset + 1, Some(label.clone()));
+            {
+                let mut child_ref = child.borrow_mut();
+
+                // Set the bounds
+                child_ref.set_bounds(lower_bound, upper_bound);
+
+                // Set the symbol
+                child_ref.set_symbol(symbol.character);
+
+                // The child's context is the parent's advanced by its symbol
+                if let (Some(lm), Some(context)) = (&self.language_model, context) {
+                    child_ref.set_context(lm.context_after(context, symbol.character));
                 }
+
+                // Set the colors
+                child_ref.set_colors(
+                    (symbol.foreground_color.r, symbol.foreground_color.g, symbol.foreground_color.b),
+                    (symbol.background_color.r, symbol.background_color.g, symbol.background_color.b)
+                );
+
+                // Set the parent
+                child_ref.set_parent(Rc::downgrade(parent));
             }
+            children.push(child);
 
-            println!("Created {} child nodes for alphabet symbols", created_count);
+            // Update the lower bound for the next symbol
+            lower_bound = upper_bound;
         }
 
-        // Set the ALL_CHILDREN flag
-        node.borrow_mut().set_flag(NodeFlags::ALL_CHILDREN, true);
+        if let Some((start, start_bound)) = hidden {
+            let end = first + probs.len();
+            children.push(Self::aggregate_child(&mut self.node_pool, parent, offset + 1, (start, end), (start_bound, lower_bound)));
+        }
+    }
 
-        // Notify event handlers
-        for handler in &self.node_creation_handlers {
-            handler(node);
+    /// Create an aggregate child standing in for the symbols `symbols.0..symbols.1`
+    fn aggregate_child(
+        pool: &mut NodePool,
+        parent: &Rc<RefCell<DasherNode>>,
+        offset: i32,
+        symbols: (usize, usize),
+        bounds: (u32, u32),
+    ) -> Rc<RefCell<DasherNode>> {
+        let child = pool.acquire(offset, None);
+        {
+            let mut child_ref = child.borrow_mut();
+            child_ref.set_bounds(bounds.0, bounds.1);
+            child_ref.set_aggregate(symbols.0 as u32, symbols.1 as u32);
+            child_ref.set_flag(NodeFlags::ALL_CHILDREN, true);
+            child_ref.set_parent(Rc::downgrade(parent));
         }
+        child
     }
 
     /// Make a child of the root into a new root
     pub fn make_root(&mut self, new_root: &Rc<RefCell<DasherNode>>) {
         // Get the current root
         if let Some(root) = &self.root {
-            // Delete nephews of the new root
-            root.borrow_mut().delete_nephews(new_root);
+            // Return nephews of the new root to the pool
+            self.node_pool.release_nephews(root, new_root);
             root.borrow_mut().set_flag(NodeFlags::COMMITTED, true);
 
             // Add the old root to the queue
             self.old_roots.push_back(root.clone());
 
             // Clean up old roots if necessary
-            while self.old_roots.len() > 10 &&
-                  (!self.require_conversion ||
-                   self.old_roots[0].borrow().get_flag(NodeFlags::CONVERTED)) {
-                if let Some(old_root) = self.old_roots.pop_front() {
-                    if let Some(next_root) = self.old_roots.front() {
-                        old_root.borrow_mut().orphan_child(next_root);
-                    }
-                }
-            }
+            self.trim_old_roots();
 
             // Set the new root
             self.root = Some(new_root.clone());
@@ -511,11 +844,11 @@ impl DasherModel {
             self.root_min += (range * new_root_ref.lower_bound() as i64) / (Self::NORMALIZATION as i64);
 
             // Update any scheduled steps
-            for step in &mut self.goto_queue {
-                let r = step.1 - step.0;
-                step.1 = step.0 + (r * new_root_ref.upper_bound() as i64) / (Self::NORMALIZATION as i64);
-                step.0 += (r * new_root_ref.lower_bound() as i64) / (Self::NORMALIZATION as i64);
-            }
+            let (lower, upper) = (new_root_ref.lower_bound() as i64, new_root_ref.upper_bound() as i64);
+            self.goto_queue.rebase(|(min, max)| {
+                let r = max - min;
+                (min + (r * lower) / (Self::NORMALIZATION as i64), min + (r * upper) / (Self::NORMALIZATION as i64))
+            });
         }
     }
 
@@ -556,6 +889,7 @@ impl DasherModel {
                ((self.root_min - self.root_min_min) as f64 / root_width as f64) {
                 // Cache the unusable root node
                 self.old_roots.push_back(parent_node);
+                self.trim_old_roots();
                 return false;
             }
 
@@ -567,11 +901,10 @@ impl DasherModel {
             self.root_min -= (lower * root_width) / range;
 
             // Update any scheduled steps
-            for step in &mut self.goto_queue {
-                let step_width = step.1 - step.0;
-                step.1 += ((Self::NORMALIZATION as i64 - upper) * step_width) / range;
-                step.0 -= (lower * step_width) / range;
-            }
+            self.goto_queue.rebase(|(min, max)| {
+                let step_width = max - min;
+                (min - (lower * step_width) / range, max + ((Self::NORMALIZATION as i64 - upper) * step_width) / range)
+            });
 
             return true;
         }
@@ -579,82 +912,148 @@ impl DasherModel {
         false
     }
 
+    /// Drop the oldest ancestors beyond the governor's `max_ancestors`
+    ///
+    /// Ancestors still waiting for conversion are kept.
+    fn trim_old_roots(&mut self) {
+        let max_ancestors = self.memory.limits().max_ancestors as usize;
+        while self.old_roots.len() > max_ancestors &&
+              (!self.require_conversion ||
+               self.old_roots[0].borrow().get_flag(NodeFlags::CONVERTED)) {
+            if let Some(old_root) = self.old_roots.pop_front() {
+                if let Some(next_root) = self.old_roots.front() {
+                    self.node_pool.orphan_child(&old_root, next_root);
+                }
+                self.node_pool.release(old_root);
+                self.memory.record_ancestor_dropped();
+            }
+        }
+    }
+
+    /// Get the limits on the size of the node tree
+    pub fn memory_limits(&self) -> MemoryLimits {
+        self.memory.limits()
+    }
+
+    /// Set the limits on the size of the node tree
+    pub fn set_memory_limits(&mut self, limits: MemoryLimits) {
+        self.memory.set_limits(limits);
+        self.trim_old_roots();
+    }
+
+    /// Get the node tree's size and eviction counters
+    pub fn memory_stats(&self) -> MemoryStats {
+        self.memory.stats()
+    }
+
+    /// Collapse the subtrees seen least recently if the tree is over its limits
+    ///
+    /// Called once per frame after `expand_visible`. Returns the number of nodes freed.
+    pub fn enforce_memory_limits(&mut self) -> u64 {
+        let root = match &self.root {
+            Some(root) => root.clone(),
+            None => return 0,
+        };
+        let top = self.old_roots.front().cloned().unwrap_or_else(|| root.clone());
+        let created = self.nodes_created();
+        self.memory.enforce(&top, &root, &mut self.node_pool, created)
+    }
+
     /// Process the next scheduled step
     pub fn next_scheduled_step(&mut self) -> bool {
-        if self.goto_queue.is_empty() {
+        let (new_root_min, new_root_max) = match self.goto_queue.pop_front() {
+            Some(step) => step,
+            None => return false,
+        };
+
+        // Update the total information
+        self.total_nats += ((new_root_max - new_root_min) as f64 / (self.root_max - self.root_min) as f64).ln();
+
+        // Update the display offset
+        self.display_offset = (self.display_offset * 90) / 100;
+
+        // Only allow the update if it won't make the root too small
+        if (new_root_max - new_root_min) <= Self::MAX_Y / 4 {
             return false;
         }
+        self.root_min = new_root_min;
+        self.root_max = new_root_max;
 
-        if let Some((new_root_min, new_root_max)) = self.goto_queue.pop_front() {
-            // Update the total information
-            self.total_nats += ((new_root_max - new_root_min) as f64 / (self.root_max - self.root_min) as f64).ln();
+        // Make the child under the crosshair the new root while it stays large enough
+        while self.enter_crosshair_child() {}
+        true
+    }
 
-            // Update the display offset
-            self.display_offset = (self.display_offset * 90) / 100;
+    /// Get the child of the root that covers the crosshair
+    fn crosshair_child(&self) -> Option<Rc<RefCell<DasherNode>>> {
+        let root = self.root.as_ref()?;
+        let root_ref = root.borrow();
+        let width = self.root_max - self.root_min;
+        let to_y = |bound: u32| self.root_min + ((bound as i64 * width) / (Self::NORMALIZATION as i64));
+
+        // Symbol children tile the root in order, with any control
+        // nodes after them, so the crosshair child is found by bisection
+        let children = root_ref.children();
+        let index = children.partition_point(|child| {
+            let child_ref = child.borrow();
+            !child_ref.get_flag(NodeFlags::CONTROL) && to_y(child_ref.upper_bound()) <= Self::ORIGIN_Y
+        });
+
+        let child = children.get(index)?;
+        let child_ref = child.borrow();
+        if to_y(child_ref.lower_bound()) <= Self::ORIGIN_Y && to_y(child_ref.upper_bound()) > Self::ORIGIN_Y {
+            Some(child.clone())
+        } else {
+            None
+        }
+    }
 
-            // Check if we need to make a child the new root
-            if new_root_min <= Self::ORIGIN_Y && new_root_max > Self::ORIGIN_Y {
-                // Find a child that covers the crosshair
-                let child_to_make_root = {
-                    let mut result = None;
-
-                    if let Some(root) = &self.root {
-                        let root_ref = root.borrow();
-                        let width = self.root_max - self.root_min;
-                        let is_game_path = root_ref.get_flag(NodeFlags::GAME);
-
-                        // Find the child covering the crosshair
-                        for child in root_ref.children() {
-                            let child_ref = child.borrow();
-                            let child_min = self.root_min + ((child_ref.lower_bound() as i64 * width) / (Self::NORMALIZATION as i64));
-                            let child_max = self.root_min + ((child_ref.upper_bound() as i64 * width) / (Self::NORMALIZATION as i64));
-
-                            if child_min <= Self::ORIGIN_Y && child_max > Self::ORIGIN_Y {
-                                // Check if the child is on the game path
-                                if is_game_path && !child_ref.get_flag(NodeFlags::GAME) {
-                                    return false;
-                                }
-
-                                result = Some(child.clone());
-                                break;
-                            }
-                        }
-                    }
+    /// Check that a child of the root may become the root in game mode
+    fn on_game_path(&self, child: &Rc<RefCell<DasherNode>>) -> bool {
+        let is_game_path = self.root.as_ref().map_or(false, |root| root.borrow().get_flag(NodeFlags::GAME));
+        !is_game_path || child.borrow().get_flag(NodeFlags::GAME)
+    }
 
-                    result
-                };
+    /// Make the child under the crosshair the new root, if it is on screen enough to be one
+    ///
+    /// `make_root` converts the root range and the scheduled steps into the
+    /// child's coordinates, so the next level is searched in the right frame.
+    fn enter_crosshair_child(&mut self) -> bool {
+        let child = match self.crosshair_child() {
+            Some(child) if self.on_game_path(&child) => child,
+            _ => return false,
+        };
 
-                if let Some(child) = child_to_make_root {
-                    // Update the target coordinates
-                    self.goto_queue.push_back((new_root_min, new_root_max));
-
-                    // Make the child the new root
-                    self.root = Some(child);
-
-                    // Get the updated coordinates
-                    if let Some((updated_min, updated_max)) = self.goto_queue.pop_back() {
-                        // Continue with the updated coordinates
-                        if updated_min <= Self::ORIGIN_Y && updated_max > Self::ORIGIN_Y &&
-                           (updated_max - updated_min) > Self::MAX_Y / 4 {
-                            self.root_min = updated_min;
-                            self.root_max = updated_max;
-                            return true;
-                        }
-                    }
+        let (lower, upper) = {
+            let child_ref = child.borrow();
+            (child_ref.lower_bound() as i64, child_ref.upper_bound() as i64)
+        };
+        let width = self.root_max - self.root_min;
+        if (width * (upper - lower)) / (Self::NORMALIZATION as i64) <= Self::MAX_Y / 4 {
+            return false;
+        }
 
-                    return false;
-                }
-            }
+        self.make_root(&child);
+        true
+    }
 
-            // Only allow the update if it won't make the root too small
-            if (new_root_max - new_root_min) > Self::MAX_Y / 4 {
-                self.root_min = new_root_min;
-                self.root_max = new_root_max;
-                return true;
-            }
+    /// Process up to `steps` scheduled steps at once
+    ///
+    /// Used to catch up after dropped frames. The skipped steps lie on the
+    /// trajectory to the last one, so only the last is applied; the display
+    /// offset still decays once per step. Applying a step follows the
+    /// crosshair down as many levels as it crossed.
+    pub fn next_scheduled_steps(&mut self, steps: usize) -> bool {
+        let skipped = self.goto_queue.skip(steps.saturating_sub(1));
+        for _ in 0..skipped {
+            self.display_offset = (self.display_offset * 90) / 100;
         }
+        self.next_scheduled_step()
+    }
 
-        false
+    /// Get the number of scheduled steps left
+    pub fn scheduled_step_count(&self) -> usize {
+        self.goto_queue.len()
     }
 
     /// Schedule a single step
@@ -702,13 +1101,11 @@ impl DasherModel {
         };
 
         // Add the step to the queue
-        self.goto_queue.push_back((r1 + m1_final, r2 + m2_final));
+        self.goto_queue.set_target((r1 + m1_final, r2 + m2_final));
     }
 
     /// Schedule a zoom operation
     pub fn schedule_zoom(&mut self, y1: i64, y2: i64, mut n_steps: i32) {
-        self.goto_queue.clear();
-
         // Rename for readability
         let r1 = self.root_min;
         let r2 = self.root_max;
@@ -725,9 +1122,12 @@ impl DasherModel {
         let nh = r2_new - r1_new;
         let log_height_mul = if nh == oh { 0.0 } else { (nh as f64 / oh as f64).ln() };
 
-        // Add steps to the queue
+        // Precompute the fraction of the way from R to r after each step
         let mut s = n_steps;
-        while n_steps > 1 {
+        let fractions = std::iter::from_fn(|| {
+            if n_steps <= 1 {
+                return None;
+            }
             let d_frac = if nh == oh {
                 s as f64 / max as f64
             } else {
@@ -737,18 +1137,13 @@ impl DasherModel {
                 (h - oh as f64) / (nh as f64 - oh as f64)
             };
 
-            // Use the fraction to interpolate from R to r
-            let new_min = r1 + (d_frac * (r1_new - r1) as f64) as i64;
-            let new_max = r2 + (d_frac * (r2_new - r2) as f64) as i64;
-
-            self.goto_queue.push_back((new_min, new_max));
-
             s += n_steps - 1;
             n_steps -= 1;
-        }
+            Some(d_frac)
+        });
 
         // Add the final point
-        self.goto_queue.push_back((r1_new, r2_new));
+        self.goto_queue.set_curve((r1, r2), (r1_new, r2_new), fractions.chain(std::iter::once(1.0)));
     }
 
     /// Clear all scheduled steps
@@ -785,7 +1180,7 @@ impl DasherModel {
             }
 
             // Set the last output
-            self.last_output = Some(Rc::downgrade(new_node));
+            self.last_output = Some(NodeHandle::new(new_node));
 
             // Get the symbol from the node
             let symbol = new_node.borrow().symbol();
@@ -1041,3 +1436,270 @@ impl DasherModel {
         );
     }
 }
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_expand_node_covers_normalization() {
+        let mut model = DasherModel::new();
+        let root = Rc::new(RefCell::new(DasherNode::new(0, None)));
+        root.borrow_mut().set_bounds(0, DasherModel::NORMALIZATION);
+        model.expand_node(&root);
+
+        let root = root.borrow();
+        let symbols: Vec<_> = root.children().iter()
+            .filter(|c| c.borrow().symbol().is_some())
+            .collect();
+        assert_eq!(symbols.len(), model.symbol_chars.len());
+
+        // Children tile the whole range without gaps, each at least 1 wide
+        let mut lower = 0;
+        for child in &symbols {
+            let child = child.borrow();
+            assert_eq!(child.lower_bound(), lower);
+            assert!(child.upper_bound() > child.lower_bound());
+            lower = child.upper_bound();
+        }
+        assert_eq!(lower, DasherModel::NORMALIZATION);
+    }
+
+    #[test]
+    fn test_background_training_swaps_model() {
+        let mut model = DasherModel::new();
+        model.start_background_training(PPMOrder::Two, vec![TrainingSource::Text("abc abc abc".to_string())]);
+        assert!(model.background_training_progress().is_some());
+
+        let start = std::time::Instant::now();
+        while !model.poll_background_training() {
+            assert!(start.elapsed() < std::time::Duration::from_secs(30), "training did not finish");
+            std::thread::sleep(std::time::Duration::from_millis(1));
+        }
+        assert!(model.background_training_progress().is_none());
+
+        let probs = model.language_model().unwrap().get_probs("ab");
+        assert!(probs.iter().all(|(&c, &p)| c == 'c' || p < probs[&'c']));
+    }
+
+    #[test]
+    fn test_expand_node_reuses_pooled_nodes() {
+        let mut model = DasherModel::new();
+        let root = model.node_pool.acquire(0, None);
+        model.expand_node(&root);
+        let first = root.borrow().children()[0].borrow().label().map(str::to_string);
+
+        // Re-expanding recycles the previous children instead of allocating
+        root.borrow_mut().set_flag(NodeFlags::ALL_CHILDREN, false);
+        model.expand_node(&root);
+        let (acquired, reused) = model.node_pool.stats();
+        assert!(reused * 2 >= acquired - 1);
+        assert_eq!(root.borrow().children()[0].borrow().label().map(str::to_string), first);
+    }
+
+    #[test]
+    fn test_expand_visible_aggregates_hidden_symbols() {
+        let mut model = DasherModel::new();
+        let root = model.node_pool.acquire(0, None);
+        model.root = Some(root.clone());
+        model.root_min = 0;
+        model.root_max = DasherModel::MAX_Y;
+
+        // Only the top eighth is visible: the rest collapses into one aggregate
+        model.expand_visible(0, DasherModel::MAX_Y / 8);
+        let symbol_children = |root: &Rc<RefCell<DasherNode>>| root.borrow().children().iter()
+            .filter(|c| !c.borrow().get_flag(NodeFlags::CONTROL))
+            .map(|c| {
+                let c = c.borrow();
+                (c.lower_bound(), c.upper_bound(), c.aggregate().is_some())
+            })
+            .collect::<Vec<_>>();
+
+        let children = symbol_children(&root);
+        assert_eq!(children.iter().filter(|c| c.2).count(), 1);
+        assert!(children.len() < model.symbol_chars.len());
+        assert_eq!(children.last().unwrap().1, DasherModel::NORMALIZATION);
+
+        // Scrolling the rest into view splits the aggregate into symbol nodes
+        model.expand_visible(0, DasherModel::MAX_Y);
+        let children = symbol_children(&root);
+        assert!(children.iter().all(|c| !c.2));
+        assert_eq!(children.len(), model.symbol_chars.len());
+        for pair in children.windows(2) {
+            assert_eq!(pair[0].1, pair[1].0);
+        }
+    }
+
+    #[test]
+    fn test_memory_limits_collapse_hidden_subtrees() {
+        let mut model = DasherModel::new();
+        let root = model.node_pool.acquire(0, None);
+        model.root = Some(root.clone());
+        model.root_min = 0;
+        model.root_max = DasherModel::MAX_Y;
+        model.expand_visible(0, DasherModel::MAX_Y);
+        model.set_memory_limits(MemoryLimits { max_nodes: 0, ..Default::default() });
+        model.enforce_memory_limits();
+        let full = model.memory_stats().live_nodes;
+
+        // With only the top of the tree on screen, a tight budget collapses the rest
+        model.expand_visible(0, DasherModel::MAX_Y / 8);
+        model.set_memory_limits(MemoryLimits { max_nodes: full / 4, ..Default::default() });
+        let freed = model.enforce_memory_limits();
+        let stats = model.memory_stats();
+        assert!(freed > 0);
+        assert_eq!(stats.live_nodes, full - freed);
+        assert!(stats.evictions > 0);
+
+        let clock = model.memory.clock();
+        let mut pending = vec![root.clone()];
+        while let Some(node) = pending.pop() {
+            let node = node.borrow();
+            if node.last_visible() == clock && node.get_flag(NodeFlags::ALL_CHILDREN) {
+                assert!(node.child_count() > 0);
+            }
+            pending.extend(node.children().iter().cloned());
+        }
+        assert!(root.borrow().child_count() > 0);
+    }
+
+    #[test]
+    fn test_memory_limits_bound_ancestors() {
+        let mut model = DasherModel::new();
+        let mut parent = model.node_pool.acquire(0, None);
+        for _ in 0..5 {
+            let child = model.node_pool.acquire(0, None);
+            child.borrow_mut().set_parent(Rc::downgrade(&parent));
+            parent.borrow_mut().add_child(child.clone());
+            model.old_roots.push_back(parent);
+            parent = child;
+        }
+        model.root = Some(parent);
+
+        model.set_memory_limits(MemoryLimits { max_ancestors: 2, ..Default::default() });
+        assert_eq!(model.old_roots.len(), 2);
+        assert_eq!(model.memory_stats().ancestors_dropped, 3);
+        assert!(model.old_roots[0].borrow().parent().is_none());
+    }
+
+    #[test]
+    fn test_swapping_language_model_rebuilds_contexts() {
+        let trained = |text: &str| {
+            let mut language_model = ArenaPPMLanguageModel::new(PPMOrder::Three);
+            for c in text.chars() {
+                language_model.enter_symbol(c);
+            }
+            Box::new(language_model)
+        };
+        let bounds = |model: &DasherModel| -> Vec<(u32, u32)> {
+            model.root.as_ref().unwrap().borrow().children().iter()
+                .map(|child| (child.borrow().lower_bound(), child.borrow().upper_bound()))
+                .collect()
+        };
+        let start = |language_model: Box<ArenaPPMLanguageModel>| {
+            let mut model = DasherModel::new();
+            model.set_language_model(language_model);
+            let root = model.node_pool.acquire(0, None);
+            model.root = Some(root.clone());
+            model.expand_node(&root);
+            model
+        };
+
+        // Expand two levels with a large model, so the nodes hold deep cursors into it
+        let mut model = start(trained(&"the quick brown fox jumps over the lazy dog. ".repeat(50)));
+        let children: Vec<_> = model.root.as_ref().unwrap().borrow().children().to_vec();
+        for child in &children {
+            model.expand_node(child);
+        }
+
+        model.set_language_model(trained("ab"));
+        let children: Vec<_> = model.root.as_ref().unwrap().borrow().children().to_vec();
+        for child in &children {
+            model.expand_node(child);
+        }
+        assert_eq!(bounds(&model), bounds(&start(trained("ab"))));
+    }
+
+    #[test]
+    fn test_batched_zoom_steps_reach_the_same_target() {
+        let setup = || {
+            let mut model = DasherModel::new();
+            let root = model.node_pool.acquire(0, None);
+            model.expand_node(&root);
+            model.root = Some(root);
+            // The crosshair starts halfway down the root
+            model.root_min = DasherModel::ORIGIN_Y - DasherModel::MAX_Y / 2;
+            model.root_max = DasherModel::ORIGIN_Y + DasherModel::MAX_Y / 2;
+            model.schedule_zoom(DasherModel::ORIGIN_Y - DasherModel::MAX_Y / 8, DasherModel::ORIGIN_Y + DasherModel::MAX_Y / 8, 8);
+            model
+        };
+
+        let mut stepped = setup();
+        assert_eq!(stepped.scheduled_step_count(), 8);
+        while stepped.next_scheduled_step() {}
+
+        // Taking every step in one batch lands on the same range
+        let mut batched = setup();
+        assert!(batched.next_scheduled_steps(100));
+        assert_eq!(batched.scheduled_step_count(), 0);
+        assert_eq!(batched.root_range(), stepped.root_range());
+        let symbol = |model: &DasherModel| model.root.as_ref().unwrap().borrow().symbol();
+        assert_eq!(symbol(&batched), symbol(&stepped));
+        assert!((batched.total_nats - stepped.total_nats).abs() < 1e-9);
+    }
+
+    #[test]
+    fn test_batched_zoom_steps_descend_like_single_steps() {
+        // A chain of nodes whose middle child covers most of its parent
+        let setup = || {
+            let mut model = DasherModel::new();
+            let root = model.node_pool.acquire(0, None);
+            let mut parent = root.clone();
+            for (depth, symbols) in ["abc", "def", "ghi"].iter().enumerate() {
+                let bounds = [0, DasherModel::NORMALIZATION / 8, DasherModel::NORMALIZATION * 7 / 8, DasherModel::NORMALIZATION];
+                let mut middle = None;
+                for (i, symbol) in symbols.chars().enumerate() {
+                    let child = model.node_pool.acquire(depth as i32, None);
+                    {
+                        let mut child_ref = child.borrow_mut();
+                        child_ref.set_symbol(symbol);
+                        child_ref.set_bounds(bounds[i], bounds[i + 1]);
+                        child_ref.set_parent(Rc::downgrade(&parent));
+                    }
+                    parent.borrow_mut().add_child(child.clone());
+                    if i == 1 {
+                        middle = Some(child);
+                    }
+                }
+                parent.borrow_mut().set_flag(NodeFlags::ALL_CHILDREN, true);
+                parent = middle.unwrap();
+            }
+            model.root = Some(root);
+            model.root_min = DasherModel::ORIGIN_Y - DasherModel::MAX_Y / 2;
+            model.root_max = DasherModel::ORIGIN_Y + DasherModel::MAX_Y / 2;
+            model.schedule_zoom(DasherModel::ORIGIN_Y - DasherModel::MAX_Y / 16, DasherModel::ORIGIN_Y + DasherModel::MAX_Y / 16, 8);
+            model
+        };
+
+        let mut stepped = setup();
+        while stepped.next_scheduled_step() {}
+
+        let mut batched = setup();
+        assert!(batched.next_scheduled_steps(100));
+        assert_eq!(batched.scheduled_step_count(), 0);
+
+        // Both crossed every level, into the same node, without typing anything
+        let symbol = |model: &DasherModel| model.root.as_ref().unwrap().borrow().symbol();
+        assert_eq!(symbol(&stepped), Some('h'));
+        assert_eq!(symbol(&batched), Some('h'));
+        assert_eq!(batched.old_roots.len(), stepped.old_roots.len());
+        assert_eq!(batched.output_text(), stepped.output_text());
+        assert_eq!(batched.output_text(), "");
+
+        // The root range is in the new root's coordinates, up to rounding
+        let (min, max) = batched.root_range();
+        let (stepped_min, stepped_max) = stepped.root_range();
+        assert!((min - stepped_min).abs() < 64 && (max - stepped_max).abs() < 64);
+        assert!(min <= DasherModel::ORIGIN_Y && max > DasherModel::ORIGIN_Y);
+    }
+}
@@ -6,6 +6,8 @@
 use std::cell::RefCell;
 use std::rc::{Rc, Weak};
 
+use super::LanguageContext;
+
 /// Node flags representing the state of the node
 #[derive(Debug, Clone, Copy, PartialEq, Eq)]
 pub struct NodeFlags(pub u32);
@@ -76,8 +78,8 @@ pub struct DasherNode {
     /// Offset into text buffer
     offset: i32,
 
-    /// Label for the node
-    label: Option<String>,
+    /// Label for the node, shared with the alphabet symbol it came from
+    label: Option<Rc<str>>,
 
     /// Only child that was rendered (filled the screen)
     only_child_rendered: Option<Weak<RefCell<DasherNode>>>,
@@ -93,6 +95,40 @@ pub struct DasherNode {
 
     /// Speed multiplier for this node (affects how quickly the user can navigate through it)
     speed_mul: f64,
+
+    /// Language model context after this node's symbol
+    context: Option<LanguageContext>,
+
+    /// Symbol indices `first..last` this node stands in for until it is split
+    aggregate: Option<(u32, u32)>,
+
+    /// Incremented each time the node is recycled by a `NodePool`
+    generation: u32,
+
+    /// Memory governor clock when the node was last on screen, or 0
+    last_visible: u32,
+}
+
+/// Weak reference to a node that no longer resolves once the node is recycled
+#[derive(Debug, Clone)]
+pub struct NodeHandle {
+    node: Weak<RefCell<DasherNode>>,
+    generation: u32,
+}
+
+impl NodeHandle {
+    /// Create a handle to a node
+    pub fn new(node: &Rc<RefCell<DasherNode>>) -> Self {
+        Self {
+            node: Rc::downgrade(node),
+            generation: node.borrow().generation,
+        }
+    }
+
+    /// Get the node, if it is still alive and has not been recycled
+    pub fn get(&self) -> Option<Rc<RefCell<DasherNode>>> {
+        self.node.upgrade().filter(|node| node.borrow().generation == self.generation)
+    }
 }
 
 impl DasherNode {
@@ -120,6 +156,11 @@ impl DasherNode {
 
     /// Create a new Dasher node
     pub fn new(offset: i32, label: Option<String>) -> Self {
+        Self::with_shared_label(offset, label.map(Rc::from))
+    }
+
+    /// Create a new Dasher node with a label shared with other nodes
+    pub fn with_shared_label(offset: i32, label: Option<Rc<str>>) -> Self {
         Self {
             lower_bound: 0,
             upper_bound: Self::NORMALIZATION,
@@ -133,9 +174,53 @@ impl DasherNode {
             foreground_color: (0, 0, 0),
             background_color: (255, 255, 255),
             speed_mul: 1.0,
+            context: None,
+            aggregate: None,
+            generation: 0,
+            last_visible: 0,
         }
     }
 
+    /// Reset this node for reuse, keeping its child list's allocation
+    ///
+    /// Outstanding `NodeHandle`s to the node stop resolving.
+    pub(crate) fn recycle(&mut self, offset: i32, label: Option<Rc<str>>) {
+        let mut children = std::mem::take(&mut self.children);
+        children.clear();
+        let generation = self.generation.wrapping_add(1);
+
+        *self = Self::with_shared_label(offset, label);
+        self.children = children;
+        self.generation = generation;
+    }
+
+    /// Get the number of times this node has been recycled
+    pub fn generation(&self) -> u32 {
+        self.generation
+    }
+
+    /// Take the children out of this node, keeping the list's allocation
+    pub(crate) fn drain_children(&mut self) -> std::vec::Drain<'_, Rc<RefCell<DasherNode>>> {
+        self.set_flag(NodeFlags::ALL_CHILDREN, false);
+        self.only_child_rendered = None;
+        self.children.drain(..)
+    }
+
+    /// Detach this node from its parent
+    pub(crate) fn clear_parent(&mut self) {
+        self.parent = None;
+    }
+
+    /// Get the memory governor clock when the node was last on screen
+    pub fn last_visible(&self) -> u32 {
+        self.last_visible
+    }
+
+    /// Record that the node is on screen at governor clock `clock`
+    pub fn set_last_visible(&mut self, clock: u32) {
+        self.last_visible = clock;
+    }
+
     /// Get the speed multiplier for this node
     pub fn speed_mul(&self) -> f64 {
         self.speed_mul
@@ -167,6 +252,26 @@ impl DasherNode {
         self.symbol.map(|c| c as u32)
     }
 
+    /// Set the language model context after this node's symbol
+    pub fn set_context(&mut self, context: LanguageContext) {
+        self.context = Some(context);
+    }
+
+    /// Get the language model context after this node's symbol
+    pub fn context(&self) -> Option<&LanguageContext> {
+        self.context.as_ref()
+    }
+
+    /// Mark this node as standing in for the off-screen symbols `first..last`
+    pub fn set_aggregate(&mut self, first: u32, last: u32) {
+        self.aggregate = Some((first, last));
+    }
+
+    /// Get the symbol indices this node stands in for, if it is an aggregate
+    pub fn aggregate(&self) -> Option<(u32, u32)> {
+        self.aggregate
+    }
+
     /// Set the colors for this node
     pub fn set_colors(&mut self, foreground: (u8, u8, u8), background: (u8, u8, u8)) {
         self.foreground_color = foreground;
@@ -227,6 +332,11 @@ impl DasherNode {
         &self.children
     }
 
+    /// Replace the child at `index` with `children`
+    pub(crate) fn replace_child(&mut self, index: usize, children: Vec<Rc<RefCell<DasherNode>>>) {
+        self.children.splice(index..index + 1, children);
+    }
+
     /// Get the number of children
     pub fn child_count(&self) -> usize {
         self.children.len()
@@ -248,13 +358,13 @@ impl DasherNode {
     }
 
     /// Get the label
-    pub fn label(&self) -> Option<&String> {
-        self.label.as_ref()
+    pub fn label(&self) -> Option<&str> {
+        self.label.as_deref()
     }
 
     /// Get the text of this node (for FFI compatibility)
     pub fn get_text(&self) -> String {
-        self.label.clone().unwrap_or_default()
+        self.label().unwrap_or_default().to_string()
     }
 
     /// Get the depth of this node in the tree
@@ -380,6 +490,10 @@ pub fn do_action(&mut self) {
             foreground_color: self.foreground_color,
             background_color: self.background_color,
             speed_mul: self.speed_mul,
+            context: self.context.clone(),
+            aggregate: self.aggregate,
+            generation: 0,
+            last_visible: 0,
         }
     }
 }
@@ -0,0 +1,173 @@
+//! # Node Pool
+//!
+//! Recycles `DasherNode` allocations. Subtrees pruned while zooming are returned
+//! to the pool instead of being freed, and new children are taken from it, so a
+//! steady zoom reuses the same nodes and child lists instead of hitting the
+//! allocator. `NodeHandle` generations make stale references to a recycled node
+//! fail to resolve.
+
+use std::cell::RefCell;
+use std::rc::Rc;
+
+use super::node::DasherNode;
+
+/// Default number of free nodes kept for reuse
+pub const DEFAULT_POOL_CAPACITY: usize = 4096;
+
+/// Pool of reusable tree nodes
+pub struct NodePool {
+    /// Nodes ready for reuse; each is only referenced from here
+    free: Vec<Rc<RefCell<DasherNode>>>,
+
+    /// Maximum number of free nodes kept; extra nodes are dropped
+    capacity: usize,
+
+    /// Number of nodes handed out by `acquire`
+    acquired: u64,
+
+    /// Number of `acquire` calls served from the free list
+    reused: u64,
+
+    /// Scratch stack for releasing subtrees without recursion
+    pending: Vec<Rc<RefCell<DasherNode>>>,
+}
+
+impl NodePool {
+    /// Create a pool that keeps at most `capacity` free nodes
+    pub fn new(capacity: usize) -> Self {
+        Self {
+            free: Vec::with_capacity(capacity),
+            capacity,
+            acquired: 0,
+            reused: 0,
+            pending: Vec::new(),
+        }
+    }
+
+    /// Get a node, reusing a released one when available
+    pub fn acquire(&mut self, offset: i32, label: Option<Rc<str>>) -> Rc<RefCell<DasherNode>> {
+        self.acquired += 1;
+        match self.free.pop() {
+            Some(node) => {
+                self.reused += 1;
+                node.borrow_mut().recycle(offset, label);
+                node
+            }
+            None => Rc::new(RefCell::new(DasherNode::with_shared_label(offset, label))),
+        }
+    }
+
+    /// Return a node and its subtree to the pool
+    ///
+    /// Nodes still referenced elsewhere are left intact and detached from the
+    /// released parent.
+    pub fn release(&mut self, node: Rc<RefCell<DasherNode>>) {
+        self.pending.push(node);
+        self.release_pending();
+    }
+
+    /// Release all children of a node
+    pub fn release_children(&mut self, node: &Rc<RefCell<DasherNode>>) {
+        self.pending.extend(node.borrow_mut().drain_children());
+        self.release_pending();
+    }
+
+    /// Release the children of every child of `parent` except `keep`
+    pub fn release_nephews(&mut self, parent: &Rc<RefCell<DasherNode>>, keep: &Rc<RefCell<DasherNode>>) {
+        for sibling in parent.borrow().children().iter().filter(|child| !Rc::ptr_eq(child, keep)) {
+            self.pending.extend(sibling.borrow_mut().drain_children());
+        }
+        self.release_pending();
+    }
+
+    /// Detach `child` from `parent` and release all of `parent`'s other children
+    pub fn orphan_child(&mut self, parent: &Rc<RefCell<DasherNode>>, child: &Rc<RefCell<DasherNode>>) {
+        self.pending.extend(parent.borrow_mut().drain_children().filter(|node| !Rc::ptr_eq(node, child)));
+        self.release_pending();
+        child.borrow_mut().clear_parent();
+    }
+
+    /// Release every node on the pending stack and their subtrees
+    fn release_pending(&mut self) {
+        while let Some(node) = self.pending.pop() {
+            if Rc::strong_count(&node) > 1 {
+                node.borrow_mut().clear_parent();
+                continue;
+            }
+
+            let mut node_ref = node.borrow_mut();
+            self.pending.extend(node_ref.drain_children());
+            node_ref.recycle(0, None);
+            drop(node_ref);
+
+            if self.free.len() < self.capacity {
+                self.free.push(node);
+            }
+        }
+    }
+
+    /// Get the number of free nodes
+    pub fn free_count(&self) -> usize {
+        self.free.len()
+    }
+
+    /// Get the maximum number of free nodes kept
+    pub fn capacity(&self) -> usize {
+        self.capacity
+    }
+
+    /// Get the number of nodes handed out and how many of those were reused
+    pub fn stats(&self) -> (u64, u64) {
+        (self.acquired, self.reused)
+    }
+}
+
+impl Default for NodePool {
+    fn default() -> Self {
+        Self::new(DEFAULT_POOL_CAPACITY)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::model::node::NodeHandle;
+
+    #[test]
+    fn test_release_and_reuse() {
+        let mut pool = NodePool::new(8);
+        let label: Rc<str> = Rc::from("a");
+
+        let root = pool.acquire(0, None);
+        for _ in 0..3 {
+            let child = pool.acquire(1, Some(label.clone()));
+            child.borrow_mut().set_parent(Rc::downgrade(&root));
+            root.borrow_mut().add_child(child);
+        }
+        let handle = NodeHandle::new(&root.borrow().children()[0]);
+        assert!(handle.get().is_some());
+
+        pool.release_children(&root);
+        assert_eq!(pool.free_count(), 3);
+        assert_eq!(root.borrow().child_count(), 0);
+
+        // Reused nodes invalidate handles to their previous use
+        let reused = pool.acquire(1, Some(label.clone()));
+        assert_eq!(pool.stats(), (5, 1));
+        assert_eq!(reused.borrow().label(), Some("a"));
+        assert!(handle.get().is_none());
+    }
+
+    #[test]
+    fn test_shared_nodes_are_not_recycled() {
+        let mut pool = NodePool::new(8);
+        let root = pool.acquire(0, None);
+        let child = pool.acquire(1, None);
+        child.borrow_mut().set_parent(Rc::downgrade(&root));
+        root.borrow_mut().add_child(child.clone());
+
+        pool.release(root);
+        assert_eq!(pool.free_count(), 1);
+        assert!(child.borrow().parent().is_none());
+    }
+}
@@ -0,0 +1,169 @@
+//! # Output Buffer
+//!
+//! Holds the text produced by the model together with a generation counter, so
+//! hosts can borrow the text in place and fetch only what changed since the last
+//! generation they saw.
+
+use std::collections::VecDeque;
+
+/// Number of edits remembered for incremental deltas
+const HISTORY_LEN: usize = 256;
+
+/// Changes to the output since a given generation
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct OutputDelta<'a> {
+    /// Number of leading bytes of the old text that are unchanged
+    pub keep: usize,
+
+    /// Bytes to append after truncating the old text to `keep`
+    pub appended: &'a str,
+
+    /// Generation the delta brings the caller up to
+    pub generation: u64,
+
+    /// The requested generation is too old; `appended` holds the whole text
+    pub resync: bool,
+}
+
+/// Output text with change tracking
+#[derive(Debug, Default)]
+pub struct OutputBuffer {
+    /// The current text
+    text: String,
+
+    /// Incremented on every change
+    generation: u64,
+
+    /// Recent edits as (generation, length of the prefix left unchanged)
+    history: VecDeque<(u64, usize)>,
+}
+
+impl OutputBuffer {
+    /// Create a new, empty output buffer
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Get the current text
+    pub fn as_str(&self) -> &str {
+        &self.text
+    }
+
+    /// Get the current generation
+    pub fn generation(&self) -> u64 {
+        self.generation
+    }
+
+    /// Append a character
+    pub fn push(&mut self, c: char) {
+        let keep = self.text.len();
+        self.text.push(c);
+        self.record(keep);
+    }
+
+    /// Remove the last character
+    pub fn pop(&mut self) -> Option<char> {
+        let c = self.text.pop()?;
+        self.record(self.text.len());
+        Some(c)
+    }
+
+    /// Clear the text
+    pub fn clear(&mut self) {
+        if self.text.is_empty() {
+            return;
+        }
+        self.text.clear();
+        self.record(0);
+    }
+
+    /// Replace the text, recording only the part that differs
+    pub fn set(&mut self, text: &str) {
+        if self.text == text {
+            return;
+        }
+
+        let mut keep = self.text.bytes()
+            .zip(text.bytes())
+            .take_while(|(a, b)| a == b)
+            .count();
+        while !text.is_char_boundary(keep) {
+            keep -= 1;
+        }
+
+        self.text.truncate(keep);
+        self.text.push_str(&text[keep..]);
+        self.record(keep);
+    }
+
+    /// Get the changes made after `generation`
+    pub fn delta_since(&self, generation: u64) -> OutputDelta<'_> {
+        let oldest_known = self.history.front().map(|&(g, _)| g - 1).unwrap_or(self.generation);
+        if generation > self.generation || generation < oldest_known {
+            return OutputDelta {
+                keep: 0,
+                appended: &self.text,
+                generation: self.generation,
+                resync: true,
+            };
+        }
+
+        let keep = self.history.iter()
+            .filter(|&&(g, _)| g > generation)
+            .map(|&(_, keep)| keep)
+            .min()
+            .unwrap_or(self.text.len());
+
+        OutputDelta {
+            keep,
+            appended: &self.text[keep..],
+            generation: self.generation,
+            resync: false,
+        }
+    }
+
+    fn record(&mut self, keep: usize) {
+        self.generation += 1;
+        if self.history.len() == HISTORY_LEN {
+            self.history.pop_front();
+        }
+        self.history.push_back((self.generation, keep));
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_delta_since() {
+        let mut output = OutputBuffer::new();
+        output.set("hello");
+        let seen = output.generation();
+
+        output.push('!');
+        output.set("help!");
+
+        let delta = output.delta_since(seen);
+        assert!(!delta.resync);
+        assert_eq!(delta.keep, 3);
+        assert_eq!(delta.appended, "p!");
+
+        // Up to date callers get an empty delta
+        let delta = output.delta_since(output.generation());
+        assert_eq!(delta.appended, "");
+        assert_eq!(delta.keep, output.as_str().len());
+    }
+
+    #[test]
+    fn test_delta_resync_after_history_overflow() {
+        let mut output = OutputBuffer::new();
+        for _ in 0..HISTORY_LEN + 1 {
+            output.push('a');
+        }
+
+        let delta = output.delta_since(0);
+        assert!(delta.resync);
+        assert_eq!(delta.appended.len(), HISTORY_LEN + 1);
+    }
+}
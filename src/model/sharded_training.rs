@@ -0,0 +1,173 @@
+//! # Sharded Training
+//!
+//! Trains a PPM model and its training statistics from a large corpus on every
+//! core. The corpus is cut into shards at line breaks; worker threads take
+//! shards from a shared counter and train each one into their own trie and
+//! statistics, and the per-worker results are merged at the end.
+//!
+//! Shard boundaries depend only on the shard size, each shard starts from an
+//! empty context, and merged tries are renumbered breadth first, so the result
+//! is the same for any number of threads or scheduling order.
+
+use std::path::Path;
+use std::sync::atomic::{AtomicUsize, Ordering};
+use std::thread;
+
+use crate::alphabet::{TrainingError, TrainingStats};
+use super::language::{ArenaPPMLanguageModel, LanguageModel, PPMOrder, SnapshotError};
+
+/// Default shard size in bytes
+pub const DEFAULT_SHARD_BYTES: usize = 4 << 20;
+
+/// A trained model with the statistics of the text it was trained on
+#[derive(Debug)]
+pub struct TrainedCorpus {
+    /// PPM model
+    pub model: ArenaPPMLanguageModel,
+    /// Character, bigram and word counts
+    pub stats: TrainingStats,
+}
+
+impl TrainedCorpus {
+    /// Write the model and statistics as a binary snapshot
+    pub fn save_snapshot<P: AsRef<Path>>(&self, path: P) -> Result<(), SnapshotError> {
+        self.model.save_snapshot(Some(&self.stats), path)
+    }
+}
+
+/// Multi-threaded corpus trainer
+#[derive(Debug, Clone)]
+pub struct ShardedTrainer {
+    /// Order of the trained model
+    order: PPMOrder,
+
+    /// Number of worker threads
+    threads: usize,
+
+    /// Target shard size in bytes
+    shard_bytes: usize,
+}
+
+impl ShardedTrainer {
+    /// Create a trainer that uses one thread per available core
+    pub fn new(order: PPMOrder) -> Self {
+        let threads = thread::available_parallelism().map(|n| n.get()).unwrap_or(1);
+        Self { order, threads, shard_bytes: DEFAULT_SHARD_BYTES }
+    }
+
+    /// Set the number of worker threads
+    pub fn with_threads(mut self, threads: usize) -> Self {
+        self.threads = threads.max(1);
+        self
+    }
+
+    /// Set the target shard size in bytes
+    pub fn with_shard_bytes(mut self, shard_bytes: usize) -> Self {
+        self.shard_bytes = shard_bytes.max(1);
+        self
+    }
+
+    /// Train on text files
+    pub fn train_files<P: AsRef<Path>>(&self, paths: &[P]) -> Result<TrainedCorpus, TrainingError> {
+        let texts = paths.iter()
+            .map(|path| std::fs::read_to_string(path))
+            .collect::<std::io::Result<Vec<_>>>()?;
+        let texts: Vec<&str> = texts.iter().map(String::as_str).collect();
+        Ok(self.train_texts(&texts))
+    }
+
+    /// Train on texts, each of which is split into shards
+    pub fn train_texts(&self, texts: &[&str]) -> TrainedCorpus {
+        let shards: Vec<&str> = texts.iter()
+            .flat_map(|text| split_shards(text, self.shard_bytes))
+            .collect();
+        let next_shard = AtomicUsize::new(0);
+        let workers = self.threads.min(shards.len()).max(1);
+
+        let mut results: Vec<TrainedCorpus> = thread::scope(|scope| {
+            let handles: Vec<_> = (0..workers)
+                .map(|_| scope.spawn(|| {
+                    let mut corpus = TrainedCorpus {
+                        model: ArenaPPMLanguageModel::new(self.order),
+                        stats: TrainingStats::new(),
+                    };
+                    loop {
+                        let index = next_shard.fetch_add(1, Ordering::Relaxed);
+                        let shard = match shards.get(index) {
+                            Some(shard) => shard,
+                            None => break,
+                        };
+                        corpus.model.reset();
+                        for c in shard.chars() {
+                            corpus.model.enter_symbol(c);
+                        }
+                        corpus.stats.update(shard);
+                    }
+                    corpus
+                }))
+                .collect();
+            handles.into_iter()
+                .map(|handle| handle.join().expect("training worker panicked"))
+                .collect()
+        });
+
+        let mut corpus = results.swap_remove(0);
+        for other in &results {
+            corpus.model.merge(&other.model);
+            corpus.stats.merge(&other.stats);
+        }
+        corpus.model.canonicalize();
+        corpus
+    }
+}
+
+/// Split text into pieces of about `shard_bytes`, ending each piece at a line break
+fn split_shards(text: &str, shard_bytes: usize) -> Vec<&str> {
+    let mut shards = Vec::new();
+    let mut rest = text;
+    while rest.len() > shard_bytes {
+        let mut end = shard_bytes;
+        while !rest.is_char_boundary(end) {
+            end += 1;
+        }
+        let end = match rest[end..].find('\n') {
+            Some(newline) => end + newline + 1,
+            None => rest.len(),
+        };
+        let (shard, tail) = rest.split_at(end);
+        shards.push(shard);
+        rest = tail;
+    }
+    if !rest.is_empty() {
+        shards.push(rest);
+    }
+    shards
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_split_shards_at_line_breaks() {
+        let text = "one\ntwo\nthree\nfour\n";
+        let shards = split_shards(text, 5);
+        assert_eq!(shards, vec!["one\ntwo\n", "three\n", "four\n"]);
+        assert_eq!(split_shards("", 5), Vec::<&str>::new());
+    }
+
+    #[test]
+    fn test_result_is_independent_of_threads() {
+        let text = "the quick brown fox\njumps over\nthe lazy dog\n".repeat(20);
+        let single = ShardedTrainer::new(PPMOrder::Three).with_threads(1).with_shard_bytes(64).train_texts(&[&text]);
+        let multi = ShardedTrainer::new(PPMOrder::Three).with_threads(4).with_shard_bytes(64).train_texts(&[&text]);
+
+        assert_eq!(single.stats.total_chars, text.chars().count());
+        assert_eq!(single.stats.word_frequency, multi.stats.word_frequency);
+
+        let (mut a, mut b) = (Vec::new(), Vec::new());
+        single.model.write_snapshot(None, &mut a).unwrap();
+        multi.model.write_snapshot(None, &mut b).unwrap();
+        assert_eq!(a, b);
+    }
+}
@@ -0,0 +1,243 @@
+//! # Background Training
+//!
+//! Builds a language model on a worker thread so that loading a large corpus
+//! does not stall the frame loop. The worker reports progress through shared
+//! atomics and hands the finished model back over a channel; `DasherModel`
+//! polls the job between frames and swaps the new model in once it is ready.
+
+use std::path::PathBuf;
+use std::sync::atomic::{AtomicBool, AtomicU64, AtomicU8, Ordering};
+use std::sync::mpsc::{self, Receiver, TryRecvError};
+use std::sync::Arc;
+use std::thread::{self, JoinHandle};
+
+use super::language::{ArenaPPMLanguageModel, LanguageModel, PPMOrder, SnapshotLanguageModel};
+
+/// Number of characters trained between progress updates and cancellation checks
+const TRAINING_CHUNK: usize = 4096;
+
+/// A language model that can be built on another thread
+pub type SendLanguageModel = Box<dyn LanguageModel + Send>;
+
+/// Input for a background training job
+#[derive(Debug, Clone)]
+pub enum TrainingSource {
+    /// Train on text
+    Text(String),
+    /// Train on the contents of a text file
+    File(PathBuf),
+    /// Load a binary model snapshot instead of training
+    Snapshot(PathBuf),
+}
+
+/// State of a background training job
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum TrainingState {
+    /// The worker is still building the model
+    Running = 0,
+    /// The model is ready to be taken
+    Finished = 1,
+    /// Building the model failed
+    Failed = 2,
+    /// The job was cancelled
+    Cancelled = 3,
+}
+
+/// Progress shared between a job and its worker
+#[derive(Debug, Default)]
+struct Progress {
+    /// Bytes of text trained so far
+    processed: AtomicU64,
+
+    /// Bytes of text to train in total, known once every source has been read
+    total: AtomicU64,
+
+    /// Current `TrainingState`
+    state: AtomicU8,
+
+    /// Set to ask the worker to stop
+    cancel: AtomicBool,
+}
+
+/// A language model being built on a worker thread
+pub struct TrainingJob {
+    /// Progress shared with the worker
+    progress: Arc<Progress>,
+
+    /// Channel the worker sends the finished model on
+    receiver: Receiver<std::result::Result<SendLanguageModel, String>>,
+
+    /// Worker thread, joined when the job is dropped
+    handle: Option<JoinHandle<()>>,
+}
+
+impl TrainingJob {
+    /// Start building a PPM model of `order` from `sources`
+    ///
+    /// Text and file sources are trained in order into one model. If any source
+    /// is a snapshot, the last snapshot is loaded instead and the other sources
+    /// are trained into its overlay.
+    pub fn spawn(order: PPMOrder, sources: Vec<TrainingSource>) -> Self {
+        let progress = Arc::new(Progress::default());
+        let (sender, receiver) = mpsc::channel();
+
+        let worker_progress = progress.clone();
+        let handle = thread::Builder::new()
+            .name("dasher-training".to_string())
+            .spawn(move || {
+                let result = build_model(order, sources, &worker_progress);
+                let state = match &result {
+                    Ok(Some(_)) => TrainingState::Finished,
+                    Ok(None) => TrainingState::Cancelled,
+                    Err(_) => TrainingState::Failed,
+                };
+                // Publish the state first so it is current once the result arrives
+                worker_progress.state.store(state as u8, Ordering::Release);
+                if let Some(result) = result.transpose() {
+                    let _ = sender.send(result);
+                }
+            })
+            .ok();
+
+        if handle.is_none() {
+            progress.state.store(TrainingState::Failed as u8, Ordering::Release);
+        }
+
+        Self { progress, receiver, handle }
+    }
+
+    /// Get the state of the job
+    pub fn state(&self) -> TrainingState {
+        match self.progress.state.load(Ordering::Acquire) {
+            0 => TrainingState::Running,
+            1 => TrainingState::Finished,
+            2 => TrainingState::Failed,
+            _ => TrainingState::Cancelled,
+        }
+    }
+
+    /// Get the fraction of the input trained so far, from 0 to 1
+    pub fn progress(&self) -> f32 {
+        if self.state() == TrainingState::Finished {
+            return 1.0;
+        }
+        let total = self.progress.total.load(Ordering::Relaxed);
+        if total == 0 {
+            return 0.0;
+        }
+        (self.progress.processed.load(Ordering::Relaxed) as f64 / total as f64).min(1.0) as f32
+    }
+
+    /// Ask the worker to stop; no model will be delivered
+    pub fn cancel(&self) {
+        self.progress.cancel.store(true, Ordering::Relaxed);
+    }
+
+    /// Take the result if the worker has finished, without blocking
+    ///
+    /// Returns `None` while the job is running, and after the result has been taken.
+    pub fn try_take(&mut self) -> Option<std::result::Result<Box<dyn LanguageModel>, String>> {
+        match self.receiver.try_recv() {
+            Ok(result) => Some(result.map(|model| model as Box<dyn LanguageModel>)),
+            Err(TryRecvError::Empty) => None,
+            Err(TryRecvError::Disconnected) if self.state() == TrainingState::Running => {
+                Some(Err("training thread exited unexpectedly".to_string()))
+            }
+            Err(TryRecvError::Disconnected) => None,
+        }
+    }
+}
+
+impl Drop for TrainingJob {
+    fn drop(&mut self) {
+        // The worker checks the flag between chunks, so this join is short
+        self.cancel();
+        if let Some(handle) = self.handle.take() {
+            let _ = handle.join();
+        }
+    }
+}
+
+/// Build the model for a job; `Ok(None)` means the job was cancelled
+fn build_model(order: PPMOrder, sources: Vec<TrainingSource>, progress: &Progress)
+    -> std::result::Result<Option<SendLanguageModel>, String>
+{
+    let mut snapshot = None;
+    let mut texts = Vec::new();
+    for source in sources {
+        match source {
+            TrainingSource::Text(text) => texts.push(text),
+            TrainingSource::File(path) => texts.push(
+                std::fs::read_to_string(&path).map_err(|e| format!("{}: {}", path.display(), e))?
+            ),
+            TrainingSource::Snapshot(path) => snapshot = Some(
+                SnapshotLanguageModel::open(&path).map_err(|e| format!("{}: {}", path.display(), e))?
+            ),
+        }
+    }
+
+    let total: usize = texts.iter().map(|text| text.len()).sum();
+    progress.total.store(total as u64, Ordering::Relaxed);
+
+    let mut model: SendLanguageModel = match snapshot {
+        Some(snapshot) => Box::new(snapshot),
+        None => Box::new(ArenaPPMLanguageModel::new(order)),
+    };
+
+    let mut trained = 0;
+    let mut chunk = 0;
+    for text in &texts {
+        for (offset, c) in text.char_indices() {
+            model.enter_symbol(c);
+            chunk += 1;
+            if chunk == TRAINING_CHUNK {
+                chunk = 0;
+                if progress.cancel.load(Ordering::Relaxed) {
+                    return Ok(None);
+                }
+                progress.processed.store((trained + offset) as u64, Ordering::Relaxed);
+            }
+        }
+        trained += text.len();
+    }
+    progress.processed.store(trained as u64, Ordering::Relaxed);
+
+    Ok(Some(model))
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::time::{Duration, Instant};
+
+    fn wait_for(job: &mut TrainingJob) -> std::result::Result<Box<dyn LanguageModel>, String> {
+        let start = Instant::now();
+        loop {
+            if let Some(result) = job.try_take() {
+                return result;
+            }
+            assert!(start.elapsed() < Duration::from_secs(30), "training did not finish");
+            thread::sleep(Duration::from_millis(1));
+        }
+    }
+
+    #[test]
+    fn test_trains_in_background() {
+        let text = "hello help hello ".repeat(1000);
+        let mut job = TrainingJob::spawn(PPMOrder::Two, vec![TrainingSource::Text(text)]);
+        let model = wait_for(&mut job).unwrap();
+
+        assert_eq!(job.state(), TrainingState::Finished);
+        assert_eq!(job.progress(), 1.0);
+        let probs = model.get_probs("hel");
+        assert!(probs[&'l'] > probs[&'p']);
+        assert!(job.try_take().is_none());
+    }
+
+    #[test]
+    fn test_reports_missing_files() {
+        let mut job = TrainingJob::spawn(PPMOrder::Two, vec![TrainingSource::File(PathBuf::from("/nonexistent/training.txt"))]);
+        assert!(wait_for(&mut job).is_err());
+        assert_eq!(job.state(), TrainingState::Failed);
+    }
+}
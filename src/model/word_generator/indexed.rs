@@ -0,0 +1,106 @@
+//! Indexed Word Generator
+//!
+//! Serves words from an `IndexedDictionary`, reading them in place from the
+//! index bytes instead of building a `String` per word. `next_word_str` and
+//! `symbols_into` are the allocation-free forms of `next_word` and
+//! `get_symbols`.
+
+use std::path::Path;
+use std::sync::Arc;
+
+use crate::alphabet::{AlphabetInfo, AlphabetMap};
+use crate::model::language::{IndexBytes, IndexedDictionary};
+use super::{BaseWordGenerator, WordGenerator, WordGeneratorError};
+
+/// Most words `generate_words` returns, as for the other generators
+const MAX_GENERATED_WORDS: usize = 100;
+
+pub struct IndexedWordGenerator<B: AsRef<[u8]> = IndexBytes> {
+    base: BaseWordGenerator,
+    index: IndexedDictionary<B>,
+    current_index: usize,
+}
+
+impl IndexedWordGenerator<IndexBytes> {
+    /// Create a generator reading an indexed dictionary file
+    pub fn open(alphabet_info: AlphabetInfo, alphabet_map: AlphabetMap, path: impl AsRef<Path>)
+                -> Result<Self, WordGeneratorError> {
+        let bytes = std::fs::read(path)?;
+        let index = IndexedDictionary::from_bytes(IndexBytes::Shared(Arc::from(bytes)))?;
+        Ok(Self::new(alphabet_info, alphabet_map, index))
+    }
+}
+
+impl<B: AsRef<[u8]>> IndexedWordGenerator<B> {
+    /// Create a generator over `index`
+    pub fn new(alphabet_info: AlphabetInfo, alphabet_map: AlphabetMap, index: IndexedDictionary<B>) -> Self {
+        Self { base: BaseWordGenerator::new(alphabet_info, alphabet_map), index, current_index: 0 }
+    }
+
+    /// Get the index the generator reads
+    pub fn index(&self) -> &IndexedDictionary<B> {
+        &self.index
+    }
+
+    /// Get the next word in sorted order, borrowed from the index
+    pub fn next_word_str(&mut self) -> Option<&str> {
+        if self.current_index >= self.index.len() {
+            return None;
+        }
+        self.current_index += 1;
+        Some(self.index.word(self.current_index - 1))
+    }
+
+    /// Append the symbols of `word` to `symbols`
+    pub fn symbols_into(&self, word: &str, symbols: &mut Vec<u32>) {
+        self.base.symbols_into(word, symbols);
+    }
+
+    pub fn reset(&mut self) {
+        self.current_index = 0;
+    }
+}
+
+impl<B: AsRef<[u8]>> WordGenerator for IndexedWordGenerator<B> {
+    fn next_word(&mut self) -> Option<String> {
+        self.next_word_str().map(str::to_string)
+    }
+
+    fn get_symbols(&self, word: &str) -> Vec<u32> {
+        self.base.string_to_symbols(word)
+    }
+
+    fn generate_words(&mut self, context: &str) -> Vec<String> {
+        // Most frequent words starting with the context
+        self.index.top_with_prefix(context, MAX_GENERATED_WORDS)
+            .into_iter()
+            .map(|i| self.index.word(i).to_string())
+            .collect()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::model::language::write_dictionary_index;
+
+    #[test]
+    fn test_indexed_generator_reads_in_place() {
+        let mut bytes = Vec::new();
+        write_dictionary_index([("world", 0.4), ("hello", 0.5), ("help", 0.3)], &mut bytes).unwrap();
+        let index = IndexedDictionary::from_bytes(bytes).unwrap();
+        let mut gen = IndexedWordGenerator::new(AlphabetInfo::default(), AlphabetMap::default(), index);
+
+        assert_eq!(gen.next_word_str(), Some("hello"));
+        assert_eq!(gen.next_word(), Some("help".to_string()));
+        assert_eq!(gen.next_word_str(), Some("world"));
+        assert_eq!(gen.next_word_str(), None);
+        gen.reset();
+        assert_eq!(gen.next_word_str(), Some("hello"));
+
+        assert_eq!(gen.generate_words("hel"), vec!["hello".to_string(), "help".to_string()]);
+        let mut symbols = Vec::new();
+        gen.symbols_into("help", &mut symbols);
+        assert_eq!(symbols, gen.get_symbols("help"));
+    }
+}
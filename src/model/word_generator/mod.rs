@@ -4,11 +4,13 @@ use std::io;
 use crate::alphabet::AlphabetMap;
 use crate::alphabet::AlphabetInfo;
 
+mod indexed;
 mod predictive;
 mod user_dictionary;
 
+pub use indexed::IndexedWordGenerator;
 pub use predictive::PredictiveWordGenerator;
-pub use user_dictionary::UserDictionaryWordGenerator;
+pub use user_dictionary::{DictionaryCursor, UserDictionary, UserDictionaryWordGenerator};
 
 /// Trait for word generators that can provide words based on various conditions.
 ///
@@ -75,13 +77,20 @@ impl BaseWordGenerator {
     /// Convert a string to symbol indices using the alphabet map
     pub fn string_to_symbols(&self, text: &str) -> Vec<u32> {
         let mut symbols = Vec::new();
+        self.symbols_into(text, &mut symbols);
+        symbols
+    }
+
+    /// Append the symbol indices of a string to `symbols`
+    ///
+    /// Characters outside the alphabet are skipped.
+    pub fn symbols_into(&self, text: &str, symbols: &mut Vec<u32>) {
         for c in text.chars() {
             if let Some(symbol) = self.alphabet_map.char_to_index(c) {
                 // Convert from usize to u32
                 symbols.push(symbol as u32);
             }
         }
-        symbols
     }
 }
 
@@ -93,7 +102,7 @@ pub struct FileWordGenerator {
     path: Box<Path>,
     /// Whether to accept user-added words
     accept_user: bool,
-    /// Current line indices in the file
+    /// Byte offset of each line in the file
     line_indices: Vec<u64>,
     /// Current position in line_indices
     current_index: usize,
@@ -133,21 +142,28 @@ impl FileWordGenerator {
     }
 
     /// Index the file to get line positions
+    ///
+    /// `next_word` seeks to these, so they are byte offsets, not line numbers.
+    /// For large word lists an `IndexedWordGenerator` avoids the file reads.
     fn index_file(&mut self) -> Result<(), WordGeneratorError> {
         use std::io::{BufRead, BufReader};
         use std::fs::File;
 
-        let file = File::open(&self.path)?;
-        let reader = BufReader::new(file);
+        let mut reader = BufReader::new(File::open(&self.path)?);
 
         self.line_indices.clear();
         self.current_index = 0;
 
-        for (index, line) in reader.lines().enumerate() {
-            match line {
-                Ok(_) => self.line_indices.push(index as u64),
-                Err(e) => return Err(WordGeneratorError::IoError(e)),
+        let mut offset = 0u64;
+        let mut line = Vec::new();
+        loop {
+            line.clear();
+            let read = reader.read_until(b'\n', &mut line)?;
+            if read == 0 {
+                break;
             }
+            self.line_indices.push(offset);
+            offset += read as u64;
         }
 
         Ok(())
@@ -1,15 +1,233 @@
 //! User Dictionary Word Generator
+//!
+//! Words are kept in a `UserDictionary`: a character trie where each node also
+//! remembers its most frequent completions. Finding the completions of a
+//! prefix walks one edge per character and reads that list, so it costs
+//! O(prefix) whatever the size of the dictionary, and a `DictionaryCursor` can
+//! follow the user's typing one symbol at a time.
 
 use crate::alphabet::{AlphabetInfo, AlphabetMap};
 use super::{WordGenerator, WordGeneratorError, BaseWordGenerator};
+use std::cmp::Ordering;
 use std::fs::{File, OpenOptions};
 use std::io::{BufRead, BufReader, Write};
 use std::path::PathBuf;
 
+/// Number of best completions each trie node keeps
+pub const TOP_COMPLETIONS: usize = 16;
+
+/// Index of a word in the dictionary
+type WordId = u32;
+
+/// A trie node
+#[derive(Debug, Clone, Default)]
+struct TrieNode {
+    /// Child nodes, sorted by character
+    children: Vec<(char, u32)>,
+
+    /// Word ending at this node
+    word: Option<WordId>,
+
+    /// Most frequent words below this node, best first
+    top: Vec<WordId>,
+}
+
+/// Position in the dictionary after a prefix
+///
+/// A cursor past any stored word stays there, whatever is entered next.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct DictionaryCursor(u32);
+
+impl DictionaryCursor {
+    const NONE: u32 = u32::MAX;
+
+    /// Check whether any stored word starts with the prefix
+    pub fn is_valid(&self) -> bool {
+        self.0 != Self::NONE
+    }
+}
+
+/// Word list with counts, indexed for prefix completion
+#[derive(Debug, Clone)]
+pub struct UserDictionary {
+    nodes: Vec<TrieNode>,
+
+    /// Words and how often each was added
+    words: Vec<(String, u32)>,
+}
+
+impl Default for UserDictionary {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+impl UserDictionary {
+    /// Create an empty dictionary
+    pub fn new() -> Self {
+        Self { nodes: vec![TrieNode::default()], words: Vec::new() }
+    }
+
+    /// Get the number of distinct words
+    pub fn len(&self) -> usize {
+        self.words.len()
+    }
+
+    /// Check whether the dictionary has no words
+    pub fn is_empty(&self) -> bool {
+        self.words.is_empty()
+    }
+
+    /// Get the cursor for the empty prefix
+    pub fn root(&self) -> DictionaryCursor {
+        DictionaryCursor(0)
+    }
+
+    /// Move a cursor past one more character of the prefix
+    pub fn advance(&self, cursor: DictionaryCursor, c: char) -> DictionaryCursor {
+        if !cursor.is_valid() {
+            return cursor;
+        }
+        let children = &self.nodes[cursor.0 as usize].children;
+        match children.binary_search_by(|&(child, _)| child.cmp(&c)) {
+            Ok(i) => DictionaryCursor(children[i].1),
+            Err(_) => DictionaryCursor(DictionaryCursor::NONE),
+        }
+    }
+
+    /// Get the cursor after `prefix`
+    pub fn find(&self, prefix: &str) -> DictionaryCursor {
+        prefix.chars().fold(self.root(), |cursor, c| self.advance(cursor, c))
+    }
+
+    /// Get the most frequent words starting at `cursor`, best first
+    ///
+    /// Yields at most `TOP_COMPLETIONS` words.
+    pub fn top(&self, cursor: DictionaryCursor) -> impl Iterator<Item = &str> + '_ {
+        let top = if cursor.is_valid() { &self.nodes[cursor.0 as usize].top[..] } else { &[] };
+        top.iter().map(move |&id| self.words[id as usize].0.as_str())
+    }
+
+    /// Get up to `max` words starting with `prefix`, most frequent first
+    pub fn completions(&self, prefix: &str, max: usize) -> Vec<&str> {
+        let cursor = self.find(prefix);
+        if max <= TOP_COMPLETIONS || !cursor.is_valid() {
+            return self.top(cursor).take(max).collect();
+        }
+
+        // More than the cached list asks for a walk of the subtree
+        let mut ids = Vec::new();
+        let mut pending = vec![cursor.0];
+        while let Some(node) = pending.pop() {
+            let node = &self.nodes[node as usize];
+            ids.extend(node.word);
+            pending.extend(node.children.iter().map(|&(_, child)| child));
+        }
+        ids.sort_by(|&a, &b| self.rank(a, b));
+        ids.into_iter().take(max).map(|id| self.words[id as usize].0.as_str()).collect()
+    }
+
+    /// Check whether `word` is in the dictionary
+    pub fn contains(&self, word: &str) -> bool {
+        self.count(word) > 0
+    }
+
+    /// Get how often `word` was added
+    pub fn count(&self, word: &str) -> u32 {
+        let cursor = self.find(word);
+        if !cursor.is_valid() {
+            return 0;
+        }
+        self.nodes[cursor.0 as usize].word.map_or(0, |id| self.words[id as usize].1)
+    }
+
+    /// Add one use of `word`, returning its new count
+    pub fn insert(&mut self, word: &str) -> u32 {
+        self.add(word, 1)
+    }
+
+    /// Add `count` uses of `word`, returning its new count
+    pub fn add(&mut self, word: &str, count: u32) -> u32 {
+        if word.is_empty() {
+            return 0;
+        }
+
+        let mut path = Vec::with_capacity(word.len() + 1);
+        let mut node = 0u32;
+        path.push(node);
+        for c in word.chars() {
+            node = match self.nodes[node as usize].children.binary_search_by(|&(child, _)| child.cmp(&c)) {
+                Ok(i) => self.nodes[node as usize].children[i].1,
+                Err(i) => {
+                    let child = self.nodes.len() as u32;
+                    self.nodes.push(TrieNode::default());
+                    self.nodes[node as usize].children.insert(i, (c, child));
+                    child
+                }
+            };
+            path.push(node);
+        }
+
+        let id = match self.nodes[node as usize].word {
+            Some(id) => id,
+            None => {
+                let id = self.words.len() as WordId;
+                self.words.push((word.to_string(), 0));
+                self.nodes[node as usize].word = Some(id);
+                id
+            }
+        };
+        let entry = &mut self.words[id as usize];
+        entry.1 = entry.1.saturating_add(count);
+        let total = entry.1;
+
+        // Only this word's rank changed, and only upwards
+        for node in path {
+            self.promote(node, id);
+        }
+        total
+    }
+
+    /// Order two words by count, most frequent first, then by age
+    fn rank(&self, a: WordId, b: WordId) -> Ordering {
+        self.words[b as usize].1.cmp(&self.words[a as usize].1).then(a.cmp(&b))
+    }
+
+    /// Move `id` up the top list of `node` after its count increased
+    fn promote(&mut self, node: u32, id: WordId) {
+        let mut top = std::mem::take(&mut self.nodes[node as usize].top);
+        let mut pos = match top.iter().position(|&other| other == id) {
+            Some(pos) => pos,
+            None if top.len() < TOP_COMPLETIONS => {
+                top.push(id);
+                top.len() - 1
+            }
+            None if self.rank(id, top[TOP_COMPLETIONS - 1]) == Ordering::Less => {
+                top[TOP_COMPLETIONS - 1] = id;
+                TOP_COMPLETIONS - 1
+            }
+            None => {
+                self.nodes[node as usize].top = top;
+                return;
+            }
+        };
+        while pos > 0 && self.rank(top[pos], top[pos - 1]) == Ordering::Less {
+            top.swap(pos, pos - 1);
+            pos -= 1;
+        }
+        self.nodes[node as usize].top = top;
+    }
+
+    /// Iterate over the words in the order they were first added
+    pub fn words(&self) -> impl Iterator<Item = &str> + '_ {
+        self.words.iter().map(|(word, _)| word.as_str())
+    }
+}
+
 pub struct UserDictionaryWordGenerator {
     base: BaseWordGenerator,
     dict_path: PathBuf,
-    words: Vec<String>,
+    dictionary: UserDictionary,
     current_index: usize,
 }
 
@@ -18,7 +236,7 @@ impl UserDictionaryWordGenerator {
         let mut gen = Self {
             base: BaseWordGenerator::new(alphabet_info, alphabet_map),
             dict_path,
-            words: Vec::new(),
+            dictionary: UserDictionary::new(),
             current_index: 0,
         };
         gen.load_words();
@@ -26,12 +244,12 @@ impl UserDictionaryWordGenerator {
     }
 
     fn load_words(&mut self) {
-        self.words.clear();
+        self.dictionary = UserDictionary::new();
         if let Ok(file) = File::open(&self.dict_path) {
             let reader = BufReader::new(file);
             for word in reader.lines().flatten() {
                 if !word.trim().is_empty() {
-                    self.words.push(word.trim().to_string());
+                    self.dictionary.insert(word.trim());
                 }
             }
         }
@@ -40,14 +258,19 @@ impl UserDictionaryWordGenerator {
     pub fn add_word(&mut self, word: &str) -> Result<(), WordGeneratorError> {
         let word = word.trim();
         if word.is_empty() { return Ok(()); }
-        if !self.words.contains(&word.to_string()) {
-            self.words.push(word.to_string());
+        if !self.dictionary.contains(word) {
+            self.dictionary.insert(word);
             let mut file = OpenOptions::new().create(true).append(true).open(&self.dict_path)?;
             writeln!(file, "{}", word)?;
         }
         Ok(())
     }
 
+    /// Get the dictionary the generator reads
+    pub fn dictionary(&self) -> &UserDictionary {
+        &self.dictionary
+    }
+
     pub fn reset(&mut self) {
         self.current_index = 0;
     }
@@ -55,13 +278,9 @@ impl UserDictionaryWordGenerator {
 
 impl WordGenerator for UserDictionaryWordGenerator {
     fn next_word(&mut self) -> Option<String> {
-        if self.current_index < self.words.len() {
-            let word = self.words[self.current_index].clone();
-            self.current_index += 1;
-            Some(word)
-        } else {
-            None
-        }
+        let word = self.dictionary.words().nth(self.current_index)?.to_string();
+        self.current_index += 1;
+        Some(word)
     }
 
     fn get_symbols(&self, word: &str) -> Vec<u32> {
@@ -70,11 +289,7 @@ impl WordGenerator for UserDictionaryWordGenerator {
 
     fn generate_words(&mut self, context: &str) -> Vec<String> {
         // Simple context filter: return words starting with context
-        if context.is_empty() {
-            self.words.clone()
-        } else {
-            self.words.iter().filter(|w| w.starts_with(context)).cloned().collect()
-        }
+        self.dictionary.completions(context, usize::MAX).into_iter().map(str::to_string).collect()
     }
 }
 
@@ -99,4 +314,37 @@ mod tests {
         assert!(gen.generate_words("").contains(&"world".to_string()));
         assert_eq!(gen.generate_words("hel"), vec!["hello".to_string(), "help".to_string()]);
     }
+
+    #[test]
+    fn test_trie_keeps_top_completions() {
+        let mut dictionary = UserDictionary::new();
+        for (word, count) in [("help", 2), ("hello", 5), ("helm", 1), ("world", 3)] {
+            dictionary.add(word, count);
+        }
+        assert_eq!(dictionary.completions("hel", 10), vec!["hello", "help", "helm"]);
+        assert_eq!(dictionary.completions("x", 10), Vec::<&str>::new());
+        assert_eq!(dictionary.count("hel"), 0);
+
+        // Cursors follow typing a symbol at a time
+        let cursor = "he".chars().fold(dictionary.root(), |cursor, c| dictionary.advance(cursor, c));
+        assert_eq!(cursor, dictionary.find("he"));
+        assert_eq!(dictionary.top(dictionary.advance(cursor, 'l')).next(), Some("hello"));
+        assert!(!dictionary.advance(cursor, 'z').is_valid());
+
+        // A word overtaking another moves up every list on its path
+        assert_eq!(dictionary.insert("helm"), 2);
+        assert_eq!(dictionary.add("helm", 4), 6);
+        assert_eq!(dictionary.completions("", 2), vec!["helm", "hello"]);
+        assert_eq!(dictionary.completions("hel", 3), vec!["helm", "hello", "help"]);
+
+        // Lists stay bounded, and longer requests walk the subtree
+        for i in 0..TOP_COMPLETIONS * 2 {
+            dictionary.add(&format!("w{:02}", i), 10 + i as u32);
+        }
+        let top: Vec<_> = dictionary.top(dictionary.find("w")).collect();
+        assert_eq!(top.len(), TOP_COMPLETIONS);
+        assert_eq!(top[0], format!("w{:02}", TOP_COMPLETIONS * 2 - 1));
+        assert_eq!(dictionary.completions("w", usize::MAX).len(), TOP_COMPLETIONS * 2 + 1);
+        assert_eq!(dictionary.completions("w", usize::MAX).last(), Some(&"world"));
+    }
 }
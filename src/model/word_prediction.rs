@@ -1,83 +1,213 @@
+//! Word prediction for the Dasher model
+//!
+//! The manager follows the output text as it changes instead of recomputing
+//! from the whole string each time it is asked. Each entered symbol moves a
+//! cursor in the user dictionary, whose trie nodes keep their best
+//! completions, and predictions from the other generators are cached by the
+//! context the language model reads: the last few characters before the
+//! current word, plus the word so far.
+
 use std::collections::HashMap;
-use crate::model::word_generator::WordGenerator;
+use crate::model::output::OutputBuffer;
+use crate::model::word_generator::{DictionaryCursor, UserDictionary, WordGenerator};
 
 use crate::model::language::LanguageModel;
 
+/// Number of contexts whose generator predictions are kept
+const MAX_CACHED_CONTEXTS: usize = 256;
+
 /// Manages word prediction and generation for the Dasher model
 pub struct WordPredictionManager {
     /// The word generators available
     generators: Vec<Box<dyn crate::model::word_generator::WordGenerator>>,
-    /// Cache of predicted words for each context
+    /// Cache of generator predictions for each context
     prediction_cache: HashMap<String, Vec<String>>,
     /// Maximum number of predictions to cache
     max_predictions: usize,
-    /// Maximum size of context to consider
+    /// Maximum size of context to consider, in characters
     max_context_size: usize,
+    /// Words the user has written
+    dictionary: UserDictionary,
+    /// Output generation the predictions were last brought up to
+    generation: Option<u64>,
+    /// Length of the output text at that generation, in bytes
+    text_len: usize,
+    /// Current word so far
+    prefix: String,
+    /// Dictionary position after `prefix`
+    cursor: DictionaryCursor,
+    /// Predictions for the current output text
+    predictions: Vec<String>,
+}
+
+/// Check whether `c` continues a word
+fn is_word_char(c: char) -> bool {
+    c.is_alphanumeric() || c == '\''
+}
+
+/// Get the word the text ends with, if any
+fn trailing_word(text: &str) -> &str {
+    let start = text
+        .char_indices()
+        .rev()
+        .take_while(|&(_, c)| is_word_char(c))
+        .last()
+        .map_or(text.len(), |(i, _)| i);
+    &text[start..]
+}
+
+/// Get the cache key for `text`: up to `max_chars` characters before the last word, then the word
+fn context_key(text: &str, max_chars: usize) -> &str {
+    let word_start = text.len() - trailing_word(text).len();
+    let start = text[..word_start]
+        .char_indices()
+        .rev()
+        .take(max_chars)
+        .last()
+        .map_or(word_start, |(i, _)| i);
+    &text[start..]
 }
 
 impl WordPredictionManager {
     /// Create a new word prediction manager
     pub fn new(max_predictions: usize, max_context_size: usize) -> Self {
+        let dictionary = UserDictionary::new();
         Self {
             generators: Vec::new(),
             prediction_cache: HashMap::new(),
             max_predictions,
             max_context_size,
+            cursor: dictionary.root(),
+            dictionary,
+            generation: None,
+            text_len: 0,
+            prefix: String::new(),
+            predictions: Vec::new(),
         }
     }
 
     /// Add a word generator
     pub fn add_generator(&mut self, generator: Box<dyn WordGenerator>) {
         self.generators.push(generator);
+        self.clear_cache();
+    }
+
+    /// Get the dictionary of words the user has written
+    pub fn dictionary(&self) -> &UserDictionary {
+        &self.dictionary
+    }
+
+    /// Get a mutable reference to the dictionary, for seeding it with known words
+    pub fn dictionary_mut(&mut self) -> &mut UserDictionary {
+        self.generation = None;
+        &mut self.dictionary
     }
 
     /// Get predictions for the current context
     pub fn get_predictions(&mut self, context: &str) -> Vec<String> {
-        // Use the context as the cache key
-        let cache_key = context.to_string();
-        
-        // Return cached predictions if available
-        if let Some(predictions) = self.prediction_cache.get(&cache_key) {
-            return predictions.clone();
-        }
+        let cursor = self.dictionary.find(trailing_word(context));
+        self.predict(context, cursor)
+    }
 
-        // Generate new predictions
-        let mut predictions = Vec::new();
-        
-        // Get predictions from all generators
-        for generator in &mut self.generators {
-            let words = generator.generate_words(context);
-            for word in words {
-                if !predictions.contains(&word) {
-                    predictions.push(word);
-                    if predictions.len() >= self.max_predictions {
-                        break;
+    /// Bring the predictions up to date with the output text
+    ///
+    /// Appended symbols are entered one at a time, and a completed word is
+    /// added to the dictionary. Anything else, such as a deletion, finds the
+    /// current word again from the text without relearning it.
+    pub fn sync(&mut self, output: &OutputBuffer) -> &[String] {
+        let text = output.as_str();
+        match self.generation {
+            Some(generation) if generation == output.generation() => return &self.predictions,
+            Some(generation) => {
+                let delta = output.delta_since(generation);
+                if !delta.resync && delta.keep == self.text_len {
+                    for c in delta.appended.chars() {
+                        self.enter_symbol(c);
                     }
+                } else {
+                    self.resync(text);
                 }
             }
+            None => self.resync(text),
         }
+        self.generation = Some(output.generation());
+        self.text_len = text.len();
+        self.predictions = self.predict(text, self.cursor);
+        &self.predictions
+    }
 
-        // Cache the predictions
-        self.prediction_cache.insert(cache_key, predictions.clone());
-        
-        predictions
+    /// Get the predictions from the last `sync`
+    pub fn predictions(&self) -> &[String] {
+        &self.predictions
     }
 
     /// Clear the prediction cache
     pub fn clear_cache(&mut self) {
         self.prediction_cache.clear();
+        self.generation = None;
     }
 
     /// Update the context and get new predictions
     pub fn update_context(&mut self, context: &str) -> Vec<String> {
-        // Take only the last max_context_size words
-        let context = if context.len() > self.max_context_size {
-            &context[context.len() - self.max_context_size..]
-        } else {
-            context
-        };
-
-        self.get_predictions(context)
+        self.get_predictions(context_key(context, self.max_context_size))
+    }
+
+    fn enter_symbol(&mut self, c: char) {
+        if is_word_char(c) {
+            self.prefix.push(c);
+            self.cursor = self.dictionary.advance(self.cursor, c);
+        } else if !self.prefix.is_empty() {
+            self.dictionary.insert(&self.prefix);
+            self.prefix.clear();
+            self.cursor = self.dictionary.root();
+        }
+    }
+
+    fn resync(&mut self, text: &str) {
+        self.prefix.clear();
+        self.prefix.push_str(trailing_word(text));
+        self.cursor = self.dictionary.find(&self.prefix);
+    }
+
+    /// Combine dictionary completions at `cursor` with cached generator predictions for `text`
+    fn predict(&mut self, text: &str, cursor: DictionaryCursor) -> Vec<String> {
+        let key = context_key(text, self.max_context_size);
+        let mut predictions: Vec<String> = self.dictionary
+            .top(cursor)
+            .take(self.max_predictions)
+            .map(str::to_string)
+            .collect();
+        if predictions.len() >= self.max_predictions || self.generators.is_empty() {
+            return predictions;
+        }
+
+        if !self.prediction_cache.contains_key(key) {
+            let mut generated = Vec::new();
+            for generator in &mut self.generators {
+                for word in generator.generate_words(key) {
+                    if !generated.contains(&word) {
+                        generated.push(word);
+                        if generated.len() >= self.max_predictions {
+                            break;
+                        }
+                    }
+                }
+            }
+            if self.prediction_cache.len() >= MAX_CACHED_CONTEXTS {
+                self.prediction_cache.clear();
+            }
+            self.prediction_cache.insert(key.to_string(), generated);
+        }
+
+        for word in &self.prediction_cache[key] {
+            if predictions.len() >= self.max_predictions {
+                break;
+            }
+            if !predictions.contains(word) {
+                predictions.push(word.clone());
+            }
+        }
+        predictions
     }
 }
 
@@ -129,4 +259,31 @@ mod tests {
         assert!(predictions.contains(&"t".to_string()));
         assert!(predictions.contains(&"w".to_string()));
     }
+
+    #[test]
+    fn test_predictions_follow_output() {
+        let mut manager = WordPredictionManager::new(3, 4);
+        manager.dictionary_mut().add("world", 2);
+
+        let mut output = OutputBuffer::new();
+        for c in "hello wo".chars() {
+            output.push(c);
+            manager.sync(&output);
+        }
+        assert_eq!(manager.predictions(), ["world".to_string()]);
+
+        // The finished word was learned once, and deleting back into it finds it again
+        output.push(' ');
+        manager.sync(&output);
+        assert_eq!(manager.dictionary().count("hello"), 1);
+        assert_eq!(manager.dictionary().count("wo"), 1);
+        output.set("hello wo");
+        output.set("hel");
+        assert_eq!(manager.sync(&output), ["hello".to_string()]);
+        assert_eq!(manager.dictionary().count("hello"), 1);
+
+        assert_eq!(context_key("to be or no", 4), " or no");
+        assert_eq!(trailing_word("it's"), "it's");
+        assert_eq!(trailing_word("end. "), "");
+    }
 }
@@ -0,0 +1,119 @@
+//! # Zoom Trajectory
+//!
+//! Scheduled root movements, stored as a curve rather than a queue of points.
+//! A trajectory is a start and end range for the root and, for each step, the
+//! fraction of the way from one to the other. Steps are interpolated when they
+//! are taken.
+//!
+//! Rebasing the root (`make_root`, `reparent_root`) maps every scheduled range
+//! through the same linear function of its bounds. Interpolation commutes with
+//! that map, so only the two ends are rebased, however many steps remain.
+
+/// Root movements still to be taken, in order
+#[derive(Debug, Clone, Default)]
+pub struct ZoomTrajectory {
+    /// Root range the fractions start from
+    start: (i64, i64),
+
+    /// Root range at a fraction of 1
+    end: (i64, i64),
+
+    /// Fraction of the way from `start` to `end` after each step
+    fractions: Vec<f64>,
+
+    /// Index of the next step in `fractions`
+    next: usize,
+}
+
+impl ZoomTrajectory {
+    /// Create an empty trajectory
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Get the number of steps still to be taken
+    pub fn len(&self) -> usize {
+        self.fractions.len() - self.next
+    }
+
+    /// Check whether no steps are left
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+
+    /// Remove all steps, keeping the allocation
+    pub fn clear(&mut self) {
+        self.fractions.clear();
+        self.next = 0;
+    }
+
+    /// Replace the steps with a single move to `target`
+    pub fn set_target(&mut self, target: (i64, i64)) {
+        self.set_curve(target, target, [1.0]);
+    }
+
+    /// Replace the steps with moves from `start` towards `end`, one per fraction
+    pub fn set_curve(&mut self, start: (i64, i64), end: (i64, i64), fractions: impl IntoIterator<Item = f64>) {
+        self.clear();
+        self.start = start;
+        self.end = end;
+        self.fractions.extend(fractions);
+    }
+
+    /// Get the root range after the `i`th of the remaining steps
+    pub fn get(&self, i: usize) -> Option<(i64, i64)> {
+        self.fractions.get(self.next + i).map(|&fraction| self.interpolate(fraction))
+    }
+
+    /// Take the next step
+    pub fn pop_front(&mut self) -> Option<(i64, i64)> {
+        let point = self.get(0)?;
+        self.next += 1;
+        Some(point)
+    }
+
+    /// Skip up to `count` steps, always leaving the last one; returns the number skipped
+    pub fn skip(&mut self, count: usize) -> usize {
+        let skipped = count.min(self.len().saturating_sub(1));
+        self.next += skipped;
+        skipped
+    }
+
+    /// Map the remaining steps through `rebase`, a linear function of a root range
+    pub fn rebase(&mut self, mut rebase: impl FnMut((i64, i64)) -> (i64, i64)) {
+        if self.is_empty() {
+            return;
+        }
+        self.start = rebase(self.start);
+        self.end = rebase(self.end);
+    }
+
+    #[inline]
+    fn interpolate(&self, fraction: f64) -> (i64, i64) {
+        (self.start.0 + (fraction * (self.end.0 - self.start.0) as f64) as i64,
+         self.start.1 + (fraction * (self.end.1 - self.start.1) as f64) as i64)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_rebasing_ends_matches_rebasing_points() {
+        let mut trajectory = ZoomTrajectory::new();
+        trajectory.set_curve((0, 4096), (-4096, 8192), [0.25, 0.5, 1.0]);
+        assert_eq!(trajectory.len(), 3);
+
+        let shift = |(min, max): (i64, i64)| (min * 2 - 100, max * 2 - 100);
+        let expected: Vec<_> = (0..3).map(|i| shift(trajectory.get(i).unwrap())).collect();
+        trajectory.rebase(shift);
+        assert_eq!((0..3).map(|i| trajectory.get(i).unwrap()).collect::<Vec<_>>(), expected);
+
+        // Skipping always leaves the final step
+        assert_eq!(trajectory.skip(10), 2);
+        assert_eq!(trajectory.pop_front(), Some(expected[2]));
+        assert!(trajectory.is_empty());
+        assert_eq!(trajectory.pop_front(), None);
+    }
+}
@@ -0,0 +1,359 @@
+//! # Draw Command Buffer
+//!
+//! A compact, caller-owned list of draw commands produced by a single render pass.
+//!
+//! Instead of crossing the FFI boundary once per primitive, the view records every
+//! rectangle, circle, line, polygon and string into a `DrawCommandBuffer`, which the
+//! host replays in one loop. The buffer keeps its allocations between frames, so a
+//! steady-state frame does not allocate.
+
+use crate::view::{Color, DasherScreen, Label};
+
+/// Kind of a recorded draw command
+#[repr(C)]
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum DrawCommandKind {
+    /// Rectangle from (`x1`, `y1`) to (`x2`, `y2`)
+    Rectangle = 0,
+    /// Circle centred on (`x1`, `y1`) with radius `x2`
+    Circle = 1,
+    /// Line from (`x1`, `y1`) to (`x2`, `y2`)
+    Line = 2,
+    /// Polygon whose points are `points[data_offset..data_offset + data_len]`
+    Polygon = 3,
+    /// String at (`x1`, `y1`) whose UTF-8 bytes are `text[data_offset..data_offset + data_len]`
+    String = 4,
+}
+
+/// A single draw command
+///
+/// Colors are packed with `Color::to_packed`, so they can be handed to ImGui as-is.
+/// Lines and strings only use `fill_color`.
+#[repr(C)]
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub struct DrawCommand {
+    /// What to draw
+    pub kind: DrawCommandKind,
+    pub x1: i32,
+    pub y1: i32,
+    pub x2: i32,
+    pub y2: i32,
+    /// Fill color (or line/text color)
+    pub fill_color: u32,
+    /// Outline color
+    pub outline_color: u32,
+    /// Line width in pixels
+    pub line_width: i32,
+    /// Font size for strings
+    pub font_size: u32,
+    /// Offset into the point or text array
+    pub data_offset: u32,
+    /// Number of points or text bytes
+    pub data_len: u32,
+    /// Id of the cached label drawn by a string command, or 0
+    ///
+    /// Stable for as long as the view keeps the label cached, so hosts can key
+    /// pre-rasterised text on it instead of the string.
+    pub label_id: u32,
+}
+
+/// A polygon vertex in screen coordinates
+#[repr(C)]
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct DrawPoint {
+    pub x: i32,
+    pub y: i32,
+}
+
+/// Position in a draw command buffer, for cutting it back to an earlier length
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct DrawBufferMark {
+    commands: usize,
+    points: usize,
+    text: usize,
+}
+
+/// Reusable buffer of draw commands for one frame
+#[derive(Debug, Default)]
+pub struct DrawCommandBuffer {
+    /// Recorded commands, in painting order
+    commands: Vec<DrawCommand>,
+
+    /// Vertices referenced by polygon commands
+    points: Vec<DrawPoint>,
+
+    /// UTF-8 text referenced by string commands, each string null-terminated
+    text: Vec<u8>,
+}
+
+impl DrawCommandBuffer {
+    /// Create a new, empty draw command buffer
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Remove all commands, keeping the allocated capacity
+    pub fn clear(&mut self) {
+        self.commands.clear();
+        self.points.clear();
+        self.text.clear();
+    }
+
+    /// Get the current end of the buffer
+    pub fn mark(&self) -> DrawBufferMark {
+        DrawBufferMark {
+            commands: self.commands.len(),
+            points: self.points.len(),
+            text: self.text.len(),
+        }
+    }
+
+    /// Drop everything recorded after `mark`
+    pub fn truncate(&mut self, mark: DrawBufferMark) {
+        self.commands.truncate(mark.commands);
+        self.points.truncate(mark.points);
+        self.text.truncate(mark.text);
+    }
+
+    /// Get the recorded commands
+    pub fn commands(&self) -> &[DrawCommand] {
+        &self.commands
+    }
+
+    /// Get the polygon vertices
+    pub fn points(&self) -> &[DrawPoint] {
+        &self.points
+    }
+
+    /// Get the string data
+    pub fn text(&self) -> &[u8] {
+        &self.text
+    }
+
+    /// Get the number of recorded commands
+    pub fn len(&self) -> usize {
+        self.commands.len()
+    }
+
+    /// Check whether the buffer holds no commands
+    pub fn is_empty(&self) -> bool {
+        self.commands.is_empty()
+    }
+
+    /// Get the points of a polygon command
+    pub fn polygon_points(&self, command: &DrawCommand) -> &[DrawPoint] {
+        let start = command.data_offset as usize;
+        &self.points[start..start + command.data_len as usize]
+    }
+
+    /// Get the text of a string command
+    pub fn string_text(&self, command: &DrawCommand) -> &str {
+        let start = command.data_offset as usize;
+        let bytes = &self.text[start..start + command.data_len as usize];
+        std::str::from_utf8(bytes).unwrap_or("")
+    }
+
+    fn push(&mut self, kind: DrawCommandKind, coords: (i32, i32, i32, i32),
+            fill_color: Color, outline_color: Color, line_width: i32) {
+        self.commands.push(DrawCommand {
+            kind,
+            x1: coords.0,
+            y1: coords.1,
+            x2: coords.2,
+            y2: coords.3,
+            fill_color: fill_color.to_packed(),
+            outline_color: outline_color.to_packed(),
+            line_width,
+            font_size: 0,
+            data_offset: 0,
+            data_len: 0,
+            label_id: 0,
+        });
+    }
+
+    /// Record a rectangle
+    pub fn push_rectangle(&mut self, x1: i32, y1: i32, x2: i32, y2: i32,
+                          fill_color: Color, outline_color: Color, line_width: i32) {
+        self.push(DrawCommandKind::Rectangle, (x1, y1, x2, y2), fill_color, outline_color, line_width);
+    }
+
+    /// Record a circle
+    pub fn push_circle(&mut self, cx: i32, cy: i32, r: i32,
+                       fill_color: Color, line_color: Color, line_width: i32) {
+        self.push(DrawCommandKind::Circle, (cx, cy, r, 0), fill_color, line_color, line_width);
+    }
+
+    /// Record a line
+    pub fn push_line(&mut self, x1: i32, y1: i32, x2: i32, y2: i32, color: Color, line_width: i32) {
+        self.push(DrawCommandKind::Line, (x1, y1, x2, y2), color, color, line_width);
+    }
+
+    /// Record a polygon
+    pub fn push_polygon(&mut self, points: &[(i32, i32)], fill_color: Color, outline_color: Color, line_width: i32) {
+        let offset = self.points.len() as u32;
+        self.points.extend(points.iter().map(|&(x, y)| DrawPoint { x, y }));
+
+        self.push(DrawCommandKind::Polygon, (0, 0, 0, 0), fill_color, outline_color, line_width);
+        if let Some(command) = self.commands.last_mut() {
+            command.data_offset = offset;
+            command.data_len = points.len() as u32;
+        }
+    }
+
+    /// Record a string
+    pub fn push_string(&mut self, text: &str, x: i32, y: i32, font_size: u32, color: Color) {
+        let offset = self.text.len() as u32;
+        self.text.extend_from_slice(text.as_bytes());
+        self.text.push(0);
+
+        self.push(DrawCommandKind::String, (x, y, 0, 0), color, color, 0);
+        if let Some(command) = self.commands.last_mut() {
+            command.font_size = font_size;
+            command.data_offset = offset;
+            command.data_len = text.len() as u32;
+        }
+    }
+
+    /// Record a string for a label, keeping its cache id
+    pub fn push_label(&mut self, label: &dyn Label, x: i32, y: i32, font_size: u32, color: Color) {
+        self.push_string(label.get_text(), x, y, font_size, color);
+        if let Some(command) = self.commands.last_mut() {
+            command.label_id = label.id();
+        }
+    }
+}
+
+/// Screen that records draw calls into a `DrawCommandBuffer`
+///
+/// Text measurement stays with the host screen; this screen only receives the
+/// drawing calls of a frame.
+pub(crate) struct RecordingScreen {
+    width: i32,
+    height: i32,
+    buffer: DrawCommandBuffer,
+}
+
+impl RecordingScreen {
+    /// Create a recording screen that appends to `buffer`
+    pub(crate) fn new(width: i32, height: i32, buffer: DrawCommandBuffer) -> Self {
+        Self { width, height, buffer }
+    }
+
+    /// Hand back the recorded buffer
+    pub(crate) fn into_buffer(self) -> DrawCommandBuffer {
+        self.buffer
+    }
+
+    /// Get the buffer being recorded into
+    pub(crate) fn buffer(&self) -> &DrawCommandBuffer {
+        &self.buffer
+    }
+
+    /// Get the buffer being recorded into, for editing
+    pub(crate) fn buffer_mut(&mut self) -> &mut DrawCommandBuffer {
+        &mut self.buffer
+    }
+}
+
+/// Label used by the recording screen
+struct RecordedLabel {
+    text: String,
+    wrap_size: u32,
+}
+
+impl Label for RecordedLabel {
+    fn get_text(&self) -> &str {
+        &self.text
+    }
+
+    fn get_wrap_size(&self) -> u32 {
+        self.wrap_size
+    }
+}
+
+impl DasherScreen for RecordingScreen {
+    fn get_width(&self) -> i32 {
+        self.width
+    }
+
+    fn get_height(&self) -> i32 {
+        self.height
+    }
+
+    fn make_label(&self, text: &str, wrap_size: u32) -> Box<dyn Label> {
+        Box::new(RecordedLabel { text: text.to_string(), wrap_size })
+    }
+
+    fn text_size(&self, label: &dyn Label, font_size: u32) -> (i32, i32) {
+        // The view measures labels with the host screen; this is only a fallback.
+        // Count characters rather than UTF-8 bytes so non-Latin labels are not overestimated.
+        let char_width = (font_size / 2) as i32;
+        (label.get_text().chars().count() as i32 * char_width, font_size as i32)
+    }
+
+    fn draw_string(&mut self, label: &dyn Label, x: i32, y: i32, font_size: u32, color: Color) {
+        self.buffer.push_label(label, x, y, font_size, color);
+    }
+
+    fn draw_rectangle(&mut self, x1: i32, y1: i32, x2: i32, y2: i32,
+                     fill_color: Color, outline_color: Color, line_width: i32) {
+        self.buffer.push_rectangle(x1, y1, x2, y2, fill_color, outline_color, line_width);
+    }
+
+    fn draw_circle(&mut self, cx: i32, cy: i32, r: i32,
+                  fill_color: Color, line_color: Color, line_width: i32) {
+        self.buffer.push_circle(cx, cy, r, fill_color, line_color, line_width);
+    }
+
+    fn draw_line(&mut self, x1: i32, y1: i32, x2: i32, y2: i32, color: Color, line_width: i32) {
+        self.buffer.push_line(x1, y1, x2, y2, color, line_width);
+    }
+
+    fn draw_polygon(&mut self, points: &[(i32, i32)], fill_color: Color, outline_color: Color, line_width: i32) {
+        if points.len() < 3 {
+            return;
+        }
+        self.buffer.push_polygon(points, fill_color, outline_color, line_width);
+    }
+
+    fn display(&mut self) {
+        // The host presents the frame once it has replayed the buffer
+    }
+
+    fn is_point_visible(&self, _x: i32, _y: i32) -> bool {
+        true
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::view::color_palette;
+
+    #[test]
+    fn test_push_and_clear() {
+        let mut buffer = DrawCommandBuffer::new();
+        buffer.push_rectangle(0, 0, 10, 10, color_palette::WHITE, color_palette::BLACK, 1);
+        buffer.push_polygon(&[(0, 0), (5, 5), (0, 10)], color_palette::RED, color_palette::BLACK, 1);
+        buffer.push_string("abc", 3, 4, 12, color_palette::BLUE);
+
+        assert_eq!(buffer.len(), 3);
+        assert_eq!(buffer.polygon_points(&buffer.commands()[1]).len(), 3);
+        assert_eq!(buffer.string_text(&buffer.commands()[2]), "abc");
+        assert_eq!(buffer.text(), b"abc\0");
+        assert_eq!(buffer.commands()[0].fill_color, color_palette::WHITE.to_packed());
+
+        let capacity = buffer.commands.capacity();
+        buffer.clear();
+        assert!(buffer.is_empty());
+        assert!(buffer.points().is_empty());
+        assert_eq!(buffer.commands.capacity(), capacity);
+    }
+
+    #[test]
+    fn test_recording_screen_measures_characters() {
+        let screen = RecordingScreen::new(640, 480, DrawCommandBuffer::new());
+        let label = screen.make_label("αβγ", 0);
+        assert_eq!(screen.text_size(label.as_ref(), 20), (30, 20));
+    }
+}
@@ -0,0 +1,182 @@
+//! # Label Cache
+//!
+//! Keeps the labels a view creates, and the text sizes measured for them, across
+//! frames. A node label is made once through `DasherScreen::make_label` and
+//! measured once per font size; later frames reuse both without calling back into
+//! the host. Each cached label has a stable id that hosts can use to key their own
+//! rasterised-text cache (see `DrawCommand::label_id`).
+
+use std::collections::HashMap;
+use std::rc::Rc;
+
+use crate::view::{DasherScreen, Label};
+
+/// Number of entries above which unused labels are evicted
+pub const DEFAULT_LABEL_CACHE_CAPACITY: usize = 1024;
+
+/// Frames a label may go unused before it can be evicted
+const EVICT_AFTER_FRAMES: u64 = 120;
+
+/// Most font sizes remembered per label; older sizes are replaced first
+const MAX_SIZES_PER_LABEL: usize = 8;
+
+/// A host label together with its cache id
+pub struct CachedLabel {
+    inner: Box<dyn Label>,
+    id: u32,
+}
+
+impl Label for CachedLabel {
+    fn get_text(&self) -> &str {
+        self.inner.get_text()
+    }
+
+    fn get_wrap_size(&self) -> u32 {
+        self.inner.get_wrap_size()
+    }
+
+    fn id(&self) -> u32 {
+        self.id
+    }
+}
+
+/// A cache entry
+struct Entry {
+    label: Rc<CachedLabel>,
+
+    /// Measured (font size, (width, height)) pairs, oldest first
+    sizes: Vec<(u32, (i32, i32))>,
+
+    /// Frame in which the entry was last used
+    last_used: u64,
+}
+
+/// Cache of labels and their measured sizes, keyed by text
+pub struct LabelCache {
+    entries: HashMap<String, Entry>,
+    capacity: usize,
+    frame: u64,
+    next_id: u32,
+    misses: u64,
+}
+
+impl LabelCache {
+    /// Create a cache that starts evicting above `capacity` entries
+    pub fn new(capacity: usize) -> Self {
+        Self {
+            entries: HashMap::new(),
+            capacity,
+            frame: 0,
+            next_id: 1,
+            misses: 0,
+        }
+    }
+
+    /// Start a new frame, evicting labels that have gone unused if the cache is full
+    pub fn begin_frame(&mut self) {
+        self.frame += 1;
+        if self.entries.len() > self.capacity {
+            let frame = self.frame;
+            self.entries.retain(|_, entry| frame - entry.last_used <= EVICT_AFTER_FRAMES);
+        }
+    }
+
+    /// Get the label for `text`, creating it through `screen` on first use
+    pub fn label(&mut self, screen: &dyn DasherScreen, text: &str) -> Rc<CachedLabel> {
+        let frame = self.frame;
+        if let Some(entry) = self.entries.get_mut(text) {
+            entry.last_used = frame;
+            return entry.label.clone();
+        }
+
+        self.misses += 1;
+        let label = Rc::new(CachedLabel {
+            inner: screen.make_label(text, 0),
+            id: self.next_id,
+        });
+        self.next_id = self.next_id.wrapping_add(1).max(1);
+
+        self.entries.insert(text.to_string(), Entry {
+            label: label.clone(),
+            sizes: Vec::new(),
+            last_used: frame,
+        });
+        label
+    }
+
+    /// Get the size of a label at `font_size`, measuring it through `screen` on first use
+    pub fn text_size(&mut self, screen: &dyn DasherScreen, label: &CachedLabel, font_size: u32) -> (i32, i32) {
+        let entry = match self.entries.get_mut(label.get_text()) {
+            Some(entry) if entry.label.id == label.id => entry,
+            _ => return screen.text_size(label, font_size),
+        };
+
+        if let Some(&(_, size)) = entry.sizes.iter().find(|(s, _)| *s == font_size) {
+            return size;
+        }
+
+        let size = screen.text_size(label, font_size);
+        if entry.sizes.len() == MAX_SIZES_PER_LABEL {
+            entry.sizes.remove(0);
+        }
+        entry.sizes.push((font_size, size));
+        size
+    }
+
+    /// Forget all labels, e.g. after the screen changes
+    pub fn clear(&mut self) {
+        self.entries.clear();
+    }
+
+    /// Get the number of cached labels
+    pub fn len(&self) -> usize {
+        self.entries.len()
+    }
+
+    /// Check whether the cache is empty
+    pub fn is_empty(&self) -> bool {
+        self.entries.is_empty()
+    }
+
+    /// Get the number of labels created because they were not cached
+    pub fn misses(&self) -> u64 {
+        self.misses
+    }
+}
+
+impl Default for LabelCache {
+    fn default() -> Self {
+        Self::new(DEFAULT_LABEL_CACHE_CAPACITY)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::view::draw_buffer::{DrawCommandBuffer, RecordingScreen};
+
+    #[test]
+    fn test_labels_and_sizes_are_reused() {
+        let screen = RecordingScreen::new(100, 100, DrawCommandBuffer::new());
+        let mut cache = LabelCache::new(4);
+
+        cache.begin_frame();
+        let a = cache.label(&screen, "a");
+        let size = cache.text_size(&screen, &a, 12);
+        let again = cache.label(&screen, "a");
+        assert_eq!(a.id(), again.id());
+        assert_eq!(cache.text_size(&screen, &again, 12), size);
+        assert_eq!(cache.misses(), 1);
+
+        // Unused labels are evicted once the cache is over capacity
+        for i in 0..5 {
+            cache.label(&screen, &i.to_string());
+        }
+        for _ in 0..=EVICT_AFTER_FRAMES {
+            cache.begin_frame();
+        }
+        cache.begin_frame();
+        assert!(cache.is_empty());
+        assert_ne!(cache.label(&screen, "a").id(), a.id());
+    }
+}
@@ -4,12 +4,22 @@
 //! responsible for rendering the Dasher interface.
 
 pub mod square;
+pub mod draw_buffer;
+pub mod label_cache;
+pub mod nonlinear;
+pub mod retained;
+pub mod vertex_buffer;
 #[cfg(test)]
 mod square_tests;
 
 pub use square::DasherViewSquare;
 pub use square::NodeShape;
 pub use square::SquareViewConfig;
+pub use square::RenderStats;
+pub use draw_buffer::{DrawBufferMark, DrawCommand, DrawCommandBuffer, DrawCommandKind, DrawPoint};
+pub use retained::FrameChange;
+pub use vertex_buffer::{LabelInstance, Vertex, VertexBuffer};
+pub use label_cache::LabelCache;
 
 use crate::DasherInput;
 use crate::model::DasherModel;
@@ -40,6 +50,11 @@ impl Color {
         Self { r: rgba.0, g: rgba.1, b: rgba.2, a: rgba.3 }
     }
 
+    /// Pack into a 32-bit value with red in the low byte (ImGui `IM_COL32` layout)
+    pub fn to_packed(&self) -> u32 {
+        (self.a as u32) << 24 | (self.b as u32) << 16 | (self.g as u32) << 8 | self.r as u32
+    }
+
     /// Convert to CSS color string (for web rendering)
     pub fn to_css_string(&self) -> String {
         format!("rgba({}, {}, {}, {})", self.r, self.g, self.b, self.a as f32 / 255.0)
@@ -71,6 +86,11 @@ pub trait Label {
 
     /// Get the wrap size of the label
     fn get_wrap_size(&self) -> u32;
+
+    /// Get the id the view's label cache gave this label, or 0 if it is not cached
+    fn id(&self) -> u32 {
+        0
+    }
 }
 
 /// Abstract interface for drawing operations, implemented by platform-specific canvases.
@@ -0,0 +1,248 @@
+//! # Nonlinear Coordinate Maps
+//!
+//! The square view stretches Dasher X exponentially past a threshold and Y
+//! piecewise linearly around the crosshair. Evaluating `exp`/`ln` for every
+//! node edge is a large part of render time, so the X curve is sampled into a
+//! table once per resize or configuration change and interpolated linearly.
+//! The inverse searches the same table, and coordinates beyond it fall back to
+//! the exact formula. The Y map is
+//! piecewise linear already and only needs its gradients precomputed.
+
+use crate::model::DasherModel;
+
+/// Log2 of the sampled span of the X curve, in Dasher units past the threshold
+///
+/// This covers screen-space X far beyond the right edge of any screen.
+const FORWARD_SPAN_LOG2: u32 = 21;
+
+/// Log2 of the number of intervals in the table
+const TABLE_INTERVALS_LOG2: u32 = 12;
+
+/// Parameters the maps are built from
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub struct MapParams {
+    /// Screen-space margin subtracted before the X map
+    pub margin: i64,
+    /// Exponential X coefficient; 1 or less disables the X nonlinearity
+    pub x_log_coeff: f64,
+    /// X value past which the exponential part applies
+    pub x_log_threshold: i64,
+    /// Whether the Y nonlinearity is on
+    pub y_nonlinear: bool,
+    /// Lower bound of the nonlinear Y range
+    pub y1: i64,
+    /// Upper bound of the nonlinear Y range
+    pub y2: i64,
+    /// Boundary between the two Y regions, in Dasher units
+    pub y3: i64,
+    /// Boundary between the two Y regions, in screen-space units
+    pub y3_screen: i64,
+}
+
+/// An increasing function sampled at `2^TABLE_INTERVALS_LOG2 + 1` evenly spaced points from zero
+#[derive(Debug, Clone)]
+struct SampledCurve {
+    /// Log2 of the sample spacing
+    step_log2: u32,
+    /// Function values at each sample point
+    samples: Vec<i64>,
+}
+
+impl SampledCurve {
+    fn build(span_log2: u32, f: impl Fn(i64) -> i64) -> Self {
+        let step_log2 = span_log2 - TABLE_INTERVALS_LOG2;
+        let samples = (0..=(1i64 << TABLE_INTERVALS_LOG2))
+            .map(|i| f(i << step_log2))
+            .collect();
+        Self { step_log2, samples }
+    }
+
+    /// Interpolate at `d`, or `None` if `d` is outside the sampled span
+    #[inline]
+    fn eval(&self, d: i64) -> Option<i64> {
+        let index = (d >> self.step_log2) as usize;
+        if d < 0 || index + 1 >= self.samples.len() {
+            return None;
+        }
+        let (a, b) = (self.samples[index], self.samples[index + 1]);
+        let frac = d & ((1 << self.step_log2) - 1);
+        Some(a + (((b - a) as i128 * frac as i128) >> self.step_log2) as i64)
+    }
+
+    /// Find the `d` the curve maps to `value`, or `None` outside the sampled range
+    #[inline]
+    fn invert(&self, value: i64) -> Option<i64> {
+        let upper = self.samples.partition_point(|&sample| sample <= value);
+        if upper == 0 || upper == self.samples.len() {
+            return None;
+        }
+        let index = upper - 1;
+        let (a, b) = (self.samples[index], self.samples[index + 1]);
+        let frac = (((value - a) as i128) << self.step_log2) / (b - a) as i128;
+        Some(((index as i64) << self.step_log2) + frac as i64)
+    }
+}
+
+/// Forward and inverse X/Y maps of a square view
+#[derive(Debug, Clone)]
+pub struct CoordinateMaps {
+    params: MapParams,
+    /// Exponential part of the X map, indexed by distance past the threshold
+    curve_x: Option<SampledCurve>,
+}
+
+impl CoordinateMaps {
+    /// Build the maps for `params`
+    pub fn new(params: MapParams) -> Self {
+        let coeff = params.x_log_coeff;
+        let curve_x = (coeff > 1.0)
+            .then(|| SampledCurve::build(FORWARD_SPAN_LOG2, |d| exact_x_curve(coeff, d)));
+        Self { params, curve_x }
+    }
+
+    /// Get the parameters the maps were built from
+    pub fn params(&self) -> &MapParams {
+        &self.params
+    }
+
+    /// Map Dasher X to screen-space X
+    #[inline]
+    pub fn x_map(&self, dasher_x: i64) -> i64 {
+        let x = dasher_x - self.params.margin;
+        let threshold = self.params.x_log_threshold;
+        match &self.curve_x {
+            Some(curve) if x >= threshold => {
+                let d = x - threshold;
+                curve.eval(d).unwrap_or_else(|| exact_x_curve(self.params.x_log_coeff, d)).saturating_add(threshold)
+            }
+            _ => x,
+        }
+    }
+
+    /// Map screen-space X back to Dasher X
+    #[inline]
+    pub fn ix_map(&self, screen_x: i64) -> i64 {
+        let threshold = self.params.x_log_threshold;
+        let x = match &self.curve_x {
+            Some(curve) if screen_x >= threshold => {
+                let d = screen_x - threshold;
+                curve.invert(d).unwrap_or_else(|| exact_ix_curve(self.params.x_log_coeff, d)) + threshold
+            }
+            _ => screen_x,
+        };
+        x + self.params.margin
+    }
+
+    /// Map Dasher Y to screen-space Y
+    #[inline]
+    pub fn y_map(&self, dasher_y: i64) -> i64 {
+        let MapParams { y_nonlinear, y1, y2, y3, y3_screen, .. } = self.params;
+        if y_nonlinear {
+            if dasher_y > y1 && dasher_y < y3 {
+                return y1 + (dasher_y - y1) * (y3_screen - y1) / (y3 - y1);
+            } else if dasher_y >= y3 && dasher_y < y2 {
+                return y3_screen + (dasher_y - y3) * (y2 - y3_screen) / (y2 - y3);
+            }
+        }
+        dasher_y
+    }
+
+    /// Map screen-space Y back to Dasher Y
+    #[inline]
+    pub fn iy_map(&self, screen_y: i64) -> i64 {
+        let MapParams { y_nonlinear, y1, y2, y3, y3_screen, .. } = self.params;
+        if y_nonlinear {
+            if screen_y > y1 && screen_y < y3_screen {
+                return y1 + (screen_y - y1) * (y3 - y1) / (y3_screen - y1);
+            } else if screen_y >= y3_screen && screen_y < y2 {
+                return y3 + (screen_y - y3_screen) * (y2 - y3) / (y2 - y3_screen);
+            }
+        }
+        screen_y
+    }
+
+    /// Map Dasher X/Y arrays to screen space in place
+    ///
+    /// The loops have no calls or cross-element dependencies, so the compiler
+    /// can vectorise the linear parts.
+    pub fn map_slices(&self, xs: &mut [i64], ys: &mut [i64]) {
+        for x in xs.iter_mut() {
+            *x = self.x_map(*x);
+        }
+        for y in ys.iter_mut() {
+            *y = self.y_map(*y);
+        }
+    }
+}
+
+/// Exponential part of the X map at distance `d` past the threshold
+fn exact_x_curve(coeff: f64, d: i64) -> i64 {
+    let max = DasherModel::MAX_Y as f64;
+    let dx = d as f64 / max;
+    (((dx * coeff).exp() - 1.0) / coeff * max) as i64
+}
+
+/// Logarithmic part of the inverse X map at distance `d` past the threshold
+fn exact_ix_curve(coeff: f64, d: i64) -> i64 {
+    let max = DasherModel::MAX_Y as f64;
+    ((d as f64 * coeff / max + 1.0).ln() / coeff * max) as i64
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn params() -> MapParams {
+        MapParams {
+            margin: 1000,
+            x_log_coeff: f64::exp(4.8 / 3.0),
+            x_log_threshold: DasherModel::MAX_Y / 2,
+            y_nonlinear: true,
+            y1: 0,
+            y2: DasherModel::MAX_Y,
+            y3: DasherModel::MAX_Y / 2,
+            y3_screen: DasherModel::MAX_Y * 7 / 20,
+        }
+    }
+
+    #[test]
+    fn test_tables_follow_exact_curves() {
+        let maps = CoordinateMaps::new(params());
+        let threshold = params().x_log_threshold;
+        let coeff = params().x_log_coeff;
+
+        for d in (0..(1i64 << FORWARD_SPAN_LOG2)).step_by(997) {
+            let exact = exact_x_curve(coeff, d) + threshold;
+            let mapped = maps.x_map(d + threshold + params().margin);
+            assert!((mapped - exact).abs() <= 1 + exact / 100_000, "x_map({}) = {}, expected {}", d, mapped, exact);
+        }
+        for d in (0..(1i64 << 27)).step_by(65_537) {
+            let exact = exact_ix_curve(coeff, d) + threshold + params().margin;
+            let mapped = maps.ix_map(d + threshold);
+            assert!((mapped - exact).abs() <= 2, "ix_map({}) = {}, expected {}", d, mapped, exact);
+        }
+
+        // Beyond the tables the exact curve is used
+        let far = threshold + (1 << FORWARD_SPAN_LOG2) + 12345;
+        assert_eq!(maps.x_map(far + params().margin), exact_x_curve(coeff, far - threshold) + threshold);
+    }
+
+    #[test]
+    fn test_maps_round_trip() {
+        let maps = CoordinateMaps::new(params());
+        for y in (-1000..DasherModel::MAX_Y + 1000).step_by(4099) {
+            assert!((maps.iy_map(maps.y_map(y)) - y).abs() <= 2, "y = {}", y);
+        }
+        for x in (0..DasherModel::MAX_Y * 2).step_by(8191) {
+            let round_trip = maps.ix_map(maps.x_map(x));
+            assert!((round_trip - x).abs() <= 2, "x = {}, round trip {}", x, round_trip);
+        }
+
+        let mut xs = [0, DasherModel::MAX_Y, DasherModel::MAX_Y * 3];
+        let mut ys = [-5, DasherModel::MAX_Y / 4, DasherModel::MAX_Y * 3 / 4];
+        let expected: Vec<_> = xs.iter().zip(&ys).map(|(&x, &y)| (maps.x_map(x), maps.y_map(y))).collect();
+        maps.map_slices(&mut xs, &mut ys);
+        let mapped: Vec<_> = xs.iter().copied().zip(ys.iter().copied()).collect();
+        assert_eq!(mapped, expected);
+    }
+}
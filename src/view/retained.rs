@@ -0,0 +1,113 @@
+//! # Retained Rendering
+//!
+//! While the user pauses or holds the pointer near the crosshair, the tree does
+//! not move between frames, yet a full render still clears and repaints the
+//! whole canvas. In retained mode the square view compares a small key of
+//! everything the scene is drawn from with the one from the previous frame. If
+//! it matches, only the crosshair and cursor overlay are redrawn, or nothing at
+//! all when the cursor has not moved either, and `FrameChange` tells the host
+//! whether it can keep the draw list it already has.
+
+use crate::model::DasherModel;
+use crate::view::draw_buffer::DrawBufferMark;
+use crate::view::nonlinear::MapParams;
+use crate::view::{Orientation, SquareViewConfig};
+
+/// What changed in the last rendered frame
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub enum FrameChange {
+    /// Nothing was drawn; the previous frame is still current
+    Unchanged = 0,
+    /// Only the crosshair and cursor overlay were redrawn
+    Overlay = 1,
+    /// The whole frame was redrawn
+    #[default]
+    Full = 2,
+}
+
+/// Everything the scene below the overlay is drawn from
+#[derive(Debug, Clone, PartialEq)]
+pub(crate) struct SceneKey {
+    /// Address of the root node
+    root: usize,
+    root_bounds: (u32, u32),
+    root_offset: i32,
+    /// Root coordinates in the model
+    root_range: (i64, i64),
+    /// Node counters, which move whenever children are created or expanded
+    nodes_created: u64,
+    expansions: u64,
+    dimensions: (i32, i32),
+    orientation: Orientation,
+    maps: MapParams,
+    config: SquareViewConfig,
+}
+
+impl SceneKey {
+    /// Build the key for rendering `model` with the given view state
+    pub(crate) fn new(model: &DasherModel, dimensions: (i32, i32), orientation: Orientation,
+                      maps: MapParams, config: &SquareViewConfig) -> Self {
+        let (root, root_bounds, root_offset) = match model.get_root_node() {
+            Some(root) => {
+                let node = root.borrow();
+                (std::rc::Rc::as_ptr(&root) as usize, (node.lower_bound(), node.upper_bound()), node.offset())
+            }
+            None => (0, (0, 0), 0),
+        };
+        Self {
+            root,
+            root_bounds,
+            root_offset,
+            root_range: model.root_range(),
+            nodes_created: model.nodes_created(),
+            expansions: model.expansion_count(),
+            dimensions,
+            orientation,
+            maps,
+            config: config.clone(),
+        }
+    }
+}
+
+/// Where the overlay of a frame sits in a draw command buffer
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub(crate) struct BufferMarks {
+    /// End of the scene and start of the overlay
+    pub(crate) scene_end: DrawBufferMark,
+    /// End of the frame
+    pub(crate) frame_end: DrawBufferMark,
+}
+
+/// The last frame drawn in retained mode
+#[derive(Debug, Clone)]
+pub(crate) struct RetainedFrame {
+    pub(crate) scene: SceneKey,
+    /// Cursor position drawn in the overlay, if any
+    pub(crate) cursor: Option<(i32, i32)>,
+    /// Buffer layout when the frame was recorded with `render_into`
+    pub(crate) marks: Option<BufferMarks>,
+}
+
+impl RetainedFrame {
+    /// Decide how much of a frame showing `scene` and `cursor` has to be redrawn
+    ///
+    /// `buffer_end` is the current end of the buffer being rendered into, or
+    /// `None` when drawing to the screen. A screen does not keep its previous
+    /// contents, so anything but an unchanged frame is redrawn in full there.
+    pub(crate) fn change_for(previous: Option<&RetainedFrame>, scene: &SceneKey, cursor: Option<(i32, i32)>,
+                             buffer_end: Option<DrawBufferMark>) -> FrameChange {
+        let previous = match previous {
+            Some(previous) if previous.scene == *scene => previous,
+            _ => return FrameChange::Full,
+        };
+        match (buffer_end, previous.marks) {
+            // The host must hand back the buffer it was given last frame
+            (Some(end), Some(marks)) if end == marks.frame_end => {
+                if previous.cursor == cursor { FrameChange::Unchanged } else { FrameChange::Overlay }
+            }
+            (None, None) if previous.cursor == cursor => FrameChange::Unchanged,
+            _ => FrameChange::Full,
+        }
+    }
+}
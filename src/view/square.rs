@@ -5,14 +5,18 @@ use crate::model::DasherModel;
 use crate::model::node::DasherNode;
 use crate::DasherInput;
 use crate::Result;
-use crate::view::{DasherView, DasherScreen, Orientation, Color, Label};
+use crate::view::{DasherView, DasherScreen, Orientation, Color};
 use crate::view::color_palette;
-use crate::ffi::context;
+use crate::view::draw_buffer::{DrawCommandBuffer, RecordingScreen};
+use crate::view::label_cache::{CachedLabel, LabelCache};
+use crate::view::nonlinear::{CoordinateMaps, MapParams};
+use crate::view::retained::{BufferMarks, FrameChange, RetainedFrame, SceneKey};
+use crate::ffi::context::{self, ffi_debug};
 
 /// Text string for delayed rendering
 struct TextString {
-    /// The label to render
-    label: Box<dyn Label>,
+    /// The label to render, shared with the view's label cache
+    label: Rc<CachedLabel>,
 
     /// X coordinate
     x: i32,
@@ -32,7 +36,7 @@ struct TextString {
 
 impl TextString {
     /// Create a new text string
-    fn new(label: Box<dyn Label>, x: i32, y: i32, size: u32, color: Color) -> Self {
+    fn new(label: Rc<CachedLabel>, x: i32, y: i32, size: u32, color: Color) -> Self {
         Self {
             label,
             x,
@@ -44,11 +48,42 @@ impl TextString {
     }
 }
 
+/// An entry on the explicit stack `render_node` walks the tree with
+enum RenderItem {
+    /// A node with its Dasher bounds, x extent and level below the root
+    Node { node: Rc<RefCell<DasherNode>>, lower: i64, upper: i64, depth: i64, level: usize },
+
+    /// A run of siblings too small to draw individually, filled as one span
+    Span { lower: i64, upper: i64, depth: i64, color: Color },
+}
+
 /// Constants for the Square View
 const SCALE_FACTOR: i64 = 1 << 26; // Large power of 2 for efficient division
 
+/// Work done by the last call to `render`
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct RenderStats {
+    /// Number of node shapes drawn
+    pub nodes_drawn: u32,
+
+    /// Number of labels created for node text (label cache misses)
+    pub labels_created: u32,
+
+    /// Number of spans drawn in place of runs of tiny siblings
+    pub spans_drawn: u32,
+
+    /// Number of visible nodes merged into spans or dropped by the node limit
+    pub nodes_culled: u32,
+
+    /// How much of the frame was redrawn
+    pub frame_change: FrameChange,
+
+    /// Time spent laying out and drawing the delayed text
+    pub text_layout: std::time::Duration,
+}
+
 /// Configuration for the Square View
-#[derive(Debug, Clone)]
+#[derive(Debug, Clone, PartialEq)]
 pub struct SquareViewConfig {
     /// Node shape type
     pub node_shape: NodeShape,
@@ -103,6 +138,18 @@ pub struct SquareViewConfig {
 
     /// Whether to use PPM (Prediction by Partial Match) for node sizing
     pub use_ppm: bool,
+
+    /// On-screen height in pixels below which a node is merged with its tiny neighbours
+    pub min_node_size: i32,
+
+    /// Deepest level below the root that is drawn
+    pub max_render_depth: usize,
+
+    /// Maximum number of shapes drawn per frame
+    pub max_nodes_per_frame: u32,
+
+    /// Skip redrawing the scene while the tree is stationary
+    pub retained_mode: bool,
 }
 
 impl Default for SquareViewConfig {
@@ -126,6 +173,10 @@ impl Default for SquareViewConfig {
             flowing_interface: true, // Enable flowing interface by default
             flowing_speed: 2.0, // Default speed
             use_ppm: true, // Enable PPM by default
+            min_node_size: 2,
+            max_render_depth: 2,
+            max_nodes_per_frame: 4096,
+            retained_mode: false,
         }
     }
 }
@@ -182,6 +233,24 @@ pub struct DasherViewSquare {
 
     /// Configuration for the view
     config: SquareViewConfig,
+
+    /// Command recorder that replaces the screen's drawing calls during `render_into`
+    recorder: Option<RecordingScreen>,
+
+    /// Work done by the last render
+    render_stats: RenderStats,
+
+    /// Labels and text sizes kept across frames
+    label_cache: LabelCache,
+
+    /// Nonlinear coordinate maps, rebuilt when the scale factors or configuration change
+    maps: CoordinateMaps,
+
+    /// Traversal stack reused by `render_node`
+    render_stack: Vec<RenderItem>,
+
+    /// Last frame drawn in retained mode
+    retained: Option<RetainedFrame>,
 }
 
 impl DasherViewSquare {
@@ -225,6 +294,15 @@ impl DasherViewSquare {
             delayed_texts: Vec::new(),
             y3_screen: 0, // Will be calculated in set_scale_factor
             config,
+            recorder: None,
+            render_stats: RenderStats::default(),
+            label_cache: LabelCache::default(),
+            maps: CoordinateMaps::new(MapParams {
+                margin: 0, x_log_coeff: 1.0, x_log_threshold: 0,
+                y_nonlinear: false, y1: 0, y2: 0, y3: 0, y3_screen: 0,
+            }),
+            render_stack: Vec::new(),
+            retained: None,
         };
 
         // Initialize scale factors
@@ -306,16 +384,69 @@ impl DasherViewSquare {
         self.config.draw_outlines = enable;
     }
 
+    /// Set the node size cutoff in pixels, the deepest drawn level and the per-frame shape limit
+    pub fn set_render_limits(&mut self, min_node_size: i32, max_render_depth: usize, max_nodes_per_frame: u32) {
+        self.config.min_node_size = min_node_size.max(0);
+        self.config.max_render_depth = max_render_depth;
+        self.config.max_nodes_per_frame = max_nodes_per_frame.max(1);
+    }
+
     /// Set the margin width
     pub fn set_margin_width(&mut self, width: i64) {
         self.config.margin_width = width;
         self._set_scale_factor(); // Recalculate scale factors
     }
 
+    /// Enable or disable retained mode
+    ///
+    /// In retained mode a frame whose tree, view and configuration match the
+    /// previous frame only redraws the overlay, or nothing at all, and reports
+    /// it in `RenderStats::frame_change`.
+    pub fn set_retained_mode(&mut self, enable: bool) {
+        self.config.retained_mode = enable;
+        self.retained = None;
+    }
+
+    /// Render the model into a draw command buffer instead of the screen
+    ///
+    /// The buffer is cleared first and keeps its capacity, so hosts can pass the same
+    /// buffer every frame. Text is still measured by the screen. In retained mode
+    /// the buffer is only cleared when the scene changed; hosts must then pass the
+    /// buffer from the previous frame, which is kept as it is when nothing changed.
+    pub fn render_into(&mut self, model: &mut DasherModel, buffer: &mut DrawCommandBuffer) -> Result<()> {
+        if !self.config.retained_mode {
+            buffer.clear();
+        }
+
+        let (width, height) = self.get_dimensions();
+        self.recorder = Some(RecordingScreen::new(width, height, std::mem::take(buffer)));
+
+        let result = self.render(model);
+
+        if let Some(recorder) = self.recorder.take() {
+            *buffer = recorder.into_buffer();
+        }
+
+        result
+    }
+
+    /// Get the work done by the last render
+    pub fn last_render_stats(&self) -> RenderStats {
+        self.render_stats
+    }
+
+    /// Get the target for drawing calls: the command recorder if one is active, otherwise the screen
+    fn canvas(&mut self) -> &mut dyn DasherScreen {
+        match &mut self.recorder {
+            Some(recorder) => recorder,
+            None => self.screen.as_mut(),
+        }
+    }
+
     /// Process delayed text rendering
     fn do_delayed_text(&mut self, text: &mut TextString) {
         // Get text dimensions
-        let (_text_width, text_height) = self.screen.text_size(&*text.label, text.size);
+        let (_text_width, text_height) = self.label_cache.text_size(self.screen.as_ref(), &text.label, text.size);
 
         // Calculate text position
         let text_x = text.x;
@@ -336,14 +467,14 @@ impl DasherViewSquare {
 
             // Draw shadow layers
             for i in 1..=depth {
-                self.screen.draw_string(&*text.label, text_x + i, text_y + i, text.size, shadow_color);
+                self.canvas().draw_string(&*text.label, text_x + i, text_y + i, text.size, shadow_color);
             }
 
             // Draw the main text on top
-            self.screen.draw_string(&*text.label, text_x, text_y, text.size, text.color);
+            self.canvas().draw_string(&*text.label, text_x, text_y, text.size, text.color);
         } else {
             // Draw normal text
-            self.screen.draw_string(&*text.label, text_x, text_y, text.size, text.color);
+            self.canvas().draw_string(&*text.label, text_x, text_y, text.size, text.color);
         }
 
         // Process children
@@ -400,6 +531,8 @@ impl DasherViewSquare {
             self.y3_screen = self.config.y3;
         }
 
+        self.refresh_maps();
+
         // Invalidate cached visible region
         self.visible_region = None;
     }
@@ -409,8 +542,10 @@ impl DasherViewSquare {
         // Convert Dasher coordinates to screen coordinates
         let (screen_x, screen_y) = self.dasher_to_screen(max_x, mid_y);
 
-        // Create label object
-        let label_obj = self.screen.make_label(label, 0);
+        // Get the label object, creating it only the first time this text is drawn
+        let misses = self.label_cache.misses();
+        let label_obj = self.label_cache.label(self.screen.as_ref(), label);
+        self.render_stats.labels_created += (self.label_cache.misses() - misses) as u32;
 
         // Calculate font size based on position
         // In C++, font size is scaled based on the distance from the origin
@@ -430,99 +565,72 @@ impl DasherViewSquare {
     }
 
     /// Map Dasher Y coordinate to screen Y coordinate
+    ///
+    /// The C++ implementation uses three regions: a steeper gradient from Y1 to
+    /// Y3, a shallower one from Y3 to Y2, and the identity outside them.
+    #[inline]
     fn y_map(&self, dasher_y: i64) -> i64 {
-        // Check if Y nonlinearity is enabled
-        if self.config.y_nonlinear {
-            // Apply nonlinear mapping based on the C++ implementation
-            // The C++ implementation uses three regions:
-            // 1. Y1 to Y3: Linear mapping with a steeper gradient
-            // 2. Y3 to Y2: Linear mapping with a shallower gradient
-            // 3. Outside these regions: Linear mapping with the original gradient
-
-            let y1 = self.config.y1;
-            let y2 = self.config.y2;
-            let y3 = self.config.y3;
-
-            if dasher_y > y1 && dasher_y < y3 {
-                // Region 1: Steeper gradient
-                let gradient = (y3 - y1) as f64 / (self.y3_screen - y1) as f64;
-                let mapped = y1 + ((dasher_y - y1) as f64 / gradient) as i64;
-                return mapped;
-            } else if dasher_y >= y3 && dasher_y < y2 {
-                // Region 2: Shallower gradient
-                let gradient = (y2 - y3) as f64 / (y2 - self.y3_screen) as f64;
-                let mapped = self.y3_screen + ((dasher_y - y3) as f64 / gradient) as i64;
-                return mapped;
-            }
-        }
-
-        // Linear mapping for regions outside the nonlinear range or if nonlinearity is disabled
-        dasher_y
+        self.maps.y_map(dasher_y)
     }
 
     /// Map Dasher X coordinate to screen X coordinate
+    ///
+    /// Linear up to the threshold and exponential past it, read from a table.
+    #[inline]
     fn _x_map(&self, dasher_x: i64) -> i64 {
-        // Apply margin
-        let x = dasher_x - self.margin_width;
-
-        // Apply logarithmic mapping if enabled
-        if self.x_log_coeff > 1.0 && x >= self.x_log_threshold {
-            // Calculate the logarithmic part
-            let dx = (x - self.x_log_threshold) as f64 / DasherModel::MAX_Y as f64;
-            let dx = ((dx * self.x_log_coeff).exp() - 1.0) / self.x_log_coeff;
-
-            // Combine linear and logarithmic parts
-            let result = (dx * DasherModel::MAX_Y as f64) as i64 + self.x_log_threshold;
-            return result;
-        }
-
-        // Linear mapping for values below threshold
-        x
+        self.maps.x_map(dasher_x)
     }
 
     /// Inverse Y mapping
+    #[inline]
     fn iy_map(&self, screen_y: i64) -> i64 {
-        // Check if Y nonlinearity is enabled
-        if self.config.y_nonlinear {
-            // Apply inverse nonlinear mapping
-            let y1 = self.config.y1;
-            let y2 = self.config.y2;
-            let y3 = self.config.y3;
-            let y3_screen = self.y3_screen;
-
-            if screen_y > y1 && screen_y < y3_screen {
-                // Region 1: Steeper gradient
-                let gradient = (y3 - y1) as f64 / (y3_screen - y1) as f64;
-                let mapped = y1 + ((screen_y - y1) as f64 * gradient) as i64;
-                return mapped;
-            } else if screen_y >= y3_screen && screen_y < y2 {
-                // Region 2: Shallower gradient
-                let gradient = (y2 - y3) as f64 / (y2 - y3_screen) as f64;
-                let mapped = y3 + ((screen_y - y3_screen) as f64 * gradient) as i64;
-                return mapped;
-            }
-        }
-
-        // Linear mapping for regions outside the nonlinear range or if nonlinearity is disabled
-        screen_y
+        self.maps.iy_map(screen_y)
     }
 
     /// Inverse X mapping
+    #[inline]
     fn ix_map(&self, screen_x: i64) -> i64 {
-        // Apply logarithmic mapping if enabled
-        if self.x_log_coeff > 1.0 && screen_x >= self.x_log_threshold {
-            // Calculate the logarithmic part
-            let dx = ((screen_x - self.x_log_threshold) as f64 * self.x_log_coeff / DasherModel::MAX_Y as f64 + 1.0).ln() / self.x_log_coeff;
+        self.maps.ix_map(screen_x)
+    }
 
-            // Combine linear and logarithmic parts
-            let result = (dx * DasherModel::MAX_Y as f64) as i64 + self.x_log_threshold;
+    /// Parameters of the coordinate maps for the current configuration
+    fn map_params(&self) -> MapParams {
+        MapParams {
+            margin: self.margin_width,
+            x_log_coeff: self.x_log_coeff,
+            x_log_threshold: self.x_log_threshold,
+            y_nonlinear: self.config.y_nonlinear,
+            y1: self.config.y1,
+            y2: self.config.y2,
+            y3: self.config.y3,
+            y3_screen: self.y3_screen,
+        }
+    }
 
-            // Apply margin
-            return result + self.margin_width;
+    /// Rebuild the coordinate maps if their parameters changed
+    fn refresh_maps(&mut self) {
+        let params = self.map_params();
+        if params != *self.maps.params() {
+            self.maps = CoordinateMaps::new(params);
         }
+    }
 
-        // Linear mapping for values below threshold
-        screen_x + self.margin_width
+    /// Convert many Dasher points to screen coordinates at once
+    ///
+    /// Equivalent to calling `dasher_to_screen` for each point, with the
+    /// orientation resolved once for the whole batch. `out` is cleared first.
+    pub fn dasher_to_screen_batch(&self, points: &[(i64, i64)], out: &mut Vec<(i32, i32)>) {
+        out.clear();
+        out.reserve(points.len());
+        let (width, height) = self.get_dimensions();
+        let (sx, sy) = (self.scale_factor_x, self.scale_factor_y);
+        let mapped = points.iter().map(|&(x, y)| (self.maps.x_map(x), self.maps.y_map(y)));
+        match self.orientation {
+            Orientation::LeftToRight => out.extend(mapped.map(|(x, y)| ((x / sx) as i32, (y / sy) as i32))),
+            Orientation::RightToLeft => out.extend(mapped.map(|(x, y)| (width - (x / sx) as i32, (y / sy) as i32))),
+            Orientation::TopToBottom => out.extend(mapped.map(|(x, y)| ((y / sy) as i32, (x / sx) as i32))),
+            Orientation::BottomToTop => out.extend(mapped.map(|(x, y)| ((y / sy) as i32, height - (x / sx) as i32))),
+        }
     }
 
     /// Draw a triangle node
@@ -543,7 +651,7 @@ impl DasherViewSquare {
         ];
 
         // Draw filled triangle
-        self.screen.draw_polygon(&points, fill_color, outline_color, line_width);
+        self.canvas().draw_polygon(&points, fill_color, outline_color, line_width);
     }
 
     /// Draw a truncated triangle node
@@ -567,7 +675,7 @@ impl DasherViewSquare {
         ];
 
         // Draw filled polygon
-        self.screen.draw_polygon(&points, fill_color, outline_color, line_width);
+        self.canvas().draw_polygon(&points, fill_color, outline_color, line_width);
     }
 
     /// Draw a quadric node (curved shape)
@@ -635,7 +743,7 @@ impl DasherViewSquare {
         }
 
         // Draw the polygon
-        self.screen.draw_polygon(&points, fill_color, outline_color, line_width);
+        self.canvas().draw_polygon(&points, fill_color, outline_color, line_width);
     }
 
     /// Draw a circle node
@@ -652,17 +760,245 @@ impl DasherViewSquare {
         let screen_radius = (radius as f64 / DasherModel::MAX_Y as f64 * width as f64) as i32;
 
         // Draw the circle
-        self.screen.draw_circle(cx, cy, screen_radius, fill_color, outline_color, line_width);
+        self.canvas().draw_circle(cx, cy, screen_radius, fill_color, outline_color, line_width);
+    }
+
+    /// Clear the screen and draw the tree
+    fn draw_scene(&mut self, model: &DasherModel) {
+        // Get screen dimensions
+        let (width, height) = self.get_dimensions();
+
+        // Clear the screen
+        self.canvas().draw_rectangle(0, 0, width, height, color_palette::WHITE, color_palette::BLACK, 1);
+
+        // Draw the root node and its children
+        if let Some(root) = model.get_root_node() {
+            // Always use the standard render_node method
+            // The flowing interface is handled internally
+            self.render_node(root);
+        }
+    }
+
+    /// Get where the cursor is drawn, if it is drawn
+    fn cursor_position(&self) -> Option<(i32, i32)> {
+        if !self.config.draw_cursor {
+            return None;
+        }
+        // Clone the input device to avoid borrowing issues
+        let input_clone = self.get_input_device()?.box_clone();
+        input_clone.get_screen_coordinates(self)
+    }
+
+    /// Draw the crosshair and cursor
+    fn draw_overlay(&mut self) -> Option<(i32, i32)> {
+        // Draw the crosshair if enabled
+        if self.config.draw_crosshair {
+            self.crosshair();
+        }
+
+        // Draw the cursor if enabled and an input device is available
+        let cursor = self.cursor_position();
+        if let Some((x, y)) = cursor {
+            self.draw_cursor(x, y);
+        }
+        cursor
+    }
+
+    /// Draw the node labels queued while drawing the tree
+    fn draw_delayed_text(&mut self) {
+        let text_start = std::time::Instant::now();
+        let mut delayed_texts = std::mem::take(&mut self.delayed_texts);
+        for text in &mut delayed_texts {
+            self.do_delayed_text(text);
+        }
+        self.render_stats.text_layout = text_start.elapsed();
+    }
+
+    /// Render a frame in retained mode
+    ///
+    /// The overlay is drawn after the labels so that it can be replaced on its
+    /// own in a recorded buffer.
+    fn render_retained(&mut self, model: &DasherModel) -> Result<()> {
+        let scene = SceneKey::new(model, self.get_dimensions(), self.orientation, *self.maps.params(), &self.config);
+        let cursor = self.cursor_position();
+        let buffer_end = self.recorder.as_ref().map(|recorder| recorder.buffer().mark());
+        let change = RetainedFrame::change_for(self.retained.as_ref(), &scene, cursor, buffer_end);
+        self.render_stats.frame_change = change;
+
+        match change {
+            FrameChange::Unchanged => return Ok(()),
+            FrameChange::Overlay => {
+                let scene_end = self.retained.as_ref().and_then(|frame| frame.marks).map(|marks| marks.scene_end);
+                if let (Some(recorder), Some(scene_end)) = (&mut self.recorder, scene_end) {
+                    recorder.buffer_mut().truncate(scene_end);
+                }
+            }
+            FrameChange::Full => {
+                if let Some(recorder) = &mut self.recorder {
+                    recorder.buffer_mut().clear();
+                }
+                self.label_cache.begin_frame();
+                self.draw_scene(model);
+                self.draw_delayed_text();
+            }
+        }
+
+        let scene_end = self.recorder.as_ref().map(|recorder| recorder.buffer().mark());
+        let cursor = self.draw_overlay();
+        let marks = scene_end.zip(self.recorder.as_ref().map(|recorder| recorder.buffer().mark()))
+            .map(|(scene_end, frame_end)| BufferMarks { scene_end, frame_end });
+
+        self.canvas().display();
+        self.retained = Some(RetainedFrame { scene, cursor, marks });
+        Ok(())
+    }
+
+    /// X extent of the root node
+    fn root_depth(&self, offset: i32, width: i32) -> i64 {
+        // Calculate the base node depth (distance from origin)
+        let base_depth = DasherModel::MAX_Y / 4;
+        if !self.config.flowing_interface {
+            return base_depth;
+        }
+
+        // In flowing interface mode, nodes start from the right side of the screen
+        // and move left as they get closer to being selected
+        let depth_factor = 1.0 - (offset as f64 * 0.1).min(0.9);
+        let flowing_depth = (width as f64 * depth_factor * self.config.flowing_speed) as i64;
+        flowing_depth.max(base_depth).min(width as i64 * 2)
+    }
+
+    /// X extent of nodes at `level` whose parent extends to `parent_depth`
+    fn child_depth(&self, parent_depth: i64, level: usize, width: i32) -> i64 {
+        if !self.config.flowing_interface {
+            // In standard mode, children are twice as far from the origin as their parent
+            return parent_depth * 2;
+        }
+
+        // Children sit to the right of their parent, with a wider gap below the root
+        let spacing = if level == 1 { 0.5 } else { 0.2 };
+        parent_depth + (width as f64 * spacing * self.config.flowing_speed) as i64
+    }
+
+    /// Background alpha of nodes at `level` extending to `depth`
+    fn node_alpha(&self, depth: i64, level: usize, width: i32) -> u8 {
+        if level == 1 {
+            // The root's children are always opaque
+            255
+        } else if self.config.flowing_interface {
+            // Make nodes more transparent when they're further away
+            let distance_factor = (depth as f64 / (width as f64 * 2.0)).min(1.0);
+            (255.0 * (1.0 - distance_factor * 0.5)) as u8
+        } else {
+            200
+        }
+    }
+
+    /// On-screen height in pixels of a Dasher y-range
+    fn screen_height_of(&self, lower: i64, upper: i64) -> i64 {
+        (self.y_map(upper) - self.y_map(lower)) / self.scale_factor_y.max(1)
+    }
+
+    /// Draw one node of the render traversal and queue its label
+    fn draw_tree_node(&mut self, node: &Rc<RefCell<DasherNode>>, lower: i64, upper: i64, depth: i64, level: usize, width: i32) {
+        let node_ref = node.borrow();
+        ffi_debug!("render_node: {} at level {}: lower={}, upper={}, depth={}",
+            context::DrawingContext::from_node(node).to_string(), level, lower, upper, depth);
+
+        // If using PPM, scale the drawn height of non-root nodes by probability
+        let (mut shape_lower, mut shape_upper) = (lower, upper);
+        if level > 0 && self.config.use_ppm {
+            let probability = node_ref.cumulative_probability().unwrap_or(0.01) as f64;
+            let new_height = ((upper - lower) as f64 * probability.sqrt() * 2.0) as i64;
+            let center = (lower + upper) / 2;
+            shape_lower = center - new_height / 2;
+            shape_upper = center + new_height / 2;
+        }
+
+        let (r, g, b) = (node_ref.background_color().0, node_ref.background_color().1, node_ref.background_color().2);
+        let bg_color = Color::from_tuple((r, g, b, self.node_alpha(depth, level, width)));
+        let (r, g, b) = (node_ref.foreground_color().0, node_ref.foreground_color().1, node_ref.foreground_color().2);
+        let fg_color = Color::from_tuple((r, g, b, 255));
+
+        self.draw_node_shape(
+            depth,
+            shape_lower,
+            shape_upper,
+            bg_color,
+            if self.config.draw_outlines { color_palette::BLACK } else { color_palette::TRANSPARENT },
+            1
+        );
+
+        if let Some(label) = node_ref.label() {
+            let text_x = match (self.config.flowing_interface, level) {
+                (false, _) => depth / 2,
+                // The root's children label just past their right edge
+                (true, 1) => depth + 20,
+                (true, _) => depth / 4,
+            };
+            let text = self.dasher_draw_text(text_x, (lower + upper) / 2, label, fg_color);
+            self.add_delayed_text(text);
+        }
+    }
+
+    /// Push the visible children of a node onto the render stack, first child on top
+    ///
+    /// Consecutive children below `min_node_size` on screen become one span.
+    #[allow(clippy::too_many_arguments)]
+    fn push_children(&mut self, node: &Rc<RefCell<DasherNode>>, lower: i64, upper: i64, parent_depth: i64,
+                     level: usize, width: i32, (min_y, max_y): (i64, i64), stack: &mut Vec<RenderItem>) {
+        let node_ref = node.borrow();
+        let range = upper - lower;
+        let depth = self.child_depth(parent_depth, level, width);
+        let alpha = self.node_alpha(depth, level, width);
+        let min_size = self.config.min_node_size as i64;
+        let first = stack.len();
+
+        let mut run: Option<(i64, i64, Color)> = None;
+        for child in node_ref.children() {
+            let child_ref = child.borrow();
+            let child_lower = lower + (range * child_ref.lower_bound() as i64) / DasherNode::NORMALIZATION as i64;
+            let child_upper = lower + (range * child_ref.upper_bound() as i64) / DasherNode::NORMALIZATION as i64;
+
+            // Skip nodes that are completely outside the visible region
+            if child_upper < min_y || child_lower > max_y {
+                continue;
+            }
+
+            if self.screen_height_of(child_lower, child_upper) < min_size {
+                self.render_stats.nodes_culled += 1;
+                run = match run {
+                    Some((run_lower, _, color)) => Some((run_lower, child_upper, color)),
+                    None => {
+                        let (r, g, b) = (child_ref.background_color().0, child_ref.background_color().1, child_ref.background_color().2);
+                        Some((child_lower, child_upper, Color::from_tuple((r, g, b, alpha))))
+                    }
+                };
+                continue;
+            }
+
+            if let Some((lower, upper, color)) = run.take() {
+                stack.push(RenderItem::Span { lower, upper, depth, color });
+            }
+            stack.push(RenderItem::Node { node: Rc::clone(child), lower: child_lower, upper: child_upper, depth, level });
+        }
+        if let Some((lower, upper, color)) = run {
+            stack.push(RenderItem::Span { lower, upper, depth, color });
+        }
+
+        // Pop in document order
+        stack[first..].reverse();
     }
 
     /// Draw a node with the current shape
     fn draw_node_shape(&mut self, range: i64, y1: i64, y2: i64, fill_color: Color, outline_color: Color, line_width: i32) {
+        self.render_stats.nodes_drawn += 1;
         match self.config.node_shape {
             NodeShape::Rectangle => {
                 // Draw a rectangle
                 let (sx1, sy1) = self.dasher_to_screen(0, y1);
                 let (sx2, sy2) = self.dasher_to_screen(range, y2);
-                self.screen.draw_rectangle(sx1, sy1, sx2, sy2, fill_color, outline_color, line_width);
+                self.canvas().draw_rectangle(sx1, sy1, sx2, sy2, fill_color, outline_color, line_width);
             }
             NodeShape::Triangle => {
                 // Draw a triangle
@@ -690,13 +1026,13 @@ impl DasherViewSquare {
         let cy = height / 2;
 
         // Draw horizontal line
-        self.screen.draw_line(cx - 10, cy, cx + 10, cy, color_palette::RED, 2);
+        self.canvas().draw_line(cx - 10, cy, cx + 10, cy, color_palette::RED, 2);
 
         // Draw vertical line
-        self.screen.draw_line(cx, cy - 10, cx, cy + 10, color_palette::RED, 2);
+        self.canvas().draw_line(cx, cy - 10, cx, cy + 10, color_palette::RED, 2);
 
         // Draw circle at intersection
-        self.screen.draw_circle(cx, cy, 5, color_palette::RED, color_palette::BLACK, 1);
+        self.canvas().draw_circle(cx, cy, 5, color_palette::RED, color_palette::BLACK, 1);
     }
 
     /// Draw the cursor at the specified position
@@ -707,13 +1043,13 @@ impl DasherViewSquare {
         let cursor_width = 2;
 
         // Draw horizontal line
-        self.screen.draw_line(x - cursor_size, y, x + cursor_size, y, cursor_color, cursor_width);
+        self.canvas().draw_line(x - cursor_size, y, x + cursor_size, y, cursor_color, cursor_width);
 
         // Draw vertical line
-        self.screen.draw_line(x, y - cursor_size, x, y + cursor_size, cursor_color, cursor_width);
+        self.canvas().draw_line(x, y - cursor_size, x, y + cursor_size, cursor_color, cursor_width);
 
         // Draw small circle at intersection
-        self.screen.draw_circle(x, y, 3, cursor_color, color_palette::BLACK, 1);
+        self.canvas().draw_circle(x, y, 3, cursor_color, color_palette::BLACK, 1);
     }
 }
 
@@ -835,7 +1171,7 @@ impl DasherView for DasherViewSquare {
         let (sx1, sy1) = self.dasher_to_screen(x1, y1);
         let (sx2, sy2) = self.dasher_to_screen(x2, y2);
 
-        self.screen.draw_line(sx1, sy1, sx2, sy2, Color::from_tuple(color), line_width);
+        self.canvas().draw_line(sx1, sy1, sx2, sy2, Color::from_tuple(color), line_width);
     }
 
     fn draw_rectangle(&mut self, x1: i64, y1: i64, x2: i64, y2: i64,
@@ -843,7 +1179,7 @@ impl DasherView for DasherViewSquare {
         let (sx1, sy1) = self.dasher_to_screen(x1, y1);
         let (sx2, sy2) = self.dasher_to_screen(x2, y2);
 
-        self.screen.draw_rectangle(sx1, sy1, sx2, sy2,
+        self.canvas().draw_rectangle(sx1, sy1, sx2, sy2,
                                   Color::from_tuple(fill_color),
                                   Color::from_tuple(outline_color),
                                   line_width);
@@ -864,409 +1200,90 @@ impl DasherView for DasherViewSquare {
             }
         };
 
-        self.screen.draw_circle(sx, sy, sr,
+        self.canvas().draw_circle(sx, sy, sr,
                                Color::from_tuple(fill_color),
                                Color::from_tuple(line_color),
                                line_width);
     }
 
     fn render(&mut self, model: &mut DasherModel) -> Result<()> {
-        // Get screen dimensions
-        let (width, height) = self.get_dimensions();
-
-        // Clear the screen
-        self.screen.draw_rectangle(0, 0, width, height, color_palette::WHITE, color_palette::BLACK, 1);
+        self.render_stats = RenderStats::default();
+        // The Y parameters can be edited through `config_mut`
+        self.refresh_maps();
 
-        // Draw the root node and its children
-        if let Some(root) = model.get_root_node() {
-            // Always use the standard render_node method
-            // The flowing interface is handled internally
-            self.render_node(root);
+        if self.config.retained_mode {
+            return self.render_retained(model);
         }
+        self.retained = None;
 
-        // Draw the crosshair if enabled
-        if self.config.draw_crosshair {
-            self.crosshair();
-        }
-
-        // Draw the cursor if enabled and an input device is available
-        if self.config.draw_cursor {
-            if let Some(input) = self.get_input_device() {
-                // Clone the input device to avoid borrowing issues
-                let input_clone = input.box_clone();
-                if let Some((x, y)) = input_clone.get_screen_coordinates(self) {
-                    self.draw_cursor(x, y);
-                }
-            }
-        }
+        self.label_cache.begin_frame();
+        self.draw_scene(model);
+        self.draw_overlay();
 
         // Process delayed text rendering
-        let mut delayed_texts = std::mem::take(&mut self.delayed_texts);
-        for text in &mut delayed_texts {
-            self.do_delayed_text(text);
-        }
+        self.draw_delayed_text();
 
         // Display the frame
-        self.screen.display();
+        self.canvas().display();
 
         Ok(())
     }
 
-    /// Render a node and its children
+    /// Render a node and its visible descendants
+    ///
+    /// The tree is walked depth first with an explicit stack, down to
+    /// `max_render_depth` levels below `node`. Siblings shorter on screen than
+    /// `min_node_size` pixels are not descended into; each run of them is
+    /// filled as a single span, and drawing stops after `max_nodes_per_frame`
+    /// shapes. Each level's x extent, colours and text placement follow the
+    /// flowing interface settings.
     fn render_node(&mut self, node: Rc<RefCell<DasherNode>>) {
-        // Create a drawing context for this node
-        let drawing_context = crate::ffi::context::DrawingContext::from_node(&node);
-
-        // Set the current drawing context
-        crate::ffi::context::set_current_drawing_context(drawing_context.clone());
-
-        // Get the global context
-        let global_context = crate::ffi::context::get_global_context();
-
-        // Log debug information
-        if global_context.get_debug_mode() {
-            global_context.add_debug(&format!("render_node: Starting to render node {}", drawing_context.node_id));
-        }
-
-        let node_ref = node.borrow();
-
-        // Calculate node boundaries in Dasher coordinates
-        let lower = node_ref.lower_bound() as i64;
-        let upper = node_ref.upper_bound() as i64;
-        let _range = upper - lower; // Used later in the method
-
-        // Get the visible region
+        let (width, _height) = self.get_dimensions();
         let (_min_x, min_y, _max_x, max_y) = self.get_visible_region();
 
-        // Skip nodes that are completely outside the visible region
-        if upper < min_y || lower > max_y {
-            if global_context.get_debug_mode() {
-                global_context.add_debug(&format!("render_node: Node {} is outside visible region, skipping", drawing_context.node_id));
-            }
-
-            // Clear the current drawing context
-            crate::ffi::context::clear_current_drawing_context();
-
-            return;
-        }
-
-        // Log node information
-        if global_context.get_debug_mode() {
-            global_context.add_debug(&format!(
-                "render_node: Node {} boundaries: lower={}, upper={}, visible_region=({}, {})",
-                drawing_context.node_id, lower, upper, min_y, max_y
-            ));
-        }
-
-        // Get screen dimensions
-        let (width, height) = self.get_dimensions();
-
-        // Calculate the base node depth (distance from origin)
-        let base_depth = DasherModel::MAX_Y / 4;
-
-        // Calculate the node depth based on the flowing interface settings
-        let node_depth = if self.config.flowing_interface {
-            // In flowing interface mode, nodes start from the right side of the screen
-            // and move left as they get closer to being selected
-
-            // Calculate a depth that places the node on the right side of the screen
-            // and adjusts based on the flowing speed
-            let flow_factor = self.config.flowing_speed;
-            let depth_factor = 1.0 - (node_ref.offset() as f64 * 0.1).min(0.9); // Adjust based on node depth in tree
-
-            // Calculate the flowing depth - higher values = further to the right
-            let flowing_depth = (width as f64 * depth_factor * flow_factor) as i64;
-
-            // Ensure the depth is within reasonable bounds
-            flowing_depth.max(base_depth).min(width as i64 * 2)
-        } else {
-            // In standard mode, use a fixed depth
-            base_depth
+        let (lower, upper, depth) = {
+            let node_ref = node.borrow();
+            (node_ref.lower_bound() as i64, node_ref.upper_bound() as i64, self.root_depth(node_ref.offset(), width))
         };
 
-        // Create colors with appropriate alpha for depth perception
-        let alpha = if self.config.flowing_interface {
-            // Make nodes more transparent when they're further away
-            let distance_factor = (node_depth as f64 / (width as f64 * 2.0)).min(1.0);
-            let alpha_value = (255.0 * (1.0 - distance_factor * 0.5)) as u8;
-            alpha_value
-        } else {
-            200 // Default alpha
-        };
-
-        let bg_color = Color::from_tuple((
-            node_ref.background_color().0,
-            node_ref.background_color().1,
-            node_ref.background_color().2,
-            alpha
-        ));
-
-        let fg_color = Color::from_tuple((
-            node_ref.foreground_color().0,
-            node_ref.foreground_color().1,
-            node_ref.foreground_color().2,
-            255
-        ));
-
-        // Draw the node with the current shape
-        self.draw_node_shape(
-            node_depth,
-            lower,
-            upper,
-            bg_color,
-            if self.config.draw_outlines { color_palette::BLACK } else { color_palette::TRANSPARENT },
-            1
-        );
-
-        // Draw the node label
-        if let Some(label) = node_ref.label() {
-            // Calculate text position based on flowing interface
-            let text_x = if self.config.flowing_interface {
-                // Position text closer to the left edge of the node
-                node_depth / 4
-            } else {
-                // Standard position
-                node_depth / 2
-            };
-
-            // Create a delayed text object
-            let text = self.dasher_draw_text(text_x, (lower + upper) / 2, label, fg_color);
-
-            // Add it to the delayed texts
-            self.add_delayed_text(text);
+        // Skip trees that are completely outside the visible region
+        if upper < min_y || lower > max_y {
+            ffi_debug!("render_node: Root is outside visible region ({}, {}), skipping", lower, upper);
+            return;
         }
 
-        // Render children recursively
-        // We'll do this directly here instead of calling a separate method
-        let node_ref = node.borrow();
-        let range = upper - lower;
-
-        // Calculate the child depth based on the flowing interface settings
-        let child_depth = if self.config.flowing_interface {
-            // In flowing interface mode, children are positioned to the right of their parent
-            // The deeper in the tree, the further to the right
-            let flow_factor = self.config.flowing_speed;
-
-            // Make sure children are visible by using a larger offset
-            let depth_offset = (width as f64 * 0.5 * flow_factor) as i64; // Increased space between parent and child
-
-            // Position children to the right of their parent
-            node_depth + depth_offset
-        } else {
-            // In standard mode, children are twice as far from the origin as their parent
-            node_depth * 2
-        };
-
-        // Debug output to help diagnose rendering issues
-        println!("Rendering child nodes at depth: {}", child_depth);
-
-        // Render each child
-        for child in node_ref.children() {
-            let child_ref = child.borrow();
-
-            // Calculate child boundaries in Dasher coordinates
-            let child_lower = lower + (range * child_ref.lower_bound() as i64) / DasherNode::NORMALIZATION as i64;
-            let child_upper = lower + (range * child_ref.upper_bound() as i64) / DasherNode::NORMALIZATION as i64;
-
-            // Skip nodes that are completely outside the visible region
-            if child_upper < min_y || child_lower > max_y {
-                continue;
-            }
-
-            // If using PPM, adjust the child height based on probability
-            let mut adjusted_lower = child_lower;
-            let mut adjusted_upper = child_upper;
-
-            if self.config.use_ppm {
-                // Calculate the probability
-                let probability = child_ref.cumulative_probability().unwrap_or(0.01) as f64;
-
-                // Adjust the height based on probability
-                let height_factor = probability.sqrt() * 2.0;
-                let child_height = child_upper - child_lower;
-                let new_height = (child_height as f64 * height_factor) as i64;
-
-                // Center the adjusted height
-                let center = (child_lower + child_upper) / 2;
-                adjusted_lower = center - new_height / 2;
-                adjusted_upper = center + new_height / 2;
-            }
-
-            // Create colors with appropriate alpha for depth perception
-            // Always use full opacity for better visibility during debugging
-            let child_alpha = 255; // Full opacity
-
-            // Make child nodes more visible with brighter colors
-            let child_bg_color = Color::from_tuple((
-                child_ref.background_color().0,
-                child_ref.background_color().1,
-                child_ref.background_color().2,
-                child_alpha
-            ));
-
-            let child_fg_color = Color::from_tuple((
-                child_ref.foreground_color().0,
-                child_ref.foreground_color().1,
-                child_ref.foreground_color().2,
-                255
-            ));
-
-            // Debug output to help diagnose rendering issues
-            if let Some(label) = child_ref.label() {
-                println!("Rendering child node with label: {}", label);
-            }
-
-            // Draw the child node with the current shape
-            self.draw_node_shape(
-                child_depth,
-                adjusted_lower,
-                adjusted_upper,
-                child_bg_color,
-                if self.config.draw_outlines { color_palette::BLACK } else { color_palette::TRANSPARENT },
-                1
-            );
-
-            // Draw the child node label
-            if let Some(label) = child_ref.label() {
-                // Calculate text position based on flowing interface
-                let text_x = if self.config.flowing_interface {
-                    // Position text at a fixed position for better visibility during debugging
-                    child_depth + 20 // Fixed offset from the node
-                } else {
-                    // Standard position
-                    child_depth / 2
-                };
-
-                // Create a delayed text object
-                let text = self.dasher_draw_text(text_x, (child_lower + child_upper) / 2, label, child_fg_color);
-
-                // Add it to the delayed texts
-                self.add_delayed_text(text);
+        let mut stack = std::mem::take(&mut self.render_stack);
+        stack.clear();
+        stack.push(RenderItem::Node { node, lower, upper, depth, level: 0 });
 
-                // Debug output
-                println!("Added text '{}' at position ({}, {})",
-                    label, text_x, (child_lower + child_upper) / 2);
+        while let Some(item) = stack.pop() {
+            let drawn = self.render_stats.nodes_drawn + self.render_stats.spans_drawn;
+            if drawn >= self.config.max_nodes_per_frame {
+                self.render_stats.nodes_culled += stack.len() as u32 + 1;
+                ffi_debug!("render_node: Node limit {} reached", self.config.max_nodes_per_frame);
+                break;
             }
 
-            // Recursively render grandchildren if any
-            if !child_ref.children().is_empty() {
-                // Create a new Rc to avoid borrowing issues
-                let child_node = Rc::clone(&child);
-
-                // Render the child's children
-                let child_node_ref = child_node.borrow();
-                for grandchild in child_node_ref.children() {
-                    let grandchild_ref = grandchild.borrow();
-
-                    // Calculate grandchild boundaries
-                    let grandchild_range = child_upper - child_lower;
-                    let grandchild_lower = child_lower + (grandchild_range * grandchild_ref.lower_bound() as i64) / DasherNode::NORMALIZATION as i64;
-                    let grandchild_upper = child_lower + (grandchild_range * grandchild_ref.upper_bound() as i64) / DasherNode::NORMALIZATION as i64;
-
-                    // Skip nodes that are completely outside the visible region
-                    if grandchild_upper < min_y || grandchild_lower > max_y {
-                        continue;
-                    }
-
-                    // Calculate the grandchild depth based on the flowing interface settings
-                    let grandchild_depth = if self.config.flowing_interface {
-                        // In flowing interface mode, grandchildren are positioned to the right of their parent
-                        // The deeper in the tree, the further to the right
-                        let flow_factor = self.config.flowing_speed;
-                        let depth_offset = (width as f64 * 0.2 * flow_factor) as i64; // Space between parent and child
-
-                        // Position grandchildren to the right of their parent
-                        child_depth + depth_offset
-                    } else {
-                        // In standard mode, grandchildren are twice as far from the origin as their parent
-                        child_depth * 2
-                    };
-
-                    // If using PPM, adjust the grandchild height based on probability
-                    let mut adjusted_lower = grandchild_lower;
-                    let mut adjusted_upper = grandchild_upper;
-
-                    if self.config.use_ppm {
-                        // Calculate the probability
-                        let probability = grandchild_ref.cumulative_probability().unwrap_or(0.01) as f64;
-
-                        // Adjust the height based on probability
-                        let height_factor = probability.sqrt() * 2.0;
-                        let grandchild_height = grandchild_upper - grandchild_lower;
-                        let new_height = (grandchild_height as f64 * height_factor) as i64;
-
-                        // Center the adjusted height
-                        let center = (grandchild_lower + grandchild_upper) / 2;
-                        adjusted_lower = center - new_height / 2;
-                        adjusted_upper = center + new_height / 2;
-                    }
-
-                    // Create colors with appropriate alpha for depth perception
-                    let grandchild_alpha = if self.config.flowing_interface {
-                        // Make nodes more transparent when they're further away
-                        let distance_factor = (grandchild_depth as f64 / (width as f64 * 2.0)).min(1.0);
-                        let alpha_value = (255.0 * (1.0 - distance_factor * 0.5)) as u8;
-                        alpha_value
-                    } else {
-                        200 // Default alpha
-                    };
-
-                    let grandchild_bg_color = Color::from_tuple((
-                        grandchild_ref.background_color().0,
-                        grandchild_ref.background_color().1,
-                        grandchild_ref.background_color().2,
-                        grandchild_alpha
-                    ));
-
-                    let grandchild_fg_color = Color::from_tuple((
-                        grandchild_ref.foreground_color().0,
-                        grandchild_ref.foreground_color().1,
-                        grandchild_ref.foreground_color().2,
-                        255
-                    ));
-
-                    // Draw the grandchild node with the current shape
-                    self.draw_node_shape(
-                        grandchild_depth,
-                        adjusted_lower,
-                        adjusted_upper,
-                        grandchild_bg_color,
-                        if self.config.draw_outlines { color_palette::BLACK } else { color_palette::TRANSPARENT },
-                        1
-                    );
-
-                    // Draw the grandchild node label
-                    if let Some(label) = grandchild_ref.label() {
-                        // Calculate text position based on flowing interface
-                        let text_x = if self.config.flowing_interface {
-                            // Position text closer to the left edge of the node
-                            grandchild_depth / 4
-                        } else {
-                            // Standard position
-                            grandchild_depth / 2
-                        };
-
-                        // Create a delayed text object
-                        let text = self.dasher_draw_text(text_x, (grandchild_lower + grandchild_upper) / 2, label, grandchild_fg_color);
-
-                        // Add it to the delayed texts
-                        self.add_delayed_text(text);
+            match item {
+                RenderItem::Span { lower, upper, depth, color } => {
+                    self.render_stats.spans_drawn += 1;
+                    let (sx1, sy1) = self.dasher_to_screen(0, lower);
+                    let (sx2, sy2) = self.dasher_to_screen(depth, upper);
+                    self.canvas().draw_rectangle(sx1, sy1, sx2, sy2, color, color_palette::TRANSPARENT, 0);
+                }
+                RenderItem::Node { node, lower, upper, depth, level } => {
+                    self.draw_tree_node(&node, lower, upper, depth, level, width);
+                    if level < self.config.max_render_depth {
+                        self.push_children(&node, lower, upper, depth, level + 1, width, (min_y, max_y), &mut stack);
                     }
                 }
             }
         }
 
-        // Log completion of rendering this node
-        if global_context.get_debug_mode() {
-            global_context.add_debug(&format!("render_node: Finished rendering node {}", drawing_context.node_id));
-        }
-
-        // Clear the current drawing context
-        crate::ffi::context::clear_current_drawing_context();
+        stack.clear();
+        self.render_stack = stack;
     }
 
-
-
     fn get_input_device(&self) -> Option<&dyn DasherInput> {
         self.input_device.as_deref()
     }
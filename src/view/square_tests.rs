@@ -2,8 +2,9 @@
 mod tests {
     use std::cell::RefCell;
     use std::rc::Rc;
+    use crate::model::DasherModel;
     use crate::model::node::DasherNode;
-    use crate::view::{Color, DasherScreen, DasherView, Label, Orientation};
+    use crate::view::{Color, DasherScreen, DasherView, DrawCommandBuffer, DrawCommandKind, FrameChange, Label, Orientation};
     use crate::view::square::{DasherViewSquare, NodeShape, SquareViewConfig};
 
     // Mock implementation of DasherScreen for testing
@@ -210,6 +211,10 @@ mod tests {
             flowing_interface: true,
             flowing_speed: 2.0,
             use_ppm: true,
+            min_node_size: 2,
+            max_render_depth: 2,
+            max_nodes_per_frame: 4096,
+            retained_mode: false,
         };
         let view = DasherViewSquare::with_config(screen, config);
 
@@ -376,6 +381,173 @@ mod tests {
         view.config_mut().x_nonlinear = false;
         assert!(!view.config().x_nonlinear);
     }
+
+    #[test]
+    fn test_square_view_batch_transform_matches_single() {
+        let screen = Box::new(MockScreen::new(800, 600));
+        let mut view = DasherViewSquare::new(screen);
+        view.set_x_nonlinear(true);
+        view.set_y_nonlinear(true);
+
+        let points: Vec<(i64, i64)> = (0..64)
+            .map(|i| (i * DasherModel::MAX_X / 8, i * DasherModel::MAX_Y / 48 - 1000))
+            .collect();
+        let mut batch = Vec::new();
+        view.dasher_to_screen_batch(&points, &mut batch);
+        let single: Vec<_> = points.iter().map(|&(x, y)| view.dasher_to_screen(x, y)).collect();
+        assert_eq!(batch, single);
+
+        // Screen to Dasher and back lands within a pixel, allowing for truncation
+        let (x, y) = view.screen_to_dasher(600, 200);
+        let (sx, sy) = view.dasher_to_screen(x, y);
+        assert!((sx - 600).abs() <= 1 && (sy - 200).abs() <= 1, "({}, {})", sx, sy);
+    }
+
+    #[test]
+    fn test_square_view_merges_tiny_siblings() {
+        const TINY: u32 = 200;
+        let norm = DasherNode::NORMALIZATION;
+        let big = norm * 9 / 20;
+
+        let build_root = || {
+            // The root spans the whole Dasher Y range so the large children clear the size cutoff
+            let mut root = DasherNode::new(0, Some("root".to_string()));
+            root.set_bounds(0, DasherModel::MAX_Y as u32);
+            let root = Rc::new(RefCell::new(root));
+
+            // A large child, a run of tiny ones, then another large child
+            let mut bounds = vec![(0, big)];
+            let tiny_span = norm - 2 * big;
+            for i in 0..TINY {
+                bounds.push((big + tiny_span * i / TINY, big + tiny_span * (i + 1) / TINY));
+            }
+            bounds.push((norm - big, norm));
+            for (i, (lower, upper)) in bounds.into_iter().enumerate() {
+                let mut child = DasherNode::new(1, Some(format!("c{}", i)));
+                child.set_bounds(lower, upper);
+                root.borrow_mut().add_child(Rc::new(RefCell::new(child)));
+            }
+            root
+        };
+
+        let screen = Box::new(MockScreen::new(800, 600));
+        let mut view = DasherViewSquare::new(screen);
+        view.render_node(build_root());
+
+        // The root and both large children are drawn, the tiny run becomes one span
+        let stats = view.last_render_stats();
+        assert_eq!(stats.nodes_drawn, 3);
+        assert_eq!(stats.spans_drawn, 1);
+        assert_eq!(stats.nodes_culled, TINY);
+
+        // The shape limit stops the traversal early
+        let screen = Box::new(MockScreen::new(800, 600));
+        let mut view = DasherViewSquare::with_config(screen, SquareViewConfig {
+            max_nodes_per_frame: 2,
+            ..SquareViewConfig::default()
+        });
+        view.render_node(build_root());
+        let stats = view.last_render_stats();
+        assert_eq!(stats.nodes_drawn + stats.spans_drawn, 2);
+        assert_eq!(stats.nodes_culled, TINY + 2);
+    }
+
+    #[test]
+    fn test_square_view_retained_mode() {
+        use crate::input::{DasherInput, MouseInput};
+        use crate::view::square_tests::DasherViewSquareExt;
+
+        let screen = Box::new(MockScreen::new(800, 600));
+        let mut view = DasherViewSquare::new(screen);
+        view.set_retained_mode(true);
+        let mut model = DasherModel::new();
+        let mut root = DasherNode::new(0, Some("a".to_string()));
+        root.set_bounds(0, DasherNode::NORMALIZATION);
+        model.set_node(Rc::new(RefCell::new(root)));
+
+        let mut mouse = MouseInput::new();
+        mouse.activate();
+        mouse.set_coordinates(100, 100);
+        view.set_input_device(Box::new(mouse.clone()));
+
+        let mut buffer = DrawCommandBuffer::new();
+        view.render_into(&mut model, &mut buffer).unwrap();
+        assert_eq!(view.last_render_stats().frame_change, FrameChange::Full);
+        let full = buffer.commands().to_vec();
+
+        // A stationary frame leaves the buffer as it was
+        view.render_into(&mut model, &mut buffer).unwrap();
+        assert_eq!(view.last_render_stats().frame_change, FrameChange::Unchanged);
+        assert_eq!(view.last_render_stats().nodes_drawn, 0);
+        assert_eq!(buffer.commands(), &full[..]);
+
+        // Moving the cursor only replaces the overlay at the end of the buffer
+        mouse.set_coordinates(200, 150);
+        view.set_input_device(Box::new(mouse.clone()));
+        view.render_into(&mut model, &mut buffer).unwrap();
+        assert_eq!(view.last_render_stats().frame_change, FrameChange::Overlay);
+        assert_eq!(buffer.len(), full.len());
+        assert_ne!(buffer.commands(), &full[..]);
+        assert!(buffer.commands().iter().any(|c| c.kind == DrawCommandKind::Line && c.y1 == 150));
+
+        // A different buffer, or a changed configuration, is drawn in full
+        let mut other = DrawCommandBuffer::new();
+        view.render_into(&mut model, &mut other).unwrap();
+        assert_eq!(view.last_render_stats().frame_change, FrameChange::Full);
+        view.set_draw_outlines(!view.config().draw_outlines);
+        view.render_into(&mut model, &mut other).unwrap();
+        assert_eq!(view.last_render_stats().frame_change, FrameChange::Full);
+
+        // On a screen, a stationary frame makes no drawing calls
+        view.render(&mut model).unwrap();
+        let calls = view.get_screen_for_testing().get_draw_calls().len();
+        view.render(&mut model).unwrap();
+        assert_eq!(view.last_render_stats().frame_change, FrameChange::Unchanged);
+        assert_eq!(view.get_screen_for_testing().get_draw_calls().len(), calls);
+    }
+
+    #[test]
+    fn test_square_view_render_into_buffer() {
+        use crate::view::square_tests::DasherViewSquareExt;
+
+        let screen = Box::new(MockScreen::new(800, 600));
+        let mut view = DasherViewSquare::new(screen);
+        let mut model = DasherModel::new();
+
+        let mut root = DasherNode::new(0, Some("a".to_string()));
+        root.set_bounds(0, DasherNode::NORMALIZATION);
+        model.set_node(Rc::new(RefCell::new(root)));
+
+        let mut buffer = DrawCommandBuffer::new();
+        view.render_into(&mut model, &mut buffer).unwrap();
+
+        // Everything went into the buffer, nothing to the screen
+        assert!(view.get_screen_for_testing().get_draw_calls().is_empty());
+        assert_eq!(buffer.commands()[0].kind, DrawCommandKind::Rectangle);
+        assert!(buffer.commands().iter().any(|c| c.kind == DrawCommandKind::String && buffer.string_text(c) == "a"));
+
+        // The render counted its work
+        let stats = view.last_render_stats();
+        assert!(stats.nodes_drawn > 0);
+        assert!(stats.labels_created > 0);
+
+        // Rendering again reuses the buffer rather than appending to it
+        let first_len = buffer.len();
+        view.render_into(&mut model, &mut buffer).unwrap();
+        assert_eq!(buffer.len(), first_len);
+
+        // Labels come from the cache and keep their id between frames
+        assert_eq!(view.last_render_stats().labels_created, 0);
+        let label_id = buffer.commands().iter()
+            .find(|c| c.kind == DrawCommandKind::String)
+            .map(|c| c.label_id)
+            .unwrap();
+        assert_ne!(label_id, 0);
+
+        // Plain rendering still goes to the screen
+        view.render(&mut model).unwrap();
+        assert!(!view.get_screen_for_testing().get_draw_calls().is_empty());
+    }
 }
 
 // Add this extension trait to access the screen for testing
@@ -0,0 +1,247 @@
+//! # Vertex Buffer
+//!
+//! Tessellates a frame's `DrawCommandBuffer` into a flat triangle list that a
+//! GPU can draw in one call. Web hosts read the vertices straight out of WASM
+//! linear memory as a `Float32Array`, so a frame crosses the JS boundary once
+//! instead of once per primitive.
+//!
+//! Each `Vertex` is a screen-space position in pixels followed by its color
+//! packed as RGBA bytes, which WebGL reads with a normalized `UNSIGNED_BYTE`
+//! attribute. Rectangles, circles, lines, polygons and their outlines all
+//! become triangles in painting order. Strings are not tessellated: they are
+//! listed as `LabelInstance`s, drawn after the triangles, whose text stays in
+//! the command buffer. Like the command buffer, the vertex buffer keeps its
+//! allocations between frames.
+
+use crate::view::draw_buffer::{DrawCommand, DrawCommandBuffer, DrawCommandKind, DrawPoint};
+
+/// Fewest segments a circle is drawn with
+const MIN_CIRCLE_SEGMENTS: usize = 8;
+
+/// Most segments a circle is drawn with
+const MAX_CIRCLE_SEGMENTS: usize = 64;
+
+/// A triangle corner
+#[repr(C)]
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub struct Vertex {
+    pub x: f32,
+    pub y: f32,
+    /// Color packed with `Color::to_packed`, red in the low byte
+    pub color: u32,
+}
+
+/// A string to draw on top of the triangles
+#[repr(C)]
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub struct LabelInstance {
+    pub x: f32,
+    pub y: f32,
+    pub font_size: f32,
+    /// Text color packed with `Color::to_packed`
+    pub color: u32,
+    /// Id of the cached label, or 0; see `DrawCommand::label_id`
+    pub label_id: u32,
+    /// Offset of the UTF-8 text in the command buffer's text array
+    pub text_offset: u32,
+    /// Length of the text in bytes
+    pub text_len: u32,
+}
+
+/// Reusable triangle list for one frame
+#[derive(Debug, Default)]
+pub struct VertexBuffer {
+    vertices: Vec<Vertex>,
+    labels: Vec<LabelInstance>,
+}
+
+impl VertexBuffer {
+    /// Create a new, empty vertex buffer
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Remove all vertices and labels, keeping the allocated capacity
+    pub fn clear(&mut self) {
+        self.vertices.clear();
+        self.labels.clear();
+    }
+
+    /// Get the triangle list, three vertices per triangle
+    pub fn vertices(&self) -> &[Vertex] {
+        &self.vertices
+    }
+
+    /// Get the labels, in painting order
+    pub fn labels(&self) -> &[LabelInstance] {
+        &self.labels
+    }
+
+    /// Replace the contents with the tessellation of `commands`
+    pub fn build(&mut self, commands: &DrawCommandBuffer) {
+        self.clear();
+        for command in commands.commands() {
+            self.push_command(commands, command);
+        }
+    }
+
+    fn push_command(&mut self, commands: &DrawCommandBuffer, command: &DrawCommand) {
+        let (x1, y1, x2, y2) = (command.x1 as f32, command.y1 as f32, command.x2 as f32, command.y2 as f32);
+        let width = command.line_width as f32;
+        match command.kind {
+            DrawCommandKind::Rectangle => {
+                let corners = [(x1, y1), (x2, y1), (x2, y2), (x1, y2)];
+                if is_visible(command.fill_color) {
+                    self.push_quad(corners, command.fill_color);
+                }
+                if is_visible(command.outline_color) && width > 0.0 {
+                    self.push_outline(&corners, command.outline_color, width);
+                }
+            }
+            DrawCommandKind::Circle => {
+                let radius = x2;
+                if radius <= 0.0 {
+                    return;
+                }
+                let segments = (radius as usize / 2).clamp(MIN_CIRCLE_SEGMENTS, MAX_CIRCLE_SEGMENTS);
+                let step = std::f32::consts::TAU / segments as f32;
+                let mut points = [(0.0, 0.0); MAX_CIRCLE_SEGMENTS];
+                for (i, point) in points[..segments].iter_mut().enumerate() {
+                    let angle = i as f32 * step;
+                    *point = (x1 + radius * angle.cos(), y1 + radius * angle.sin());
+                }
+                if is_visible(command.fill_color) {
+                    self.push_fan(&points[..segments], command.fill_color);
+                }
+                if is_visible(command.outline_color) && width > 0.0 {
+                    self.push_outline(&points[..segments], command.outline_color, width);
+                }
+            }
+            DrawCommandKind::Line => {
+                if is_visible(command.fill_color) {
+                    self.push_segment((x1, y1), (x2, y2), command.fill_color, width.max(1.0), 0.0);
+                }
+            }
+            DrawCommandKind::Polygon => {
+                let points = commands.polygon_points(command);
+                if points.len() < 3 {
+                    return;
+                }
+                let corner = |p: &DrawPoint| (p.x as f32, p.y as f32);
+                if is_visible(command.fill_color) {
+                    // Node shapes are convex, so a fan from the first corner covers them
+                    let first = corner(&points[0]);
+                    for pair in points[1..].windows(2) {
+                        self.push_triangle([first, corner(&pair[0]), corner(&pair[1])], command.fill_color);
+                    }
+                }
+                if is_visible(command.outline_color) && width > 0.0 {
+                    for (i, point) in points.iter().enumerate() {
+                        let next = &points[(i + 1) % points.len()];
+                        self.push_segment(corner(point), corner(next), command.outline_color, width, width / 2.0);
+                    }
+                }
+            }
+            DrawCommandKind::String => {
+                self.labels.push(LabelInstance {
+                    x: x1,
+                    y: y1,
+                    font_size: command.font_size as f32,
+                    color: command.fill_color,
+                    label_id: command.label_id,
+                    text_offset: command.data_offset,
+                    text_len: command.data_len,
+                });
+            }
+        }
+    }
+
+    fn push_triangle(&mut self, corners: [(f32, f32); 3], color: u32) {
+        self.vertices.extend(corners.iter().map(|&(x, y)| Vertex { x, y, color }));
+    }
+
+    /// Push a quad with corners in order around its edge
+    fn push_quad(&mut self, corners: [(f32, f32); 4], color: u32) {
+        self.push_triangle([corners[0], corners[1], corners[2]], color);
+        self.push_triangle([corners[0], corners[2], corners[3]], color);
+    }
+
+    /// Fill a convex polygon, given as corners in order around its edge
+    fn push_fan(&mut self, corners: &[(f32, f32)], color: u32) {
+        for pair in corners[1..].windows(2) {
+            self.push_triangle([corners[0], pair[0], pair[1]], color);
+        }
+    }
+
+    /// Stroke a closed outline through `corners`
+    fn push_outline(&mut self, corners: &[(f32, f32)], color: u32, width: f32) {
+        for (i, &corner) in corners.iter().enumerate() {
+            // Extending each edge by half the width closes the corners
+            self.push_segment(corner, corners[(i + 1) % corners.len()], color, width, width / 2.0);
+        }
+    }
+
+    /// Push a line from `a` to `b` as a quad, `width` wide and extended by `cap` at both ends
+    fn push_segment(&mut self, a: (f32, f32), b: (f32, f32), color: u32, width: f32, cap: f32) {
+        let (dx, dy) = (b.0 - a.0, b.1 - a.1);
+        let length = (dx * dx + dy * dy).sqrt();
+        if length == 0.0 {
+            return;
+        }
+        let (ux, uy) = (dx / length, dy / length);
+        let (nx, ny) = (-uy * width / 2.0, ux * width / 2.0);
+        let (a, b) = ((a.0 - ux * cap, a.1 - uy * cap), (b.0 + ux * cap, b.1 + uy * cap));
+        self.push_quad([(a.0 + nx, a.1 + ny), (b.0 + nx, b.1 + ny), (b.0 - nx, b.1 - ny), (a.0 - nx, a.1 - ny)], color);
+    }
+}
+
+/// Check whether a packed color has any opacity
+#[inline]
+fn is_visible(color: u32) -> bool {
+    color >> 24 != 0
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::view::color_palette;
+
+    #[test]
+    fn test_tessellates_commands_in_order() {
+        let mut commands = DrawCommandBuffer::new();
+        commands.push_rectangle(0, 0, 10, 20, color_palette::WHITE, color_palette::TRANSPARENT, 1);
+        commands.push_rectangle(0, 0, 10, 20, color_palette::TRANSPARENT, color_palette::BLACK, 2);
+        commands.push_polygon(&[(0, 0), (5, 5), (0, 10), (-5, 5)], color_palette::RED, color_palette::TRANSPARENT, 1);
+        commands.push_line(0, 0, 0, 0, color_palette::BLACK, 1);
+        commands.push_string("abc", 3, 4, 12, color_palette::BLUE);
+        commands.push_circle(50, 50, 4, color_palette::RED, color_palette::TRANSPARENT, 1);
+
+        let mut vertices = VertexBuffer::new();
+        vertices.build(&commands);
+
+        // A filled rectangle is two triangles covering it
+        let fill = &vertices.vertices()[..6];
+        assert!(fill.iter().all(|v| v.color == color_palette::WHITE.to_packed()));
+        assert_eq!(fill.iter().map(|v| (v.x, v.y)).fold((0.0f32, 0.0f32), |m, p| (m.0.max(p.0), m.1.max(p.1))), (10.0, 20.0));
+
+        // Outline quads are capped to close the corners
+        let outline = &vertices.vertices()[6..30];
+        assert!(outline.iter().all(|v| v.color == color_palette::BLACK.to_packed()));
+        assert_eq!(outline.iter().map(|v| v.x).fold(f32::MAX, f32::min), -1.0);
+
+        // The quadrilateral becomes a fan of two, the empty line nothing,
+        // and the circle its minimum number of segments less two
+        let total = vertices.vertices().len();
+        assert_eq!(total, 30 + 6 + (MIN_CIRCLE_SEGMENTS - 2) * 3);
+        assert_eq!(vertices.labels().len(), 1);
+        let label = vertices.labels()[0];
+        assert_eq!((label.x, label.y, label.font_size), (3.0, 4.0, 12.0));
+        assert_eq!(&commands.text()[label.text_offset as usize..][..label.text_len as usize], b"abc");
+
+        // Rebuilding reuses the allocations
+        let capacity = vertices.vertices.capacity();
+        vertices.build(&commands);
+        assert_eq!(vertices.vertices.capacity(), capacity);
+        assert_eq!(vertices.vertices().len(), total);
+    }
+}
@@ -10,7 +10,7 @@ use web_sys::{CanvasRenderingContext2d, HtmlCanvasElement};
 use std::collections::HashMap;
 
 use crate::api::DasherInterface;
-use crate::view::{Color, DasherScreen, Label};
+use crate::view::{Color, DasherScreen, DrawCommandBuffer, Label, VertexBuffer};
 use crate::settings::Settings;
 
 /// WebAssembly bindings for the Dasher interface
@@ -18,6 +18,10 @@ use crate::settings::Settings;
 pub struct DasherInterfaceWasm {
     interface: DasherInterface,
     screen: Option<WebDasherScreen>,
+    /// Commands of the last frame drawn with `render_vertices`
+    commands: DrawCommandBuffer,
+    /// Tessellation of `commands`
+    vertices: VertexBuffer,
 }
 
 #[wasm_bindgen]
@@ -36,6 +40,8 @@ impl DasherInterfaceWasm {
         Ok(DasherInterfaceWasm {
             interface,
             screen: None,
+            commands: DrawCommandBuffer::new(),
+            vertices: VertexBuffer::new(),
         })
     }
 
@@ -55,6 +61,82 @@ impl DasherInterfaceWasm {
         self.interface.new_frame(time_ms)
     }
 
+    /// Render with `render_vertices` into a `width` x `height` pixel viewport
+    ///
+    /// Use this instead of `set_canvas` when the page draws with WebGL or
+    /// WebGPU, which cannot share a canvas with a 2D context.
+    #[wasm_bindgen]
+    pub fn set_viewport(&mut self, width: i32, height: i32) -> Result<(), JsValue> {
+        self.screen = None;
+        self.interface.change_screen(Box::new(ViewportScreen { width, height }))
+            .map_err(|e| JsValue::from_str(&format!("Failed to change screen: {}", e)))
+    }
+
+    /// Process a new frame, tessellating it instead of drawing to a canvas
+    ///
+    /// Afterwards `vertices` and `labels` view the frame in linear memory.
+    #[wasm_bindgen]
+    pub fn render_vertices(&mut self, time_ms: u64) -> bool {
+        let running = self.interface.render_into(time_ms, &mut self.commands);
+        self.vertices.build(&self.commands);
+        running
+    }
+
+    /// Get the number of vertices of the last `render_vertices` frame
+    #[wasm_bindgen]
+    pub fn vertex_count(&self) -> u32 {
+        self.vertices.vertices().len() as u32
+    }
+
+    /// View the triangle list of the last `render_vertices` frame
+    ///
+    /// Three words per vertex: x and y in pixels as floats, then the color as
+    /// RGBA bytes, to read with a normalized `UNSIGNED_BYTE` attribute at byte
+    /// offset 8 with a 12 byte stride. The view is not a copy: it is only
+    /// valid until the next call into the module, which may move memory.
+    #[wasm_bindgen]
+    pub fn vertices(&self) -> js_sys::Float32Array {
+        let vertices = self.vertices.vertices();
+        // SAFETY: `Vertex` is `repr(C)` with three 4-byte fields, and the
+        // view is documented to die with the next call that could move it
+        unsafe {
+            let words = std::slice::from_raw_parts(vertices.as_ptr() as *const f32, vertices.len() * 3);
+            js_sys::Float32Array::view(words)
+        }
+    }
+
+    /// Get the number of labels of the last `render_vertices` frame
+    #[wasm_bindgen]
+    pub fn label_count(&self) -> u32 {
+        self.vertices.labels().len() as u32
+    }
+
+    /// View the labels of the last `render_vertices` frame
+    ///
+    /// Seven words per label: x, y and font size as floats, then color, label
+    /// id, text offset and text length as `u32`, read through a `Uint32Array`
+    /// on the same buffer. Labels with a non-zero id keep it while they stay
+    /// cached, so pages only need `label_text` for ids they have not seen.
+    /// Valid until the next call into the module, like `vertices`.
+    #[wasm_bindgen]
+    pub fn labels(&self) -> js_sys::Float32Array {
+        let labels = self.vertices.labels();
+        // SAFETY: `LabelInstance` is `repr(C)` with seven 4-byte fields
+        unsafe {
+            let words = std::slice::from_raw_parts(labels.as_ptr() as *const f32, labels.len() * 7);
+            js_sys::Float32Array::view(words)
+        }
+    }
+
+    /// Get the text of label `index` of the last `render_vertices` frame
+    #[wasm_bindgen]
+    pub fn label_text(&self, index: u32) -> Option<String> {
+        let label = self.vertices.labels().get(index as usize)?;
+        let start = label.text_offset as usize;
+        let bytes = self.commands.text().get(start..start + label.text_len as usize)?;
+        std::str::from_utf8(bytes).ok().map(str::to_string)
+    }
+
     /// Set the mouse position
     #[wasm_bindgen]
     pub fn set_mouse_position(&mut self, x: i32, y: i32) -> Result<(), JsValue> {
@@ -239,6 +321,49 @@ impl DasherScreen for WebDasherScreen {
     }
 }
 
+/// Screen with a size but no canvas, for frames drawn from vertex buffers
+///
+/// Every frame is recorded with `render_into`, so nothing is ever drawn here.
+struct ViewportScreen {
+    width: i32,
+    height: i32,
+}
+
+impl DasherScreen for ViewportScreen {
+    fn get_width(&self) -> i32 {
+        self.width
+    }
+
+    fn get_height(&self) -> i32 {
+        self.height
+    }
+
+    fn make_label(&self, text: &str, wrap_size: u32) -> Box<dyn Label> {
+        Box::new(WebLabel::new(text, wrap_size))
+    }
+
+    fn text_size(&self, label: &dyn Label, font_size: u32) -> (i32, i32) {
+        // Same approximation the recording screen uses
+        (label.get_text().len() as i32 * (font_size / 2) as i32, font_size as i32)
+    }
+
+    fn draw_string(&mut self, _label: &dyn Label, _x: i32, _y: i32, _font_size: u32, _color: Color) {}
+
+    fn draw_rectangle(&mut self, _x1: i32, _y1: i32, _x2: i32, _y2: i32,
+                     _fill_color: Color, _outline_color: Color, _line_width: i32) {}
+
+    fn draw_circle(&mut self, _cx: i32, _cy: i32, _r: i32,
+                  _fill_color: Color, _line_color: Color, _line_width: i32) {}
+
+    fn draw_line(&mut self, _x1: i32, _y1: i32, _x2: i32, _y2: i32, _color: Color, _line_width: i32) {}
+
+    fn display(&mut self) {}
+
+    fn is_point_visible(&self, _x: i32, _y: i32) -> bool {
+        true
+    }
+}
+
 /// WebAssembly implementation of Label
 #[derive(Clone)]
 pub struct WebLabel {
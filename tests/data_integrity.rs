@@ -2,7 +2,7 @@
 
 use std::fs;
 use std::path::Path;
-use dasher_core::alphabet::{load_alphabet, load_color_schemes};
+use dasher_core::alphabet::{load_alphabet, load_color_schemes, load_symbol_table};
 
 #[test]
 fn test_all_alphabet_xmls_loadable() {
@@ -27,6 +27,32 @@ fn test_all_alphabet_xmls_loadable() {
     }
 }
 
+#[test]
+fn test_large_alphabet_symbol_table() {
+    let path = Path::new(env!("CARGO_MANIFEST_DIR"))
+        .join("data/alphabets/autoConverted/alphabet.cantonese.trad.by.cangjie.xml");
+    let source = fs::read_to_string(&path).expect("read failed");
+    let nodes = source.matches("<node ").count();
+
+    let table = load_symbol_table(&path).expect("symbol table failed to load");
+    assert_eq!(table.len(), nodes);
+    assert!(table.iter().all(|(label, text)| !label.is_empty() && !text.is_empty()));
+}
+
+#[test]
+fn test_alphabet_glyphs() {
+    let path = Path::new(env!("CARGO_MANIFEST_DIR")).join("data/alphabets/alphabet.english.with.limited.punctuation.xml");
+    let alphabet = load_symbol_table(&path).expect("symbol table failed to load").into_alphabet();
+    let glyphs: Vec<char> = alphabet.glyphs().chars().collect();
+
+    // Sorted, without repeats, and covering every label and output character
+    assert!(glyphs.windows(2).all(|pair| pair[0] < pair[1]));
+    for symbol in alphabet.symbols() {
+        assert!(symbol.display_text.chars().all(|c| glyphs.contains(&c)), "{:?}", symbol.display_text);
+    }
+    assert!(glyphs.len() < 256, "English needs {} glyphs", glyphs.len());
+}
+
 #[test]
 fn test_all_color_xmls_loadable() {
     let data_dir = Path::new(env!("CARGO_MANIFEST_DIR")).join("data/colors");